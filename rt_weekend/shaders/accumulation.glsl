@@ -0,0 +1,97 @@
+// Accumulation of the frames, shared by raytrace.rgen, wavefront_resolve.comp
+// and accumulation_bench.comp. Mirrors accumulateFrame in
+// src/render/accumulation.cpp, keep both in sync.
+//
+// The state image is only accessed here: the running mean as floats in rgb,
+// and in alpha the frame count in 14.2 fixed point (bits 0-15) and the
+// compensation of each channel in 5 signed bits (16-20, 21-25, 26-30). The
+// display image gets the mean and the count for the passes reading the result.
+// In the compensated mode, the rounding error of each update of the mean is
+// kept (Kahan summation) and removed from the next one, in half ulps of the
+// mean.
+
+// AccumulationMode
+#define ACCUMULATION_AVERAGE 0
+#define ACCUMULATION_COMPENSATED 1
+
+// ACCUMULATION_COUNT_SCALE, ACCUMULATION_COMPENSATION_STEPS
+const float ACCUMULATION_COUNT_SCALE        = 4.0;
+const float ACCUMULATION_COMPENSATION_STEPS = 15.0;
+
+layout(binding = 1, set = 0, rgba16f) uniform writeonly image2D image;
+layout(binding = 7, set = 0, rgba32ui) uniform uimage2D accumState;
+
+struct AccumulationPixel
+{
+  vec3  mean;
+  float count;
+  vec3  compensation;  // In half ulps of the mean
+};
+
+AccumulationPixel decodeAccumulation(uvec4 texel)
+{
+  AccumulationPixel pixel;
+  pixel.mean  = uintBitsToFloat(texel.rgb);
+  pixel.count = float(texel.a & 0xFFFFu) / ACCUMULATION_COUNT_SCALE;
+
+  ivec3 steps        = ivec3(bitfieldExtract(int(texel.a), 16, 5), bitfieldExtract(int(texel.a), 21, 5),
+                             bitfieldExtract(int(texel.a), 26, 5));
+  pixel.compensation = vec3(steps) * (1.0 / ACCUMULATION_COMPENSATION_STEPS);
+  return pixel;
+}
+
+uvec4 encodeAccumulation(AccumulationPixel pixel)
+{
+  uvec3 steps = uvec3(ivec3(roundEven(pixel.compensation * ACCUMULATION_COMPENSATION_STEPS))) & 0x1Fu;
+  uint  alpha = uint(pixel.count * ACCUMULATION_COUNT_SCALE) | (steps.r << 16) | (steps.g << 21) | (steps.b << 26);
+  return uvec4(floatBitsToUint(pixel.mean), alpha);
+}
+
+AccumulationPixel loadAccumulation(ivec2 pixel)
+{
+  return decodeAccumulation(imageLoad(accumState, pixel));
+}
+
+void storeAccumulation(ivec2 pixel, AccumulationPixel state)
+{
+  imageStore(accumState, pixel, encodeAccumulation(state));
+  imageStore(image, pixel, vec4(state.mean, state.count));
+}
+
+// `history`: state of the pixel, `continued` is false on the first frame and
+// when the history was reprojected. Returns the new state.
+AccumulationPixel accumulateFrame(AccumulationPixel history, vec3 color, bool continued, int mode)
+{
+  AccumulationPixel pixel;
+  float             count = history.count + 1.0;
+
+  if(mode == ACCUMULATION_COMPENSATED)
+  {
+    // frexp(): |m| in [2^(e-1), 2^e), of ulp 2^(e-24)
+    vec3  m = history.mean;
+    ivec3 exponent;
+    frexp(m, exponent);
+    vec3 c = continued ? ldexp(history.compensation, exponent - 25) : vec3(0.0);
+
+    // `precise`: the compiler must not simplify (t - m) - y to 0
+    precise vec3 y = (color - m) / count - c;
+    precise vec3 t = m + y;
+    precise vec3 e = (t - m) - y;
+
+    frexp(t, exponent);
+    vec3 steps = roundEven(ldexp(e, 25 - exponent) * ACCUMULATION_COMPENSATION_STEPS);
+    steps      = clamp(steps, -ACCUMULATION_COMPENSATION_STEPS, ACCUMULATION_COMPENSATION_STEPS);
+
+    pixel.mean         = t;
+    pixel.compensation = steps * (1.0 / ACCUMULATION_COMPENSATION_STEPS);
+  }
+  else
+  {
+    pixel.mean         = mix(history.mean, color, 1.0 / count);
+    pixel.compensation = vec3(0.0);
+  }
+
+  // Stored in fixed point, saturated
+  pixel.count = min(roundEven(count * ACCUMULATION_COUNT_SCALE), 65535.0) / ACCUMULATION_COUNT_SCALE;
+  return pixel;
+}
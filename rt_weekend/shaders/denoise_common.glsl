@@ -0,0 +1,64 @@
+// Shared by the denoiser compute passes, see src/application_impl_denoise.cpp
+// and the CPU reference in src/denoise/atrous_filter.cpp
+
+#define DENOISE_GROUP_SIZE 16
+
+// clang-format off
+layout(binding = 0, rgba16f) uniform readonly image2D accumImage;
+layout(binding = 1, rgba16f) uniform readonly image2D gbufferNormalDepth;
+layout(binding = 2, rgba8)   uniform readonly image2D gbufferAlbedo;
+layout(binding = 3, rgba16f) uniform image2D historyColor[2];
+layout(binding = 4, rgba16f) uniform image2D historyMoments[2];
+layout(binding = 5, rgba16f) uniform image2D historyNormalDepth[2];
+layout(binding = 6, rgba16f) uniform image2D pingImages[2];
+layout(binding = 7, rgba16f) uniform writeonly image2D outputImage;
+// clang-format on
+
+layout(binding = 8) uniform CameraProperties
+{
+    mat4 view;
+    mat4 proj;
+    mat4 viewInverse;
+    mat4 projInverse;
+    mat4 prevView;
+    mat4 prevProj;
+}
+cam;
+
+layout(push_constant) uniform DenoiseConstants
+{
+    int   historyIndex;  // History images written this frame, the other ones are read
+    int   historyValid;
+    int   iteration;
+    int   iterations;
+    float sigmaLuminance;
+    float sigmaNormal;
+    float sigmaDepth;
+    float maxHistory;
+}
+pc;
+
+const float ALBEDO_EPSILON = 1e-3;
+const float DEPTH_EPSILON  = 1e-3;
+const float LUM_EPSILON    = 1e-4;
+
+float luminance(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Filtering is done on the illumination only, to keep texture details
+vec3 demodulate(vec3 color, vec3 albedo)
+{
+    return color / max(albedo, vec3(ALBEDO_EPSILON));
+}
+
+vec3 remodulate(vec3 illumination, vec3 albedo)
+{
+    return illumination * max(albedo, vec3(ALBEDO_EPSILON));
+}
+
+bool insideImage(ivec2 p, ivec2 size)
+{
+    return all(greaterThanEqual(p, ivec2(0))) && all(lessThan(p, size));
+}
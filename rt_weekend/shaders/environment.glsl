@@ -0,0 +1,115 @@
+// Environment map and its importance sampling, see Environment in
+// src/sampling/environment.hpp: an equirectangular radiance map, u along the
+// azimuth, v from +Y down to -Y, and the piecewise constant distribution
+// proportional to its luminance built on the CPU. Directions are sampled from
+// the marginal CDF of the rows then the conditional CDF of the row.
+//
+// Expects random.glsl (MATH_PI). The distribution is only declared when
+// ENVIRONMENT_DISTRIBUTION is defined, the compute shaders only look the map
+// up.
+
+// clang-format off
+layout(binding = 8, set = 1) uniform sampler2D environmentMap;
+#ifdef ENVIRONMENT_DISTRIBUTION
+layout(binding = 11, set = 1) readonly buffer EnvironmentDistribution_
+{
+  uvec4 size;   // width, height
+  float cdf[];  // Marginal (height + 1), then the conditional of each row (width + 1 each)
+} envDist;
+#endif
+// clang-format on
+
+vec2 environmentDirectionToUv(vec3 direction)
+{
+  float u = atan(direction.x, -direction.z) / (2.0 * MATH_PI) + 0.5;
+  float v = acos(clamp(direction.y, -1.0, 1.0)) / MATH_PI;
+  return vec2(u, v);
+}
+
+vec3 environmentUvToDirection(vec2 uv)
+{
+  float phi      = (uv.x - 0.5) * 2.0 * MATH_PI;
+  float theta    = uv.y * MATH_PI;
+  float sinTheta = sin(theta);
+  return vec3(sinTheta * sin(phi), cos(theta), -sinTheta * cos(phi));
+}
+
+vec3 environmentRadiance(vec3 direction)
+{
+  return textureLod(environmentMap, environmentDirectionToUv(normalize(direction)), 0.0).rgb;
+}
+
+// Power heuristic, weight of the strategy of density `pdf`
+float misWeight(float pdf, float otherPdf)
+{
+  float a = pdf * pdf;
+  float b = otherPdf * otherPdf;
+  return a + b > 0.0 ? a / (a + b) : 0.0;
+}
+
+#ifdef ENVIRONMENT_DISTRIBUTION
+
+// Largest float below 1, keeps the samples in their texel
+const float ENVIRONMENT_MAX_OFFSET = 0.99999994;
+
+// First interval of the CDF starting at `offset` whose upper bound is above
+// `u`, same search as findInterval in environment.cpp
+uint findInterval(uint offset, uint count, float u)
+{
+  uint first = 0;
+  while(count > 0)
+  {
+    uint step = count / 2;
+    uint it   = first + step;
+    if(envDist.cdf[offset + it + 1] <= u)
+    {
+      first = it + 1;
+      count -= step + 1;
+    }
+    else
+    {
+      count = step;
+    }
+  }
+  return first;
+}
+
+// Solid angle density of the direction sampled from `uv`, in the texel (x, y)
+float environmentPdf(uvec2 texel, float v)
+{
+  uint  width    = envDist.size.x;
+  uint  height   = envDist.size.y;
+  uint  row      = height + 1 + texel.y * (width + 1);
+  float py       = envDist.cdf[texel.y + 1] - envDist.cdf[texel.y];
+  float px       = envDist.cdf[row + texel.x + 1] - envDist.cdf[row + texel.x];
+  float sinTheta = sin(v * MATH_PI);
+  return sinTheta > 0.0 ? py * float(height) * px * float(width) / (2.0 * MATH_PI * MATH_PI * sinTheta) : 0.0;
+}
+
+float environmentPdf(vec3 direction)
+{
+  uvec2 size  = envDist.size.xy;
+  vec2  uv    = environmentDirectionToUv(normalize(direction));
+  uvec2 texel = min(uvec2(uv * vec2(size)), size - 1);
+  return environmentPdf(texel, uv.y);
+}
+
+// Direction in xyz, solid angle density in w. `u` in [0, 1)^2.
+vec4 sampleEnvironment(vec2 u)
+{
+  uint width  = envDist.size.x;
+  uint height = envDist.size.y;
+
+  uint  y  = findInterval(0, height, u.y);
+  float py = envDist.cdf[y + 1] - envDist.cdf[y];
+  float v  = (float(y) + min((u.y - envDist.cdf[y]) / py, ENVIRONMENT_MAX_OFFSET)) / float(height);
+
+  uint  row = height + 1 + y * (width + 1);
+  uint  x   = findInterval(row, width, u.x);
+  float px  = envDist.cdf[row + x + 1] - envDist.cdf[row + x];
+  float s   = (float(x) + min((u.x - envDist.cdf[row + x]) / px, ENVIRONMENT_MAX_OFFSET)) / float(width);
+
+  return vec4(environmentUvToDirection(vec2(s, v)), environmentPdf(uvec2(x, y), v));
+}
+
+#endif
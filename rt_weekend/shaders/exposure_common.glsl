@@ -0,0 +1,28 @@
+// Bindings and constants of the exposure passes, see
+// src/application_impl_exposure.cpp
+
+// clang-format off
+layout(binding = 0) uniform sampler2D sourceImage;  // Displayed by post.frag
+layout(binding = 1) buffer Exposure_
+{
+  ExposureState state;
+  uint          histogram[EXPOSURE_HISTOGRAM_BINS];
+} exposure;
+// clang-format on
+
+// ExposureSettings
+layout(push_constant) uniform ExposureConstants
+{
+  float minLog2;
+  float maxLog2;
+  float lowPercentile;
+  float highPercentile;
+  float keyValue;
+  float compensation;
+  float speedUp;
+  float speedDown;
+  float deltaSeconds;
+  int   autoExposure;
+  int   reset;  // Jumps to the target, no adaptation
+}
+pc;
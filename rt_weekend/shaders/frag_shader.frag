@@ -3,6 +3,7 @@
 #extension GL_EXT_nonuniform_qualifier : enable
 #extension GL_GOOGLE_include_directive : enable
 #extension GL_EXT_scalar_block_layout : enable
+#extension GL_EXT_buffer_reference : require
 
 #include "wavefront.glsl"
 
@@ -26,10 +27,8 @@ layout(location = 4) in vec3 worldPos;
 // Outgoing
 layout(location = 0) out vec4 outColor;
 // Buffers
-layout(binding = 1, scalar) buffer MatColorBufferObject { WaveFrontMaterial m[]; } materials[];
 layout(binding = 2, scalar) buffer ScnDesc { sceneDesc i[]; } scnDesc;
 layout(binding = 3) uniform sampler2D[] textureSamplers;
-layout(binding = 4, scalar) buffer MatIndex { int i[]; } matIdx[];
 
 // clang-format on
 
@@ -37,11 +36,11 @@ layout(binding = 4, scalar) buffer MatIndex { int i[]; } matIdx[];
 void main()
 {
   // Object of this instance
-  int objId = scnDesc.i[pushC.instanceId].objId;
+  sceneDesc inst = scnDesc.i[pushC.instanceId];
 
   // Material of the object
-  int               matIndex = matIdx[nonuniformEXT(objId)].i[gl_PrimitiveID];
-  WaveFrontMaterial mat      = materials[nonuniformEXT(objId)].m[matIndex];
+  int               matIndex = inst.matIndices.i[gl_PrimitiveID];
+  WaveFrontMaterial mat      = inst.materials.m[matIndex];
 
   vec3 N = normalize(fragNormal);
 
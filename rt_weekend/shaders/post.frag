@@ -1,12 +1,22 @@
 #version 450
+#extension GL_GOOGLE_include_directive : enable
+#include "tone_mapping.glsl"
+
 layout(location = 0) in vec2 outUV;
 layout(location = 0) out vec4 fragColor;
 
 layout(set = 0, binding = 0) uniform sampler2D noisyTxt;
+// Adapted by exposure_adapt.comp, the histogram that follows is not read
+layout(set = 0, binding = 1) readonly buffer Exposure_
+{
+  ExposureState state;
+}
+exposure;
 
 layout(push_constant) uniform shaderInformation
 {
   float aspectRatio;
+  int   toneMapper;
 }
 pushc;
 
@@ -14,5 +24,7 @@ void main()
 {
   vec2  uv    = outUV;
   float gamma = 1. / 2.2;
-  fragColor   = pow(texture(noisyTxt, uv).rgba, vec4(gamma));
+  vec4  color = texture(noisyTxt, uv).rgba;
+  vec3  ldr   = toneMap(pushc.toneMapper, color.rgb * exposure.state.exposure);
+  fragColor   = vec4(pow(ldr, vec3(gamma)), color.a);
 }
@@ -37,19 +37,14 @@ float rnd(inout uint prev)
     return (float(lcg(prev)) / float(0x01000000));
 }
 
+// Uniform direction on the unit sphere (normalizing a cube sample is not uniform)
 vec3 rndSphereSurfaceVec(inout uint prev)
 {
-    float x = rnd(prev) * 2.0f - 1.0f;
-    float y = rnd(prev) * 2.0f - 1.0f;
-    float z = rnd(prev) * 2.0f - 1.0f;
+    float z   = 1.0f - 2.0f * rnd(prev);
+    float r   = sqrt(max(0.0f, 1.0f - z * z));
+    float phi = 2.0f * MATH_PI * rnd(prev);
 
-    vec3 dir = vec3(x, y, z);
-
-    if (length(dir) < 0.00001f) {
-        return normalize(vec3(1.0f));
-    }
-
-    return normalize(dir);
+    return vec3(r * cos(phi), r * sin(phi), z);
 }
 
 vec3 rndHemisphereVec(inout uint prev, vec3 normal)
@@ -1,14 +1,57 @@
+// Set when the raygen runs the bounce loop (iterative path tracing): the
+// closest-hit shaders return the scattered ray instead of tracing it
+layout(constant_id = 0) const bool PATH_ITERATIVE = false;
+// Bounces of a path, chosen per pipeline (see ShaderConstant in
+// shader_permutations.hpp). Constant id 2 is specific to a shader.
+layout(constant_id = 1) const int MAX_PATH_DEPTH = 8;
+// Next event estimation of the environment on the diffuse surfaces, combined
+// with the BSDF sampling by multiple importance sampling
+layout(constant_id = 3) const bool SAMPLE_ENVIRONMENT = true;
+
+// Random sequence of one path, see sampling.glsl
+struct SamplerState
+{
+  int   type;
+  uint  index;      // Sample index in the pixel sequence
+  uint  dimension;  // Next dimension to draw
+  uint  seed;       // Scrambling seed, or LCG state
+  uvec2 pixel;
+};
+
 struct hitPayload
 {
   vec3 hitValue;
   bool hasHit;
   int depth;
+  // Primary hit surface, written to the G-buffer by the raygen
+  vec3  normal;
+  float hitT;  // < 0 on miss
+  vec3  albedo;
+  // Carried along the path so bounces keep drawing new dimensions
+  SamplerState samplerState;
+  // Scattered ray for PATH_ITERATIVE, tMin and tMax in w
+  vec4 rayOrigin;
+  vec4 rayDirection;
+  vec3 attenuation;
+  // Solid angle density the ray was sampled with, weights the environment
+  // when it misses. 0 for the camera and specular rays: no weighting.
+  float bsdfPdf;
+  // Environment sample of PATH_ITERATIVE, traced by the raygen from
+  // rayOrigin: direction and tMax, contribution when not occluded
+  vec4 lightDirection;
+  vec3 lightValue;
 };
 
+// Low byte of Sphere.material, RGB8 albedo in the upper bytes
+const uint SPHERE_DIFFUSE = 0;
+const uint SPHERE_METAL   = 1;
+const uint SPHERE_GLASS   = 2;
+
 struct Sphere
 {
   highp vec3  center;
   highp float radius;
+  uint        material;
 };
 
 struct Aabb
@@ -0,0 +1,61 @@
+// Camera reprojection helpers, the G-buffer stores the distance along the
+// primary ray instead of a projected depth
+
+// World position of the primary hit of `pixel`, at `hitT` along the ray
+vec3 reconstructWorldPosition(vec2 pixel, vec2 size, float hitT, mat4 viewInverse, mat4 projInverse)
+{
+    vec2 d         = (pixel + vec2(0.5)) / size * 2.0 - 1.0;
+    vec4 origin    = viewInverse * vec4(0, 0, 0, 1);
+    vec4 target    = projInverse * vec4(d.x, d.y, 1, 1);
+    vec4 direction = viewInverse * vec4(normalize(target.xyz), 0);
+
+    return origin.xyz + direction.xyz * hitT;
+}
+
+// Distance stored in the G-buffer for the primary hit of a jittered ray, at
+// `hitPos` from `origin` with `normal`: where the ray through the pixel
+// center meets the tangent plane of the hit, so that the position
+// reconstructed above lies on the surface. The jittered distance is kept
+// where the center ray grazes that plane.
+float pixelCenterHitT(vec2 pixel, vec2 size, vec3 origin, vec3 hitPos, vec3 normal, mat4 viewInverse, mat4 projInverse)
+{
+    vec3  direction = reconstructWorldPosition(pixel, size, 1.0, viewInverse, projInverse) - origin;
+    float hitT      = length(hitPos - origin);
+    float cosine    = dot(direction, normal);
+    float centerT   = abs(cosine) > 1e-6 ? dot(hitPos - origin, normal) / cosine : -1.0;
+    return (centerT > 0.5 * hitT && centerT < 2.0 * hitT) ? centerT : hitT;
+}
+
+// Camera position of a rigid view matrix
+vec3 cameraPosition(mat4 view)
+{
+    return -(transpose(mat3(view)) * view[3].xyz);
+}
+
+// Continuous pixel coordinates of `worldPos` seen from another camera,
+// returns false when the point is behind that camera
+bool projectToPixel(vec3 worldPos, mat4 view, mat4 proj, vec2 size, out vec2 pixel)
+{
+    vec4 clip = proj * view * vec4(worldPos, 1.0);
+    if(clip.w <= 0.0)
+    {
+        return false;
+    }
+
+    vec2 ndc = clip.xy / clip.w;
+    pixel    = (ndc * 0.5 + 0.5) * size - vec2(0.5);
+    return true;
+}
+
+// Disocclusion test between the current surface and a history sample
+bool isHistoryConsistent(vec3 normal, float expectedHitT, vec4 prevNormalDepth)
+{
+    if(prevNormalDepth.w <= 0.0)
+    {
+        return false;
+    }
+
+    bool sameDepth  = abs(prevNormalDepth.w - expectedHitT) <= 0.05 * expectedHitT;
+    bool sameNormal = dot(normal, prevNormalDepth.xyz) >= 0.9;
+    return sameDepth && sameNormal;
+}
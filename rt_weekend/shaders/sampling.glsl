@@ -0,0 +1,164 @@
+// Sampler library, mirrored on the CPU by src/sampling/sampler.hpp: both
+// must be kept in sync. The includer must also include raycommon.glsl
+// (SamplerState) and random.glsl (tea, lcg).
+
+#define SAMPLER_LCG 0         // tea seeded LCG, the original sampler
+#define SAMPLER_SOBOL_OWEN 1  // Sobol sequence, hash-based Owen scrambling per pixel
+#define SAMPLER_BLUE_NOISE 2  // Sobol sequence, one global Owen scrambling, blue-noise rotation per pixel
+
+#define SOBOL_DIMENSIONS 16
+#define SOBOL_BITS 32
+#define BLUE_NOISE_SIZE 64
+
+const uint  BLUE_NOISE_SEED   = 0x68bc21ebu;
+const float ONE_MINUS_EPSILON = 0.99999994;
+
+// Uploaded from SamplerTables::pack()
+layout(binding = 6, set = 0, std430) readonly buffer SamplerTables
+{
+    uint  sobolMatrices[SOBOL_DIMENSIONS * SOBOL_BITS];
+    float blueNoise[BLUE_NOISE_SIZE * BLUE_NOISE_SIZE];
+}
+samplerTables;
+
+// lowbias32, Chris Wellons
+uint hashUint(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint hashCombine(uint seed, uint value)
+{
+    return seed ^ (hashUint(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// Burley 2020, "Practical Hash-based Owen Scrambling"
+uint nestedUniformScramble(uint x, uint seed)
+{
+    x = bitfieldReverse(x);
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return bitfieldReverse(x);
+}
+
+uint sobol(uint index, uint dim)
+{
+    uint result = 0;
+    uint column = dim * SOBOL_BITS;
+    for(; index != 0; index >>= 1, ++column)
+    {
+        if((index & 1u) != 0)
+        {
+            result ^= samplerTables.sobolMatrices[column];
+        }
+    }
+    return result;
+}
+
+// Maps 32 random bits to [0, 1), keeping the 24 bits a float can hold
+float toUnitFloat(uint bits)
+{
+    return min(float(bits >> 8) * (1.0 / 16777216.0), ONE_MINUS_EPSILON);
+}
+
+// `index` is the index of the sample in the pixel sequence
+SamplerState samplerInit(int type, uvec2 pixel, uint width, uint index)
+{
+    SamplerState s;
+    s.type      = type;
+    s.index     = index;
+    s.dimension = 0;
+    s.pixel     = pixel;
+
+    if(type == SAMPLER_LCG)
+    {
+        s.seed = tea(pixel.y * width + pixel.x, index);
+    }
+    else if(type == SAMPLER_SOBOL_OWEN)
+    {
+        s.seed = hashUint(pixel.y * width + pixel.x);
+    }
+    else
+    {
+        s.seed = BLUE_NOISE_SEED;
+    }
+    return s;
+}
+
+// Draws the next dimension of the sequence
+float sampleNext(inout SamplerState s)
+{
+    uint dim = s.dimension++;
+
+    if(s.type == SAMPLER_LCG)
+    {
+        return float(lcg(s.seed)) / float(0x01000000);
+    }
+
+    // Dimensions past the tables are padded with independently scrambled
+    // copies; the index is shuffled per group to decorrelate them
+    uint groupSeed = hashCombine(s.seed, dim / SOBOL_DIMENSIONS);
+    uint shuffled  = nestedUniformScramble(s.index, groupSeed);
+    uint bits      = nestedUniformScramble(sobol(shuffled, dim % SOBOL_DIMENSIONS), hashCombine(groupSeed, dim + 1));
+
+    float u = toUnitFloat(bits);
+    if(s.type == SAMPLER_BLUE_NOISE)
+    {
+        // Cranley-Patterson rotation, the texture is shifted for every dimension
+        uvec2 texel = (s.pixel + dim * uvec2(41u, 23u)) % BLUE_NOISE_SIZE;
+        u += samplerTables.blueNoise[texel.y * BLUE_NOISE_SIZE + texel.x];
+        u = min(u >= 1.0 ? u - 1.0 : u, ONE_MINUS_EPSILON);
+    }
+    return u;
+}
+
+vec2 sampleNext2D(inout SamplerState s)
+{
+    float x = sampleNext(s);
+    float y = sampleNext(s);
+    return vec2(x, y);
+}
+
+// Duff et al. 2017, "Building an Orthonormal Basis, Revisited"
+vec3 toWorld(vec3 local, vec3 n)
+{
+    float signZ = n.z >= 0.0 ? 1.0 : -1.0;
+    float a     = -1.0 / (signZ + n.z);
+    float b     = n.x * n.y * a;
+
+    vec3 tangent   = vec3(1.0 + signZ * n.x * n.x * a, signZ * b, -signZ * n.x);
+    vec3 bitangent = vec3(b, signZ + n.y * n.y * a, -n.y);
+    return tangent * local.x + bitangent * local.y + n * local.z;
+}
+
+vec3 sampleUniformSphere(vec2 u)
+{
+    float z   = 1.0 - 2.0 * u.x;
+    float r   = sqrt(max(0.0, 1.0 - z * z));
+    float phi = 2.0 * MATH_PI * u.y;
+    return vec3(r * cos(phi), r * sin(phi), z);
+}
+
+vec3 sampleUniformHemisphere(vec2 u, vec3 normal)
+{
+    float z   = u.x;
+    float r   = sqrt(max(0.0, 1.0 - z * z));
+    float phi = 2.0 * MATH_PI * u.y;
+    return toWorld(vec3(r * cos(phi), r * sin(phi), z), normal);
+}
+
+vec3 sampleCosineHemisphere(vec2 u, vec3 normal)
+{
+    float r   = sqrt(u.x);
+    float phi = 2.0 * MATH_PI * u.y;
+    float z   = sqrt(max(0.0, 1.0 - u.x));
+    return toWorld(vec3(r * cos(phi), r * sin(phi), z), normal);
+}
@@ -0,0 +1,85 @@
+// Shared by exposure_histogram.comp, exposure_adapt.comp and post.frag, see
+// the CPU reference in src/render/tone_mapping.cpp
+
+#define EXPOSURE_HISTOGRAM_BINS 256
+#define EXPOSURE_GROUP_SIZE 16
+
+// ToneMapper
+#define TONE_MAPPER_CLAMP 0
+#define TONE_MAPPER_REINHARD 1
+#define TONE_MAPPER_ACES 2
+#define TONE_MAPPER_FILMIC 3
+
+// Written by exposure_adapt.comp, read by post.frag
+struct ExposureState
+{
+  float exposure;     // Linear scale of the radiance
+  float exposureLog2; // Adapted value
+  float averageLog2;  // Metered in the last frame
+  uint  valid;        // The exposure was set once, adaptation starts from it
+};
+
+float luminance(vec3 color)
+{
+  return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+uint luminanceBin(float lum, float minLog2, float maxLog2)
+{
+  // Also rejects NaN
+  if(!(lum > 0.0))
+    return 0;
+  float value = log2(lum);
+  if(value < minLog2)
+    return 0;
+  float t = (value - minLog2) / (maxLog2 - minLog2) * float(EXPOSURE_HISTOGRAM_BINS - 1);
+  return 1 + min(uint(t), EXPOSURE_HISTOGRAM_BINS - 2);
+}
+
+float binLog2(uint bin, float minLog2, float maxLog2)
+{
+  return minLog2 + (float(bin) - 0.5) * (maxLog2 - minLog2) / float(EXPOSURE_HISTOGRAM_BINS - 1);
+}
+
+// Fit of the ACES RRT and ODT by Stephen Hill, column-major matrices
+const mat3 ACES_INPUT  = mat3(0.59719, 0.07600, 0.02840, 0.35458, 0.90834, 0.13383, 0.04823, 0.01566, 0.83777);
+const mat3 ACES_OUTPUT = mat3(1.60475, -0.10208, -0.00327, -0.53108, 1.10813, -0.07276, -0.07367, -0.00605, 1.07602);
+
+vec3 rrtAndOdtFit(vec3 v)
+{
+  vec3 a = v * (v + 0.0245786) - 0.000090537;
+  vec3 b = v * (0.983729 * v + 0.4329510) + 0.238081;
+  return a / b;
+}
+
+// Uncharted 2 curve by John Hable
+vec3 hableCurve(vec3 x)
+{
+  const float A = 0.15;  // Shoulder strength
+  const float B = 0.50;  // Linear strength
+  const float C = 0.10;  // Linear angle
+  const float D = 0.20;  // Toe strength
+  const float E = 0.02;  // Toe numerator
+  const float F = 0.30;  // Toe denominator
+  return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+}
+
+// Exposed radiance to display [0, 1], before the gamma
+vec3 toneMap(int toneMapper, vec3 color)
+{
+  vec3 c = max(color, vec3(0.0));
+  if(toneMapper == TONE_MAPPER_REINHARD)
+  {
+    c = c / (1.0 + c);
+  }
+  else if(toneMapper == TONE_MAPPER_ACES)
+  {
+    c = ACES_OUTPUT * rrtAndOdtFit(ACES_INPUT * c);
+  }
+  else if(toneMapper == TONE_MAPPER_FILMIC)
+  {
+    const float white = 11.2;
+    c = hableCurve(c) / hableCurve(vec3(white));
+  }
+  return clamp(c, 0.0, 1.0);
+}
@@ -1,6 +1,7 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_EXT_scalar_block_layout : enable
+#extension GL_EXT_buffer_reference : require
 #extension GL_GOOGLE_include_directive : enable
 
 #include "wavefront.glsl"
@@ -0,0 +1,118 @@
+// Virtual textures, see ResidencyManager: the virtual levels of a texture are
+// read from the page pool through the page table, its tail from the bindless
+// texture of its slot. The pages that would have been sampled are requested
+// in the feedback buffer, read back on the CPU.
+//
+// Expects `textureSamplers` and the push constants `pushC` to be declared.
+// Outside of the hit shaders, the includer defines the pixel and the hit
+// distance of the sample (see wavefront_shade.comp).
+
+#ifndef VT_PIXEL
+#define VT_PIXEL (gl_LaunchIDEXT.xy + uvec2(pushC.tileOffset))
+#endif
+#ifndef VT_HIT_T
+#define VT_HIT_T gl_HitTEXT
+#endif
+
+const uint VT_PAGE_SIZE     = 128;
+const uint VT_PAGE_BORDER   = 4;
+const uint VT_PAGE_STRIDE   = VT_PAGE_SIZE + 2 * VT_PAGE_BORDER;
+const uint VT_INVALID_ENTRY = 0xFFFFFFFFu;
+
+struct VtTextureInfo
+{
+  uint width;
+  uint height;
+  uint nbLevels;  // Virtual levels, 0 when the texture is fully resident
+  uint pageTableOffset;
+};
+
+// Physical page in the low 16 bits, level of that page above
+layout(buffer_reference, scalar, buffer_reference_align = 4) readonly buffer VtPageTable { uint e[]; };
+layout(buffer_reference, scalar, buffer_reference_align = 4) readonly buffer VtTextures { VtTextureInfo t[]; };
+layout(buffer_reference, scalar, buffer_reference_align = 4) buffer VtFeedback { uint f[]; };
+
+// clang-format off
+layout(binding = 9, set = 1) uniform sampler2D vtPool;
+layout(binding = 10, set = 1, scalar) uniform VtDesc_
+{
+  VtPageTable pageTable;
+  VtTextures  textures;     // Of each texture slot
+  VtFeedback  feedback;     // One entry per 4x4 pixels
+  uint        feedbackWidth;
+  uint        feedbackSize;
+  uint        frame;
+  uint        poolPagesX;
+  vec2        invPoolSize;
+  float       pixelSpread;  // Footprint of a pixel at unit distance
+} vt;
+// clang-format on
+
+uvec2 vtLevelSize(VtTextureInfo info, uint level)
+{
+  return max(uvec2(info.width, info.height) >> level, uvec2(1));
+}
+
+uvec2 vtPageCount(VtTextureInfo info, uint level)
+{
+  return (vtLevelSize(info, level) + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+}
+
+uvec2 vtPageOf(VtTextureInfo info, uint level, vec2 uv)
+{
+  return min(uvec2(uv * vec2(vtLevelSize(info, level))) / VT_PAGE_SIZE, vtPageCount(info, level) - 1);
+}
+
+uint vtEntryIndex(VtTextureInfo info, uint level, uvec2 page)
+{
+  uint index = info.pageTableOffset;
+  for(uint l = 0; l < level; l++)
+  {
+    uvec2 count = vtPageCount(info, l);
+    index += count.x * count.y;
+  }
+  return index + page.y * vtPageCount(info, level).x + page.x;
+}
+
+// One pixel of each 4x4 block writes its request per frame, in turn
+void vtWriteFeedback(uint slot, uint level, uvec2 page)
+{
+  uvec2 pixel = VT_PIXEL;
+  uint  turn  = vt.frame % 16;
+  if(pixel.x % 4 != turn % 4 || pixel.y % 4 != turn / 4)
+    return;
+
+  uint index = (pixel.y / 4) * vt.feedbackWidth + pixel.x / 4;
+  if(index < vt.feedbackSize)
+    vt.feedback.f[index] = (slot << 18) | (level << 14) | (page.x << 7) | page.y;
+}
+
+// `uvDensity`: texture coordinates per world unit at the hit. The level is
+// the footprint of the pixel at the hit distance, filtering is bilinear.
+vec4 sampleTexture(uint slot, vec2 uv, float uvDensity)
+{
+  VtTextureInfo info = vt.textures.t[slot];
+
+  float footprint = uvDensity * sqrt(float(info.width) * float(info.height)) * vt.pixelSpread * VT_HIT_T;
+  float lod       = max(log2(max(footprint, 1e-8)), 0.0);
+
+  if(lod >= float(info.nbLevels))
+    return textureLod(textureSamplers[nonuniformEXT(slot)], uv, lod - float(info.nbLevels));
+
+  uint  level = uint(lod);
+  vec2  wrap  = fract(uv);
+  uvec2 page  = vtPageOf(info, level, wrap);
+  vtWriteFeedback(slot, level, page);
+
+  uint entry = vt.pageTable.e[vtEntryIndex(info, level, page)];
+  if(entry == VT_INVALID_ENTRY)
+    return textureLod(textureSamplers[nonuniformEXT(slot)], uv, 0.0);
+
+  // Finest resident level covering the page, possibly coarser than requested
+  uint  physical = entry & 0xFFFF;
+  uint  resident = entry >> 16;
+  vec2  texel    = wrap * vec2(vtLevelSize(info, resident));
+  vec2  inPage   = texel - vec2(vtPageOf(info, resident, wrap) * VT_PAGE_SIZE);
+  vec2  origin   = vec2(physical % vt.poolPagesX, physical / vt.poolPagesX) * float(VT_PAGE_STRIDE) + float(VT_PAGE_BORDER);
+  return textureLod(vtPool, (origin + inPage) * vt.invPoolSize, 0.0);
+}
@@ -18,14 +18,25 @@ struct WaveFrontMaterial
   float dissolve;  // 1 == opaque; 0 == fully transparent
   int   illum;     // illumination model (see http://www.fileformat.info/format/material/)
   int   textureId;
+  int   textureIdSpec;
 };
 
+// Buffers of a model, reached through the device addresses of the scene description
+layout(buffer_reference, scalar, buffer_reference_align = 4) readonly buffer Vertices { Vertex v[]; };
+layout(buffer_reference, scalar, buffer_reference_align = 4) readonly buffer Indices { uvec3 i[]; };
+layout(buffer_reference, scalar, buffer_reference_align = 4) readonly buffer Materials { WaveFrontMaterial m[]; };
+layout(buffer_reference, scalar, buffer_reference_align = 4) readonly buffer MatIndices { int i[]; };
+
 struct sceneDesc
 {
-  int  objId;
-  int  txtOffset;
-  mat4 transfo;
-  mat4 transfoIT;
+  Vertices   vertices;    // Offset to the instanced geometry, indices are relative to it
+  Indices    indices;     // One triangle per element
+  Materials  materials;
+  MatIndices matIndices;  // Material of each triangle
+  int        objId;
+  int        txtOffset;
+  mat4       transfo;
+  mat4       transfoIT;
 };
 
 
@@ -0,0 +1,110 @@
+// Queues of the wavefront path tracer, see src/application_impl_wavefront.cpp.
+// The paths of a whole image are advanced one bounce at a time: the rays of
+// the queue are traced, their hits sorted by shading model and material, then
+// each shading model runs as its own dispatch and queues the next rays.
+//
+// The includer must also include raycommon.glsl (SamplerState).
+
+#define WAVEFRONT_GROUP_SIZE 64
+#define WAVEFRONT_IMAGE_GROUP_SIZE 8
+#define WAVEFRONT_MODEL_COUNT 5
+#define WAVEFRONT_SORT_BLOCK_SIZE 256  // Same as the radix: one thread per digit value
+#define WAVEFRONT_SORT_RADIX 256
+
+// Same cut-off as the iterative megakernel, see raytrace.rgen. The path
+// depth is MAX_PATH_DEPTH of raycommon.glsl.
+const int RUSSIAN_ROULETTE_DEPTH = 3;
+
+// Shading models, in the high bits of the sort key
+const uint MODEL_SKY            = 0;
+const uint MODEL_SPHERE_DIFFUSE = 1;  // MODEL_SPHERE_DIFFUSE + SPHERE_* of raycommon.glsl
+const uint MODEL_SPHERE_METAL   = 2;
+const uint MODEL_SPHERE_GLASS   = 3;
+const uint MODEL_MESH           = 4;
+
+// Material within the model in the low bits, WAVEFRONT_SORT_KEY_BITS in application_impl.hpp
+const uint MATERIAL_KEY_BITS = 13;
+const uint SORT_KEY_BITS     = 16;
+const uint SORT_PASSES       = (SORT_KEY_BITS + 7) / 8;
+const uint SORTED_BUFFER     = SORT_PASSES & 1;  // Pair of sort buffers holding the result
+
+uint makeSortKey(uint model, uint material)
+{
+  return (model << MATERIAL_KEY_BITS) | min(material, (1u << MATERIAL_KEY_BITS) - 1);
+}
+
+// `WavefrontRay` in application_impl_wavefront.cpp
+struct WavefrontRay
+{
+  vec3         origin;
+  float        tMin;
+  vec3         direction;
+  float        tMax;
+  vec3         throughput;
+  uint         pixel;  // y * width + x
+  SamplerState samplerState;
+  int          depth;
+};
+
+// Filled by the hit and miss shaders of the extension pass
+struct WavefrontHit
+{
+  float t;          // < 0 on miss
+  uint  instance;   // Meshes: gl_InstanceCustomIndexEXT, spheres: index in allSpheres
+  uint  primitive;
+  vec2  attribs;    // Barycentrics of the triangle
+};
+
+struct WavefrontHitPayload
+{
+  WavefrontHit hit;
+  uint         model;
+  uint         material;
+};
+
+struct DispatchIndirectCommand
+{
+  uint x;
+  uint y;
+  uint z;
+};
+
+// clang-format off
+layout(binding = 0, set = 2, scalar) buffer WavefrontRays { WavefrontRay r[]; } rays[2];
+layout(binding = 1, set = 2, scalar) buffer WavefrontHits { WavefrontHit h[]; } hits;
+layout(binding = 2, set = 2) buffer SortKeys { uint k[]; } sortKeys[2];
+layout(binding = 3, set = 2) buffer SortValues { uint v[]; } sortValues[2];
+layout(binding = 4, set = 2) buffer BlockHistograms { uint h[]; } blockHistograms;  // [block * RADIX + digit]
+layout(binding = 6, set = 2) buffer Radiance { vec4 c[]; } radiance;                 // Sum of the samples of the frame
+// clang-format on
+
+// Counters and indirect arguments, `WavefrontState` in application_impl_wavefront.cpp
+layout(binding = 5, set = 2, scalar) buffer WavefrontState_
+{
+  uint                    rayCount[2];  // Of each ray queue
+  uint                    modelCount[WAVEFRONT_MODEL_COUNT];   // Incremented by the extension pass
+  uint                    modelSize[WAVEFRONT_MODEL_COUNT];    // Hits of each model to shade
+  uint                    modelOffset[WAVEFRONT_MODEL_COUNT];  // First sorted hit of each model
+  DispatchIndirectCommand sortArgs;
+  DispatchIndirectCommand shadeArgs[WAVEFRONT_MODEL_COUNT];
+}
+wfState;
+
+layout(push_constant) uniform WavefrontConstants
+{
+  ivec2 imageSize;
+  int   frame;
+  int   sampleFrame;  // Frame index in the sample sequence, kept across camera moves
+  int   samplerType;
+  int   samplesPerFrame;
+  int   wave;      // Sample of the frame being traced
+  int   depth;     // Bounce being traced or shaded, its rays are in queue depth & 1
+  int   sortPass;
+  int   accumulation;  // AccumulationMode
+}
+pushC;
+
+uint getQueue()
+{
+  return uint(pushC.depth) & 1;
+}
@@ -8,10 +8,27 @@
 // Public Methods
 // -----------------------
 
-Application::Application() :
+Application::Application(const std::string&            csfFilename,
+                         const TextureSettings&        textureSettings,
+                         const VirtualTextureSettings& vtSettings,
+                         const SphereSettings&         sphereSettings,
+                         const EnvironmentSettings&    envSettings,
+                         const HeadlessSettings&       headlessSettings,
+                         const CheckpointSettings&     checkpointSettings) :
     _impl(std::make_unique<Impl>())
 {
-    _impl->initWindow();
+    _impl->m_csfFilename     = csfFilename;
+    _impl->m_textureSettings = textureSettings;
+    _impl->m_vtSettings      = vtSettings;
+    _impl->m_sphereSettings  = sphereSettings;
+    _impl->m_envSettings     = envSettings;
+    _impl->m_headlessSettings = headlessSettings;
+    _impl->m_checkpointSettings = checkpointSettings;
+    if (headlessSettings.enabled) {
+        _impl->initCamera(headlessSettings.width, headlessSettings.height);
+    } else {
+        _impl->initWindow();
+    }
     _impl->loadVulkanContext();
     _impl->setupVulkanPipeline();
 }
@@ -23,9 +40,10 @@ Application::~Application()
     _impl->destroy();
     _impl->_nvvk_context.deinit();
 
-    glfwDestroyWindow(_impl->_window);
-
-    glfwTerminate();
+    if (_impl->_window) {
+        glfwDestroyWindow(_impl->_window);
+        glfwTerminate();
+    }
 }
 
 
@@ -33,6 +51,11 @@ Application::~Application()
 
 void Application::run()
 {
+    if (_impl->m_headlessSettings.enabled) {
+        _impl->renderHeadless();
+        return;
+    }
+
     _impl->setupGlfwCallbacks(_impl->_window);
     ImGui_ImplGlfw_InitForVulkan(_impl->_window, true);
 
@@ -79,6 +102,8 @@ void Application::run()
 
         // Updating camera buffer
         _impl->updateUniformBuffer(cmdBuf);
+        // Streaming the pages requested by the last frames
+        _impl->updateVirtualTextures(cmdBuf);
 
 
         // Clearing screen
@@ -91,6 +116,10 @@ void Application::run()
         {
             // Rendering Scene
             _impl->rayTrace(cmdBuf, clearColor);
+            // Filtering the noisy accumulation
+            _impl->denoise(cmdBuf);
+            // Metering the displayed image for the tone mapper
+            _impl->computeExposure(cmdBuf);
         }
 
 
@@ -115,5 +144,10 @@ void Application::run()
         // Submit for display
         cmdBuf.end();
         _impl->submitFrame();
+
+        // Periodic save of the accumulation
+        _impl->updateCheckpoint();
     }
+
+    _impl->saveCheckpoint();
 }
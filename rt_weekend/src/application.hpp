@@ -1,7 +1,33 @@
 #ifndef APPLICATION_HPP
 #define APPLICATION_HPP
 
+#include "primitive/sphere_set.hpp"
+#include "sampling/environment.hpp"
+#include "texture/texture_processor.hpp"
+#include "texture/virtual_texture.hpp"
+#include <cstdint>
 #include <memory>
+#include <string>
+
+// Rendering without window nor swapchain: the frames are accumulated in the
+// offscreen image, read back and written to a file, see render/image_writer.hpp
+struct HeadlessSettings {
+    bool        enabled{false};
+    std::string output{"render.png"};  // Extension selects the format
+    uint32_t    width{1280};
+    uint32_t    height{720};
+    uint32_t    frames{100};  // Accumulated before writing, each of SAMPLES_COUNT paths per pixel
+    std::string denoiseDump;  // Directory of the inputs and output of the denoiser, see denoise/atrous_filter.hpp
+    bool        traceBenchmark{false};  // Megakernel and wavefront throughput instead of an image
+    bool        accumulationBenchmark{false};  // Time of the accumulation modes over the frames, and their error
+};
+
+// Accumulation saved to a file periodically and on exit, then resumed on the
+// next start if the scene is the same, see render/accumulation_checkpoint.hpp
+struct CheckpointSettings {
+    std::string filename;        // Disabled when empty
+    float       interval{60.0f};  // Seconds between two saves, 0 only saves on exit
+};
 
 class Application 
 {
@@ -10,9 +36,23 @@ private:
     std::unique_ptr<Impl> _impl;
 
 public:
-    Application();
+    // csfFilename: cadscenefile to ray trace instead of the default scene
+    // textureSettings: mip filter and compression of the loaded textures
+    // vtSettings: streaming of the textures through virtual texturing
+    // sphereSettings: count and BLAS clustering of the random spheres
+    // envSettings: sky lighting the scene, and importance sampled
+    // headlessSettings: renders to a file instead of a window when enabled
+    // checkpointSettings: file the accumulation is saved to and resumed from
+    explicit Application(const std::string&            csfFilename        = "",
+                         const TextureSettings&        textureSettings    = TextureSettings(),
+                         const VirtualTextureSettings& vtSettings         = VirtualTextureSettings(),
+                         const SphereSettings&         sphereSettings     = SphereSettings(),
+                         const EnvironmentSettings&    envSettings        = EnvironmentSettings(),
+                         const HeadlessSettings&       headlessSettings   = HeadlessSettings(),
+                         const CheckpointSettings&     checkpointSettings = CheckpointSettings());
     ~Application();
 
+    // Interactive loop until the window is closed, or the headless render
     void run();
 };
 
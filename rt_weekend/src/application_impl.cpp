@@ -19,6 +19,8 @@ void Application::Impl::setup(
 {
     AppBase::setup(instance, device, physicalDevice, queueFamily);
     m_alloc.init(device, physicalDevice);
+    m_uploader.init(device, physicalDevice, m_queue, queueFamily);
+    m_geometryArena.init(device, &m_alloc);
     m_offscreenDepthFormat = nvvk::findDepthFormat(physicalDevice);
 
     // Search path for shaders and other media
@@ -27,6 +29,7 @@ void Application::Impl::setup(
         NVPSystem::exePath() + PROJECT_RELDIRECTORY "..",
         std::string(PROJECT_NAME),
     };
+    m_shaderVariants.init(device, _default_search_paths);
 }
 
 void Application::Impl::initWindow()
@@ -37,9 +40,13 @@ void Application::Impl::initWindow()
 
     _window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "RT Weekend", nullptr, nullptr);
 
-    // Setup camera
+    initCamera(WINDOW_WIDTH, WINDOW_HEIGHT);
+}
+
+void Application::Impl::initCamera(int width, int height)
+{
     CameraManip.setMode(CameraManip.Walk);
-    CameraManip.setWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    CameraManip.setWindowSize(width, height);
     CameraManip.setLookat(nvmath::vec3f(0, 0, 1), nvmath::vec3f(0, 0, 0), nvmath::vec3f(0, 1, 0));
 
     m_camera_ref.camera = CameraManip.getMatrix();
@@ -54,15 +61,18 @@ void Application::Impl::loadVulkanContext() {
     context_info.setVersion(1, 2);
     context_info.addInstanceLayer("VK_LAYER_LUNARG_monitor", true);
     context_info.addInstanceExtension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME, true);
-    context_info.addInstanceExtension(VK_KHR_SURFACE_EXTENSION_NAME);
+    // Nothing is presented when headless, a device without display is fine
+    if (!m_headlessSettings.enabled) {
+        context_info.addInstanceExtension(VK_KHR_SURFACE_EXTENSION_NAME);
 #ifdef _WIN32
-    context_info.addInstanceExtension(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+        context_info.addInstanceExtension(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #else
-    contextInfo.addInstanceExtension(VK_KHR_XLIB_SURFACE_EXTENSION_NAME);
-    contextInfo.addInstanceExtension(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+        context_info.addInstanceExtension(VK_KHR_XLIB_SURFACE_EXTENSION_NAME);
+        context_info.addInstanceExtension(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #endif
+        context_info.addDeviceExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
     context_info.addInstanceExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
-    context_info.addDeviceExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
     context_info.addDeviceExtension(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
     context_info.addDeviceExtension(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
     context_info.addDeviceExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
@@ -92,38 +102,58 @@ void Application::Impl::loadVulkanContext() {
 }
 
 void Application::Impl::setupVulkanPipeline() {
-    // Window need to be opened to get the surface on which to draw
-    const vk::SurfaceKHR surface = nvvk::AppBase::getVkSurface(_nvvk_context.m_instance, _window);
-    _nvvk_context.setGCTQueueWithPresent(surface);
-
-    setup(
-        _nvvk_context.m_instance, 
-        _nvvk_context.m_device, 
-        _nvvk_context.m_physicalDevice,
-        _nvvk_context.m_queueGCT.familyIndex);
-
-    nvvk::AppBase::createSwapchain(surface, WINDOW_WIDTH, WINDOW_HEIGHT);
-    nvvk::AppBase::createDepthBuffer();
-    nvvk::AppBase::createRenderPass();
-    nvvk::AppBase::createFrameBuffers();
-
-    // Setup Imgui
-    initGUI(0);  // Using sub-pass 0
+    if (m_headlessSettings.enabled) {
+        // No surface: the images are only rendered offscreen, at the requested size
+        setup(
+            _nvvk_context.m_instance,
+            _nvvk_context.m_device,
+            _nvvk_context.m_physicalDevice,
+            _nvvk_context.m_queueGCT.familyIndex);
+
+        m_size = vk::Extent2D(m_headlessSettings.width, m_headlessSettings.height);
+        createHeadlessFrames();
+    } else {
+        // Window need to be opened to get the surface on which to draw
+        const vk::SurfaceKHR surface = nvvk::AppBase::getVkSurface(_nvvk_context.m_instance, _window);
+        _nvvk_context.setGCTQueueWithPresent(surface);
+
+        setup(
+            _nvvk_context.m_instance, 
+            _nvvk_context.m_device, 
+            _nvvk_context.m_physicalDevice,
+            _nvvk_context.m_queueGCT.familyIndex);
+
+        nvvk::AppBase::createSwapchain(surface, WINDOW_WIDTH, WINDOW_HEIGHT);
+        nvvk::AppBase::createDepthBuffer();
+        nvvk::AppBase::createRenderPass();
+        nvvk::AppBase::createFrameBuffers();
+
+        // Setup Imgui
+        initGUI(0);  // Using sub-pass 0
+    }
 
     // Creation of the example
-    createSkyboxTexture();
-    loadModel(nvh::findFile("media/scenes/Medieval_building.obj", _default_search_paths, true));
-    loadModel(nvh::findFile("media/scenes/plane.obj", _default_search_paths, true));
-
-    {
-        auto sphere_cmdpool = nvvk::CommandPool { m_device, m_graphicsQueueIndex };
-        m_sphereHandler = std::make_unique<SphereHandler>(sphere_cmdpool, m_alloc);
+    initBindless();
+    initTextureProcessor(m_textureSettings);
+    initVirtualTextures();
+    createEnvironment();
+    if (m_csfFilename.empty()) {
+        loadModel(nvh::findFile("media/scenes/Medieval_building.obj", _default_search_paths, true));
+        loadModel(nvh::findFile("media/scenes/plane.obj", _default_search_paths, true));
+    } else {
+        loadCsfScene(m_csfFilename);
     }
 
+    m_sphereHandler = std::make_unique<SphereHandler>(m_alloc, m_uploader, m_sphereSettings);
+
     createOffscreenRender();
+    createDenoiseRender();
+    createReprojectionRender();
+    createTileRender();
     createDescriptorSetLayout();
     createUniformBuffer();
     createSceneDescriptionBuffer();
+    createSamplerTablesBuffer();
     updateDescriptorSet();
 
     initRayTracing();
@@ -133,9 +163,30 @@ void Application::Impl::setupVulkanPipeline() {
     createRtPipeline();
     createRtShaderBindingTable();
 
+    createDenoiseDescriptor();
+    createDenoisePipeline();
+    updateDenoiseDescriptorSet();
+
+    createExposureResources();
+    createExposureDescriptor();
+    createExposurePipelines();
+
+    // The headless mode reads the image back before the tone mapper, without render pass
     createPostDescriptor();
-    createPostPipeline();
+    if (!m_headlessSettings.enabled) {
+        createPostPipeline();
+    }
     updatePostDescriptorSet();
+
+    createTileScheduler();
+
+    createWavefrontRender();
+    createWavefrontDescriptor();
+    updateWavefrontDescriptorSet();
+    createWavefrontPipelines();
+    createTraceTimings();
+
+    resumeCheckpoint();
 }
 
 void Application::Impl::destroyResources()
@@ -144,23 +195,22 @@ void Application::Impl::destroyResources()
     m_device.destroy(m_descSetLayout);
     m_alloc.destroy(m_cameraMat);
     m_alloc.destroy(m_sceneDesc);
+    m_alloc.destroy(m_samplerTables);
 
+    m_uploader.deinit();
     for(auto& m : m_objModel)
     {
-        m_alloc.destroy(m.vertexBuffer);
-        m_alloc.destroy(m.indexBuffer);
-        m_alloc.destroy(m.matColorBuffer);
-        m_alloc.destroy(m.matIndexBuffer);
+        destroyModel(m);
     }
+    m_geometryArena.deinit();
 
     m_sphereHandler->destroy(m_alloc);
 
 
-    for(auto& t : m_textures)
-    {
-        m_alloc.destroy(t);
-    }
-    m_alloc.destroy(*m_skybox_txt);
+    destroyTextures();
+    m_alloc.destroy(m_envTexture);
+    m_alloc.destroy(m_envDistribution);
+    destroyVirtualTextures();
 
     //#Post
     m_device.destroy(m_postPipeline);
@@ -169,8 +219,14 @@ void Application::Impl::destroyResources()
     m_device.destroy(m_postDescSetLayout);
     m_alloc.destroy(m_offscreenColor);
     m_alloc.destroy(m_offscreenDepth);
+    m_alloc.destroy(m_accumState);
     m_device.destroy(m_offscreenRenderPass);
     m_device.destroy(m_offscreenFramebuffer);
+    destroyExposure();
+
+    // #Denoise
+    destroyDenoise();
+    destroyReprojection();
 
     // #VKRay
     m_rtBuilder.destroy();
@@ -179,6 +235,17 @@ void Application::Impl::destroyResources()
     m_device.destroy(m_rtPipeline);
     m_device.destroy(m_rtPipelineLayout);
     m_alloc.destroy(m_rtSBTBuffer);
+    m_shaderVariants.printStats();
+    m_shaderVariants.deinit();
+
+    // #Tiles
+    destroyTileScheduler();
+
+    // #Wavefront
+    destroyWavefront();
+
+    // #Headless
+    destroyHeadless();
 }
 
 // Extra UI
@@ -187,6 +254,39 @@ void Application::Impl::renderUI()
     bool changed = false;
 
     changed |= ImGuiH::CameraWidget();
+    ImGui::Checkbox("Reproject on camera motion", &m_reprojectionEnabled);
+
+    // Recursion may not be supported by the device, iterative is forced then
+    bool recursionSupported = m_rtProperties.maxRayRecursionDepth > 1;
+    if (recursionSupported && ImGui::Checkbox("Iterative path tracing", &m_iterativePathTracing)) {
+        recreateRtPipeline();
+    }
+    // A specialization constant: the pipelines are recreated, their variants
+    // are created once for each depth
+    int maxDepth = MAX_PATH_DEPTH_LIMIT;
+    if (!m_iterativePathTracing) {
+        maxDepth = std::min(maxDepth, static_cast<int>(m_rtProperties.maxRayRecursionDepth) - 1);
+    }
+    if (ImGui::SliderInt("Max path depth", &m_maxPathDepth, 1, maxDepth)) {
+        recreateRtPipeline();
+    }
+    if (ImGui::Checkbox("Environment sampling", &m_sampleEnvironment)) {
+        recreateRtPipeline();
+    }
+
+    // Compensated: the running mean does not drift over long accumulations, for
+    // the same traffic, see render/accumulation.hpp
+    int accumulation = static_cast<int>(m_accumulationMode);
+    if (ImGui::Combo("Accumulation", &accumulation, "Average\0Compensated\0")) {
+        m_accumulationMode = static_cast<AccumulationMode>(accumulation);
+        changed            = true;
+    }
+
+    int samplerType = static_cast<int>(m_samplerType);
+    if (ImGui::Combo("Sampler", &samplerType, "LCG\0Sobol (Owen scrambled)\0Sobol (blue-noise rotated)\0")) {
+        m_samplerType = static_cast<SamplerType>(samplerType);
+        changed       = true;
+    }
     if(ImGui::CollapsingHeader("Light"))
     {
         auto& pc = m_pushConstant;
@@ -198,6 +298,12 @@ void Application::Impl::renderUI()
         changed |= ImGui::SliderFloat("Intensity", &pc.lightIntensity, 0.f, 150.f);
     }
 
+    renderTileUI();
+    renderWavefrontUI();
+    renderDenoiseUI();
+    renderExposureUI();
+    renderVirtualTextureUI();
+
     if(changed) {
         resetFrameId();
     }
@@ -205,22 +311,69 @@ void Application::Impl::renderUI()
 
 void Application::Impl::onResize(int w, int h)
 {
+    // The accumulation so far is resampled to the new size instead of
+    // restarting, but for the tiles: their frame counts start over
+    AccumulationCheckpoint accumulation;
+    bool                   tiled    = m_tiledRendering && !m_wavefrontEnabled;
+    bool                   resample = !tiled && readAccumulation(accumulation);
+
     resetFrameId();
     createOffscreenRender();
+    createDenoiseRender();
+    createReprojectionRender();
+    createTileRender();
+    createVirtualTextureFeedback();
+    updateDenoiseDescriptorSet();
     updatePostDescriptorSet();
     updateRtDescriptorSet();
+    createWavefrontRender();
+    updateWavefrontDescriptorSet();
+    m_tileScheduler.reset(w, h, m_tileSize);
+
+    if (resample) {
+        writeAccumulation(resampleAccumulationCheckpoint(accumulation, m_offscreenSize.width, m_offscreenSize.height));
+    }
 }
 
 void Application::Impl::resetFrameId() {
     m_rtcurrentFrameId = -1;
+    m_rtSampleFrame    = 0;
+    // A new accumulation, saved by the next checkpoint
+    m_checkpointSampleFrame = -1;
+    // Scene or settings changed, the denoiser history can't be reused
+    m_denoiseHistoryValid = false;
+}
+
+uint32_t Application::Impl::getFramesInFlight() const
+{
+    if (m_headlessSettings.enabled) {
+        return HEADLESS_FRAMES_IN_FLIGHT;
+    }
+    return static_cast<uint32_t>(m_commandBuffers.size());
+}
+
+uint32_t Application::Impl::getFrameInFlightIndex() const
+{
+    if (m_headlessSettings.enabled) {
+        return m_headlessFrame;
+    }
+    return getCurFrame();
 }
 
 void Application::Impl::updateFrameId() {
+    m_rtReprojectHistory = false;
+
     const auto& current_camera_mat = CameraManip.getMatrix();
     auto        current_camera_fov = CameraManip.getFov();
 
     if (memcmp(&current_camera_mat.a00, &m_camera_ref.camera.a00, sizeof(nvmath::mat4f)) != 0 || current_camera_fov != m_camera_ref.fov) {
-        resetFrameId();
+        // Camera motion only: the converged samples are reprojected to the new
+        // view instead of being thrown away. The tiled mode traces parts of the
+        // image over several frames, the history copy would be stale for them.
+        // The wavefront mode does not reproject.
+        m_rtReprojectHistory = m_reprojectionEnabled && !m_tiledRendering && !m_wavefrontEnabled
+                               && m_rtcurrentFrameId >= 0;
+        m_rtcurrentFrameId   = -1;
         m_camera_ref.camera = current_camera_mat;
         m_camera_ref.fov = current_camera_fov;
     }
@@ -13,7 +13,28 @@
 #include <nvvk/descriptorsets_vk.hpp>
 #include <nvvk/raytraceKHR_vk.hpp>
 
+#include "common/obj_loader.h"
+#include "denoise/atrous_filter.hpp"
 #include "primitive/sphere.hpp"
+#include "render/accumulation.hpp"
+#include "render/accumulation_checkpoint.hpp"
+#include "render/geometry_arena.hpp"
+#include "render/shader_variants.hpp"
+#include "render/slot_allocator.hpp"
+#include "render/tile_scheduler.hpp"
+#include "render/tone_mapping.hpp"
+#include "render/uploader.hpp"
+#include "render/wavefront_sort.hpp"
+#include "sampling/environment.hpp"
+#include "sampling/sampler.hpp"
+#include "texture/texture_processor.hpp"
+#include "texture/tile_cache.hpp"
+#include "texture/virtual_texture.hpp"
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
 
 // -----------------------
 // Constants
@@ -22,6 +43,26 @@
 static constexpr int WINDOW_WIDTH = 1280;
 static constexpr int WINDOW_HEIGHT = 720;
 
+// Command buffers and fences of the headless mode, cycled like the swapchain images
+static constexpr uint32_t HEADLESS_FRAMES_IN_FLIGHT = 2;
+
+// Upper bound of the bindless texture array, lowered to the device limits
+static constexpr uint32_t BINDLESS_MAX_TEXTURES = 16384;
+
+// Hit groups of the ray tracing pipelines, the TLAS instances select theirs
+// (the rays are traced with an SBT record stride of 0): the meshes, then one
+// group per sphere material, each specialized for it
+static constexpr uint32_t HIT_GROUP_MESH   = 0;
+static constexpr uint32_t HIT_GROUP_SPHERE = 1;  // + SphereMaterial
+static constexpr uint32_t HIT_GROUP_COUNT  = HIT_GROUP_SPHERE + SPHERE_MATERIAL_COUNT;
+
+// Upper bound of the path depth, MAX_PATH_DEPTH specialization constant
+static constexpr int MAX_PATH_DEPTH_LIMIT = 16;
+
+// Shading models of the wavefront mode and bits of their sort keys, see wavefront_queue.glsl
+static constexpr uint32_t WAVEFRONT_MODEL_COUNT   = 5;
+static constexpr uint32_t WAVEFRONT_SORT_KEY_BITS = 16;
+
 
 // -----------------------
 // Impl Structure
@@ -42,14 +83,28 @@ private:
         float         fov;
     };
 
+    // Holding the camera matrices
+    struct CameraMatrices
+    {
+        nvmath::mat4f view;
+        nvmath::mat4f proj;
+        nvmath::mat4f viewInverse;
+        // #VKRay
+        nvmath::mat4f projInverse;
+        // Last frame, for reprojection
+        nvmath::mat4f prevView;
+        nvmath::mat4f prevProj;
+    };
+
 public:
     CameraParams m_camera_ref;
     int m_max_accumulated_frames = 100;
-    GLFWwindow* _window;
+    GLFWwindow* _window{nullptr};  // None when headless
     nvvk::Context _nvvk_context;
     std::vector<std::string> _default_search_paths;
 
     void initWindow();
+    void initCamera(int width, int height);
     void loadVulkanContext();
     void setupVulkanPipeline();
     void destroyResources();
@@ -57,24 +112,42 @@ public:
     void onResize(int w, int h) override;
     void resetFrameId();
     void updateFrameId();
+    // Command buffers of the frame loop: the swapchain images, or the headless ring
+    uint32_t getFramesInFlight() const;
+    uint32_t getFrameInFlightIndex() const;
 
 
     // The OBJ model
     struct ObjModel
     {
-        uint32_t     nbIndices{0};
-        uint32_t     nbVertices{0};
-        nvvk::Buffer vertexBuffer;    // Device buffer of all 'Vertex'
-        nvvk::Buffer indexBuffer;     // Device buffer of the indices forming triangles
-        nvvk::Buffer matColorBuffer;  // Device buffer of array of 'Wavefront material'
-        nvvk::Buffer matIndexBuffer;  // Device buffer of array of 'Wavefront material'
+        uint32_t             nbIndices{0};
+        uint32_t             nbVertices{0};
+        uint32_t             nbMaterials{0};
+        GeometryArena::Range vertices;    // All 'Vertex'
+        GeometryArena::Range indices;     // Indices forming triangles
+        GeometryArena::Range materials;   // Array of 'Wavefront material'
+        GeometryArena::Range matIndices;  // Material of each triangle
+    };
+
+    // Range of an ObjModel built as one BLAS, a model can hold several geometries (CSF)
+    struct ObjGeometry
+    {
+        uint32_t objIndex{0};      // Reference to the `m_objModel`
+        uint32_t firstIndex{0};
+        uint32_t nbIndices{0};
+        uint32_t vertexOffset{0};
+        uint32_t nbVertices{0};
     };
 
-    // Instance of the OBJ
+    // Instance of the OBJ, `sceneDesc` in wavefront.glsl
     struct ObjInstance
     {
+        vk::DeviceAddress vertices{0};    // Model buffers, offset to the geometry of the instance
+        vk::DeviceAddress indices{0};
+        vk::DeviceAddress materials{0};
+        vk::DeviceAddress matIndices{0};
         uint32_t      objIndex{0};     // Reference to the `m_objModel`
-        uint32_t      txtOffset{0};    // Offset in `m_textures`
+        uint32_t      txtOffset{0};    // Slot of the first texture of the model
         nvmath::mat4f transform{1};    // Position of the instance
         nvmath::mat4f transformIT{1};  // Inverse transpose
     };
@@ -90,19 +163,39 @@ public:
     ObjPushConstant m_pushConstant;
 
     // #Descriptors
+    void initBindless();
     void createDescriptorSetLayout();
     void updateDescriptorSet();
+    void writeTextureDescriptors(uint32_t first, uint32_t count);
     void createUniformBuffer();
     void updateUniformBuffer(const vk::CommandBuffer& cmdBuf);
     void createSceneDescriptionBuffer();
-    void createTextureImages(const vk::CommandBuffer& cmdBuf, const std::vector<std::string>& textures);
+    void updateSceneAddresses();
+    void createSamplerTablesBuffer();
+    uint32_t createTextureImages(const vk::CommandBuffer& cmdBuf, const std::vector<std::string>& textures);
+    void uploadModel(ObjModel&                       model,
+                     const std::vector<VertexObj>&   vertices,
+                     const std::vector<uint32_t>&    indices,
+                     const std::vector<MaterialObj>& materials,
+                     const std::vector<int32_t>&     matIndices);
+    void destroyModel(ObjModel& model);
+    void destroyTextures();
     void loadModel(const std::string& filename, nvmath::mat4f transform = nvmath::mat4f(1));
-    void createSkyboxTexture();
+    void loadCsfScene(const std::string& filename);
+    void createEnvironment();
+    void initTextureProcessor(TextureSettings settings);
+    nvvk::Texture createProcessedTexture(const ProcessedTexture& processed, bool cube, const vk::SamplerCreateInfo& samplerCreateInfo);
 
 
     // Array of objects and instances in the scene
     std::vector<ObjModel>          m_objModel;
     std::vector<ObjInstance>       m_objInstance;
+    std::vector<ObjGeometry>       m_objGeometry;      // One BLAS each
+    std::vector<uint32_t>          m_objInstanceBlas;  // Reference to the `m_objGeometry` of each instance
+    std::string                    m_csfFilename;      // Replaces the default OBJ scene when set
+    TextureSettings                m_textureSettings;  // Requested, compression may be unsupported
+    TextureProcessor               m_textureProcessor;
+    SphereSettings                 m_sphereSettings;
     std::unique_ptr<SphereHandler> m_sphereHandler;
 
     // Graphic pipeline
@@ -112,12 +205,20 @@ public:
     vk::DescriptorSet           m_descSet;
 
     nvvk::Buffer               m_cameraMat;  // Device-Host of the camera matrices
+    CameraMatrices             m_cameraMatrices;  // Host copy of the last upload
     nvvk::Buffer               m_sceneDesc;  // Device buffer of the OBJ instances
+    nvvk::Buffer               m_samplerTables;  // Sobol matrices and blue noise, see sampling.glsl
     std::vector<nvvk::Texture> m_textures;   // vector of all textures of the scene
-    std::unique_ptr<nvvk::Texture> m_skybox_txt = nullptr; 
+    std::vector<uint32_t>      m_textureSlots;  // Slot of each texture in the bindless array
+    SlotAllocator              m_txtSlotAlloc;  // Binding 3
+    EnvironmentSettings        m_envSettings;
+    nvvk::Texture              m_envTexture;       // Equirectangular radiance, binding 8
+    nvvk::Buffer               m_envDistribution;  // CDFs of its importance sampling, binding 11
 
 
-    nvvk::AllocatorDedicated m_alloc;  // Allocator for buffer, images, acceleration structures
+    nvvk::AllocatorDedicated   m_alloc;  // Allocator for buffer, images, acceleration structures
+    Uploader                   m_uploader;       // Bounded staging for the geometry and texture uploads
+    GeometryArena              m_geometryArena;  // Vertices, indices and materials of all the models
 
     // #Post
     void createOffscreenRender();
@@ -126,6 +227,13 @@ public:
     void updatePostDescriptorSet();
     void drawPost(vk::CommandBuffer cmdBuf);
 
+    // `pushc` in post.frag
+    struct PostPushConstant
+    {
+        float aspectRatio;
+        int   toneMapper;  // ToneMapper
+    };
+
     nvvk::DescriptorSetBindings m_postDescSetLayoutBind;
     vk::DescriptorPool          m_postDescPool;
     vk::DescriptorSetLayout     m_postDescSetLayout;
@@ -134,21 +242,27 @@ public:
     vk::PipelineLayout          m_postPipelineLayout;
     vk::RenderPass              m_offscreenRenderPass;
     vk::Framebuffer             m_offscreenFramebuffer;
-    nvvk::Texture               m_offscreenColor;
-    vk::Format                  m_offscreenColorFormat{vk::Format::eR32G32B32A32Sfloat};
+    nvvk::Texture               m_offscreenColor;  // Displayed mean and count of the accumulation
+    vk::Extent2D                m_offscreenSize;  // Of the images, m_size already changed in onResize()
+    vk::Format                  m_offscreenColorFormat{vk::Format::eR16G16B16A16Sfloat};
+    AccumulationMode            m_accumulationMode{AccumulationMode::Average};
+    nvvk::Texture               m_accumState;  // Packed mean, count and compensation, see accumulation.hpp
     nvvk::Texture               m_offscreenDepth;
     vk::Format                  m_offscreenDepthFormat;
 
     // #VKRAY
     void initRayTracing();
-    nvvk::RaytracingBuilderKHR::BlasInput objectToVkGeometryKHR(const ObjModel& model);
+    nvvk::RaytracingBuilderKHR::BlasInput objectToVkGeometryKHR(const ObjGeometry& geometry);
     void createBottomLevelAS();
     void createTopLevelAS();
     void createRtDescriptorSet();
     void updateRtDescriptorSet();
     void createRtPipeline();
+    void recreateRtPipeline();
     void createRtShaderBindingTable();
+    nvvk::Buffer createShaderBindingTable(vk::Pipeline pipeline, uint32_t groupCount);
     void rayTrace(const vk::CommandBuffer& cmdBuf, const nvmath::vec4f& clearColor);
+    void traceRays(const vk::CommandBuffer& cmdBuf, const vk::Offset2D& offset, const vk::Extent2D& extent);
 
     vk::PhysicalDeviceRayTracingPipelinePropertiesKHR    m_rtProperties;
     nvvk::RaytracingBuilderKHR                           m_rtBuilder;
@@ -160,6 +274,10 @@ public:
     vk::PipelineLayout                                   m_rtPipelineLayout;
     vk::Pipeline                                         m_rtPipeline;
     nvvk::Buffer                                         m_rtSBTBuffer;
+    bool                                                 m_iterativePathTracing{false};  // Bounce loop in the raygen
+    int                                                  m_maxPathDepth{8};
+    bool                                                 m_sampleEnvironment{true};  // Next event estimation of the sky
+    ShaderVariants                                       m_shaderVariants;  // Of the ray tracing and wavefront pipelines
     int                                                  m_rtcurrentFrameId;
 
     struct RtPushConstant
@@ -169,7 +287,264 @@ public:
         float         lightIntensity;
         int           lightType;
         int           frameId;
+        int           reproject;   // Accumulation is reprojected from the previous camera
+        nvmath::vec2i tileOffset;  // Origin of the launch in the output image
+        nvmath::vec2i imageSize;
+        int           samplerType;  // SamplerType
+        int           sampleFrame;  // Frame index in the sample sequence, kept across camera moves
+        int           accumulation;  // AccumulationMode
+        int           tileVariance;  // Counter of the traced tile in m_tileVariance, -1 when not tiled
     } m_rtPushConstants;
+    SamplerType m_samplerType{SamplerType::SobolOwen};
+    int         m_rtSampleFrame{0};
+
+    // #Headless
+    void createHeadlessFrames();
+    void destroyHeadless();
+    const vk::CommandBuffer& beginHeadlessFrame();
+    void submitHeadlessFrame();
+    void renderHeadless();
+    void benchmarkTraceModes();
+    void benchmarkAccumulationModes();
+    void saveImage(const std::string& filename);
+
+    HeadlessSettings               m_headlessSettings;
+    std::vector<vk::CommandBuffer> m_headlessCmdBuffers;
+    std::vector<vk::Fence>         m_headlessFences;  // Signaled when the command buffer can be reused
+    uint32_t                       m_headlessFrame{0};
+
+    // #Checkpoint
+    uint64_t computeSceneHash() const;
+    bool     readAccumulation(AccumulationCheckpoint& checkpoint);
+    void     writeAccumulation(const AccumulationCheckpoint& checkpoint);
+    void     resumeCheckpoint();
+    void     updateCheckpoint();
+    void     saveCheckpoint();
+
+    CheckpointSettings                             m_checkpointSettings;
+    std::chrono::high_resolution_clock::time_point m_checkpointTime;
+    int                                            m_checkpointSampleFrame{-1};  // Of the last save, not saved again
+
+    // #Exposure
+    void createExposureResources();
+    void createExposureDescriptor();
+    void updateExposureDescriptorSet(const VkDescriptorImageInfo& source);
+    void createExposurePipelines();
+    void destroyExposure();
+    void renderExposureUI();
+    void computeExposure(const vk::CommandBuffer& cmdBuf);
+
+    // `ExposureState` in tone_mapping.glsl, followed by the histogram
+    struct ExposureState
+    {
+        float    exposure;
+        float    exposureLog2;
+        float    averageLog2;
+        uint32_t valid;
+    };
+
+    // `pc` in exposure_common.glsl
+    struct ExposurePushConstant
+    {
+        float minLog2;
+        float maxLog2;
+        float lowPercentile;
+        float highPercentile;
+        float keyValue;
+        float compensation;
+        float speedUp;
+        float speedDown;
+        float deltaSeconds;
+        int   autoExposure;
+        int   reset;
+    } m_exposurePushConstants;
+
+    ExposureSettings                               m_exposureSettings;
+    ToneMapper                                     m_toneMapper{ToneMapper::Aces};
+    bool                                           m_exposureReset{true};  // Next frame jumps to the target
+    std::chrono::high_resolution_clock::time_point m_exposureTime;         // Of the last adaptation
+    nvvk::Buffer                                   m_exposureBuffer;
+    nvvk::DescriptorSetBindings                    m_exposureDescSetLayoutBind;
+    vk::DescriptorPool                             m_exposureDescPool;
+    vk::DescriptorSetLayout                        m_exposureDescSetLayout;
+    vk::DescriptorSet                              m_exposureDescSet;
+    vk::PipelineLayout                             m_exposurePipelineLayout;
+    vk::Pipeline                                   m_exposureHistogramPipeline;
+    vk::Pipeline                                   m_exposureAdaptPipeline;
+
+    // #Denoise
+    void createDenoiseRender();
+    void createDenoiseDescriptor();
+    void updateDenoiseDescriptorSet();
+    void createDenoisePipeline();
+    void destroyDenoise();
+    void renderDenoiseUI();
+    void denoise(const vk::CommandBuffer& cmdBuf);
+    void dispatchDenoiseTemporal(const vk::CommandBuffer& cmdBuf);
+    void dispatchDenoiseAtrous(const vk::CommandBuffer& cmdBuf);
+    void dumpDenoise(const std::string& directory);
+
+    struct DenoisePushConstant
+    {
+        int   historyIndex{0};
+        int   historyValid{0};
+        int   iteration{0};
+        int   iterations{5};
+        float sigmaLuminance{4.0f};
+        float sigmaNormal{128.0f};
+        float sigmaDepth{1.0f};
+        float maxHistory{8.0f};
+    } m_denoisePushConstants;
+
+    bool                        m_denoiseEnabled{true};
+    bool                        m_denoiseHistoryValid{false};
+    nvvk::Texture               m_gbufferNormalDepth;  // World normal, primary hit distance
+    nvvk::Texture               m_gbufferAlbedo;
+    nvvk::Texture               m_denoiseHistoryColor[2];
+    nvvk::Texture               m_denoiseHistoryMoments[2];
+    nvvk::Texture               m_denoiseHistoryNormalDepth[2];
+    nvvk::Texture               m_denoisePing[2];
+    nvvk::Texture               m_denoiseOutput;
+    nvvk::DescriptorSetBindings m_denoiseDescSetLayoutBind;
+    vk::DescriptorPool          m_denoiseDescPool;
+    vk::DescriptorSetLayout     m_denoiseDescSetLayout;
+    vk::DescriptorSet           m_denoiseDescSet;
+    vk::PipelineLayout          m_denoisePipelineLayout;
+    vk::Pipeline                m_denoiseTemporalPipeline;
+    vk::Pipeline                m_denoiseAtrousPipeline;
+
+    // #Tiles
+    void createTileScheduler();
+    void createTileRender();
+    void destroyTileScheduler();
+    void renderTileUI();
+    void readTileTimings(uint32_t frame);
+    void rayTraceTiles(const vk::CommandBuffer& cmdBuf);
+
+    TileScheduler                      m_tileScheduler;
+    bool                               m_tiledRendering{false};
+    int                                m_tileSize{256};
+    float                              m_tileBudgetMs{30.0f};
+    vk::QueryPool                      m_tileQueryPool;
+    std::vector<std::vector<uint32_t>> m_tileBatches;  // Tiles submitted per frame in flight
+    nvvk::Buffer                       m_tileVariance;  // Noise of the tiles, per frame in flight
+    uint32_t                           m_tileVarianceSlots{0};  // Counters per frame in flight
+    float                              m_timestampPeriod{1.0f};
+
+    // #Reprojection
+    void createReprojectionRender();
+    void destroyReprojection();
+    void copyReprojectionHistory(const vk::CommandBuffer& cmdBuf);
+
+    bool          m_reprojectionEnabled{true};
+    bool          m_rtReprojectHistory{false};  // Camera moved since the last traced frame
+    nvvk::Texture m_reprojectColor;
+    nvvk::Texture m_reprojectNormalDepth;
+
+    // #VirtualTextures
+    void initVirtualTextures();
+    void createVirtualTextureFeedback();
+    void destroyVirtualTextures();
+    void renderVirtualTextureUI();
+    bool loadVirtualTexture(uint32_t slot, const std::string& txtFile, ProcessedTexture& tail);
+    void updateVirtualTextures(const vk::CommandBuffer& cmdBuf);
+
+    // `vt` in virtual_texture.glsl, scalar layout
+    struct VtDesc
+    {
+        vk::DeviceAddress pageTable{0};
+        vk::DeviceAddress textures{0};  // TextureInfo of each texture slot
+        vk::DeviceAddress feedback{0};  // Of the current frame, one entry per 4x4 pixels
+        uint32_t          feedbackWidth{0};
+        uint32_t          feedbackSize{0};
+        uint32_t          frame{0};
+        uint32_t          poolPagesX{1};
+        nvmath::vec2f     invPoolSize{1.f, 1.f};
+        float             pixelSpread{0.f};  // Footprint of a pixel at unit distance
+    };
+
+    VirtualTextureSettings                                   m_vtSettings;
+    ResidencyManager                                         m_vtResidency;
+    std::unordered_map<uint32_t, std::unique_ptr<TileCache>> m_vtCaches;  // Per texture slot
+    nvvk::Texture                                            m_vtPool;    // Physical pages, border included
+    nvvk::Buffer                                             m_vtPageTable;
+    nvvk::Buffer                                             m_vtTextures;
+    nvvk::Buffer                                             m_vtDesc;
+    std::vector<nvvk::Buffer>                                m_vtFeedback;  // Host visible, per frame in flight
+    uint32_t                                                 m_vtFeedbackWidth{0};
+    uint32_t                                                 m_vtFeedbackSize{0};
+    uint32_t                                                 m_vtPoolPagesX{1};
+    nvmath::vec2f                                            m_vtInvPoolSize{1.f, 1.f};
+    uint64_t                                                 m_vtFrame{0};  // Frames recorded, VT enabled or not
+    FeedbackTrace                                            m_vtTrace;
+
+    // #Wavefront
+    enum class TraceTiming : int { Megakernel, Wavefront, None };
+
+    void createWavefrontRender();
+    void createWavefrontDescriptor();
+    void updateWavefrontDescriptorSet();
+    void createWavefrontPipelines();
+    void createWavefrontShadePipelines();
+    vk::Pipeline createWavefrontComputePipeline(const ShaderPermutationKey& key);
+    void createTraceTimings();
+    void destroyWavefrontBuffers();
+    void destroyWavefront();
+    void renderWavefrontUI();
+    void readTraceTimings(uint32_t frame);
+    void beginTraceTiming(const vk::CommandBuffer& cmdBuf, TraceTiming mode, float samples);
+    void endTraceTiming(const vk::CommandBuffer& cmdBuf);
+    void rayTraceWavefront(const vk::CommandBuffer& cmdBuf);
+
+    // `pushC` in wavefront_queue.glsl
+    struct WavefrontPushConstant
+    {
+        nvmath::vec2i imageSize;
+        int           frame;
+        int           sampleFrame;  // Frame index in the sample sequence, kept across camera moves
+        int           samplerType;
+        int           samplesPerFrame;
+        int           wave;   // Sample of the frame being traced
+        int           depth;  // Bounce being traced or shaded
+        int           sortPass;
+        int           accumulation;  // AccumulationMode
+    } m_wfPushConstants;
+
+    struct TraceTimingResult
+    {
+        float    ms{0.f};       // Last measured frame
+        float    samples{0.f};  // Traced in that frame
+        double   totalMs{0.0};  // Of all the measured frames, reset by the benchmark
+        double   totalSamples{0.0};
+        uint32_t frames{0};
+    };
+
+    bool                                               m_wavefrontEnabled{false};
+    int                                                m_wavefrontSamplesPerFrame{8};
+    nvvk::Buffer                                       m_wfRays[2];        // Ray queues, one per bounce parity
+    nvvk::Buffer                                       m_wfHits;
+    nvvk::Buffer                                       m_wfSortKeys[2];    // Ping-pong of the sort passes
+    nvvk::Buffer                                       m_wfSortValues[2];  // Hit indices
+    nvvk::Buffer                                       m_wfBlockHistograms;
+    nvvk::Buffer                                       m_wfState;          // Counters and indirect arguments
+    nvvk::Buffer                                       m_wfRadiance;
+    nvvk::DescriptorSetBindings                        m_wfDescSetLayoutBind;
+    vk::DescriptorPool                                 m_wfDescPool;
+    vk::DescriptorSetLayout                            m_wfDescSetLayout;
+    vk::DescriptorSet                                  m_wfDescSet;
+    vk::PipelineLayout                                 m_wfPipelineLayout;
+    vk::Pipeline                                       m_wfCameraPipeline;
+    vk::Pipeline                                       m_wfArgsPipeline;
+    vk::Pipeline                                       m_wfSortHistogramPipeline;
+    vk::Pipeline                                       m_wfSortScanPipeline;
+    vk::Pipeline                                       m_wfSortScatterPipeline;
+    std::array<vk::Pipeline, WAVEFRONT_MODEL_COUNT>    m_wfShadePipelines;
+    vk::Pipeline                                       m_wfResolvePipeline;
+    vk::Pipeline                                       m_wfExtendPipeline;
+    nvvk::Buffer                                       m_wfSBTBuffer;
+    vk::QueryPool                                      m_traceQueryPool;
+    std::vector<TraceTiming>                           m_traceTimingModes;  // Measured per frame in flight
+    std::array<TraceTimingResult, 2>                   m_traceTimings;      // Megakernel, wavefront
 };
 
 
@@ -0,0 +1,217 @@
+#include "application_impl.hpp"
+#include "nvh/cameramanipulator.hpp"
+#include "render/image_writer.hpp"
+
+#include <filesystem>
+
+
+// -----------------------
+// Impl Checkpoint Methods
+// -----------------------
+
+// Of what the accumulated radiance depends on and is not saved with it: a
+// checkpoint of another scene or lighting is not resumed
+uint64_t Application::Impl::computeSceneHash() const
+{
+    uint64_t hash = SCENE_HASH_SEED;
+    auto     add  = [&hash](const auto& value) { hash = hashSceneBytes(hash, &value, sizeof(value)); };
+
+    hash = hashSceneBytes(hash, m_csfFilename.data(), m_csfFilename.size());
+    add(m_sphereSettings.count);
+    add(m_sphereSettings.clusterSize);
+    add(m_sphereSettings.seed);
+    hash = hashSceneBytes(hash, m_envSettings.filename.data(), m_envSettings.filename.size());
+    add(m_envSettings.cube);
+    add(m_envSettings.intensity);
+    add(m_envSettings.sun);
+    add(m_envSettings.width);
+    add(m_pushConstant.lightPosition);
+    add(m_pushConstant.lightIntensity);
+    add(m_pushConstant.lightType);
+    add(m_samplerType);
+    return hash;
+}
+
+// Side file of the tile scheduler, next to the accumulation of a tiled render
+static std::string getTilesFilename(const std::string& filename)
+{
+    return filename + ".tiles";
+}
+
+// Reads back the accumulation, false when nothing was traced yet. The frame
+// counts of the pixels are in alpha, those of the tiles are saved aside.
+bool Application::Impl::readAccumulation(AccumulationCheckpoint& checkpoint)
+{
+    if (m_rtcurrentFrameId < 0 || m_rtSampleFrame == 0) {
+        return false;
+    }
+
+    checkpoint.width        = m_offscreenSize.width;
+    checkpoint.height       = m_offscreenSize.height;
+    checkpoint.sceneHash    = computeSceneHash();
+    checkpoint.frameId      = m_rtcurrentFrameId;
+    checkpoint.sampleFrame  = m_rtSampleFrame;
+    checkpoint.accumulation = static_cast<int32_t>(m_accumulationMode);
+    CameraManip.getLookat(checkpoint.eye, checkpoint.center, checkpoint.up);
+    checkpoint.fov = CameraManip.getFov();
+
+    // After the frames submitted so far, unpacked from the state
+    vk::ImageSubresourceLayers subresource{vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+    size_t                     nbTexels = static_cast<size_t>(m_offscreenSize.width) * m_offscreenSize.height;
+    std::vector<uint32_t>      texels(4 * nbTexels);
+    m_uploader.readImage(m_accumState.image, vk::ImageLayout::eGeneral, subresource, {0, 0}, m_offscreenSize,
+                         texels.data(), texels.size() * sizeof(uint32_t));
+
+    bool compensated = m_accumulationMode == AccumulationMode::Compensated;
+    checkpoint.color.resize(4 * nbTexels);
+    checkpoint.compensation.assign(compensated ? 4 * nbTexels : 0, 0);
+    for (size_t i = 0; i < nbTexels; ++i) {
+        AccumulationPixel pixel = decodeAccumulation(&texels[4 * i]);
+        for (int c = 0; c < 3; ++c) {
+            checkpoint.color[4 * i + c] = pixel.mean[c];
+            if (compensated) {
+                checkpoint.compensation[4 * i + c] = static_cast<int8_t>(getCompensationSteps(pixel.compensation[c]));
+            }
+        }
+        checkpoint.color[4 * i + 3] = pixel.count;
+    }
+    return true;
+}
+
+// Continues the accumulation of `checkpoint`, of the size of the images
+void Application::Impl::writeAccumulation(const AccumulationCheckpoint& checkpoint)
+{
+    // Packed as the state, without compensation in the average mode. The
+    // display image is shown before the next frame, which may never come once
+    // all the frames were accumulated.
+    size_t                nbTexels = checkpoint.color.size() / 4;
+    std::vector<uint32_t> texels(4 * nbTexels);
+    std::vector<uint16_t> display(4 * nbTexels);
+    for (size_t i = 0; i < nbTexels; ++i) {
+        AccumulationPixel pixel;
+        for (int c = 0; c < 3; ++c) {
+            pixel.mean[c] = checkpoint.color[4 * i + c];
+            if (!checkpoint.compensation.empty()) {
+                pixel.compensation[c] =
+                    float(checkpoint.compensation[4 * i + c]) * (1.0f / float(ACCUMULATION_COMPENSATION_STEPS));
+            }
+        }
+        pixel.count = std::min(std::nearbyint(checkpoint.color[4 * i + 3] * ACCUMULATION_COUNT_SCALE), 65535.0f)
+                      / ACCUMULATION_COUNT_SCALE;
+        encodeAccumulation(pixel, &texels[4 * i]);
+        for (int c = 0; c < 4; ++c) {
+            display[4 * i + c] = floatToHalf(c < 3 ? pixel.mean[c] : pixel.count);
+        }
+    }
+
+    vk::ImageSubresourceRange range{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+
+    Uploader::ImageRegion region;
+    region.extent = m_offscreenSize;
+    region.data   = texels.data();
+    region.size   = texels.size() * sizeof(uint32_t);
+    Uploader::Ticket ticket =
+        m_uploader.uploadImage(m_accumState.image, range, {region}, 1, vk::ImageLayout::eGeneral);
+
+    region.data = display.data();
+    region.size = display.size() * sizeof(uint16_t);
+    ticket = m_uploader.uploadImage(m_offscreenColor.image, range, {region}, 1, vk::ImageLayout::eGeneral);
+    m_uploader.wait(ticket);
+
+    m_rtcurrentFrameId = checkpoint.frameId;
+    m_rtSampleFrame    = checkpoint.sampleFrame;
+    m_accumulationMode = static_cast<AccumulationMode>(checkpoint.accumulation);
+
+    // Same view, updateFrameId() must not restart
+    m_camera_ref.camera = CameraManip.getMatrix();
+    m_camera_ref.fov    = CameraManip.getFov();
+}
+
+// At startup, once the images exist
+void Application::Impl::resumeCheckpoint()
+{
+    m_checkpointTime = std::chrono::high_resolution_clock::now();
+    if (m_checkpointSettings.filename.empty()) {
+        return;
+    }
+
+    const std::string&     filename = m_checkpointSettings.filename;
+    AccumulationCheckpoint checkpoint;
+    if (!loadAccumulationCheckpoint(filename, checkpoint)) {
+        LOGI("Checkpoint: no valid checkpoint in %s, starting a new accumulation\n", filename.c_str());
+        return;
+    }
+    if (checkpoint.sceneHash != computeSceneHash()) {
+        LOGW("Checkpoint: %s is of another scene, starting a new accumulation\n", filename.c_str());
+        return;
+    }
+
+    CameraManip.setLookat(checkpoint.eye, checkpoint.center, checkpoint.up, true);
+    CameraManip.setFov(checkpoint.fov);
+    bool resampled = checkpoint.width != m_offscreenSize.width || checkpoint.height != m_offscreenSize.height;
+    if (resampled) {
+        checkpoint = resampleAccumulationCheckpoint(checkpoint, m_offscreenSize.width, m_offscreenSize.height);
+    }
+    writeAccumulation(checkpoint);
+
+    // A tiled render goes on with its tiles, if of the same size: else the
+    // pixels keep their frame counts and the whole image is traced
+    TileScheduler tiles;
+    if (!resampled && tiles.loadCheckpoint(getTilesFilename(filename)) && tiles.getWidth() == m_offscreenSize.width
+        && tiles.getHeight() == m_offscreenSize.height && tiles.getTiles().size() <= m_tileVarianceSlots) {
+        tiles.setBudgetMs(m_tileBudgetMs);
+        m_tileScheduler  = std::move(tiles);
+        m_tileSize       = static_cast<int>(m_tileScheduler.getTileSize());
+        m_tiledRendering = true;
+        LOGI("Checkpoint: resumed %u tiles\n", static_cast<uint32_t>(m_tileScheduler.getTiles().size()));
+    }
+
+    m_checkpointSampleFrame = m_rtSampleFrame;
+    LOGI("Checkpoint: resumed %s at frame %d\n", filename.c_str(), m_rtcurrentFrameId + 1);
+}
+
+// Called after each frame, saves every interval
+void Application::Impl::updateCheckpoint()
+{
+    if (m_checkpointSettings.filename.empty() || m_checkpointSettings.interval <= 0.0f) {
+        return;
+    }
+
+    auto now = std::chrono::high_resolution_clock::now();
+    if (std::chrono::duration<float>(now - m_checkpointTime).count() >= m_checkpointSettings.interval) {
+        saveCheckpoint();
+        m_checkpointTime = now;
+    }
+}
+
+void Application::Impl::saveCheckpoint()
+{
+    // Nothing accumulated since the last save
+    if (m_checkpointSettings.filename.empty() || m_rtSampleFrame == m_checkpointSampleFrame) {
+        return;
+    }
+
+    AccumulationCheckpoint checkpoint;
+    if (!readAccumulation(checkpoint)) {
+        return;
+    }
+
+    const std::string& filename = m_checkpointSettings.filename;
+    if (!saveAccumulationCheckpoint(filename, checkpoint)) {
+        LOGW("Could not write the checkpoint %s\n", filename.c_str());
+        return;
+    }
+    m_checkpointSampleFrame = checkpoint.sampleFrame;
+    LOGI("Checkpoint: saved %s at frame %d\n", filename.c_str(), checkpoint.frameId + 1);
+
+    // The tiles of an earlier tiled render no longer apply
+    bool tiled = m_tiledRendering && !m_wavefrontEnabled;
+    if (tiled) {
+        if (!m_tileScheduler.saveCheckpoint(getTilesFilename(filename))) {
+            LOGW("Could not write the tiles of the checkpoint %s\n", filename.c_str());
+        }
+    } else {
+        std::error_code error;
+        std::filesystem::remove(getTilesFilename(filename), error);
+    }
+}
@@ -0,0 +1,322 @@
+#include "application_impl.hpp"
+#include "render/image_writer.hpp"
+#include "nvvk/shaders_vk.hpp"
+#include "nvh/fileoperations.hpp"
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define DENOISE_GROUP_SIZE 16  // Same group size as in denoise_common.glsl
+
+
+// -----------------------
+// Impl Denoise Methods
+// -----------------------
+
+void Application::Impl::createDenoiseRender()
+{
+    m_alloc.destroy(m_gbufferNormalDepth);
+    m_alloc.destroy(m_gbufferAlbedo);
+    m_alloc.destroy(m_denoiseOutput);
+    for (int i = 0; i < 2; ++i) {
+        m_alloc.destroy(m_denoiseHistoryColor[i]);
+        m_alloc.destroy(m_denoiseHistoryMoments[i]);
+        m_alloc.destroy(m_denoiseHistoryNormalDepth[i]);
+        m_alloc.destroy(m_denoisePing[i]);
+    }
+
+    auto createStorageTexture = [&](vk::Format format) {
+        auto createInfo = nvvk::makeImage2DCreateInfo(m_size, format,
+                                                      vk::ImageUsageFlagBits::eStorage
+                                                          | vk::ImageUsageFlagBits::eSampled
+                                                          | vk::ImageUsageFlagBits::eTransferSrc
+                                                          | vk::ImageUsageFlagBits::eTransferDst);
+
+        nvvk::Image             image   = m_alloc.createImage(createInfo);
+        vk::ImageViewCreateInfo ivInfo  = nvvk::makeImageViewCreateInfo(image.image, createInfo);
+        nvvk::Texture           texture = m_alloc.createTexture(image, ivInfo, vk::SamplerCreateInfo());
+        texture.descriptor.imageLayout  = VK_IMAGE_LAYOUT_GENERAL;
+        return texture;
+    };
+
+    m_gbufferNormalDepth = createStorageTexture(vk::Format::eR16G16B16A16Sfloat);
+    m_gbufferAlbedo      = createStorageTexture(vk::Format::eR8G8B8A8Unorm);
+    m_denoiseOutput      = createStorageTexture(vk::Format::eR16G16B16A16Sfloat);
+    for (int i = 0; i < 2; ++i) {
+        m_denoiseHistoryColor[i]       = createStorageTexture(vk::Format::eR16G16B16A16Sfloat);
+        m_denoiseHistoryMoments[i]     = createStorageTexture(vk::Format::eR16G16B16A16Sfloat);
+        m_denoiseHistoryNormalDepth[i] = createStorageTexture(vk::Format::eR16G16B16A16Sfloat);
+        m_denoisePing[i]               = createStorageTexture(vk::Format::eR16G16B16A16Sfloat);
+    }
+
+    // All images are used in the general layout, histories start empty
+    {
+        nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+        auto              cmdBuf = genCmdBuf.createCommandBuffer();
+
+        vk::ClearColorValue       clearValue(std::array<float, 4>{0.f, 0.f, 0.f, 0.f});
+        vk::ImageSubresourceRange range{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+
+        std::vector<vk::Image> images = {m_gbufferNormalDepth.image, m_gbufferAlbedo.image, m_denoiseOutput.image};
+        for (int i = 0; i < 2; ++i) {
+            images.push_back(m_denoiseHistoryColor[i].image);
+            images.push_back(m_denoiseHistoryMoments[i].image);
+            images.push_back(m_denoiseHistoryNormalDepth[i].image);
+            images.push_back(m_denoisePing[i].image);
+        }
+
+        for (auto& image : images) {
+            nvvk::cmdBarrierImageLayout(cmdBuf, image, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+            cmdBuf.clearColorImage(image, vk::ImageLayout::eGeneral, clearValue, range);
+        }
+
+        genCmdBuf.submitAndWait(cmdBuf);
+    }
+
+    m_denoiseHistoryValid = false;
+}
+
+void Application::Impl::createDenoiseDescriptor()
+{
+    using vkDS = vk::DescriptorSetLayoutBinding;
+    using vkDT = vk::DescriptorType;
+    using vkSS = vk::ShaderStageFlagBits;
+
+    // [in] Accumulation, G-buffer
+    m_denoiseDescSetLayoutBind.addBinding(vkDS(0, vkDT::eStorageImage, 1, vkSS::eCompute));
+    m_denoiseDescSetLayoutBind.addBinding(vkDS(1, vkDT::eStorageImage, 1, vkSS::eCompute));
+    m_denoiseDescSetLayoutBind.addBinding(vkDS(2, vkDT::eStorageImage, 1, vkSS::eCompute));
+    // [in/out] Ping-pong histories: color, luminance moments, G-buffer
+    m_denoiseDescSetLayoutBind.addBinding(vkDS(3, vkDT::eStorageImage, 2, vkSS::eCompute));
+    m_denoiseDescSetLayoutBind.addBinding(vkDS(4, vkDT::eStorageImage, 2, vkSS::eCompute));
+    m_denoiseDescSetLayoutBind.addBinding(vkDS(5, vkDT::eStorageImage, 2, vkSS::eCompute));
+    // [in/out] A-trous iterations
+    m_denoiseDescSetLayoutBind.addBinding(vkDS(6, vkDT::eStorageImage, 2, vkSS::eCompute));
+    // [out] Denoised image
+    m_denoiseDescSetLayoutBind.addBinding(vkDS(7, vkDT::eStorageImage, 1, vkSS::eCompute));
+    // [in] Camera matrices
+    m_denoiseDescSetLayoutBind.addBinding(vkDS(8, vkDT::eUniformBuffer, 1, vkSS::eCompute));
+
+    m_denoiseDescSetLayout = m_denoiseDescSetLayoutBind.createLayout(m_device);
+    m_denoiseDescPool      = m_denoiseDescSetLayoutBind.createPool(m_device, 1);
+    m_denoiseDescSet       = nvvk::allocateDescriptorSet(m_device, m_denoiseDescPool, m_denoiseDescSetLayout);
+}
+
+void Application::Impl::updateDenoiseDescriptorSet()
+{
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.emplace_back(m_denoiseDescSetLayoutBind.makeWrite(m_denoiseDescSet, 0, &m_offscreenColor.descriptor));
+    writes.emplace_back(m_denoiseDescSetLayoutBind.makeWrite(m_denoiseDescSet, 1, &m_gbufferNormalDepth.descriptor));
+    writes.emplace_back(m_denoiseDescSetLayoutBind.makeWrite(m_denoiseDescSet, 2, &m_gbufferAlbedo.descriptor));
+
+    std::array<VkDescriptorImageInfo, 2> color{m_denoiseHistoryColor[0].descriptor, m_denoiseHistoryColor[1].descriptor};
+    std::array<VkDescriptorImageInfo, 2> moments{m_denoiseHistoryMoments[0].descriptor,
+                                                   m_denoiseHistoryMoments[1].descriptor};
+    std::array<VkDescriptorImageInfo, 2> normalDepth{m_denoiseHistoryNormalDepth[0].descriptor,
+                                                       m_denoiseHistoryNormalDepth[1].descriptor};
+    std::array<VkDescriptorImageInfo, 2> ping{m_denoisePing[0].descriptor, m_denoisePing[1].descriptor};
+    writes.emplace_back(m_denoiseDescSetLayoutBind.makeWriteArray(m_denoiseDescSet, 3, color.data()));
+    writes.emplace_back(m_denoiseDescSetLayoutBind.makeWriteArray(m_denoiseDescSet, 4, moments.data()));
+    writes.emplace_back(m_denoiseDescSetLayoutBind.makeWriteArray(m_denoiseDescSet, 5, normalDepth.data()));
+    writes.emplace_back(m_denoiseDescSetLayoutBind.makeWriteArray(m_denoiseDescSet, 6, ping.data()));
+
+    writes.emplace_back(m_denoiseDescSetLayoutBind.makeWrite(m_denoiseDescSet, 7, &m_denoiseOutput.descriptor));
+
+    vk::DescriptorBufferInfo dbiUnif{m_cameraMat.buffer, 0, VK_WHOLE_SIZE};
+    writes.emplace_back(m_denoiseDescSetLayoutBind.makeWrite(m_denoiseDescSet, 8, &dbiUnif));
+
+    m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void Application::Impl::createDenoisePipeline()
+{
+    vk::PushConstantRange        pushConstants{vk::ShaderStageFlagBits::eCompute, 0, sizeof(DenoisePushConstant)};
+    vk::PipelineLayoutCreateInfo layoutInfo{{}, 1, &m_denoiseDescSetLayout, 1, &pushConstants};
+    m_denoisePipelineLayout = m_device.createPipelineLayout(layoutInfo);
+
+    auto createComputePipeline = [&](const std::string& filename) {
+        vk::ComputePipelineCreateInfo computePipelineCreateInfo{{}, {}, m_denoisePipelineLayout};
+        computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+            m_device, nvh::loadFile(filename, true, _default_search_paths, true), VK_SHADER_STAGE_COMPUTE_BIT);
+
+        vk::Pipeline pipeline = static_cast<const vk::Pipeline&>(
+            m_device.createComputePipeline({}, computePipelineCreateInfo));
+        m_device.destroy(computePipelineCreateInfo.stage.module);
+        return pipeline;
+    };
+
+    m_denoiseTemporalPipeline = createComputePipeline("spv/denoise_temporal.comp.spv");
+    m_denoiseAtrousPipeline   = createComputePipeline("spv/denoise_atrous.comp.spv");
+}
+
+void Application::Impl::destroyDenoise()
+{
+    m_device.destroy(m_denoiseTemporalPipeline);
+    m_device.destroy(m_denoiseAtrousPipeline);
+    m_device.destroy(m_denoisePipelineLayout);
+    m_device.destroy(m_denoiseDescPool);
+    m_device.destroy(m_denoiseDescSetLayout);
+
+    m_alloc.destroy(m_gbufferNormalDepth);
+    m_alloc.destroy(m_gbufferAlbedo);
+    m_alloc.destroy(m_denoiseOutput);
+    for (int i = 0; i < 2; ++i) {
+        m_alloc.destroy(m_denoiseHistoryColor[i]);
+        m_alloc.destroy(m_denoiseHistoryMoments[i]);
+        m_alloc.destroy(m_denoiseHistoryNormalDepth[i]);
+        m_alloc.destroy(m_denoisePing[i]);
+    }
+}
+
+void Application::Impl::renderDenoiseUI()
+{
+    if (!ImGui::CollapsingHeader("Denoiser")) {
+        return;
+    }
+
+    auto& pc = m_denoisePushConstants;
+
+    if (ImGui::Checkbox("Enabled##Denoiser", &m_denoiseEnabled)) {
+        // The post descriptor set may be in use by frames in flight
+        m_device.waitIdle();
+        updatePostDescriptorSet();
+        m_denoiseHistoryValid = false;
+    }
+
+    ImGui::SliderInt("Iterations", &pc.iterations, 1, 8);
+    ImGui::SliderFloat("Luminance Sigma", &pc.sigmaLuminance, 0.1f, 16.f);
+    ImGui::SliderFloat("Normal Sigma", &pc.sigmaNormal, 1.f, 256.f);
+    ImGui::SliderFloat("Depth Sigma", &pc.sigmaDepth, 0.1f, 16.f);
+    ImGui::SliderFloat("Max History", &pc.maxHistory, 1.f, 64.f);
+}
+
+void Application::Impl::denoise(const vk::CommandBuffer& cmdBuf)
+{
+    if (!m_denoiseEnabled) {
+        return;
+    }
+
+    // Ray tracing outputs must be written before the compute passes read them
+    vk::MemoryBarrier memBarrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead};
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                           vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eDeviceGroup,
+                           {memBarrier}, {}, {});
+
+    auto& pc        = m_denoisePushConstants;
+    pc.historyIndex = 1 - pc.historyIndex;
+    pc.historyValid = m_denoiseHistoryValid ? 1 : 0;
+
+    dispatchDenoiseTemporal(cmdBuf);
+    dispatchDenoiseAtrous(cmdBuf);
+
+    // The post shader samples the denoised output
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader,
+                           vk::DependencyFlagBits::eDeviceGroup, {memBarrier}, {}, {});
+
+    m_denoiseHistoryValid = true;
+}
+
+// Temporal reprojection and variance estimation, writes the first ping image
+void Application::Impl::dispatchDenoiseTemporal(const vk::CommandBuffer& cmdBuf)
+{
+    auto&    pc      = m_denoisePushConstants;
+    uint32_t groupsX = (m_size.width + (DENOISE_GROUP_SIZE - 1)) / DENOISE_GROUP_SIZE;
+    uint32_t groupsY = (m_size.height + (DENOISE_GROUP_SIZE - 1)) / DENOISE_GROUP_SIZE;
+
+    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_denoisePipelineLayout, 0, {m_denoiseDescSet}, {});
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_denoiseTemporalPipeline);
+    cmdBuf.pushConstants<DenoisePushConstant>(m_denoisePipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+    cmdBuf.dispatch(groupsX, groupsY, 1);
+}
+
+// A-trous iterations, each one reads the result of the previous one
+void Application::Impl::dispatchDenoiseAtrous(const vk::CommandBuffer& cmdBuf)
+{
+    auto&    pc      = m_denoisePushConstants;
+    uint32_t groupsX = (m_size.width + (DENOISE_GROUP_SIZE - 1)) / DENOISE_GROUP_SIZE;
+    uint32_t groupsY = (m_size.height + (DENOISE_GROUP_SIZE - 1)) / DENOISE_GROUP_SIZE;
+
+    vk::MemoryBarrier memBarrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead};
+    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_denoisePipelineLayout, 0, {m_denoiseDescSet}, {});
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_denoiseAtrousPipeline);
+    for (int i = 0; i < pc.iterations; ++i) {
+        cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                               vk::DependencyFlagBits::eDeviceGroup, {memBarrier}, {}, {});
+
+        pc.iteration = i;
+        cmdBuf.pushConstants<DenoisePushConstant>(m_denoisePipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+        cmdBuf.dispatch(groupsX, groupsY, 1);
+    }
+}
+
+// Reads back the inputs and the output of the A-trous filter for the CPU
+// reference, see AtrousDump. The iterations overwrite the output of the
+// temporal pass: both are run again on the last frame, with its push
+// constants, which rewrites the same histories and images.
+void Application::Impl::dumpDenoise(const std::string& directory)
+{
+    if (!m_denoiseEnabled || !m_denoiseHistoryValid) {
+        LOGW("Denoise: nothing to dump, the denoiser did not run\n");
+        return;
+    }
+    m_device.waitIdle();
+
+    auto runPass = [&](bool temporal) {
+        nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+        auto              cmdBuf = genCmdBuf.createCommandBuffer();
+        if (temporal) {
+            dispatchDenoiseTemporal(cmdBuf);
+        } else {
+            dispatchDenoiseAtrous(cmdBuf);
+        }
+        // Visible to the copies of the readbacks
+        vk::MemoryBarrier readBarrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead};
+        cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+                               vk::DependencyFlagBits::eDeviceGroup, {readBarrier}, {}, {});
+        genCmdBuf.submitAndWait(cmdBuf);
+    };
+
+    vk::ImageSubresourceLayers subresource{vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+    size_t                     nbTexels = static_cast<size_t>(m_size.width) * m_size.height;
+
+    auto readImage = [&](const nvvk::Texture& texture, bool halfData) {
+        std::vector<float> rgba;
+        if (halfData) {
+            std::vector<uint16_t> texels(4 * nbTexels);
+            m_uploader.readImage(texture.image, vk::ImageLayout::eGeneral, subresource, {0, 0}, m_size,
+                                 texels.data(), texels.size() * sizeof(uint16_t));
+            rgba = halfToFloat(texels);
+        } else {
+            std::vector<uint8_t> texels(4 * nbTexels);
+            m_uploader.readImage(texture.image, vk::ImageLayout::eGeneral, subresource, {0, 0}, m_size,
+                                 texels.data(), texels.size());
+            rgba.resize(texels.size());
+            std::transform(texels.begin(), texels.end(), rgba.begin(), [](uint8_t v) { return v / 255.0f; });
+        }
+
+        FloatImage image(m_size.width, m_size.height);
+        memcpy(image.pixels.data(), rgba.data(), rgba.size() * sizeof(float));
+        return image;
+    };
+
+    const auto& pc = m_denoisePushConstants;
+    AtrousDump  dump;
+    dump.settings.iterations     = pc.iterations;
+    dump.settings.sigmaLuminance = pc.sigmaLuminance;
+    dump.settings.sigmaNormal    = pc.sigmaNormal;
+    dump.settings.sigmaDepth     = pc.sigmaDepth;
+
+    runPass(true);
+    dump.colorVariance = readImage(m_denoisePing[0], true);
+    dump.normalDepth   = readImage(m_gbufferNormalDepth, true);
+    dump.albedo        = readImage(m_gbufferAlbedo, false);
+    runPass(false);
+    dump.denoised = readImage(m_denoiseOutput, true);
+
+    if (!dump.save(directory)) {
+        LOGW("Could not write the denoiser dump in %s\n", directory.c_str());
+        return;
+    }
+    LOGI("Denoise: dumped %ux%u to %s\n", m_size.width, m_size.height, directory.c_str());
+}
@@ -3,64 +3,114 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "fileformats/stb_image.h"
 #include "common/obj_loader.h"
+#include "scene/csf_scene.hpp"
+#include "texture/texture_processor.hpp"
 
 #include "nvvk/pipeline_vk.hpp"
 #include "nvh/fileoperations.hpp"
 
+// -----------------------
+// Helpers
+// -----------------------
+
+static uint32_t allocateSlots(SlotAllocator& allocator, uint32_t count, const char* what)
+{
+    uint32_t first = allocator.allocate(count);
+    if (first == SlotAllocator::INVALID_SLOT) {
+        throw std::runtime_error(std::string("Out of bindless ") + what + " slots");
+    }
+    return first;
+}
+
+static GeometryArena::Range checkRange(const GeometryArena::Range& range, const char* what)
+{
+    if (!range.isValid()) {
+        throw std::runtime_error(std::string("Could not allocate the ") + what + " range in the geometry arena");
+    }
+    return range;
+}
 
-// Holding the camera matrices
-struct CameraMatrices
+static vk::Format getTextureFormat(TextureCompression compression, bool srgb)
 {
-  nvmath::mat4f view;
-  nvmath::mat4f proj;
-  nvmath::mat4f viewInverse;
-  // #VKRay
-  nvmath::mat4f projInverse;
-};
+    switch (compression) {
+        case TextureCompression::Bc1: return srgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock;
+        case TextureCompression::Bc7: return srgb ? vk::Format::eBc7SrgbBlock : vk::Format::eBc7UnormBlock;
+        default: return srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+    }
+}
 
 // -----------------------
 // Impl Descriptor Methods
 // -----------------------
 
+void Application::Impl::initBindless()
+{
+    vk::PhysicalDeviceDescriptorIndexingProperties indexingProps;
+    vk::PhysicalDeviceProperties2                  props;
+    props.pNext = &indexingProps;
+    m_physicalDevice.getProperties2(&props);
+
+    // Minus the skybox
+    uint32_t maxTextures = std::min({indexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                     indexingProps.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                     indexingProps.maxDescriptorSetUpdateAfterBindSampledImages,
+                                     indexingProps.maxDescriptorSetUpdateAfterBindSamplers});
+    maxTextures = maxTextures > 1 ? maxTextures - 1 : 0;
+
+    m_txtSlotAlloc.reset(std::min(BINDLESS_MAX_TEXTURES, maxTextures));
+    LOGI("Bindless textures: %u\n", m_txtSlotAlloc.getCapacity());
+}
+
 void Application::Impl::createDescriptorSetLayout()
 {
     using vkDS     = vk::DescriptorSetLayoutBinding;
     using vkDT     = vk::DescriptorType;
     using vkSS     = vk::ShaderStageFlagBits;
-    uint32_t nbTxt = std::max(1U, static_cast<uint32_t>(m_textures.size()));
-    uint32_t nbObj = std::max(1U, static_cast<uint32_t>(m_objModel.size()));
+    using vkDBF    = vk::DescriptorBindingFlagBits;
+    uint32_t nbTxt = m_txtSlotAlloc.getCapacity();
 
     // Camera matrices (binding = 0)
     m_descSetLayoutBind.addBinding(
-        vkDS(0, vkDT::eUniformBuffer, 1, vkSS::eVertex | vkSS::eRaygenKHR));
-    // Materials (binding = 1)
-    m_descSetLayoutBind.addBinding(
-        vkDS(1, vkDT::eStorageBuffer, nbObj, vkSS::eVertex | vkSS::eFragment | vkSS::eClosestHitKHR));
+        vkDS(0, vkDT::eUniformBuffer, 1, vkSS::eVertex | vkSS::eRaygenKHR | vkSS::eCompute));
     // Scene description (binding = 2)
     m_descSetLayoutBind.addBinding(  //
-        vkDS(2, vkDT::eStorageBuffer, 1, vkSS::eVertex | vkSS::eFragment | vkSS::eClosestHitKHR));
+        vkDS(2, vkDT::eStorageBuffer, 1, vkSS::eVertex | vkSS::eFragment | vkSS::eClosestHitKHR | vkSS::eCompute));
     // Textures (binding = 3)
     m_descSetLayoutBind.addBinding(
-        vkDS(3, vkDT::eCombinedImageSampler, nbTxt, vkSS::eFragment | vkSS::eClosestHitKHR));
-    // Materials (binding = 4)
-    m_descSetLayoutBind.addBinding(
-        vkDS(4, vkDT::eStorageBuffer, nbObj, vkSS::eFragment | vkSS::eClosestHitKHR));
-    // Storing vertices (binding = 5)
+        vkDS(3, vkDT::eCombinedImageSampler, nbTxt, vkSS::eFragment | vkSS::eClosestHitKHR | vkSS::eCompute));
+    // Vertices, indices and materials are reached through the device
+    // addresses of the scene description. The compute stage is the shading
+    // of the wavefront mode.
+    // Storing spheres (binding = 7)
     m_descSetLayoutBind.addBinding(  //
-        vkDS(5, vkDT::eStorageBuffer, nbObj, vkSS::eClosestHitKHR));
-    // Storing indices (binding = 6)
+        vkDS(7, vkDT::eStorageBuffer, 1, vkSS::eClosestHitKHR | vkSS::eIntersectionKHR | vkSS::eCompute));
+    // Environment map (binding = 8), its sampling distribution (binding = 11)
     m_descSetLayoutBind.addBinding(  //
-        vkDS(6, vkDT::eStorageBuffer, nbObj, vkSS::eClosestHitKHR));
-    // Storing spheres (binding = 7)
+        vkDS(8, vkDT::eCombinedImageSampler, 1, vkSS::eMissKHR | vkSS::eClosestHitKHR | vkSS::eCompute));
+    m_descSetLayoutBind.addBinding(  //
+        vkDS(11, vkDT::eStorageBuffer, 1, vkSS::eMissKHR | vkSS::eClosestHitKHR));
+    // Virtual texture page pool (binding = 9) and tables (binding = 10)
     m_descSetLayoutBind.addBinding(  //
-        vkDS(7, vkDT::eStorageBuffer, 1, vkSS::eClosestHitKHR | vkSS::eIntersectionKHR));
-    // Storing Skybox texture (binding = 8)
+        vkDS(9, vkDT::eCombinedImageSampler, 1, vkSS::eClosestHitKHR | vkSS::eCompute));
     m_descSetLayoutBind.addBinding(  //
-        vkDS(8, vkDT::eCombinedImageSampler, 1, vkSS::eMissKHR | vkSS::eClosestHitKHR));
+        vkDS(10, vkDT::eUniformBuffer, 1, vkSS::eClosestHitKHR | vkSS::eCompute));
+
+    // The texture array is sized once to the slot capacity, only the
+    // allocated slots are written, possibly while the set is bound: textures
+    // can be added without a new layout
+    vk::DescriptorBindingFlags bindless = vkDBF::ePartiallyBound | vkDBF::eUpdateAfterBind;
+    for (uint32_t binding : {0, 2, 3, 7, 8, 9, 10, 11}) {
+        m_descSetLayoutBind.setBindingFlags(binding, binding == 3 ? bindless : vk::DescriptorBindingFlags());
+    }
 
-    m_descSetLayout = m_descSetLayoutBind.createLayout(m_device);
-    m_descPool      = m_descSetLayoutBind.createPool(m_device, 1);
-    m_descSet       = nvvk::allocateDescriptorSet(m_device, m_descPool, m_descSetLayout);
+    m_descSetLayout = m_descSetLayoutBind.createLayout(
+        m_device, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, nvvk::DescriptorSupport::CORE_1_2);
+
+    std::vector<vk::DescriptorPoolSize> poolSizes;
+    m_descSetLayoutBind.addRequiredPoolSizes(poolSizes, 1);
+    m_descPool = m_device.createDescriptorPool(
+        {vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind, 1, static_cast<uint32_t>(poolSizes.size()), poolSizes.data()});
+    m_descSet = nvvk::allocateDescriptorSet(m_device, m_descPool, m_descSetLayout);
 }
 
 void Application::Impl::updateDescriptorSet()
@@ -74,41 +124,37 @@ void Application::Impl::updateDescriptorSet()
     vk::DescriptorBufferInfo dbiSceneDesc{m_sceneDesc.buffer, 0, VK_WHOLE_SIZE};
     writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, 2, &dbiSceneDesc));
 
-    // All material buffers, 1 buffer per OBJ
-    std::vector<vk::DescriptorBufferInfo> dbiMat;
-    std::vector<vk::DescriptorBufferInfo> dbiMatIdx;
-    std::vector<vk::DescriptorBufferInfo> dbiVert;
-    std::vector<vk::DescriptorBufferInfo> dbiIdx;
-    for(auto& obj : m_objModel)
-    {
-        dbiMat.emplace_back(obj.matColorBuffer.buffer, 0, VK_WHOLE_SIZE);
-        dbiMatIdx.emplace_back(obj.matIndexBuffer.buffer, 0, VK_WHOLE_SIZE);
-        dbiVert.emplace_back(obj.vertexBuffer.buffer, 0, VK_WHOLE_SIZE);
-        dbiIdx.emplace_back(obj.indexBuffer.buffer, 0, VK_WHOLE_SIZE);
-    }
-
-    writes.emplace_back(m_descSetLayoutBind.makeWriteArray(m_descSet, 1, dbiMat.data()));
-    writes.emplace_back(m_descSetLayoutBind.makeWriteArray(m_descSet, 4, dbiMatIdx.data()));
-    writes.emplace_back(m_descSetLayoutBind.makeWriteArray(m_descSet, 5, dbiVert.data()));
-    writes.emplace_back(m_descSetLayoutBind.makeWriteArray(m_descSet, 6, dbiIdx.data()));
-
-    // All texture samplers
-    std::vector<vk::DescriptorImageInfo> diit;
-    for(auto& texture : m_textures)
-    {
-        diit.emplace_back(texture.descriptor);
-    }
-    writes.emplace_back(m_descSetLayoutBind.makeWriteArray(m_descSet, 3, diit.data()));
-
-    // Skybox texture
-    writes.emplace_back(m_descSetLayoutBind.makeWriteArray(m_descSet, 8, &m_skybox_txt->descriptor)) ;
+    // Environment
+    writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, 8, &m_envTexture.descriptor));
+    vk::DescriptorBufferInfo dbiEnvDist{m_envDistribution.buffer, 0, VK_WHOLE_SIZE};
+    writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, 11, &dbiEnvDist));
 
     // Spheres
     vk::DescriptorBufferInfo dbiSpheres{m_sphereHandler->getSpheresBuffer().buffer, 0, VK_WHOLE_SIZE};
     writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, 7, &dbiSpheres));
 
+    // Virtual textures
+    writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, 9, &m_vtPool.descriptor));
+    vk::DescriptorBufferInfo dbiVtDesc{m_vtDesc.buffer, 0, VK_WHOLE_SIZE};
+    writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, 10, &dbiVtDesc));
+
     // Writing the information
     m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    // Bindless textures, slot by slot
+    writeTextureDescriptors(0, static_cast<uint32_t>(m_textures.size()));
+}
+
+// Textures [first, first + count) of `m_textures`
+void Application::Impl::writeTextureDescriptors(uint32_t first, uint32_t count)
+{
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.reserve(count);
+    for(uint32_t i = first; i < first + count; i++)
+    {
+        writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, 3, &m_textures[i].descriptor, m_textureSlots[i]));
+    }
+    m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
 void Application::Impl::createUniformBuffer()
@@ -131,11 +177,16 @@ void Application::Impl::updateUniformBuffer(const vk::CommandBuffer& cmdBuf)
     hostUBO.viewInverse = nvmath::invert(hostUBO.view);
     // #VKRay
     hostUBO.projInverse = nvmath::invert(hostUBO.proj);
+    // Matrices of the last frame, used for reprojection
+    hostUBO.prevView = m_cameraMatrices.view;
+    hostUBO.prevProj = m_cameraMatrices.proj;
+    m_cameraMatrices = hostUBO;
 
     // UBO on the device, and what stages access it.
     vk::Buffer deviceUBO = m_cameraMat.buffer;
     auto       uboUsageStages =
-        vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eRayTracingShaderKHR;
+        vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eRayTracingShaderKHR
+        | vk::PipelineStageFlagBits::eComputeShader;
 
     // Ensure that the modified UBO is not visible to previous frames.
     vk::BufferMemoryBarrier beforeBarrier;
@@ -170,70 +221,116 @@ void Application::Impl::createSceneDescriptionBuffer()
         vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
 
         // OBJ Instance
-        using vkBU = vk::BufferUsageFlagBits;
-
         ObjInstance instance;
-        instance.objIndex    = static_cast<uint32_t>(m_objModel.size());
         instance.transform   = nvmath::mat4f().identity();
         instance.transformIT = nvmath::mat4f().identity();
-        instance.txtOffset   = static_cast<uint32_t>(m_textures.size());
-        m_objInstance.emplace_back(instance);
         
         // OBJ Model
         ObjModel model;
-        model.nbIndices  = static_cast<uint32_t>(0);
-        model.nbVertices = static_cast<uint32_t>(0);
-
-        model.vertexBuffer =
-            m_alloc.createBuffer(cmdBuf, std::vector<VertexObj> { VertexObj {} },
-                            vkBU::eVertexBuffer | vkBU::eStorageBuffer | vkBU::eShaderDeviceAddress
-                                    | vkBU::eAccelerationStructureBuildInputReadOnlyKHR);
-        model.indexBuffer =
-            m_alloc.createBuffer(cmdBuf, std::vector<VkDescriptorBindingFlags> { VkDescriptorBindingFlags {} },
-                            vkBU::eIndexBuffer | vkBU::eStorageBuffer | vkBU::eShaderDeviceAddress
-                                    | vkBU::eAccelerationStructureBuildInputReadOnlyKHR);
-
-        model.matColorBuffer = m_alloc.createBuffer(cmdBuf, std::vector<MaterialObj> { MaterialObj {} }, vkBU::eStorageBuffer);
-        model.matIndexBuffer = m_alloc.createBuffer(cmdBuf, std::vector<int> { int {} }, vkBU::eStorageBuffer);
+        model.nbIndices   = static_cast<uint32_t>(0);
+        model.nbVertices  = static_cast<uint32_t>(0);
+        model.nbMaterials = 1;
+        uploadModel(model, {VertexObj{}}, {uint32_t{}}, {MaterialObj{}}, {int32_t{}});
+        instance.objIndex = static_cast<uint32_t>(m_objModel.size());
+
+        ObjGeometry geometry;
+        geometry.objIndex = instance.objIndex;
         m_objModel.emplace_back(model);
+        m_objInstance.emplace_back(instance);
+        m_objInstanceBlas.push_back(static_cast<uint32_t>(m_objGeometry.size()));
+        m_objGeometry.emplace_back(geometry);
 
         // Texture
-        nvvk::Texture texture;
-        vk::SamplerCreateInfo samplerCreateInfo{
-                {}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear};
-        samplerCreateInfo.setMaxLod(FLT_MAX);
-        vk::Format format = vk::Format::eR8G8B8A8Srgb;
-
-        std::array<uint8_t, 4> color{255u, 255u, 255u, 255u};
-        vk::DeviceSize         bufferSize      = sizeof(color);
-        auto                   imgSize         = vk::Extent2D(1, 1);
-        auto                   imageCreateInfo = nvvk::makeImage2DCreateInfo(imgSize, format);
+        m_objInstance.back().txtOffset = createTextureImages(cmdBuf, {});
 
-        // Creating the dummy texture
-        nvvk::Image image = m_alloc.createImage(cmdBuf, bufferSize, color.data(), imageCreateInfo);
-        vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
-        texture                        = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-
-        // The image format must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-        nvvk::cmdBarrierImageLayout(cmdBuf, texture.image, vk::ImageLayout::eUndefined,
-                                    vk::ImageLayout::eShaderReadOnlyOptimal);
-        m_textures.push_back(texture);
-        
         cmdBufGet.submitAndWait(cmdBuf);
+        m_uploader.flush();
     }
 
     using vkBU = vk::BufferUsageFlagBits;
     nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
 
+    // The geometry must be on the device before the acceleration structures
+    // are built
+    m_uploader.waitAll();
+    m_uploader.printStats();
+    m_textureProcessor.printStats();
+
+    updateSceneAddresses();
+
     auto cmdBuf = cmdGen.createCommandBuffer();
     m_sceneDesc = m_alloc.createBuffer(cmdBuf, m_objInstance, vkBU::eStorageBuffer);
     cmdGen.submitAndWait(cmdBuf);
     m_alloc.finalizeAndReleaseStaging();
+
+    m_geometryArena.printStats();
 }
 
-void Application::Impl::createTextureImages(const vk::CommandBuffer& cmdBuf, const std::vector<std::string>& textures)
+// Fills the buffer addresses of every instance, pointing at the range of its
+// geometry: shaders index them with gl_PrimitiveID and the per-geometry
+// indices directly. Addresses are checked against the size of the buffers, a
+// bad address would only show up as a device lost.
+void Application::Impl::updateSceneAddresses()
 {
-    using vkIU = vk::ImageUsageFlagBits;
+    auto check = [](vk::DeviceAddress addr, vk::DeviceAddress base, vk::DeviceSize offset, vk::DeviceSize size,
+                    vk::DeviceSize bufferSize, const char* what) {
+        if (base == 0 || addr % 4 != 0 || offset + size > bufferSize) {
+            throw std::runtime_error(std::string("Invalid ") + what + " address in the scene description");
+        }
+    };
+
+    for (size_t i = 0; i < m_objInstance.size(); i++) {
+        ObjInstance&       instance = m_objInstance[i];
+        const ObjGeometry& geometry = m_objGeometry[m_objInstanceBlas[i]];
+        const ObjModel&    model    = m_objModel[geometry.objIndex];
+
+        vk::DeviceAddress vertices   = model.vertices.address;
+        vk::DeviceAddress indices    = model.indices.address;
+        vk::DeviceAddress materials  = model.materials.address;
+        vk::DeviceAddress matIndices = model.matIndices.address;
+
+        vk::DeviceSize vertexOffset   = geometry.vertexOffset * sizeof(VertexObj);
+        vk::DeviceSize indexOffset    = geometry.firstIndex * sizeof(uint32_t);
+        vk::DeviceSize matIndexOffset = geometry.firstIndex / 3 * sizeof(int32_t);
+
+        check(vertices + vertexOffset, vertices, vertexOffset, geometry.nbVertices * sizeof(VertexObj),
+              model.vertices.size, "vertex");
+        check(indices + indexOffset, indices, indexOffset, geometry.nbIndices * sizeof(uint32_t),
+              model.indices.size, "index");
+        check(materials, materials, 0, model.nbMaterials * sizeof(MaterialObj), model.materials.size, "material");
+        check(matIndices + matIndexOffset, matIndices, matIndexOffset, geometry.nbIndices / 3 * sizeof(int32_t),
+              model.matIndices.size, "material index");
+
+        instance.vertices   = vertices + vertexOffset;
+        instance.indices    = indices + indexOffset;
+        instance.materials  = materials;
+        instance.matIndices = matIndices + matIndexOffset;
+    }
+}
+
+void Application::Impl::createSamplerTablesBuffer()
+{
+    using vkBU = vk::BufferUsageFlagBits;
+
+    SamplerTables tables;
+
+    nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+
+    auto cmdBuf     = cmdGen.createCommandBuffer();
+    m_samplerTables = m_alloc.createBuffer(cmdBuf, tables.pack(), vkBU::eStorageBuffer);
+    cmdGen.submitAndWait(cmdBuf);
+    m_alloc.finalizeAndReleaseStaging();
+}
+
+// Returns the slot of the first texture, the textures use consecutive slots
+uint32_t Application::Impl::createTextureImages(const vk::CommandBuffer& cmdBuf, const std::vector<std::string>& textures)
+{
+    bool     dummy = textures.empty() && m_textures.empty();
+    uint32_t count = dummy ? 1U : static_cast<uint32_t>(textures.size());
+    if (count == 0) {
+        return 0;
+    }
+    uint32_t firstSlot = allocateSlots(m_txtSlotAlloc, count, "texture");
 
     vk::SamplerCreateInfo samplerCreateInfo{
         {}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear};
@@ -241,7 +338,7 @@ void Application::Impl::createTextureImages(const vk::CommandBuffer& cmdBuf, con
     vk::Format format = vk::Format::eR8G8B8A8Srgb;
 
     // If no textures are present, create a dummy one to accommodate the pipeline layout
-    if(textures.empty() && m_textures.empty())
+    if(dummy)
     {
         nvvk::Texture texture;
 
@@ -259,56 +356,144 @@ void Application::Impl::createTextureImages(const vk::CommandBuffer& cmdBuf, con
         nvvk::cmdBarrierImageLayout(cmdBuf, texture.image, vk::ImageLayout::eUndefined,
                                     vk::ImageLayout::eShaderReadOnlyOptimal);
         m_textures.push_back(texture);
+        m_textureSlots.push_back(firstSlot);
     }
     else
     {
-        // Uploading all images
-        for(const auto& texture : textures)
-        {
-        std::stringstream o;
-        int               texWidth, texHeight, texChannels;
-        o << "media/textures/" << texture;
-        std::string txtFile = nvh::findFile(o.str(), _default_search_paths, true);
-
-        stbi_uc* stbi_pixels =
-            stbi_load(txtFile.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-
-        std::array<stbi_uc, 4> color{255u, 0u, 255u, 255u};
-
-        stbi_uc* pixels = stbi_pixels;
-        // Handle failure
-        if(!stbi_pixels)
-        {
-            texWidth = texHeight = 1;
-            texChannels          = 4;
-            pixels               = reinterpret_cast<stbi_uc*>(color.data());
+        // Mips and compression on the CPU, the upload goes through the uploader
+        uint32_t slot = firstSlot;
+        for (const auto& texture : textures) {
+            std::stringstream o;
+            int               texWidth, texHeight, texChannels;
+            o << "media/textures/" << texture;
+            std::string txtFile = nvh::findFile(o.str(), _default_search_paths, true);
+
+            // Only the tail is resident in the slot, the other levels are streamed
+            ProcessedTexture tail;
+            if (m_vtSettings.enabled && loadVirtualTexture(slot, txtFile, tail)) {
+                m_textures.push_back(createProcessedTexture(tail, false, samplerCreateInfo));
+                m_textureSlots.push_back(slot++);
+                continue;
+            }
+
+            // Native channel count, expanded to RGBA by the processor
+            stbi_uc* stbi_pixels = stbi_load(txtFile.c_str(), &texWidth, &texHeight, &texChannels, 0);
+
+            std::array<stbi_uc, 4> color{255u, 0u, 255u, 255u};
+
+            const stbi_uc* pixels = stbi_pixels;
+            // Handle failure
+            if (!stbi_pixels) {
+                texWidth = texHeight = 1;
+                texChannels          = 4;
+                pixels               = color.data();
+            }
+
+            ProcessedTexture processed = m_textureProcessor.process(
+                {pixels}, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), static_cast<uint32_t>(texChannels));
+            stbi_image_free(stbi_pixels);
+
+            m_textures.push_back(createProcessedTexture(processed, false, samplerCreateInfo));
+            m_textureSlots.push_back(slot++);
         }
+    }
 
-        vk::DeviceSize bufferSize = static_cast<uint64_t>(texWidth) * texHeight * sizeof(uint8_t) * 4;
-        auto           imgSize    = vk::Extent2D(texWidth, texHeight);
-        auto imageCreateInfo = nvvk::makeImage2DCreateInfo(imgSize, format, vkIU::eSampled, true);
+    return firstSlot;
+}
 
-        {
-            nvvk::ImageDedicated image =
-                m_alloc.createImage(cmdBuf, bufferSize, pixels, imageCreateInfo);
-            nvvk::cmdGenerateMipmaps(cmdBuf, image.image, format, imgSize, imageCreateInfo.mipLevels);
-            vk::ImageViewCreateInfo ivInfo =
-                nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
-            nvvk::Texture texture = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
 
-            m_textures.push_back(texture);
-        }
+// Falls back to uncompressed textures when the device cannot sample the
+// requested block format
+void Application::Impl::initTextureProcessor(TextureSettings settings)
+{
+    vk::Format format = getTextureFormat(settings.compression, settings.srgb);
+    if (!(m_physicalDevice.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage)) {
+        LOGW("Texture format %s is not supported, textures are not compressed\n", vk::to_string(format).c_str());
+        settings.compression = TextureCompression::None;
+    }
+    m_textureProcessor = TextureProcessor(settings);
+}
+
+// Creates the image of all the levels and layers of `processed` (6 layers
+// for a cube), the copies go through `m_uploader`
+nvvk::Texture Application::Impl::createProcessedTexture(const ProcessedTexture&      processed,
+                                                        bool                         cube,
+                                                        const vk::SamplerCreateInfo& samplerCreateInfo)
+{
+    using vkIU = vk::ImageUsageFlagBits;
 
-        stbi_image_free(stbi_pixels);
+    vk::Format   format  = getTextureFormat(processed.compression, m_textureProcessor.getSettings().srgb);
+    vk::Extent2D imgSize = {processed.levels[0].width, processed.levels[0].height};
+    vk::ImageCreateInfo imageCreateInfo = cube ? nvvk::makeImageCubeCreateInfo(imgSize, format, vkIU::eSampled)
+                                               : nvvk::makeImage2DCreateInfo(imgSize, format, vkIU::eSampled);
+    imageCreateInfo.setMipLevels(static_cast<uint32_t>(processed.levels.size()));
+
+    nvvk::Image image = m_alloc.createImage(imageCreateInfo);
+
+    std::vector<Uploader::ImageRegion> regions;
+    for (uint32_t level = 0; level < processed.levels.size(); level++) {
+        for (uint32_t layer = 0; layer < processed.nbLayers; layer++) {
+            Uploader::ImageRegion region;
+            region.mipLevel = level;
+            region.layer    = layer;
+            region.extent   = vk::Extent2D{processed.levels[level].width, processed.levels[level].height};
+            region.data     = processed.getData(level, layer);
+            region.size     = processed.levels[level].layerSize;
+            regions.push_back(region);
         }
     }
+    vk::ImageSubresourceRange range{vk::ImageAspectFlagBits::eColor, 0, imageCreateInfo.mipLevels, 0, processed.nbLayers};
+    uint32_t blockSize = processed.compression == TextureCompression::None ? 1 : 4;
+    m_uploader.uploadImage(image.image, range, regions, blockSize);
+
+    vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo, cube);
+    return m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
 }
 
+// Sub-allocates the mesh data of a model in the geometry arena, the copies
+// go through `m_uploader` and complete asynchronously
+void Application::Impl::uploadModel(ObjModel&                       model,
+                                    const std::vector<VertexObj>&   vertices,
+                                    const std::vector<uint32_t>&    indices,
+                                    const std::vector<MaterialObj>& materials,
+                                    const std::vector<int32_t>&     matIndices)
+{
+    using Arena = GeometryArena;
+    model.vertices   = checkRange(m_geometryArena.allocateAndUpload(m_uploader, Arena::VERTICES, vertices), "vertex");
+    model.indices    = checkRange(m_geometryArena.allocateAndUpload(m_uploader, Arena::INDICES, indices), "index");
+    model.materials  = checkRange(m_geometryArena.allocateAndUpload(m_uploader, Arena::MATERIALS, materials), "material");
+    model.matIndices = checkRange(m_geometryArena.allocateAndUpload(m_uploader, Arena::MAT_INDICES, matIndices), "material index");
+}
 
-void Application::Impl::loadModel(const std::string& filename, nvmath::mat4f transform)
+// Gives the ranges of the model back to the arena, the GPU must be done with them
+void Application::Impl::destroyModel(ObjModel& model)
 {
-    using vkBU = vk::BufferUsageFlagBits;
+    m_geometryArena.free(model.vertices);
+    m_geometryArena.free(model.indices);
+    m_geometryArena.free(model.materials);
+    m_geometryArena.free(model.matIndices);
+}
+
+// Destroys all the textures and returns their slots. The slots are released
+// with the current frame: they are only reused once it has completed, which
+// the device being idle already guarantees here.
+void Application::Impl::destroyTextures()
+{
+    for (size_t i = 0; i < m_textures.size(); ++i) {
+        m_alloc.destroy(m_textures[i]);
+        m_txtSlotAlloc.release(m_textureSlots[i], 1, m_vtFrame);
+    }
+    m_textures.clear();
+    m_textureSlots.clear();
 
+    m_txtSlotAlloc.collect(m_vtFrame);
+    if (m_txtSlotAlloc.getAllocatedCount() != 0) {
+        LOGW("%u texture slots were not released\n", m_txtSlotAlloc.getAllocatedCount());
+    }
+}
+
+void Application::Impl::loadModel(const std::string& filename, nvmath::mat4f transform)
+{
     LOGI("Loading File:  %s \n", filename.c_str());
     ObjLoader loader;
     loader.loadModel(filename);
@@ -321,114 +506,204 @@ void Application::Impl::loadModel(const std::string& filename, nvmath::mat4f tra
         m.specular = nvmath::pow(m.specular, 2.2f);
     }
 
+    ObjModel model;
+    model.nbIndices  = static_cast<uint32_t>(loader.m_indices.size());
+    model.nbVertices  = static_cast<uint32_t>(loader.m_vertices.size());
+    model.nbMaterials = static_cast<uint32_t>(loader.m_materials.size());
+
     ObjInstance instance;
     instance.objIndex    = static_cast<uint32_t>(m_objModel.size());
     instance.transform   = transform;
     instance.transformIT = nvmath::transpose(nvmath::invert(transform));
-    instance.txtOffset   = static_cast<uint32_t>(m_textures.size());
-
-    ObjModel model;
-    model.nbIndices  = static_cast<uint32_t>(loader.m_indices.size());
-    model.nbVertices = static_cast<uint32_t>(loader.m_vertices.size());
 
     // Create the buffers on Device and copy vertices, indices and materials
     nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
     vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
-    model.vertexBuffer =
-        m_alloc.createBuffer(cmdBuf, loader.m_vertices,
-                            vkBU::eVertexBuffer | vkBU::eStorageBuffer | vkBU::eShaderDeviceAddress
-                                | vkBU::eAccelerationStructureBuildInputReadOnlyKHR);
-    model.indexBuffer =
-        m_alloc.createBuffer(cmdBuf, loader.m_indices,
-                            vkBU::eIndexBuffer | vkBU::eStorageBuffer | vkBU::eShaderDeviceAddress
-                                | vkBU::eAccelerationStructureBuildInputReadOnlyKHR);
-    model.matColorBuffer = m_alloc.createBuffer(cmdBuf, loader.m_materials, vkBU::eStorageBuffer);
-    model.matIndexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_matIndx, vkBU::eStorageBuffer);
+    uploadModel(model, loader.m_vertices, loader.m_indices, loader.m_materials, loader.m_matIndx);
 
     for (auto& texture : loader.m_textures) {
         std::cout << texture << std::endl;
     }
     
     // Creates all textures found
-    createTextureImages(cmdBuf, loader.m_textures);
+    uint32_t firstTexture = static_cast<uint32_t>(m_textures.size());
+    instance.txtOffset    = createTextureImages(cmdBuf, loader.m_textures);
     cmdBufGet.submitAndWait(cmdBuf);
     m_alloc.finalizeAndReleaseStaging();
+    m_uploader.flush();
 
     std::string objNb = std::to_string(instance.objIndex);
 
+    // Loaded after the descriptor set creation: the new slots can be written
+    // right away, the set is update-after-bind, once the images are uploaded
+    if (m_descSet) {
+        m_uploader.waitAll();
+        writeTextureDescriptors(firstTexture, static_cast<uint32_t>(m_textures.size()) - firstTexture);
+    }
+
+    ObjGeometry geometry;
+    geometry.objIndex   = instance.objIndex;
+    geometry.nbIndices  = model.nbIndices;
+    geometry.nbVertices = model.nbVertices;
+
     m_objModel.emplace_back(model);
     m_objInstance.emplace_back(instance);
+    m_objInstanceBlas.push_back(static_cast<uint32_t>(m_objGeometry.size()));
+    m_objGeometry.emplace_back(geometry);
 }
 
-
-void Application::Impl::createSkyboxTexture()
+void Application::Impl::loadCsfScene(const std::string& filename)
 {
-    using vkIU = vk::ImageUsageFlagBits;
+    LOGI("Loading File:  %s \n", filename.c_str());
+    CsfScene scene;
+    if (!scene.load(filename)) {
+        throw std::runtime_error("Could not load " + filename);
+    }
+    scene.printStats();
 
-    vk::SamplerCreateInfo samplerCreateInfo{
-        {}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear};
-    samplerCreateInfo.setMaxLod(FLT_MAX);
+    // All the geometries share the buffers of one model
+    uint32_t objIndex     = static_cast<uint32_t>(m_objModel.size());
+    uint32_t geometryBase = static_cast<uint32_t>(m_objGeometry.size());
+
+    ObjModel model;
+    model.nbIndices   = static_cast<uint32_t>(scene.getIndices().size());
+    model.nbVertices  = static_cast<uint32_t>(scene.getVertices().size());
+    model.nbMaterials = static_cast<uint32_t>(scene.getMaterials().size());
 
     nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
     vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
+    uploadModel(model, scene.getVertices(), scene.getIndices(), scene.getMaterials(), scene.getMatIndices());
 
-    // Loading 6 textures
-    auto cubemap_txt_faces = { "right.png", "left.png", "top.png", "bottom.png", "front.png", "back.png" };
-
-    std::vector<stbi_uc*> cubemap_face_data;
-    vk::Format cubemap_format;
-    int face_width;
-    int face_height;
-    int face_channel;
-
-    // Load face pixels
-    for (auto& txt_face : cubemap_txt_faces) {
-    std::ostringstream txt_face_path_builder;
-    txt_face_path_builder << "media/textures/skybox/" << txt_face;
+    // No textures in CSF, only makes sure the dummy one exists
+    uint32_t firstTexture = static_cast<uint32_t>(m_textures.size());
+    uint32_t txtOffset    = createTextureImages(cmdBuf, {});
+    cmdBufGet.submitAndWait(cmdBuf);
+    m_alloc.finalizeAndReleaseStaging();
+    m_uploader.flush();
 
-    auto txt_face_path = nvh::findFile(txt_face_path_builder.str(), _default_search_paths, true);
+    if (m_descSet) {
+        m_uploader.waitAll();
+        writeTextureDescriptors(firstTexture, static_cast<uint32_t>(m_textures.size()) - firstTexture);
+    }
 
-    stbi_uc* stbi_pixels = stbi_load(txt_face_path.c_str(), &face_width, &face_height, &face_channel, STBI_rgb_alpha);
+    m_objModel.emplace_back(model);
 
-    if (stbi_pixels == nullptr) {
-        std::runtime_error("Could not load skybox texture \"" + txt_face_path + "\"");
+    for (const auto& range : scene.getGeometries()) {
+        ObjGeometry geometry;
+        geometry.objIndex     = objIndex;
+        geometry.firstIndex   = range.firstIndex;
+        geometry.nbIndices    = range.nbIndices;
+        geometry.vertexOffset = range.vertexOffset;
+        geometry.nbVertices   = range.nbVertices;
+        m_objGeometry.emplace_back(geometry);
     }
 
-    if (face_channel == 3) {
-        cubemap_format = vk::Format::eR8G8B8Srgb;
-    } else if (face_channel == 4) {
-        cubemap_format = vk::Format::eR8G8B8A8Srgb;
+    m_objInstance.reserve(m_objInstance.size() + scene.getInstances().size());
+    m_objInstanceBlas.reserve(m_objInstanceBlas.size() + scene.getInstances().size());
+    for (const auto& csfInstance : scene.getInstances()) {
+        ObjInstance instance;
+        instance.objIndex    = objIndex;
+        instance.txtOffset   = txtOffset;
+        instance.transform   = csfInstance.transform;
+        instance.transformIT = csfInstance.transformIT;
+        m_objInstance.emplace_back(instance);
+        m_objInstanceBlas.push_back(geometryBase + csfInstance.geometry);
     }
+}
 
-    cubemap_face_data.push_back(stbi_pixels);
-    }
 
-    // Arrange in linear memory
-    int face_size = static_cast<uint64_t>(face_width * face_height) * sizeof(uint8_t) * face_channel;
-    int total_size = face_size * 6;
-    auto face_linear_data = std::make_unique<unsigned char[]>(total_size);
+// Sky of the scene: an equirectangular map, the skybox cube resampled to one,
+// or the procedural gradient. Its radiance is sampled by the miss shaders,
+// its importance sampling distribution by the diffuse surfaces.
+void Application::Impl::createEnvironment()
+{
+    using vkBU = vk::BufferUsageFlagBits;
+    using vkIU = vk::ImageUsageFlagBits;
 
-    for (int i = 0; i < 6; ++i) {
-    memcpy(face_linear_data.get() + face_size * i, cubemap_face_data[i], face_size);
-    stbi_image_free(cubemap_face_data[i]);
-    }
+    const EnvironmentSettings& settings = m_envSettings;
+    Environment                env;
 
-    vk::DeviceSize buffer_size = static_cast<uint64_t>(total_size);
-    auto img_size = vk::Extent2D { static_cast<uint32_t>(face_width), static_cast<uint32_t>(face_height) };
-    auto img_create_info = nvvk::makeImageCubeCreateInfo(img_size, cubemap_format, vkIU::eSampled, true);
+    if (!settings.filename.empty()) {
+        // Radiance files as is, other formats are linearized by stb_image
+        auto   path = nvh::findFile(settings.filename, _default_search_paths, true);
+        int    width, height, channels;
+        float* pixels = stbi_loadf(path.c_str(), &width, &height, &channels, 0);
+        if (pixels == nullptr) {
+            throw std::runtime_error("Could not load environment map \"" + settings.filename + "\"");
+        }
+        env.buildFromEquirect(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                              static_cast<uint32_t>(channels), settings.intensity, settings.numThreads);
+        stbi_image_free(pixels);
+    } else if (settings.cube) {
+        // Loading 6 textures, in the layer order of a Vulkan cube
+        auto cubemap_txt_faces = {"right.png", "left.png", "top.png", "bottom.png", "front.png", "back.png"};
+
+        std::vector<float*>         cubemap_face_data;
+        std::array<const float*, 6> cubemap_faces;
+        int face_width   = 0;
+        int face_height  = 0;
+        int face_channel = 0;
+
+        for (auto& txt_face : cubemap_txt_faces) {
+            std::ostringstream txt_face_path_builder;
+            txt_face_path_builder << "media/textures/skybox/" << txt_face;
+
+            auto txt_face_path = nvh::findFile(txt_face_path_builder.str(), _default_search_paths, true);
+
+            int    width, height, channel;
+            float* pixels = stbi_loadf(txt_face_path.c_str(), &width, &height, &channel, 0);
+
+            bool consistent = cubemap_face_data.empty()
+                              || (width == face_width && height == face_height && channel == face_channel);
+            if (pixels == nullptr || width != height || !consistent) {
+                stbi_image_free(pixels);
+                for (auto data : cubemap_face_data) {
+                    stbi_image_free(data);
+                }
+                throw std::runtime_error("Could not load skybox texture \"" + txt_face_path + "\"");
+            }
+
+            face_width   = width;
+            face_height  = height;
+            face_channel = channel;
+            cubemap_faces[cubemap_face_data.size()] = pixels;
+            cubemap_face_data.push_back(pixels);
+        }
 
-    {
-    nvvk::ImageDedicated img = m_alloc.createImage(cmdBuf, buffer_size, face_linear_data.get(), img_create_info, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 6);
+        env.buildFromCube(cubemap_faces, static_cast<uint32_t>(face_width), static_cast<uint32_t>(face_channel),
+                          settings.intensity, settings.width, settings.numThreads);
+        for (auto data : cubemap_face_data) {
+            stbi_image_free(data);
+        }
+    } else {
+        env.buildSky(settings.width, settings.intensity, settings.sun, settings.numThreads);
+    }
+    LOGI("Environment: %ux%u, distribution built in %.2f ms\n", env.getWidth(), env.getHeight(), env.getBuildMs());
 
-    auto iv_info = nvvk::makeImageViewCreateInfo(img.image, img_create_info, true);
+    // Wraps around the azimuth, clamped at the poles
+    vk::SamplerCreateInfo samplerCreateInfo{{}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest};
+    samplerCreateInfo.setAddressModeU(vk::SamplerAddressMode::eRepeat);
+    samplerCreateInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
 
-    nvvk::cmdGenerateMipmaps(cmdBuf, img.image, cubemap_format, img_size, img_create_info.mipLevels);
+    vk::Extent2D        imgSize{env.getWidth(), env.getHeight()};
+    vk::ImageCreateInfo imageCreateInfo = nvvk::makeImage2DCreateInfo(imgSize, vk::Format::eR32G32B32A32Sfloat, vkIU::eSampled);
+    nvvk::Image         image           = m_alloc.createImage(imageCreateInfo);
 
-    nvvk::Texture texture = m_alloc.createTexture(img, iv_info, samplerCreateInfo);
+    Uploader::ImageRegion region;
+    region.extent = imgSize;
+    region.data   = env.getTexels().data();
+    region.size   = env.getTexels().size() * sizeof(float);
+    vk::ImageSubresourceRange range{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+    m_uploader.uploadImage(image.image, range, {region}, 1);
+    m_uploader.flush();
 
-    m_skybox_txt = std::make_unique<nvvk::Texture>(texture);
-    }
+    vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
+    m_envTexture                   = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
 
-    cmdBufGet.submitAndWait(cmdBuf);
-    // m_alloc.finalizeAndReleaseStaging();
+    nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+
+    auto cmdBuf       = cmdGen.createCommandBuffer();
+    m_envDistribution = m_alloc.createBuffer(cmdBuf, env.pack(), vkBU::eStorageBuffer);
+    cmdGen.submitAndWait(cmdBuf);
+    m_alloc.finalizeAndReleaseStaging();
 }
@@ -0,0 +1,163 @@
+#include "application_impl.hpp"
+#include "nvvk/shaders_vk.hpp"
+#include "nvh/fileoperations.hpp"
+#include "imgui.h"
+
+#define EXPOSURE_GROUP_SIZE 16  // Same group size as in tone_mapping.glsl
+
+
+// -----------------------
+// Impl Exposure Methods
+// -----------------------
+
+void Application::Impl::createExposureResources()
+{
+    using vkBU = vk::BufferUsageFlagBits;
+
+    // State of the adaptation, then the histogram
+    vk::DeviceSize size = sizeof(ExposureState) + EXPOSURE_HISTOGRAM_BINS * sizeof(uint32_t);
+    m_exposureBuffer    = m_alloc.createBuffer(size, vkBU::eStorageBuffer | vkBU::eTransferDst,
+                                               vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    // Empty histogram, not valid state: the first frame sets the exposure
+    nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+    vk::CommandBuffer cmdBuf = cmdGen.createCommandBuffer();
+    cmdBuf.fillBuffer(m_exposureBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+    cmdGen.submitAndWait(cmdBuf);
+
+    m_exposureReset = true;
+}
+
+void Application::Impl::createExposureDescriptor()
+{
+    using vkDS = vk::DescriptorSetLayoutBinding;
+    using vkDT = vk::DescriptorType;
+    using vkSS = vk::ShaderStageFlagBits;
+
+    // [in] Displayed image
+    m_exposureDescSetLayoutBind.addBinding(vkDS(0, vkDT::eCombinedImageSampler, 1, vkSS::eCompute));
+    // [in/out] Exposure state and histogram
+    m_exposureDescSetLayoutBind.addBinding(vkDS(1, vkDT::eStorageBuffer, 1, vkSS::eCompute));
+
+    m_exposureDescSetLayout = m_exposureDescSetLayoutBind.createLayout(m_device);
+    m_exposureDescPool      = m_exposureDescSetLayoutBind.createPool(m_device, 1);
+    m_exposureDescSet       = nvvk::allocateDescriptorSet(m_device, m_exposureDescPool, m_exposureDescSetLayout);
+}
+
+// Called by updatePostDescriptorSet(), the histogram is the one of the displayed image
+void Application::Impl::updateExposureDescriptorSet(const VkDescriptorImageInfo& source)
+{
+    vk::DescriptorBufferInfo exposureInfo{m_exposureBuffer.buffer, 0, VK_WHOLE_SIZE};
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.emplace_back(m_exposureDescSetLayoutBind.makeWrite(m_exposureDescSet, 0, &source));
+    writes.emplace_back(m_exposureDescSetLayoutBind.makeWrite(m_exposureDescSet, 1, &exposureInfo));
+    m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void Application::Impl::createExposurePipelines()
+{
+    vk::PushConstantRange        pushConstants{vk::ShaderStageFlagBits::eCompute, 0, sizeof(ExposurePushConstant)};
+    vk::PipelineLayoutCreateInfo layoutInfo{{}, 1, &m_exposureDescSetLayout, 1, &pushConstants};
+    m_exposurePipelineLayout = m_device.createPipelineLayout(layoutInfo);
+
+    auto createComputePipeline = [&](const std::string& filename) {
+        vk::ComputePipelineCreateInfo computePipelineCreateInfo{{}, {}, m_exposurePipelineLayout};
+        computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+            m_device, nvh::loadFile(filename, true, _default_search_paths, true), VK_SHADER_STAGE_COMPUTE_BIT);
+
+        vk::Pipeline pipeline = static_cast<const vk::Pipeline&>(
+            m_device.createComputePipeline({}, computePipelineCreateInfo));
+        m_device.destroy(computePipelineCreateInfo.stage.module);
+        return pipeline;
+    };
+
+    m_exposureHistogramPipeline = createComputePipeline("spv/exposure_histogram.comp.spv");
+    m_exposureAdaptPipeline     = createComputePipeline("spv/exposure_adapt.comp.spv");
+}
+
+void Application::Impl::destroyExposure()
+{
+    m_device.destroy(m_exposureHistogramPipeline);
+    m_device.destroy(m_exposureAdaptPipeline);
+    m_device.destroy(m_exposurePipelineLayout);
+    m_device.destroy(m_exposureDescPool);
+    m_device.destroy(m_exposureDescSetLayout);
+    m_alloc.destroy(m_exposureBuffer);
+}
+
+void Application::Impl::renderExposureUI()
+{
+    if (!ImGui::CollapsingHeader("Exposure")) {
+        return;
+    }
+
+    auto& settings = m_exposureSettings;
+
+    int toneMapper = static_cast<int>(m_toneMapper);
+    if (ImGui::Combo("Tone mapper", &toneMapper, "Clamp\0Reinhard\0ACES\0Filmic\0")) {
+        m_toneMapper = static_cast<ToneMapper>(toneMapper);
+    }
+    if (ImGui::Checkbox("Auto exposure", &settings.autoExposure)) {
+        m_exposureReset = true;
+    }
+    ImGui::SliderFloat("Compensation (EV)", &settings.compensation, -8.f, 8.f);
+
+    if (settings.autoExposure) {
+        ImGui::SliderFloat("Key value", &settings.keyValue, 0.01f, 1.f);
+        ImGui::DragFloatRange2("Metered percentiles", &settings.lowPercentile, &settings.highPercentile, 0.005f, 0.f, 1.f);
+        ImGui::DragFloatRange2("Histogram range (log2)", &settings.minLog2, &settings.maxLog2, 0.1f, -20.f, 20.f);
+        ImGui::SliderFloat("Adaptation to brighter", &settings.speedUp, 0.1f, 10.f);
+        ImGui::SliderFloat("Adaptation to darker", &settings.speedDown, 0.1f, 10.f);
+    }
+}
+
+// Histogram of the image displayed by the post pass then adaptation of the
+// exposure it applies, the CPU reference is in render/tone_mapping.cpp
+void Application::Impl::computeExposure(const vk::CommandBuffer& cmdBuf)
+{
+    auto   now          = std::chrono::high_resolution_clock::now();
+    double deltaSeconds = std::chrono::duration<double>(now - m_exposureTime).count();
+    m_exposureTime      = now;
+
+    const auto& settings = m_exposureSettings;
+    auto&       pc       = m_exposurePushConstants;
+    pc.minLog2           = settings.minLog2;
+    pc.maxLog2           = std::max(settings.maxLog2, settings.minLog2 + 1.f);
+    pc.lowPercentile     = settings.lowPercentile;
+    pc.highPercentile    = settings.highPercentile;
+    pc.keyValue          = settings.keyValue;
+    pc.compensation      = settings.compensation;
+    pc.speedUp           = settings.speedUp;
+    pc.speedDown         = settings.speedDown;
+    pc.deltaSeconds      = static_cast<float>(deltaSeconds);
+    pc.autoExposure      = settings.autoExposure ? 1 : 0;
+    pc.reset             = m_exposureReset ? 1 : 0;
+    m_exposureReset      = false;
+
+    // The image is written by the ray tracing or the denoiser, the previous
+    // post pass must be done reading the exposure before it is adapted again
+    vk::MemoryBarrier memBarrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead};
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader
+                               | vk::PipelineStageFlagBits::eFragmentShader,
+                           vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eDeviceGroup,
+                           {memBarrier}, {}, {});
+
+    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_exposurePipelineLayout, 0, {m_exposureDescSet}, {});
+    cmdBuf.pushConstants<ExposurePushConstant>(m_exposurePipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+
+    uint32_t groupsX = (m_size.width + (EXPOSURE_GROUP_SIZE - 1)) / EXPOSURE_GROUP_SIZE;
+    uint32_t groupsY = (m_size.height + (EXPOSURE_GROUP_SIZE - 1)) / EXPOSURE_GROUP_SIZE;
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_exposureHistogramPipeline);
+    cmdBuf.dispatch(groupsX, groupsY, 1);
+
+    // One workgroup reads the whole histogram
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                           vk::DependencyFlagBits::eDeviceGroup, {memBarrier}, {}, {});
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_exposureAdaptPipeline);
+    cmdBuf.dispatch(1, 1, 1);
+
+    // The post shader reads the exposure
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader,
+                           vk::DependencyFlagBits::eDeviceGroup, {memBarrier}, {}, {});
+}
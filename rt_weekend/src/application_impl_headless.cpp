@@ -0,0 +1,305 @@
+#include "application_impl.hpp"
+#include "render/image_writer.hpp"
+#include "nvvk/shaders_vk.hpp"
+#include "nvh/fileoperations.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#define ACCUMULATION_BENCH_GROUP_SIZE 16  // Same group size as in accumulation_bench.comp
+
+
+// -----------------------
+// Impl Headless Methods
+// -----------------------
+
+void Application::Impl::createHeadlessFrames()
+{
+    vk::CommandBufferAllocateInfo allocateInfo;
+    allocateInfo.setCommandPool(m_cmdPool);
+    allocateInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+    allocateInfo.setCommandBufferCount(HEADLESS_FRAMES_IN_FLIGHT);
+    m_headlessCmdBuffers = m_device.allocateCommandBuffers(allocateInfo);
+
+    // Signaled, the first use of each command buffer doesn't wait
+    m_headlessFences.resize(HEADLESS_FRAMES_IN_FLIGHT);
+    for (auto& fence : m_headlessFences) {
+        fence = m_device.createFence({vk::FenceCreateFlagBits::eSignaled});
+    }
+    m_headlessFrame = 0;
+}
+
+void Application::Impl::destroyHeadless()
+{
+    for (auto& fence : m_headlessFences) {
+        m_device.destroy(fence);
+    }
+    m_headlessFences.clear();
+    if (!m_headlessCmdBuffers.empty()) {
+        m_device.freeCommandBuffers(m_cmdPool, m_headlessCmdBuffers);
+        m_headlessCmdBuffers.clear();
+    }
+}
+
+// Same role as prepareFrame() with a swapchain: waits until the command
+// buffer of the frame in flight is no longer executed
+const vk::CommandBuffer& Application::Impl::beginHeadlessFrame()
+{
+    vk::Fence fence = m_headlessFences[m_headlessFrame];
+    while (m_device.waitForFences(fence, VK_TRUE, UINT64_MAX) == vk::Result::eTimeout) {
+    }
+    m_device.resetFences(fence);
+
+    const vk::CommandBuffer& cmdBuf = m_headlessCmdBuffers[m_headlessFrame];
+    cmdBuf.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    return cmdBuf;
+}
+
+// Nothing to present, no semaphore: the next frames are ordered by the queue
+void Application::Impl::submitHeadlessFrame()
+{
+    const vk::CommandBuffer& cmdBuf = m_headlessCmdBuffers[m_headlessFrame];
+    cmdBuf.end();
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBufferCount(1);
+    submitInfo.setPCommandBuffers(&cmdBuf);
+    m_queue.submit(submitInfo, m_headlessFences[m_headlessFrame]);
+
+    m_headlessFrame = (m_headlessFrame + 1) % HEADLESS_FRAMES_IN_FLIGHT;
+}
+
+// Frame loop of Application::run() without window, UI nor tone mapper:
+// accumulates the requested frames then writes the image
+void Application::Impl::renderHeadless()
+{
+    if (m_headlessSettings.traceBenchmark) {
+        benchmarkTraceModes();
+        return;
+    }
+    if (m_headlessSettings.accumulationBenchmark) {
+        benchmarkAccumulationModes();
+        return;
+    }
+
+    nvmath::vec4f clearColor = nvmath::vec4f(1, 1, 1, 1.00f);
+
+    // Tiles spread a frame over several submits, each frame traces the whole image
+    m_tiledRendering         = false;
+    m_max_accumulated_frames = static_cast<int>(m_headlessSettings.frames);
+
+    LOGI("Headless: %ux%u, %u frames\n", m_size.width, m_size.height, m_headlessSettings.frames);
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // A resumed checkpoint already accumulated its frames
+    uint32_t first = static_cast<uint32_t>(std::max(m_rtcurrentFrameId + 1, 0));
+    for (uint32_t frame = first; frame < m_headlessSettings.frames; ++frame) {
+        const vk::CommandBuffer& cmdBuf = beginHeadlessFrame();
+
+        // Updating camera buffer
+        updateUniformBuffer(cmdBuf);
+        // Streaming the pages requested by the last frames
+        updateVirtualTextures(cmdBuf);
+
+        // Rendering Scene
+        rayTrace(cmdBuf, clearColor);
+        // Filtering the noisy accumulation
+        denoise(cmdBuf);
+
+        submitHeadlessFrame();
+
+        // Periodic save of the accumulation
+        updateCheckpoint();
+    }
+    m_queue.waitIdle();
+    saveCheckpoint();
+
+    auto   end     = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    LOGI("Headless: rendered in %.2f s (%.2f ms/frame)\n", seconds,
+         1000.0 * seconds / std::max(m_headlessSettings.frames, 1u));
+
+    saveImage(m_headlessSettings.output);
+    if (!m_headlessSettings.denoiseDump.empty()) {
+        dumpDenoise(m_headlessSettings.denoiseDump);
+    }
+}
+
+// The same scene traced by the megakernel then by the wavefront mode, each
+// accumulating the headless frames from scratch. Only the GPU time of the
+// trace passes is measured, after a first frame that warms up the caches.
+void Application::Impl::benchmarkTraceModes()
+{
+    nvmath::vec4f clearColor = nvmath::vec4f(1, 1, 1, 1.00f);
+
+    m_tiledRendering         = false;
+    m_max_accumulated_frames = static_cast<int>(m_headlessSettings.frames) + 1;
+
+    LOGI("Trace benchmark: %ux%u, %u frames per mode, %u spheres\n", m_size.width, m_size.height,
+         m_headlessSettings.frames, m_sphereSettings.count);
+
+    const char* names[] = {"Megakernel", "Wavefront"};
+    double      msamples[2];
+    for (int mode = 0; mode < 2; ++mode) {
+        m_wavefrontEnabled = mode == static_cast<int>(TraceTiming::Wavefront);
+        resetFrameId();
+
+        for (uint32_t frame = 0; frame <= m_headlessSettings.frames; ++frame) {
+            const vk::CommandBuffer& cmdBuf = beginHeadlessFrame();
+            updateUniformBuffer(cmdBuf);
+            updateVirtualTextures(cmdBuf);
+            rayTrace(cmdBuf, clearColor);
+            submitHeadlessFrame();
+
+            // Timestamps of the frames in flight are all available once idle
+            if (frame == 0 || frame == m_headlessSettings.frames) {
+                m_queue.waitIdle();
+                for (uint32_t i = 0; i < getFramesInFlight(); ++i) {
+                    readTraceTimings(i);
+                }
+            }
+            if (frame == 0) {
+                m_traceTimings[mode] = TraceTimingResult();
+            }
+        }
+
+        const auto& timing = m_traceTimings[mode];
+        msamples[mode]     = timing.totalMs > 0.0 ? timing.totalSamples / (timing.totalMs * 1e3) : 0.0;
+        LOGI("Trace benchmark: %s, %u frames, %.2f ms/frame, %.1f Msamples/s\n", names[mode], timing.frames,
+             timing.totalMs / std::max(timing.frames, 1u), msamples[mode]);
+    }
+
+    if (msamples[0] > 0.0) {
+        LOGI("Trace benchmark: wavefront at %.2fx the throughput of the megakernel\n", msamples[1] / msamples[0]);
+    }
+}
+
+// The accumulation pass of each mode alone, accumulation_bench.comp, over the
+// headless frames: the GPU time between two timestamps around all the frames
+// but the first, which warms up the caches. Reported next to the error of the
+// formats after as many frames on the CPU reference.
+void Application::Impl::benchmarkAccumulationModes()
+{
+    struct BenchPushConstant {
+        nvmath::vec2i imageSize;
+        int           frame;
+        int           accumulation;
+    };
+
+    vk::PushConstantRange        pushConstants{vk::ShaderStageFlagBits::eCompute, 0, sizeof(BenchPushConstant)};
+    vk::PipelineLayoutCreateInfo layoutInfo{{}, 1, &m_rtDescSetLayout, 1, &pushConstants};
+    vk::PipelineLayout           pipelineLayout = m_device.createPipelineLayout(layoutInfo);
+
+    vk::ComputePipelineCreateInfo computePipelineCreateInfo{{}, {}, pipelineLayout};
+    computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+        m_device, nvh::loadFile("spv/accumulation_bench.comp.spv", true, _default_search_paths, true),
+        VK_SHADER_STAGE_COMPUTE_BIT);
+    vk::Pipeline pipeline =
+        static_cast<const vk::Pipeline&>(m_device.createComputePipeline({}, computePipelineCreateInfo));
+    m_device.destroy(computePipelineCreateInfo.stage.module);
+
+    vk::QueryPoolCreateInfo queryPoolInfo;
+    queryPoolInfo.setQueryType(vk::QueryType::eTimestamp);
+    queryPoolInfo.setQueryCount(2);
+    vk::QueryPool queryPool = m_device.createQueryPool(queryPoolInfo);
+
+    uint32_t frames   = m_headlessSettings.frames;
+    double   nbPixels = static_cast<double>(m_size.width) * m_size.height;
+    LOGI("Accumulation benchmark: %ux%u, %u frames per mode\n", m_size.width, m_size.height, frames);
+
+    // Each frame reads what the previous one wrote
+    vk::MemoryBarrier barrier{vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                              vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite};
+
+    const char* names[]       = {"Average", "Compensated"};
+    double      msPerFrame[2] = {0.0, 0.0};
+    for (int mode = 0; mode < 2; ++mode) {
+        nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+        vk::CommandBuffer cmdBuf = genCmdBuf.createCommandBuffer();
+        cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, {m_rtDescSet}, {});
+        cmdBuf.resetQueryPool(queryPool, 0, 2);
+
+        BenchPushConstant pc;
+        pc.imageSize    = nvmath::vec2i(m_size.width, m_size.height);
+        pc.accumulation = mode;
+        for (uint32_t frame = 0; frame <= frames; ++frame) {
+            if (frame == 1) {
+                cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, queryPool, 0);
+            }
+            pc.frame = static_cast<int>(frame);
+            cmdBuf.pushConstants<BenchPushConstant>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+            cmdBuf.dispatch((m_size.width + (ACCUMULATION_BENCH_GROUP_SIZE - 1)) / ACCUMULATION_BENCH_GROUP_SIZE,
+                            (m_size.height + (ACCUMULATION_BENCH_GROUP_SIZE - 1)) / ACCUMULATION_BENCH_GROUP_SIZE, 1);
+            cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                   vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eDeviceGroup,
+                                   {barrier}, {}, {});
+        }
+        cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, queryPool, 1);
+        genCmdBuf.submitAndWait(cmdBuf);
+
+        std::array<uint64_t, 2> timestamps{};
+        vk::Result result = m_device.getQueryPoolResults(queryPool, 0, 2, sizeof(timestamps), timestamps.data(),
+                                                         sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result == vk::Result::eSuccess) {
+            msPerFrame[mode] = static_cast<double>(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1e-6 / frames;
+        }
+
+        double bytes       = getAccumulationBytes() * nbPixels;
+        double gbPerSecond = msPerFrame[mode] > 0.0 ? bytes / (msPerFrame[mode] * 1e6) : 0.0;
+        LOGI("Accumulation benchmark: %s, %.3f ms/frame, %u bytes/pixel/frame, %.1f GB/s\n", names[mode],
+             msPerFrame[mode], getAccumulationBytes(), gbPerSecond);
+    }
+
+    m_device.destroy(queryPool);
+    m_device.destroy(pipeline);
+    m_device.destroy(pipelineLayout);
+
+    // Error after as many frames, the device modes are the first two formats
+    auto points = benchmarkAccumulation(frames, 4096, m_textureSettings.numThreads);
+    LOGI("frames\tbytes\tms/frame\trmse\tmax\tformat\n");
+    for (const auto& point : points) {
+        for (size_t format = 0; format < point.formats.size(); ++format) {
+            const auto& result = point.formats[format];
+            std::string ms     = format < 2 ? std::to_string(msPerFrame[format]) : "-";
+            LOGI("%u\t%u\t%s\t%g\t%g\t%s\n", point.frames, result.bytes, ms.c_str(), result.rmseError,
+                 result.maxError, result.name.c_str());
+        }
+    }
+}
+
+// Reads back the image the post pass displays, see updatePostDescriptorSet().
+// Without denoiser, the accumulation is read from its state at full precision
+// instead of the RGBA16F display image.
+void Application::Impl::saveImage(const std::string& filename)
+{
+    vk::ImageSubresourceLayers subresource{vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+    size_t                     nbTexels = static_cast<size_t>(m_size.width) * m_size.height;
+
+    std::vector<float> rgba;
+    if (m_denoiseEnabled) {
+        std::vector<uint16_t> texels(4 * nbTexels);
+        m_uploader.readImage(m_denoiseOutput.image, vk::ImageLayout::eGeneral, subresource, {0, 0}, m_size,
+                             texels.data(), texels.size() * sizeof(uint16_t));
+        rgba = halfToFloat(texels);
+    } else {
+        std::vector<uint32_t> texels(4 * nbTexels);
+        m_uploader.readImage(m_accumState.image, vk::ImageLayout::eGeneral, subresource, {0, 0}, m_size,
+                             texels.data(), texels.size() * sizeof(uint32_t));
+        rgba.resize(4 * nbTexels);
+        for (size_t i = 0; i < nbTexels; ++i) {
+            AccumulationPixel pixel = decodeAccumulation(&texels[4 * i]);
+            memcpy(&rgba[4 * i], &pixel.mean.x, 3 * sizeof(float));
+            rgba[4 * i + 3] = pixel.count;
+        }
+    }
+
+    // Converged exposure and operator of the post pass, the 8-bit formats are
+    // then only gamma corrected
+    if (!isLinearImageFormat(filename)) {
+        toneMapImage(rgba, m_size.width, m_size.height, m_toneMapper, m_exposureSettings);
+    }
+    writeImage(filename, m_size.width, m_size.height, rgba);
+    LOGI("Headless: wrote %s\n", filename.c_str());
+}
@@ -11,13 +11,17 @@ void Application::Impl::createOffscreenRender()
 {
     m_alloc.destroy(m_offscreenColor);
     m_alloc.destroy(m_offscreenDepth);
+    m_alloc.destroy(m_accumState);
+    m_offscreenSize = m_size;
 
     // Creating the color image
     {
         auto colorCreateInfo = nvvk::makeImage2DCreateInfo(m_size, m_offscreenColorFormat,
                                                         vk::ImageUsageFlagBits::eColorAttachment
                                                             | vk::ImageUsageFlagBits::eSampled
-                                                            | vk::ImageUsageFlagBits::eStorage);
+                                                            | vk::ImageUsageFlagBits::eStorage
+                                                            | vk::ImageUsageFlagBits::eTransferSrc
+                                                            | vk::ImageUsageFlagBits::eTransferDst);
 
 
         nvvk::Image             image  = m_alloc.createImage(colorCreateInfo);
@@ -26,6 +30,20 @@ void Application::Impl::createOffscreenRender()
         m_offscreenColor.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
     }
 
+    // State of the accumulation, only read after a frame wrote it: no need to
+    // clear it
+    {
+        auto createInfo = nvvk::makeImage2DCreateInfo(m_size, vk::Format::eR32G32B32A32Uint,
+                                                      vk::ImageUsageFlagBits::eStorage
+                                                          | vk::ImageUsageFlagBits::eTransferSrc
+                                                          | vk::ImageUsageFlagBits::eTransferDst);
+
+        nvvk::Image             image  = m_alloc.createImage(createInfo);
+        vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, createInfo);
+        m_accumState                   = m_alloc.createTexture(image, ivInfo);
+        m_accumState.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+
     // Creating the depth buffer
     auto depthCreateInfo =
         nvvk::makeImage2DCreateInfo(m_size, m_offscreenDepthFormat,
@@ -48,6 +66,8 @@ void Application::Impl::createOffscreenRender()
         auto              cmdBuf = genCmdBuf.createCommandBuffer();
         nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenColor.image, vk::ImageLayout::eUndefined,
                                     vk::ImageLayout::eGeneral);
+        nvvk::cmdBarrierImageLayout(cmdBuf, m_accumState.image, vk::ImageLayout::eUndefined,
+                                    vk::ImageLayout::eGeneral);
         nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenDepth.image, vk::ImageLayout::eUndefined,
                                     vk::ImageLayout::eDepthStencilAttachmentOptimal,
                                     vk::ImageAspectFlagBits::eDepth);
@@ -81,7 +101,7 @@ void Application::Impl::createOffscreenRender()
 void Application::Impl::createPostPipeline()
 {
     // Push constants in the fragment shader
-    vk::PushConstantRange pushConstantRanges = {vk::ShaderStageFlagBits::eFragment, 0, sizeof(float)};
+    vk::PushConstantRange pushConstantRanges = {vk::ShaderStageFlagBits::eFragment, 0, sizeof(PostPushConstant)};
 
     // Creating the pipeline layout
     vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
@@ -110,6 +130,8 @@ void Application::Impl::createPostDescriptor()
     using vkSS = vk::ShaderStageFlagBits;
 
     m_postDescSetLayoutBind.addBinding(vkDS(0, vkDT::eCombinedImageSampler, 1, vkSS::eFragment));
+    // Exposure adapted by exposure_adapt.comp
+    m_postDescSetLayoutBind.addBinding(vkDS(1, vkDT::eStorageBuffer, 1, vkSS::eFragment));
     m_postDescSetLayout = m_postDescSetLayoutBind.createLayout(m_device);
     m_postDescPool      = m_postDescSetLayoutBind.createPool(m_device);
     m_postDescSet       = nvvk::allocateDescriptorSet(m_device, m_postDescPool, m_postDescSetLayout);
@@ -117,9 +139,16 @@ void Application::Impl::createPostDescriptor()
 
 void Application::Impl::updatePostDescriptorSet()
 {
-    vk::WriteDescriptorSet writeDescriptorSets =
-    m_postDescSetLayoutBind.makeWrite(m_postDescSet, 0, &m_offscreenColor.descriptor);
-    m_device.updateDescriptorSets(writeDescriptorSets, nullptr);
+    const auto& source = m_denoiseEnabled ? m_denoiseOutput.descriptor : m_offscreenColor.descriptor;
+
+    vk::DescriptorBufferInfo exposureInfo{m_exposureBuffer.buffer, 0, VK_WHOLE_SIZE};
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.emplace_back(m_postDescSetLayoutBind.makeWrite(m_postDescSet, 0, &source));
+    writes.emplace_back(m_postDescSetLayoutBind.makeWrite(m_postDescSet, 1, &exposureInfo));
+    m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    updateExposureDescriptorSet(source);
 }
 
 void Application::Impl::drawPost(vk::CommandBuffer cmdBuf)
@@ -127,9 +156,10 @@ void Application::Impl::drawPost(vk::CommandBuffer cmdBuf)
     cmdBuf.setViewport(0, {vk::Viewport(0, 0, (float)m_size.width, (float)m_size.height, 0, 1)});
     cmdBuf.setScissor(0, {{{0, 0}, {m_size.width, m_size.height}}});
 
-    auto aspectRatio = static_cast<float>(m_size.width) / static_cast<float>(m_size.height);
-    cmdBuf.pushConstants<float>(m_postPipelineLayout, vk::ShaderStageFlagBits::eFragment, 0,
-                                aspectRatio);
+    PostPushConstant pc;
+    pc.aspectRatio = static_cast<float>(m_size.width) / static_cast<float>(m_size.height);
+    pc.toneMapper  = static_cast<int>(m_toneMapper);
+    cmdBuf.pushConstants<PostPushConstant>(m_postPipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, pc);
     cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, m_postPipeline);
     cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_postPipelineLayout, 0,
                                 m_postDescSet, {});
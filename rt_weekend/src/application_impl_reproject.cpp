@@ -0,0 +1,71 @@
+#include "application_impl.hpp"
+
+
+// -----------------------
+// Impl Reprojection Methods
+// -----------------------
+
+void Application::Impl::createReprojectionRender()
+{
+    m_alloc.destroy(m_reprojectColor);
+    m_alloc.destroy(m_reprojectNormalDepth);
+
+    // Copies of the accumulation and of the primary G-buffer as seen by the previous camera
+    auto createHistoryTexture = [&](vk::Format format) {
+        auto createInfo = nvvk::makeImage2DCreateInfo(m_size, format,
+                                                      vk::ImageUsageFlagBits::eStorage
+                                                          | vk::ImageUsageFlagBits::eTransferDst);
+
+        nvvk::Image             image   = m_alloc.createImage(createInfo);
+        vk::ImageViewCreateInfo ivInfo  = nvvk::makeImageViewCreateInfo(image.image, createInfo);
+        nvvk::Texture           texture = m_alloc.createTexture(image, ivInfo, vk::SamplerCreateInfo());
+        texture.descriptor.imageLayout  = VK_IMAGE_LAYOUT_GENERAL;
+        return texture;
+    };
+
+    m_reprojectColor       = createHistoryTexture(vk::Format::eR32G32B32A32Uint);
+    m_reprojectNormalDepth = createHistoryTexture(vk::Format::eR16G16B16A16Sfloat);
+
+    {
+        nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+        auto              cmdBuf = genCmdBuf.createCommandBuffer();
+        nvvk::cmdBarrierImageLayout(cmdBuf, m_reprojectColor.image, vk::ImageLayout::eUndefined,
+                                    vk::ImageLayout::eGeneral);
+        nvvk::cmdBarrierImageLayout(cmdBuf, m_reprojectNormalDepth.image, vk::ImageLayout::eUndefined,
+                                    vk::ImageLayout::eGeneral);
+        genCmdBuf.submitAndWait(cmdBuf);
+    }
+}
+
+void Application::Impl::destroyReprojection()
+{
+    m_alloc.destroy(m_reprojectColor);
+    m_alloc.destroy(m_reprojectNormalDepth);
+}
+
+void Application::Impl::copyReprojectionHistory(const vk::CommandBuffer& cmdBuf)
+{
+    // Last frame's ray tracing and the passes sampling its result must be done
+    vk::MemoryBarrier toTransfer{vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead,
+                                 vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite};
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader
+                               | vk::PipelineStageFlagBits::eFragmentShader,
+                           vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits::eDeviceGroup, {toTransfer},
+                           {}, {});
+
+    vk::ImageCopy region;
+    region.srcSubresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+    region.dstSubresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+    region.extent         = vk::Extent3D{m_size.width, m_size.height, 1};
+
+    cmdBuf.copyImage(m_accumState.image, vk::ImageLayout::eGeneral, m_reprojectColor.image,
+                     vk::ImageLayout::eGeneral, {region});
+    cmdBuf.copyImage(m_gbufferNormalDepth.image, vk::ImageLayout::eGeneral, m_reprojectNormalDepth.image,
+                     vk::ImageLayout::eGeneral, {region});
+
+    // The ray generation overwrites the accumulation and G-buffer after reading the copies
+    vk::MemoryBarrier toRayTracing{vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite,
+                                   vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite};
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                           vk::DependencyFlagBits::eDeviceGroup, {toRayTracing}, {}, {});
+}
@@ -20,21 +20,23 @@ void Application::Impl::initRayTracing()
 
     m_rtProperties = properties.get<vk::PhysicalDeviceRayTracingPipelinePropertiesKHR>();
 
-    // Spec only guarantees 1 level of "recursion". Check for that sad possibility here.
+    // Spec only guarantees 1 level of "recursion": the bounces are then traced from the raygen
     if (m_rtProperties.maxRayRecursionDepth <= 1) {
-        throw std::runtime_error("Device fails to support ray recursion (m_rtProperties.maxRayRecursionDepth <= 1)");
+        m_iterativePathTracing = true;
     }
 
     m_rtBuilder.setup(m_device, &m_alloc, m_graphicsQueueIndex);
 }
 
-nvvk::RaytracingBuilderKHR::BlasInput Application::Impl::objectToVkGeometryKHR(const ObjModel& model)
+nvvk::RaytracingBuilderKHR::BlasInput Application::Impl::objectToVkGeometryKHR(const ObjGeometry& geometry)
 {
-    // BLAS builder requires raw device addresses.
-    vk::DeviceAddress vertexAddress = m_device.getBufferAddress({ model.vertexBuffer.buffer });
-    vk::DeviceAddress indexAddress = m_device.getBufferAddress({ model.indexBuffer.buffer });
+    const ObjModel& model = m_objModel[geometry.objIndex];
 
-    auto maxPrimitiveCount = model.nbIndices / 3;
+    // BLAS builder requires raw device addresses, offset to the range of the geometry
+    vk::DeviceAddress vertexAddress = model.vertices.address + geometry.vertexOffset * sizeof(VertexObj);
+    vk::DeviceAddress indexAddress  = model.indices.address + geometry.firstIndex * sizeof(uint32_t);
+
+    auto maxPrimitiveCount = geometry.nbIndices / 3;
 
     // Describe buffer as array of VertexObj.
     vk::AccelerationStructureGeometryTrianglesDataKHR triangles;
@@ -48,7 +50,7 @@ nvvk::RaytracingBuilderKHR::BlasInput Application::Impl::objectToVkGeometryKHR(c
 
     // Indicate identity transform by setting transformData to null device pointer.
     triangles.setTransformData({});
-    triangles.setMaxVertex(model.nbVertices);
+    triangles.setMaxVertex(geometry.nbVertices);
 
     // Identify the above data as containing opaque triangles.
     vk::AccelerationStructureGeometryKHR asGeom;
@@ -75,18 +77,17 @@ void Application::Impl::createBottomLevelAS()
 {
     // BLAS - Storing each primitive in a geometry
     std::vector<nvvk::RaytracingBuilderKHR::BlasInput> allBlas;
-    allBlas.reserve(m_objModel.size() + 1);
-    for(const auto& obj : m_objModel)
+    allBlas.reserve(m_objGeometry.size() + m_sphereHandler->getClusters().size());
+    for(const auto& geometry : m_objGeometry)
     {
-        auto blas = objectToVkGeometryKHR(obj);
+        auto blas = objectToVkGeometryKHR(geometry);
 
         // We could add more geometry in each BLAS, but we add only one for now
         allBlas.emplace_back(blas);
     }
 
-    // Spheres
-    {
-        auto blas = m_sphereHandler->toVkGeometryKHR(m_device);
+    // Spheres, one BLAS per cluster
+    for (auto& blas : m_sphereHandler->toVkGeometryKHR(m_device)) {
         allBlas.emplace_back(blas);
     }
 
@@ -96,27 +97,29 @@ void Application::Impl::createBottomLevelAS()
 void Application::Impl::createTopLevelAS()
 {
     std::vector<nvvk::RaytracingBuilderKHR::Instance> tlas;
-    tlas.reserve(m_objInstance.size() + 1);
+    tlas.reserve(m_objInstance.size() + m_sphereHandler->getClusters().size());
 
     for (uint32_t i = 0; i < static_cast<uint32_t>(m_objInstance.size()); ++i)
     {
         nvvk::RaytracingBuilderKHR::Instance ray_inst;
         ray_inst.transform        = m_objInstance[i].transform; // Position of the instance
         ray_inst.instanceCustomId = i;                          // gl_InstanceCustomIndexEXT
-        ray_inst.blasId           = m_objInstance[i].objIndex;
-        ray_inst.hitGroupId       = 1;                          // We will use the same hit group for all objects
+        ray_inst.blasId           = m_objInstanceBlas[i];
+        ray_inst.hitGroupId       = HIT_GROUP_MESH;             // We will use the same hit group for all objects
         ray_inst.flags            = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
         tlas.emplace_back(ray_inst);
     }
 
-    // Add the sphere BLAS
+    // Add the sphere BLAS, the shaders index the spheres from the first of the
+    // cluster. Its hit group is specialized for the material of its spheres.
+    const auto& clusters = m_sphereHandler->getClusters();
+    for (uint32_t i = 0; i < static_cast<uint32_t>(clusters.size()); ++i)
     {
         nvvk::RaytracingBuilderKHR::Instance ray_inst;
-        // ray_inst.transform        = m_objInstance[0].transform;
         ray_inst.transform        = nvmath::mat4f().identity();
-        ray_inst.instanceCustomId = static_cast<uint32_t>(tlas.size());
-        ray_inst.blasId           = static_cast<uint32_t>(m_objModel.size());
-        ray_inst.hitGroupId       = 0;
+        ray_inst.instanceCustomId = clusters[i].first;
+        ray_inst.blasId           = static_cast<uint32_t>(m_objGeometry.size()) + i;
+        ray_inst.hitGroupId       = HIT_GROUP_SPHERE + static_cast<uint32_t>(clusters[i].material);
         ray_inst.flags            = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
         tlas.emplace_back(ray_inst);
     }
@@ -133,8 +136,25 @@ void Application::Impl::createRtDescriptorSet()
     // TLAS
     m_rtDescSetLayoutBind.addBinding(vkDSLB(0, vkDT::eAccelerationStructureKHR, 1, vkSS::eRaygenKHR | vkSS::eClosestHitKHR)); 
 
-    // Output Image
-    m_rtDescSetLayoutBind.addBinding(vkDSLB(1, vkDT::eStorageImage, 1, vkSS::eRaygenKHR));
+    // Output Image, also written by the wavefront passes (compute)
+    m_rtDescSetLayoutBind.addBinding(vkDSLB(1, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+
+    // G-buffer for the denoiser: normal/depth and albedo
+    m_rtDescSetLayoutBind.addBinding(vkDSLB(2, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+    m_rtDescSetLayoutBind.addBinding(vkDSLB(3, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+
+    // Accumulation and G-buffer of the previous camera, for reprojection
+    m_rtDescSetLayoutBind.addBinding(vkDSLB(4, vkDT::eStorageImage, 1, vkSS::eRaygenKHR));
+    m_rtDescSetLayoutBind.addBinding(vkDSLB(5, vkDT::eStorageImage, 1, vkSS::eRaygenKHR));
+
+    // Sampler tables
+    m_rtDescSetLayoutBind.addBinding(vkDSLB(6, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR | vkSS::eClosestHitKHR | vkSS::eCompute));
+
+    // State of the accumulation, see accumulation.glsl
+    m_rtDescSetLayoutBind.addBinding(vkDSLB(7, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+
+    // Noise of the tiles, see rayTraceTiles()
+    m_rtDescSetLayoutBind.addBinding(vkDSLB(8, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR));
 
     m_rtDescPool        = m_rtDescSetLayoutBind.createPool(m_device);
     m_rtDescSetLayout   = m_rtDescSetLayoutBind.createLayout(m_device);
@@ -152,6 +172,16 @@ void Application::Impl::createRtDescriptorSet()
     std::vector<vk::WriteDescriptorSet> writes;
     writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 0, &descASInfo));
     writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 1, &imageInfo));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 2, &m_gbufferNormalDepth.descriptor));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 3, &m_gbufferAlbedo.descriptor));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 4, &m_reprojectColor.descriptor));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 5, &m_reprojectNormalDepth.descriptor));
+
+    vk::DescriptorBufferInfo samplerTablesInfo{m_samplerTables.buffer, 0, VK_WHOLE_SIZE};
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 6, &samplerTablesInfo));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 7, &m_accumState.descriptor));
+    vk::DescriptorBufferInfo tileVarianceInfo{m_tileVariance.buffer, 0, VK_WHOLE_SIZE};
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 8, &tileVarianceInfo));
     
     m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
@@ -164,91 +194,95 @@ void Application::Impl::updateRtDescriptorSet()
     vk::DescriptorImageInfo imageInfo {{}, m_offscreenColor.descriptor.imageView, vk::ImageLayout::eGeneral};
     vk::WriteDescriptorSet wds {m_rtDescSet, 1, 0, 1, vkDT::eStorageImage, &imageInfo};
     m_device.updateDescriptorSets(wds, nullptr);
+
+    // (2, 3) G-buffer, (4, 5) reprojection history, (7) accumulation state, (8) tile noise
+    vk::DescriptorBufferInfo            tileVarianceInfo{m_tileVariance.buffer, 0, VK_WHOLE_SIZE};
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 2, &m_gbufferNormalDepth.descriptor));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 3, &m_gbufferAlbedo.descriptor));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 4, &m_reprojectColor.descriptor));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 5, &m_reprojectNormalDepth.descriptor));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 7, &m_accumState.descriptor));
+    writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 8, &tileVarianceInfo));
+    m_device.updateDescriptorSets(writes, nullptr);
 }
 
 void Application::Impl::createRtPipeline()
 {
-    vk::ShaderModule raygenSM = nvvk::createShaderModule(
-        m_device, nvh::loadFile("spv/raytrace.rgen.spv", true, _default_search_paths, true));
-    vk::ShaderModule missSM = nvvk::createShaderModule(
-        m_device, nvh::loadFile("spv/raytrace.rmiss.spv", true, _default_search_paths, true));
-    vk::ShaderModule diffuseMissSM = nvvk::createShaderModule(
-        m_device, nvh::loadFile("spv/diffuse.rmiss.spv", true, _default_search_paths, true));
+    m_rtShaderGroups.clear();
+
+    // Recursive: the closest-hit shaders trace the bounces, one level each
+    if (!m_iterativePathTracing) {
+        m_maxPathDepth = std::min(m_maxPathDepth, static_cast<int>(m_rtProperties.maxRayRecursionDepth) - 1);
+    }
 
     // The second miss shader is invoked when a shadow ray misses the geometry. It
     // simply indicates that no occlusion has been found
     // vk::ShaderModule shadowmissSM = nvvk::createShaderModule(
     //     m_device, nvh::loadFile("spv/raytraceShadow.rmiss.spv", true, _default_search_paths, true));
 
-
+    using vkSS = vk::ShaderStageFlagBits;
     std::vector<vk::PipelineShaderStageCreateInfo> stages;
 
+    // PATH_ITERATIVE, MAX_PATH_DEPTH and SAMPLE_ENVIRONMENT specialization
+    // constants of the raygen, miss and closest-hit shaders
+    auto pathKey = [&](const char* filename) {
+        return ShaderPermutationKey(filename)
+            .set(SHADER_CONSTANT_PATH_ITERATIVE, m_iterativePathTracing ? VK_TRUE : VK_FALSE)
+            .set(SHADER_CONSTANT_MAX_PATH_DEPTH, static_cast<uint32_t>(m_maxPathDepth))
+            .set(SHADER_CONSTANT_SAMPLE_ENVIRONMENT, m_sampleEnvironment ? VK_TRUE : VK_FALSE);
+    };
+
     // Raygen
     vk::RayTracingShaderGroupCreateInfoKHR rg{vk::RayTracingShaderGroupTypeKHR::eGeneral,
                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
     rg.setGeneralShader(static_cast<uint32_t>(stages.size()));
-    stages.push_back({{}, vk::ShaderStageFlagBits::eRaygenKHR, raygenSM, "main"});
+    stages.push_back(m_shaderVariants.getStage(vkSS::eRaygenKHR, pathKey("spv/raytrace.rgen.spv")));
     m_rtShaderGroups.push_back(rg);
     // Miss
     vk::RayTracingShaderGroupCreateInfoKHR mg{vk::RayTracingShaderGroupTypeKHR::eGeneral,
                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
     mg.setGeneralShader(static_cast<uint32_t>(stages.size()));
-    stages.push_back({{}, vk::ShaderStageFlagBits::eMissKHR, missSM, "main"});
+    stages.push_back(m_shaderVariants.getStage(vkSS::eMissKHR, pathKey("spv/raytrace.rmiss.spv")));
     m_rtShaderGroups.push_back(mg);
 
     mg.setGeneralShader(static_cast<uint32_t>(stages.size()));
-    stages.push_back({{}, vk::ShaderStageFlagBits::eMissKHR, diffuseMissSM, "main"});
+    stages.push_back(m_shaderVariants.getStage(vkSS::eMissKHR, ShaderPermutationKey("spv/diffuse.rmiss.spv")));
     m_rtShaderGroups.push_back(mg);
     // // Shadow Miss
     // mg.setGeneralShader(static_cast<uint32_t>(stages.size()));
     // stages.push_back({{}, vk::ShaderStageFlagBits::eMissKHR, shadowmissSM, "main"});
     // m_rtShaderGroups.push_back(mg);
 
-    // Hit Group0 - Closest Hit
-    // vk::ShaderModule chitSM = nvvk::createShaderModule(
-    //     m_device, nvh::loadFile("spv/raytrace.rchit.spv", true, _default_search_paths, true));
-
-    // {
-    //     vk::RayTracingShaderGroupCreateInfoKHR hg{vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
-    //                                             VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
-    //                                             VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
-    //     hg.setClosestHitShader(static_cast<uint32_t>(stages.size()));
-    //     stages.push_back({{}, vk::ShaderStageFlagBits::eClosestHitKHR, chitSM, "main"});
-    //     m_rtShaderGroups.push_back(hg);
-    // }
-
-    // Hit Group0 - Closest Hit + Intersection (procedural)
-    vk::ShaderModule chitSM_sphere = nvvk::createShaderModule(
-        m_device, nvh::loadFile("spv/raytrace_sphere.rchit.spv", true, _default_search_paths, true));
-    vk::ShaderModule rintSM_sphere = nvvk::createShaderModule(
-        m_device, nvh::loadFile("spv/raytrace.rint.spv", true, _default_search_paths, true));
+    // Hit groups, in the order of HIT_GROUP_*
+    // Meshes - Closest Hit
     {
-        vk::RayTracingShaderGroupCreateInfoKHR hg{vk::RayTracingShaderGroupTypeKHR::eProceduralHitGroup,
+        vk::RayTracingShaderGroupCreateInfoKHR hg{vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
         hg.setClosestHitShader(static_cast<uint32_t>(stages.size()));
-        stages.push_back({{}, vk::ShaderStageFlagBits::eClosestHitKHR, chitSM_sphere, "main"});
-        hg.setIntersectionShader(static_cast<uint32_t>(stages.size()));
-        stages.push_back({{}, vk::ShaderStageFlagBits::eIntersectionKHR, rintSM_sphere, "main"});
+        stages.push_back(m_shaderVariants.getStage(vkSS::eClosestHitKHR, pathKey("spv/raytrace_mesh.rchit.spv")));
         m_rtShaderGroups.push_back(hg);
     }
 
-    // Hit Group1 - Closest Hit
-    vk::ShaderModule chitSM_mesh = nvvk::createShaderModule(
-        m_device, nvh::loadFile("spv/raytrace_mesh.rchit.spv", true, _default_search_paths, true));
-    {
-        vk::RayTracingShaderGroupCreateInfoKHR hg{vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
+    // Spheres - Closest Hit + Intersection (procedural), SPHERE_MATERIAL
+    // specialization constant of each group, same intersection shader
+    uint32_t rintStage = static_cast<uint32_t>(stages.size());
+    stages.push_back(m_shaderVariants.getStage(vkSS::eIntersectionKHR, ShaderPermutationKey("spv/raytrace.rint.spv")));
+    for (uint32_t material = 0; material < SPHERE_MATERIAL_COUNT; ++material) {
+        vk::RayTracingShaderGroupCreateInfoKHR hg{vk::RayTracingShaderGroupTypeKHR::eProceduralHitGroup,
                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
         hg.setClosestHitShader(static_cast<uint32_t>(stages.size()));
-        stages.push_back({{}, vk::ShaderStageFlagBits::eClosestHitKHR, chitSM_mesh, "main"});
+        stages.push_back(m_shaderVariants.getStage(
+            vkSS::eClosestHitKHR, pathKey("spv/raytrace_sphere.rchit.spv").set(SHADER_CONSTANT_MATERIAL, material)));
+        hg.setIntersectionShader(rintStage);
         m_rtShaderGroups.push_back(hg);
     }
 
 
-
     vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
 
     // Push constant: we want to be able to update constants used by the shaders
@@ -275,25 +309,40 @@ void Application::Impl::createRtPipeline()
         m_rtShaderGroups.size()));  // 1-raygen, n-miss, n-(hit[+anyhit+intersect])
     rayPipelineInfo.setPGroups(m_rtShaderGroups.data());
 
-    rayPipelineInfo.setMaxPipelineRayRecursionDepth(16);  // Ray depth
+    // Recursive: primary ray and up to m_maxPathDepth bounces traced from the closest-hit shaders
+    uint32_t recursionDepth = m_iterativePathTracing ? 1 : static_cast<uint32_t>(m_maxPathDepth) + 1;
+    rayPipelineInfo.setMaxPipelineRayRecursionDepth(recursionDepth);  // Ray depth
     rayPipelineInfo.setLayout(m_rtPipelineLayout);
     m_rtPipeline = static_cast<const vk::Pipeline&>(
         m_device.createRayTracingPipelineKHR({}, {}, rayPipelineInfo).value);
 
-    m_device.destroy(raygenSM);
-    m_device.destroy(missSM);
-    m_device.destroy(diffuseMissSM);
     // m_device.destroy(shadowmissSM);
-    // m_device.destroy(chitSM);
-    m_device.destroy(chitSM_sphere);
-    m_device.destroy(rintSM_sphere);
-    m_device.destroy(chitSM_mesh);
+}
+
+void Application::Impl::recreateRtPipeline()
+{
+    m_device.waitIdle();
+
+    m_device.destroy(m_rtPipeline);
+    m_device.destroy(m_rtPipelineLayout);
+    m_alloc.destroy(m_rtSBTBuffer);
+
+    createRtPipeline();
+    createRtShaderBindingTable();
+    // Same path depth in the wavefront mode
+    createWavefrontShadePipelines();
+    resetFrameId();
 }
 
 void Application::Impl::createRtShaderBindingTable()
 {
-    auto groupCount =
-        static_cast<uint32_t>(m_rtShaderGroups.size());  // shaders: raygen, 2 miss, 2 chit, rint
+    // groups: raygen, 2 miss, HIT_GROUP_COUNT hit groups
+    m_rtSBTBuffer = createShaderBindingTable(m_rtPipeline, static_cast<uint32_t>(m_rtShaderGroups.size()));
+}
+
+// One handle per group, in the order of the groups of the pipeline
+nvvk::Buffer Application::Impl::createShaderBindingTable(vk::Pipeline pipeline, uint32_t groupCount)
+{
     uint32_t groupHandleSize = m_rtProperties.shaderGroupHandleSize;  // Size of a program identifier
     uint32_t groupSizeAligned =
         nvh::align_up(groupHandleSize, m_rtProperties.shaderGroupBaseAlignment);
@@ -302,35 +351,39 @@ void Application::Impl::createRtShaderBindingTable()
     uint32_t sbtSize = groupCount * groupSizeAligned;
 
     std::vector<uint8_t> shaderHandleStorage(sbtSize);
-    auto result = m_device.getRayTracingShaderGroupHandlesKHR(m_rtPipeline, 0, groupCount, sbtSize,
+    auto result = m_device.getRayTracingShaderGroupHandlesKHR(pipeline, 0, groupCount, sbtSize,
                                                                 shaderHandleStorage.data());
     assert(result == vk::Result::eSuccess);
 
     // Write the handles in the SBT
-    m_rtSBTBuffer = m_alloc.createBuffer(
+    nvvk::Buffer sbtBuffer = m_alloc.createBuffer(
         sbtSize,
         vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eShaderDeviceAddressKHR
             | vk::BufferUsageFlagBits::eShaderBindingTableKHR,
         vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
     
     // Write the handles in the SBT
-    void* mapped = m_alloc.map(m_rtSBTBuffer);
+    void* mapped = m_alloc.map(sbtBuffer);
     auto* pData  = reinterpret_cast<uint8_t*>(mapped);
     for(uint32_t g = 0; g < groupCount; g++)
     {
         memcpy(pData, shaderHandleStorage.data() + g * groupHandleSize, groupHandleSize);  // raygen
         pData += groupSizeAligned;
     }
-    m_alloc.unmap(m_rtSBTBuffer);
+    m_alloc.unmap(sbtBuffer);
 
     m_alloc.finalizeAndReleaseStaging();
+    return sbtBuffer;
 }
 
 void Application::Impl::rayTrace(const vk::CommandBuffer& cmdBuf, const nvmath::vec4f& clearColor)
 {
+    readTraceTimings(getFrameInFlightIndex());
     updateFrameId();
-    
-    if (m_rtcurrentFrameId >= m_max_accumulated_frames) {
+
+    // The wavefront mode traces the whole image, tiles are ignored
+    bool tiled = m_tiledRendering && !m_wavefrontEnabled;
+    if (!tiled && m_rtcurrentFrameId >= m_max_accumulated_frames) {
         return;
     }
     
@@ -341,10 +394,49 @@ void Application::Impl::rayTrace(const vk::CommandBuffer& cmdBuf, const nvmath::
     m_rtPushConstants.lightIntensity = m_pushConstant.lightIntensity;
     m_rtPushConstants.lightType      = m_pushConstant.lightType;
     m_rtPushConstants.frameId        = m_rtcurrentFrameId;
+    m_rtPushConstants.reproject      = m_rtReprojectHistory ? 1 : 0;
+    m_rtPushConstants.samplerType    = static_cast<int>(m_samplerType);
+    m_rtPushConstants.sampleFrame    = m_rtSampleFrame++;
+    m_rtPushConstants.accumulation   = static_cast<int>(m_accumulationMode);
+    m_rtPushConstants.tileVariance   = -1;
+    m_rtPushConstants.imageSize      = nvmath::vec2i(m_size.width, m_size.height);
+
+    if (m_rtReprojectHistory) {
+        copyReprojectionHistory(cmdBuf);
+    }
+
+    float nbPixels = static_cast<float>(m_size.width) * static_cast<float>(m_size.height);
+    if (m_wavefrontEnabled) {
+        beginTraceTiming(cmdBuf, TraceTiming::Wavefront, nbPixels * m_wavefrontSamplesPerFrame);
+        rayTraceWavefront(cmdBuf);
+        endTraceTiming(cmdBuf);
+    } else {
+        cmdBuf.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, m_rtPipeline);
+        cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, m_rtPipelineLayout, 0,
+                                    {m_rtDescSet, m_descSet}, {});
+
+        if (tiled) {
+            rayTraceTiles(cmdBuf);
+        } else {
+            // SAMPLES_COUNT of raytrace.rgen
+            beginTraceTiming(cmdBuf, TraceTiming::Megakernel, nbPixels * 8);
+            traceRays(cmdBuf, {0, 0}, m_size);
+            endTraceTiming(cmdBuf);
+        }
+    }
+
+    // Feedback of the traced rays, read back once the fence of this frame signaled
+    if (m_vtSettings.enabled) {
+        vk::MemoryBarrier feedbackBarrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead};
+        cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader,
+                               vk::PipelineStageFlagBits::eHost, {}, {feedbackBarrier}, {}, {});
+    }
+}
+
+void Application::Impl::traceRays(const vk::CommandBuffer& cmdBuf, const vk::Offset2D& offset, const vk::Extent2D& extent)
+{
+    m_rtPushConstants.tileOffset = nvmath::vec2i(offset.x, offset.y);
 
-    cmdBuf.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, m_rtPipeline);
-    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, m_rtPipelineLayout, 0,
-                                {m_rtDescSet, m_descSet}, {});
     cmdBuf.pushConstants<RtPushConstant>(m_rtPipelineLayout,
                                         vk::ShaderStageFlagBits::eRaygenKHR
                                             | vk::ShaderStageFlagBits::eClosestHitKHR
@@ -359,13 +451,13 @@ void Application::Impl::rayTrace(const vk::CommandBuffer& cmdBuf, const nvmath::
 
     using Stride = vk::StridedDeviceAddressRegionKHR;
     std::array<Stride, 4> strideAddresses{
-        Stride{sbtAddress + 0u * groupSize, groupStride, groupSize * 1},  // raygen
-        Stride{sbtAddress + 1u * groupSize, groupStride, groupSize * 2},  // miss
-        Stride{sbtAddress + 3u * groupSize, groupStride, groupSize * 2},  // hit
-        Stride{0u, 0u, 0u}};                                              // callable
+        Stride{sbtAddress + 0u * groupSize, groupStride, groupSize * 1},                // raygen
+        Stride{sbtAddress + 1u * groupSize, groupStride, groupSize * 2},                // miss
+        Stride{sbtAddress + 3u * groupSize, groupStride, groupSize * HIT_GROUP_COUNT},  // hit
+        Stride{0u, 0u, 0u}};                                                            // callable
 
     cmdBuf.traceRaysKHR(&strideAddresses[0], &strideAddresses[1], &strideAddresses[2],
                         &strideAddresses[3],              //
-                        m_size.width, m_size.height, 1);  //
+                        extent.width, extent.height, 1);  //
 
 }
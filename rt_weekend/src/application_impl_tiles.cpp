@@ -0,0 +1,177 @@
+#include "application_impl.hpp"
+#include "imgui.h"
+
+// Smallest tile of the UI, bounds the number of noise counters
+#define MIN_TILE_SIZE 32
+
+// Fixed point noise of raytrace.rgen, keep in sync: with a relative variance
+// clamped to 4, the uint32 counter of a tile up to 1024x1024 stays below 2^31
+static constexpr float TILE_VARIANCE_SCALE = 512.0f;
+
+
+// -----------------------
+// Impl Tile Methods
+// -----------------------
+
+void Application::Impl::createTileScheduler()
+{
+    m_timestampPeriod = m_physicalDevice.getProperties().limits.timestampPeriod;
+
+    // Two timestamps (begin, end) for each frame in flight
+    auto frameCount = getFramesInFlight();
+    m_tileBatches.resize(frameCount);
+
+    vk::QueryPoolCreateInfo queryPoolInfo;
+    queryPoolInfo.setQueryType(vk::QueryType::eTimestamp);
+    queryPoolInfo.setQueryCount(2 * frameCount);
+    m_tileQueryPool = m_device.createQueryPool(queryPoolInfo);
+
+    m_tileScheduler.reset(m_size.width, m_size.height, m_tileSize);
+    m_tileScheduler.setBudgetMs(m_tileBudgetMs);
+    m_tileScheduler.setTargetSamples(m_max_accumulated_frames);
+}
+
+// Noise counters of the tiles, for any tile size of the image: created with
+// the images and on resize
+void Application::Impl::createTileRender()
+{
+    m_alloc.destroy(m_tileVariance);
+
+    uint32_t tilesX     = (m_size.width + MIN_TILE_SIZE - 1) / MIN_TILE_SIZE;
+    uint32_t tilesY     = (m_size.height + MIN_TILE_SIZE - 1) / MIN_TILE_SIZE;
+    m_tileVarianceSlots = tilesX * tilesY;
+
+    vk::DeviceSize size = vk::DeviceSize(m_tileVarianceSlots) * getFramesInFlight() * sizeof(uint32_t);
+    m_tileVariance      = m_alloc.createBuffer(size, vk::BufferUsageFlagBits::eStorageBuffer
+                                                         | vk::BufferUsageFlagBits::eTransferDst,
+                                               vk::MemoryPropertyFlagBits::eHostVisible
+                                                   | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    // Tiles of the previous size
+    for (auto& batch : m_tileBatches) {
+        batch.clear();
+    }
+}
+
+void Application::Impl::destroyTileScheduler()
+{
+    m_device.destroy(m_tileQueryPool);
+    m_alloc.destroy(m_tileVariance);
+}
+
+void Application::Impl::renderTileUI()
+{
+    if (!ImGui::CollapsingHeader("Tiled Rendering")) {
+        return;
+    }
+
+    bool changed = false;
+    bool retile  = false;
+
+    changed |= ImGui::Checkbox("Enabled", &m_tiledRendering);
+    retile |= ImGui::SliderInt("Tile Size", &m_tileSize, MIN_TILE_SIZE, 1024);
+    ImGui::SliderFloat("Budget (ms)", &m_tileBudgetMs, 1.f, 100.f);
+
+    int order = static_cast<int>(m_tileScheduler.getOrder());
+    changed |= ImGui::RadioButton("Center First", &order, static_cast<int>(TileScheduler::Order::CenterFirst));
+    ImGui::SameLine();
+    changed |= ImGui::RadioButton("Variance", &order, static_cast<int>(TileScheduler::Order::Variance));
+    m_tileScheduler.setOrder(static_cast<TileScheduler::Order>(order));
+
+    if (retile) {
+        m_tileScheduler.reset(m_size.width, m_size.height, m_tileSize);
+        for (auto& batch : m_tileBatches) {
+            batch.clear();
+        }
+        changed = true;
+    }
+
+    ImGui::Text("Tiles %u / %u (%.1f%%)", m_tileScheduler.getCompletedTiles(),
+                static_cast<uint32_t>(m_tileScheduler.getTiles().size()),
+                100.f * m_tileScheduler.getProgress());
+
+    if (changed) {
+        resetFrameId();
+    }
+}
+
+void Application::Impl::readTileTimings(uint32_t frame)
+{
+    auto& batch = m_tileBatches[frame];
+    if (batch.empty()) {
+        return;
+    }
+
+    // The fence of this frame has been waited on in prepareFrame, results are available
+    std::array<uint64_t, 2> timestamps{};
+    vk::Result result = m_device.getQueryPoolResults(m_tileQueryPool, 2 * frame, 2, sizeof(timestamps),
+                                                     timestamps.data(), sizeof(uint64_t),
+                                                     vk::QueryResultFlagBits::e64);
+    if (result == vk::Result::eSuccess) {
+        float elapsedMs = static_cast<float>(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1e-6f;
+        m_tileScheduler.reportSubmit(batch, elapsedMs);
+    }
+
+    // Mean relative variance of the pixels of each tile, for Order::Variance
+    const auto* counters = static_cast<const uint32_t*>(m_alloc.map(m_tileVariance)) + frame * m_tileVarianceSlots;
+    for (uint32_t index : batch) {
+        const Tile& tile   = m_tileScheduler.getTile(index);
+        float       pixels = static_cast<float>(tile.width * tile.height);
+        m_tileScheduler.updateVariance(index, static_cast<float>(counters[index]) / (TILE_VARIANCE_SCALE * pixels));
+    }
+    m_alloc.unmap(m_tileVariance);
+
+    batch.clear();
+}
+
+void Application::Impl::rayTraceTiles(const vk::CommandBuffer& cmdBuf)
+{
+    uint32_t frame = getFrameInFlightIndex();
+    readTileTimings(frame);
+
+    // A new accumulation has been started (camera moved, settings changed)
+    if (m_rtcurrentFrameId == 0) {
+        m_tileScheduler.resetSamples();
+    }
+
+    m_tileScheduler.setBudgetMs(m_tileBudgetMs);
+    m_tileScheduler.setTargetSamples(m_max_accumulated_frames);
+
+    auto batch = m_tileScheduler.nextBatch();
+    if (batch.empty()) {
+        return;
+    }
+
+    // Noise counters of this frame in flight, summed by the tiles
+    vk::DeviceSize slotSize = vk::DeviceSize(m_tileVarianceSlots) * sizeof(uint32_t);
+    cmdBuf.fillBuffer(m_tileVariance.buffer, frame * slotSize, slotSize, 0);
+    vk::MemoryBarrier clearBarrier{vk::AccessFlagBits::eTransferWrite,
+                                   vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite};
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                           vk::DependencyFlagBits::eDeviceGroup, {clearBarrier}, {}, {});
+
+    cmdBuf.resetQueryPool(m_tileQueryPool, 2 * frame, 2);
+    cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_tileQueryPool, 2 * frame);
+
+    // Tiles write disjoint regions of the image: no barrier needed in between
+    for (uint32_t index : batch) {
+        const Tile& tile = m_tileScheduler.getTile(index);
+
+        m_rtPushConstants.frameId      = static_cast<int>(tile.samples);
+        m_rtPushConstants.sampleFrame  = static_cast<int>(tile.samples);
+        m_rtPushConstants.tileVariance = static_cast<int>(frame * m_tileVarianceSlots + index);
+        traceRays(cmdBuf, {static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y)},
+                  {tile.width, tile.height});
+    }
+
+    cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eRayTracingShaderKHR, m_tileQueryPool, 2 * frame + 1);
+
+    // Noise read back once the fence of this frame signaled
+    vk::MemoryBarrier varianceBarrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead};
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::PipelineStageFlagBits::eHost, {},
+                           {varianceBarrier}, {}, {});
+    m_rtPushConstants.tileVariance = -1;
+
+    m_tileScheduler.markDispatched(batch);
+    m_tileBatches[frame] = std::move(batch);
+}
@@ -0,0 +1,294 @@
+#include "application_impl.hpp"
+#include "fileformats/stb_image.h"
+#include "imgui.h"
+#include "nvh/cameramanipulator.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Texels per side of a physical page, border included
+static constexpr uint32_t PAGE_STRIDE = ResidencyManager::PAGE_SIZE + 2 * ResidencyManager::PAGE_BORDER;
+
+// Tile caches are built next to the working directory on first use
+static const char* VT_CACHE_DIRECTORY = "vtcache";
+
+// Largest size of one vkCmdUpdateBuffer
+static constexpr vk::DeviceSize MAX_UPDATE_SIZE = 65536;
+
+
+// -----------------------
+// Impl Virtual Texture Methods
+// -----------------------
+
+// Creates the page pool and the tables read by virtual_texture.glsl. They
+// exist when virtual textures are disabled too, reduced to one page, so that
+// the bindings stay valid: every texture then has no virtual level.
+void Application::Impl::initVirtualTextures()
+{
+    using vkBU = vk::BufferUsageFlagBits;
+    using vkMP = vk::MemoryPropertyFlagBits;
+
+    ResidencyManager::Settings settings = m_vtSettings.residency;
+    settings.framesInFlight             = getFramesInFlight();
+
+    // Square pool of pages, within the image size limits
+    uint32_t maxPagesX = m_physicalDevice.getProperties().limits.maxImageDimension2D / PAGE_STRIDE;
+    uint32_t requested = m_vtSettings.enabled ? std::max(1U, settings.nbPhysicalPages) : 1U;
+    m_vtPoolPagesX     = std::min(maxPagesX, static_cast<uint32_t>(std::ceil(std::sqrt(double(requested)))));
+    uint32_t pagesY    = std::min(maxPagesX, (requested + m_vtPoolPagesX - 1) / m_vtPoolPagesX);
+    settings.nbPhysicalPages   = std::min(requested, m_vtPoolPagesX * pagesY);
+    settings.pageTableCapacity = m_vtSettings.enabled ? std::max(1U, settings.pageTableCapacity) : 1U;
+    m_vtResidency.init(settings);
+
+    vk::Format   format   = m_textureProcessor.getSettings().srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+    vk::Extent2D poolSize = {m_vtPoolPagesX * PAGE_STRIDE, pagesY * PAGE_STRIDE};
+    m_vtInvPoolSize       = nvmath::vec2f(1.f / poolSize.width, 1.f / poolSize.height);
+
+    // Pages are fetched at one level, bilinear filtering stays within the border
+    vk::SamplerCreateInfo samplerCreateInfo{{}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest,
+                                            vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge,
+                                            vk::SamplerAddressMode::eClampToEdge};
+    vk::ImageCreateInfo imageCreateInfo = nvvk::makeImage2DCreateInfo(poolSize, format, vk::ImageUsageFlagBits::eSampled);
+    nvvk::Image             image       = m_alloc.createImage(imageCreateInfo);
+    vk::ImageViewCreateInfo ivInfo      = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
+    m_vtPool                            = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
+
+    vk::DeviceSize tableSize    = vk::DeviceSize(settings.pageTableCapacity) * sizeof(uint32_t);
+    vk::DeviceSize texturesSize = vk::DeviceSize(std::max(1U, m_txtSlotAlloc.getCapacity()))
+                                  * sizeof(ResidencyManager::TextureInfo);
+    vk::BufferUsageFlags usage = vkBU::eStorageBuffer | vkBU::eShaderDeviceAddress | vkBU::eTransferDst;
+    m_vtPageTable = m_alloc.createBuffer(tableSize, usage, vkMP::eDeviceLocal);
+    m_vtTextures  = m_alloc.createBuffer(texturesSize, usage, vkMP::eDeviceLocal);
+    m_vtDesc      = m_alloc.createBuffer(sizeof(VtDesc), vkBU::eUniformBuffer | vkBU::eTransferDst, vkMP::eDeviceLocal);
+
+    // No page resident, no texture virtual
+    nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+    vk::CommandBuffer cmdBuf = cmdGen.createCommandBuffer();
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_vtPool.image, vk::ImageLayout::eUndefined,
+                                vk::ImageLayout::eShaderReadOnlyOptimal);
+    cmdBuf.fillBuffer(m_vtPageTable.buffer, 0, VK_WHOLE_SIZE, ResidencyManager::INVALID_ENTRY);
+    cmdBuf.fillBuffer(m_vtTextures.buffer, 0, VK_WHOLE_SIZE, 0);
+    cmdGen.submitAndWait(cmdBuf);
+
+    createVirtualTextureFeedback();
+
+    if (m_vtSettings.enabled) {
+        LOGI("Virtual textures: %u pages of %u texels (%.1f MB)\n", settings.nbPhysicalPages, PAGE_STRIDE,
+             settings.nbPhysicalPages * TileCache::getPageBytes() / (1024.0 * 1024.0));
+    }
+}
+
+// One feedback entry per 4x4 pixels, reallocated with the render size
+void Application::Impl::createVirtualTextureFeedback()
+{
+    using vkBU = vk::BufferUsageFlagBits;
+    using vkMP = vk::MemoryPropertyFlagBits;
+
+    for (auto& buffer : m_vtFeedback) {
+        m_alloc.destroy(buffer);
+    }
+
+    m_vtFeedbackWidth = (m_size.width + 3) / 4;
+    m_vtFeedbackSize  = m_vtFeedbackWidth * ((m_size.height + 3) / 4);
+
+    m_vtFeedback.resize(getFramesInFlight());
+    for (auto& buffer : m_vtFeedback) {
+        buffer = m_alloc.createBuffer(std::max(1U, m_vtFeedbackSize) * sizeof(uint32_t),
+                                      vkBU::eStorageBuffer | vkBU::eShaderDeviceAddress,
+                                      vkMP::eHostVisible | vkMP::eHostCoherent);
+        void* data = m_alloc.map(buffer);
+        std::memset(data, 0xFF, std::max(1U, m_vtFeedbackSize) * sizeof(uint32_t));
+        m_alloc.unmap(buffer);
+    }
+}
+
+void Application::Impl::destroyVirtualTextures()
+{
+    if (!m_vtSettings.traceFilename.empty()) {
+        if (m_vtTrace.save(m_vtSettings.traceFilename)) {
+            LOGI("Feedback trace: %zu frames written to %s\n", m_vtTrace.frames.size(),
+                 m_vtSettings.traceFilename.c_str());
+        } else {
+            LOGW("Could not write the feedback trace %s\n", m_vtSettings.traceFilename.c_str());
+        }
+    }
+    if (m_vtSettings.enabled) {
+        m_vtResidency.printStats();
+    }
+
+    m_alloc.destroy(m_vtPool);
+    m_alloc.destroy(m_vtPageTable);
+    m_alloc.destroy(m_vtTextures);
+    m_alloc.destroy(m_vtDesc);
+    for (auto& buffer : m_vtFeedback) {
+        m_alloc.destroy(buffer);
+    }
+    m_vtFeedback.clear();
+    m_vtCaches.clear();
+}
+
+void Application::Impl::renderVirtualTextureUI()
+{
+    if (!m_vtSettings.enabled || !ImGui::CollapsingHeader("Virtual Textures")) {
+        return;
+    }
+
+    const auto& stats = m_vtResidency.getStats();
+    ImGui::Text("Pages %u / %u", m_vtResidency.getResidentCount(), m_vtResidency.getSettings().nbPhysicalPages);
+    ImGui::Text("Hit rate %.1f%%", 100.0 * stats.getHitRate());
+    ImGui::Text("Loads %llu, evictions %llu", static_cast<unsigned long long>(stats.nbLoads),
+                static_cast<unsigned long long>(stats.nbEvictions));
+    ImGui::Text("Deferred %llu", static_cast<unsigned long long>(stats.nbDeferred));
+}
+
+// Streams the texture of `slot` from its tile cache, built from `txtFile` when
+// missing or older. `tail` receives the levels resident in the bindless slot.
+// Returns false when the texture is loaded entirely instead: fitting in its
+// tail, unreadable, or no room left in the page table.
+bool Application::Impl::loadVirtualTexture(uint32_t slot, const std::string& txtFile, ProcessedTexture& tail)
+{
+    int width, height, channels;
+    if (!stbi_info(txtFile.c_str(), &width, &height, &channels)
+        || ResidencyManager::getLevelCount(static_cast<uint32_t>(width), static_cast<uint32_t>(height)) == 0) {
+        return false;
+    }
+
+    fs::path        cachePath = fs::path(VT_CACHE_DIRECTORY) / (fs::path(txtFile).filename().string() + ".vtc");
+    std::error_code ec;
+    bool stale = !fs::exists(cachePath, ec) || fs::last_write_time(cachePath, ec) < fs::last_write_time(txtFile, ec);
+
+    auto cache = std::make_unique<TileCache>();
+    if (stale || !cache->open(cachePath.string())) {
+        stbi_uc* pixels = stbi_load(txtFile.c_str(), &width, &height, &channels, 0);
+        if (!pixels) {
+            return false;
+        }
+
+        // Pages are copied to an RGBA8 pool: the cache is never block compressed
+        TextureSettings settings = m_textureProcessor.getSettings();
+        settings.compression     = TextureCompression::None;
+        ProcessedTexture processed = TextureProcessor(settings).process(
+            {pixels}, static_cast<uint32_t>(width), static_cast<uint32_t>(height), static_cast<uint32_t>(channels));
+        stbi_image_free(pixels);
+
+        fs::create_directories(cachePath.parent_path(), ec);
+        if (!TileCache::build(cachePath.string(), processed) || !cache->open(cachePath.string())) {
+            LOGW("Could not build the tile cache %s\n", cachePath.string().c_str());
+            return false;
+        }
+    }
+
+    tail = cache->readTail();
+    if (tail.levels.empty() || !m_vtResidency.addTexture(slot, cache->getWidth(), cache->getHeight())) {
+        return false;
+    }
+
+    const ResidencyManager::TextureInfo* info = m_vtResidency.getTexture(slot);
+    m_uploader.uploadBuffer(m_vtTextures.buffer, slot * sizeof(ResidencyManager::TextureInfo), info, sizeof(*info));
+    m_vtTrace.textures.push_back({slot, cache->getWidth(), cache->getHeight()});
+    m_vtCaches[slot] = std::move(cache);
+    return true;
+}
+
+// Reads back the feedback of the last use of this frame's resources, loads
+// the missing pages and updates the page table before the rays are traced
+void Application::Impl::updateVirtualTextures(const vk::CommandBuffer& cmdBuf)
+{
+    uint32_t frame = getFrameInFlightIndex();
+    auto     rtStages = vk::PipelineStageFlagBits::eRayTracingShaderKHR;
+
+    std::vector<vk::BufferMemoryBarrier> beforeBarriers;
+    std::vector<vk::BufferMemoryBarrier> afterBarriers;
+    auto addBarriers = [&](vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size, vk::AccessFlags access) {
+        beforeBarriers.emplace_back(access, vk::AccessFlagBits::eTransferWrite, VK_QUEUE_FAMILY_IGNORED,
+                                    VK_QUEUE_FAMILY_IGNORED, buffer, offset, size);
+        afterBarriers.emplace_back(vk::AccessFlagBits::eTransferWrite, access, VK_QUEUE_FAMILY_IGNORED,
+                                   VK_QUEUE_FAMILY_IGNORED, buffer, offset, size);
+    };
+
+    std::vector<ResidencyManager::Load> loads;
+    uint32_t                            first = 0, count = 0;
+    if (m_vtSettings.enabled) {
+        // The fence of this frame has been waited on in prepareFrame, its feedback is complete
+        auto* feedback = static_cast<uint32_t*>(m_alloc.map(m_vtFeedback[frame]));
+        if (!m_vtSettings.traceFilename.empty()) {
+            m_vtTrace.addFrame(feedback, m_vtFeedbackSize);
+        }
+        loads = m_vtResidency.update(feedback, m_vtFeedbackSize, m_vtFrame);
+        std::memset(feedback, 0xFF, m_vtFeedbackSize * sizeof(uint32_t));
+        m_alloc.unmap(m_vtFeedback[frame]);
+
+        // Synchronous reads, bounded by maxLoadsPerUpdate
+        std::vector<uint8_t>               pages(loads.size() * TileCache::getPageBytes());
+        std::vector<Uploader::ImageRegion> regions;
+        for (size_t i = 0; i < loads.size(); i++) {
+            const auto& load = loads[i];
+            uint8_t*    data = pages.data() + i * TileCache::getPageBytes();
+
+            auto cache = m_vtCaches.find(load.page.texture);
+            if (cache == m_vtCaches.end() || !cache->second->readPage(load.page.level, load.page.x, load.page.y, data)) {
+                LOGW("Could not read page %u of texture %u\n", load.page.pack(), load.page.texture);
+                std::memset(data, 0, TileCache::getPageBytes());
+            }
+
+            Uploader::ImageRegion region;
+            region.offset = vk::Offset2D{static_cast<int32_t>(load.physicalPage % m_vtPoolPagesX * PAGE_STRIDE),
+                                         static_cast<int32_t>(load.physicalPage / m_vtPoolPagesX * PAGE_STRIDE)};
+            region.extent = vk::Extent2D{PAGE_STRIDE, PAGE_STRIDE};
+            region.data   = data;
+            region.size   = TileCache::getPageBytes();
+            regions.push_back(region);
+        }
+
+        // The pool keeps its other pages, read by the frames in flight
+        if (!regions.empty()) {
+            vk::ImageSubresourceRange range{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+            m_uploader.uploadImage(m_vtPool.image, range, regions, 1, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                   vk::ImageLayout::eShaderReadOnlyOptimal);
+            m_uploader.flush();
+        }
+        m_uploader.poll();
+
+        if (m_vtResidency.getDirtyRange(first, count)) {
+            addBarriers(m_vtPageTable.buffer, first * sizeof(uint32_t), count * sizeof(uint32_t),
+                        vk::AccessFlagBits::eShaderRead);
+        }
+    }
+    addBarriers(m_vtDesc.buffer, 0, sizeof(VtDesc), vk::AccessFlagBits::eUniformRead);
+
+    VtDesc desc;
+    desc.pageTable     = m_device.getBufferAddress({m_vtPageTable.buffer});
+    desc.textures      = m_device.getBufferAddress({m_vtTextures.buffer});
+    desc.feedback      = m_device.getBufferAddress({m_vtFeedback[frame].buffer});
+    desc.feedbackWidth = m_vtFeedbackWidth;
+    desc.feedbackSize  = m_vtFeedbackSize;
+    desc.frame         = static_cast<uint32_t>(m_vtFrame);
+    desc.poolPagesX    = m_vtPoolPagesX;
+    desc.invPoolSize   = m_vtInvPoolSize;
+    desc.pixelSpread   = 2.f * std::tan(CameraManip.getFov() * 0.5f * nv_to_rad) / static_cast<float>(m_size.height);
+
+    cmdBuf.pipelineBarrier(rtStages, vk::PipelineStageFlagBits::eTransfer, {}, {},
+                           beforeBarriers, {});
+    if (count > 0) {
+        const uint32_t* entries = m_vtResidency.getPageTable().data() + first;
+        vk::DeviceSize  size    = count * sizeof(uint32_t);
+        for (vk::DeviceSize offset = 0; offset < size; offset += MAX_UPDATE_SIZE) {
+            vk::DeviceSize chunk = std::min(MAX_UPDATE_SIZE, size - offset);
+            cmdBuf.updateBuffer(m_vtPageTable.buffer, first * sizeof(uint32_t) + offset, chunk,
+                                reinterpret_cast<const uint8_t*>(entries) + offset);
+        }
+        m_vtResidency.clearDirty();
+    }
+    cmdBuf.updateBuffer<VtDesc>(m_vtDesc.buffer, 0, desc);
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, rtStages, {}, {}, afterBarriers, {});
+
+    m_vtFrame++;
+
+    // The accumulated samples used the coarser levels
+    if (!loads.empty()) {
+        resetFrameId();
+    }
+}
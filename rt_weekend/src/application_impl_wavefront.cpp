@@ -0,0 +1,454 @@
+#include "application_impl.hpp"
+#include "nvh/alignment.hpp"
+#include "imgui.h"
+
+#include <cstddef>
+
+// Same constants as in wavefront_queue.glsl
+#define WAVEFRONT_IMAGE_GROUP_SIZE 8
+
+// -----------------------
+// Helpers
+// -----------------------
+
+// Mirrors of wavefront_queue.glsl, scalar layout
+struct WavefrontSamplerState
+{
+    int            type;
+    uint32_t       index;
+    uint32_t       dimension;
+    uint32_t       seed;
+    nvmath::vec2ui pixel;
+};
+
+struct WavefrontRay
+{
+    nvmath::vec3f         origin;
+    float                 tMin;
+    nvmath::vec3f         direction;
+    float                 tMax;
+    nvmath::vec3f         throughput;
+    uint32_t              pixel;
+    WavefrontSamplerState samplerState;
+    int                   depth;
+};
+
+struct WavefrontHit
+{
+    float         t;
+    uint32_t      instance;
+    uint32_t      primitive;
+    nvmath::vec2f attribs;
+};
+
+struct WavefrontState
+{
+    uint32_t                    rayCount[2];
+    uint32_t                    modelCount[WAVEFRONT_MODEL_COUNT];
+    uint32_t                    modelSize[WAVEFRONT_MODEL_COUNT];
+    uint32_t                    modelOffset[WAVEFRONT_MODEL_COUNT];
+    vk::DispatchIndirectCommand sortArgs;
+    vk::DispatchIndirectCommand shadeArgs[WAVEFRONT_MODEL_COUNT];
+};
+
+static_assert(sizeof(WavefrontRay) == 76, "WavefrontRay must match wavefront_queue.glsl");
+static_assert(sizeof(WavefrontHit) == 20, "WavefrontHit must match wavefront_queue.glsl");
+
+static uint32_t divideUp(uint32_t value, uint32_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+// -----------------------
+// Impl Wavefront Methods
+// -----------------------
+
+// Queues sized for one path per pixel, reallocated with the render size
+void Application::Impl::createWavefrontRender()
+{
+    using vkBU = vk::BufferUsageFlagBits;
+    using vkMP = vk::MemoryPropertyFlagBits;
+
+    destroyWavefrontBuffers();
+
+    vk::DeviceSize nbPixels = vk::DeviceSize(std::max(1U, m_size.width * m_size.height));
+    vk::DeviceSize nbBlocks = WavefrontSort::getBlockCount(static_cast<uint32_t>(nbPixels));
+
+    vk::BufferUsageFlags usage = vkBU::eStorageBuffer;
+    for (int i = 0; i < 2; ++i) {
+        m_wfRays[i]       = m_alloc.createBuffer(nbPixels * sizeof(WavefrontRay), usage, vkMP::eDeviceLocal);
+        m_wfSortKeys[i]   = m_alloc.createBuffer(nbPixels * sizeof(uint32_t), usage, vkMP::eDeviceLocal);
+        m_wfSortValues[i] = m_alloc.createBuffer(nbPixels * sizeof(uint32_t), usage, vkMP::eDeviceLocal);
+    }
+    m_wfHits            = m_alloc.createBuffer(nbPixels * sizeof(WavefrontHit), usage, vkMP::eDeviceLocal);
+    m_wfBlockHistograms = m_alloc.createBuffer(nbBlocks * WAVEFRONT_SORT_RADIX * sizeof(uint32_t), usage, vkMP::eDeviceLocal);
+    m_wfRadiance        = m_alloc.createBuffer(nbPixels * sizeof(nvmath::vec4f), usage, vkMP::eDeviceLocal);
+    m_wfState           = m_alloc.createBuffer(sizeof(WavefrontState), usage | vkBU::eIndirectBuffer | vkBU::eTransferDst,
+                                               vkMP::eDeviceLocal);
+
+    // Counters start at zero, the passes keep them consistent afterwards
+    nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+    vk::CommandBuffer cmdBuf = cmdGen.createCommandBuffer();
+    cmdBuf.fillBuffer(m_wfState.buffer, 0, VK_WHOLE_SIZE, 0);
+    cmdGen.submitAndWait(cmdBuf);
+}
+
+void Application::Impl::createWavefrontDescriptor()
+{
+    using vkDS = vk::DescriptorSetLayoutBinding;
+    using vkDT = vk::DescriptorType;
+    using vkSS = vk::ShaderStageFlagBits;
+
+    vk::ShaderStageFlags stages = vkSS::eCompute | vkSS::eRaygenKHR;
+
+    // Ray queues (ping-pong per bounce), hits of the extension pass
+    m_wfDescSetLayoutBind.addBinding(vkDS(0, vkDT::eStorageBuffer, 2, stages));
+    m_wfDescSetLayoutBind.addBinding(vkDS(1, vkDT::eStorageBuffer, 1, stages));
+    // Sort keys and hit indices (ping-pong per sort pass), histograms of the blocks
+    m_wfDescSetLayoutBind.addBinding(vkDS(2, vkDT::eStorageBuffer, 2, stages));
+    m_wfDescSetLayoutBind.addBinding(vkDS(3, vkDT::eStorageBuffer, 2, stages));
+    m_wfDescSetLayoutBind.addBinding(vkDS(4, vkDT::eStorageBuffer, 1, stages));
+    // Counters and indirect arguments, radiance of the frame
+    m_wfDescSetLayoutBind.addBinding(vkDS(5, vkDT::eStorageBuffer, 1, stages));
+    m_wfDescSetLayoutBind.addBinding(vkDS(6, vkDT::eStorageBuffer, 1, stages));
+
+    m_wfDescSetLayout = m_wfDescSetLayoutBind.createLayout(m_device);
+    m_wfDescPool      = m_wfDescSetLayoutBind.createPool(m_device, 1);
+    m_wfDescSet       = nvvk::allocateDescriptorSet(m_device, m_wfDescPool, m_wfDescSetLayout);
+}
+
+void Application::Impl::updateWavefrontDescriptorSet()
+{
+    auto info = [](const nvvk::Buffer& buffer) { return vk::DescriptorBufferInfo{buffer.buffer, 0, VK_WHOLE_SIZE}; };
+
+    std::array<vk::DescriptorBufferInfo, 2> rays{info(m_wfRays[0]), info(m_wfRays[1])};
+    std::array<vk::DescriptorBufferInfo, 2> keys{info(m_wfSortKeys[0]), info(m_wfSortKeys[1])};
+    std::array<vk::DescriptorBufferInfo, 2> values{info(m_wfSortValues[0]), info(m_wfSortValues[1])};
+    vk::DescriptorBufferInfo hits       = info(m_wfHits);
+    vk::DescriptorBufferInfo histograms = info(m_wfBlockHistograms);
+    vk::DescriptorBufferInfo state      = info(m_wfState);
+    vk::DescriptorBufferInfo radiance   = info(m_wfRadiance);
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.emplace_back(m_wfDescSetLayoutBind.makeWriteArray(m_wfDescSet, 0, rays.data()));
+    writes.emplace_back(m_wfDescSetLayoutBind.makeWrite(m_wfDescSet, 1, &hits));
+    writes.emplace_back(m_wfDescSetLayoutBind.makeWriteArray(m_wfDescSet, 2, keys.data()));
+    writes.emplace_back(m_wfDescSetLayoutBind.makeWriteArray(m_wfDescSet, 3, values.data()));
+    writes.emplace_back(m_wfDescSetLayoutBind.makeWrite(m_wfDescSet, 4, &histograms));
+    writes.emplace_back(m_wfDescSetLayoutBind.makeWrite(m_wfDescSet, 5, &state));
+    writes.emplace_back(m_wfDescSetLayoutBind.makeWrite(m_wfDescSet, 6, &radiance));
+    m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+// The compute passes and the extension pass share one layout: the sets of
+// the megakernel plus the queues, one set of push constants
+void Application::Impl::createWavefrontPipelines()
+{
+    using vkSS = vk::ShaderStageFlagBits;
+
+    vk::PushConstantRange pushConstant{vkSS::eCompute | vkSS::eRaygenKHR | vkSS::eClosestHitKHR | vkSS::eMissKHR, 0,
+                                       sizeof(WavefrontPushConstant)};
+    std::vector<vk::DescriptorSetLayout> layouts = {m_rtDescSetLayout, m_descSetLayout, m_wfDescSetLayout};
+    vk::PipelineLayoutCreateInfo layoutInfo{{}, static_cast<uint32_t>(layouts.size()), layouts.data(), 1, &pushConstant};
+    m_wfPipelineLayout = m_device.createPipelineLayout(layoutInfo);
+
+    m_wfCameraPipeline        = createWavefrontComputePipeline(ShaderPermutationKey("spv/wavefront_camera.comp.spv"));
+    m_wfArgsPipeline          = createWavefrontComputePipeline(ShaderPermutationKey("spv/wavefront_args.comp.spv"));
+    m_wfSortHistogramPipeline = createWavefrontComputePipeline(ShaderPermutationKey("spv/wavefront_sort_histogram.comp.spv"));
+    m_wfSortScanPipeline      = createWavefrontComputePipeline(ShaderPermutationKey("spv/wavefront_sort_scan.comp.spv"));
+    m_wfSortScatterPipeline   = createWavefrontComputePipeline(ShaderPermutationKey("spv/wavefront_sort_scatter.comp.spv"));
+    m_wfResolvePipeline       = createWavefrontComputePipeline(ShaderPermutationKey("spv/wavefront_resolve.comp.spv"));
+    createWavefrontShadePipelines();
+
+    // Extension pass: same hit groups as the megakernel, the hit shaders
+    // only record the hit
+    std::vector<vk::PipelineShaderStageCreateInfo>      stages;
+    std::vector<vk::RayTracingShaderGroupCreateInfoKHR> groups;
+
+    vk::RayTracingShaderGroupCreateInfoKHR group{vk::RayTracingShaderGroupTypeKHR::eGeneral,
+                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
+                                                 VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
+    // Raygen
+    group.setGeneralShader(static_cast<uint32_t>(stages.size()));
+    stages.push_back(m_shaderVariants.getStage(vkSS::eRaygenKHR, ShaderPermutationKey("spv/wavefront_extend.rgen.spv")));
+    groups.push_back(group);
+    // Miss
+    group.setGeneralShader(static_cast<uint32_t>(stages.size()));
+    stages.push_back(m_shaderVariants.getStage(vkSS::eMissKHR, ShaderPermutationKey("spv/wavefront.rmiss.spv")));
+    groups.push_back(group);
+    // HIT_GROUP_MESH
+    vk::RayTracingShaderGroupCreateInfoKHR hg{vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
+                                              VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
+                                              VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
+    hg.setClosestHitShader(static_cast<uint32_t>(stages.size()));
+    stages.push_back(m_shaderVariants.getStage(vkSS::eClosestHitKHR, ShaderPermutationKey("spv/wavefront_mesh.rchit.spv")));
+    groups.push_back(hg);
+    // HIT_GROUP_SPHERE of each material: the same shaders, the model is
+    // read from the sphere for the sort
+    hg = vk::RayTracingShaderGroupCreateInfoKHR{vk::RayTracingShaderGroupTypeKHR::eProceduralHitGroup,
+                                                VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
+                                                VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
+    hg.setClosestHitShader(static_cast<uint32_t>(stages.size()));
+    stages.push_back(m_shaderVariants.getStage(vkSS::eClosestHitKHR, ShaderPermutationKey("spv/wavefront_sphere.rchit.spv")));
+    hg.setIntersectionShader(static_cast<uint32_t>(stages.size()));
+    stages.push_back(m_shaderVariants.getStage(vkSS::eIntersectionKHR, ShaderPermutationKey("spv/raytrace.rint.spv")));
+    for (uint32_t material = 0; material < SPHERE_MATERIAL_COUNT; ++material) {
+        groups.push_back(hg);
+    }
+
+    vk::RayTracingPipelineCreateInfoKHR rayPipelineInfo;
+    rayPipelineInfo.setStageCount(static_cast<uint32_t>(stages.size()));
+    rayPipelineInfo.setPStages(stages.data());
+    rayPipelineInfo.setGroupCount(static_cast<uint32_t>(groups.size()));
+    rayPipelineInfo.setPGroups(groups.data());
+    rayPipelineInfo.setMaxPipelineRayRecursionDepth(1);  // The hit shaders trace no ray
+    rayPipelineInfo.setLayout(m_wfPipelineLayout);
+    m_wfExtendPipeline = static_cast<const vk::Pipeline&>(
+        m_device.createRayTracingPipelineKHR({}, {}, rayPipelineInfo).value);
+
+    m_wfSBTBuffer = createShaderBindingTable(m_wfExtendPipeline, static_cast<uint32_t>(groups.size()));
+}
+
+// One shading pipeline per model, SHADE_MODEL specialization constant. The
+// path depth is the one of the megakernel, they are recreated with it.
+void Application::Impl::createWavefrontShadePipelines()
+{
+    for (uint32_t model = 0; model < WAVEFRONT_MODEL_COUNT; ++model) {
+        m_device.destroy(m_wfShadePipelines[model]);
+        m_wfShadePipelines[model] = createWavefrontComputePipeline(
+            ShaderPermutationKey("spv/wavefront_shade.comp.spv")
+                .set(SHADER_CONSTANT_MATERIAL, model)
+                .set(SHADER_CONSTANT_MAX_PATH_DEPTH, static_cast<uint32_t>(m_maxPathDepth)));
+    }
+}
+
+vk::Pipeline Application::Impl::createWavefrontComputePipeline(const ShaderPermutationKey& key)
+{
+    vk::ComputePipelineCreateInfo computePipelineCreateInfo{{}, {}, m_wfPipelineLayout};
+    computePipelineCreateInfo.stage = m_shaderVariants.getStage(vk::ShaderStageFlagBits::eCompute, key);
+    return static_cast<const vk::Pipeline&>(m_device.createComputePipeline({}, computePipelineCreateInfo));
+}
+
+// Frame times of the megakernel and of the wavefront mode, for comparison
+void Application::Impl::createTraceTimings()
+{
+    // Two timestamps (begin, end) for each frame in flight
+    auto frameCount = getFramesInFlight();
+    m_traceTimingModes.assign(frameCount, TraceTiming::None);
+
+    vk::QueryPoolCreateInfo queryPoolInfo;
+    queryPoolInfo.setQueryType(vk::QueryType::eTimestamp);
+    queryPoolInfo.setQueryCount(2 * frameCount);
+    m_traceQueryPool = m_device.createQueryPool(queryPoolInfo);
+}
+
+void Application::Impl::destroyWavefrontBuffers()
+{
+    for (int i = 0; i < 2; ++i) {
+        m_alloc.destroy(m_wfRays[i]);
+        m_alloc.destroy(m_wfSortKeys[i]);
+        m_alloc.destroy(m_wfSortValues[i]);
+    }
+    m_alloc.destroy(m_wfHits);
+    m_alloc.destroy(m_wfBlockHistograms);
+    m_alloc.destroy(m_wfRadiance);
+    m_alloc.destroy(m_wfState);
+}
+
+void Application::Impl::destroyWavefront()
+{
+    m_device.destroy(m_wfCameraPipeline);
+    m_device.destroy(m_wfArgsPipeline);
+    m_device.destroy(m_wfSortHistogramPipeline);
+    m_device.destroy(m_wfSortScanPipeline);
+    m_device.destroy(m_wfSortScatterPipeline);
+    m_device.destroy(m_wfResolvePipeline);
+    for (auto& pipeline : m_wfShadePipelines) {
+        m_device.destroy(pipeline);
+    }
+    m_device.destroy(m_wfExtendPipeline);
+    m_alloc.destroy(m_wfSBTBuffer);
+    m_device.destroy(m_wfPipelineLayout);
+    m_device.destroy(m_wfDescPool);
+    m_device.destroy(m_wfDescSetLayout);
+    m_device.destroy(m_traceQueryPool);
+
+    destroyWavefrontBuffers();
+}
+
+void Application::Impl::renderWavefrontUI()
+{
+    if (!ImGui::CollapsingHeader("Wavefront")) {
+        return;
+    }
+
+    bool changed = false;
+    changed |= ImGui::Checkbox("Enabled##Wavefront", &m_wavefrontEnabled);
+    changed |= ImGui::SliderInt("Samples per Frame", &m_wavefrontSamplesPerFrame, 1, 8);
+
+    // Last traced frames of each mode, the tiled mode is not measured
+    const char* names[] = {"Megakernel", "Wavefront"};
+    for (int mode = 0; mode < 2; ++mode) {
+        const auto& timing = m_traceTimings[mode];
+        if (timing.ms > 0.f) {
+            ImGui::Text("%s: %.2f ms, %.1f Msamples/s", names[mode], timing.ms,
+                        timing.samples / (timing.ms * 1e3f));
+        } else {
+            ImGui::Text("%s: -", names[mode]);
+        }
+    }
+
+    if (changed) {
+        resetFrameId();
+    }
+}
+
+void Application::Impl::readTraceTimings(uint32_t frame)
+{
+    TraceTiming mode = m_traceTimingModes[frame];
+    if (mode == TraceTiming::None) {
+        return;
+    }
+
+    // The fence of this frame has been waited on in prepareFrame, results are available
+    std::array<uint64_t, 2> timestamps{};
+    vk::Result result = m_device.getQueryPoolResults(m_traceQueryPool, 2 * frame, 2, sizeof(timestamps),
+                                                     timestamps.data(), sizeof(uint64_t),
+                                                     vk::QueryResultFlagBits::e64);
+    if (result == vk::Result::eSuccess) {
+        auto& timing = m_traceTimings[static_cast<int>(mode)];
+        timing.ms    = static_cast<float>(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1e-6f;
+        timing.totalMs += timing.ms;
+        timing.totalSamples += timing.samples;
+        timing.frames++;
+    }
+
+    m_traceTimingModes[frame] = TraceTiming::None;
+}
+
+void Application::Impl::beginTraceTiming(const vk::CommandBuffer& cmdBuf, TraceTiming mode, float samples)
+{
+    uint32_t frame = getFrameInFlightIndex();
+    m_traceTimingModes[frame]                      = mode;
+    m_traceTimings[static_cast<int>(mode)].samples = samples;
+
+    cmdBuf.resetQueryPool(m_traceQueryPool, 2 * frame, 2);
+    cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_traceQueryPool, 2 * frame);
+}
+
+void Application::Impl::endTraceTiming(const vk::CommandBuffer& cmdBuf)
+{
+    cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_traceQueryPool, 2 * getFrameInFlightIndex() + 1);
+}
+
+// Paths of the whole image advanced one bounce at a time. Per sample of the
+// frame (wave): camera rays, then for each bounce the extension pass, the
+// sort of the hits by shading model and material and one shading dispatch
+// per model. The sizes of the sort and shading dispatches are only known on
+// the device, they are dispatched indirectly.
+void Application::Impl::rayTraceWavefront(const vk::CommandBuffer& cmdBuf)
+{
+    using vkPS = vk::PipelineStageFlagBits;
+    using vkAF = vk::AccessFlagBits;
+
+    auto& pc           = m_wfPushConstants;
+    pc.imageSize       = nvmath::vec2i(m_size.width, m_size.height);
+    pc.frame           = m_rtcurrentFrameId;
+    pc.sampleFrame     = m_rtPushConstants.sampleFrame;  // Advanced by rayTrace
+    pc.samplerType     = static_cast<int>(m_samplerType);
+    pc.samplesPerFrame = m_wavefrontSamplesPerFrame;
+    pc.accumulation    = m_rtPushConstants.accumulation;
+
+    const vk::ShaderStageFlags pcStages = vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eRaygenKHR
+                                          | vk::ShaderStageFlagBits::eClosestHitKHR
+                                          | vk::ShaderStageFlagBits::eMissKHR;
+    auto pushConstants = [&]() { cmdBuf.pushConstants<WavefrontPushConstant>(m_wfPipelineLayout, pcStages, 0, pc); };
+
+    // Each pass reads what the previous ones wrote, counters and indirect arguments included
+    auto barrier = [&]() {
+        vk::MemoryBarrier memBarrier{vkAF::eShaderWrite, vkAF::eShaderRead | vkAF::eShaderWrite | vkAF::eIndirectCommandRead};
+        cmdBuf.pipelineBarrier(vkPS::eComputeShader | vkPS::eRayTracingShaderKHR,
+                               vkPS::eComputeShader | vkPS::eRayTracingShaderKHR | vkPS::eDrawIndirect, {},
+                               {memBarrier}, {}, {});
+    };
+
+    std::vector<vk::DescriptorSet> sets = {m_rtDescSet, m_descSet, m_wfDescSet};
+    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_wfPipelineLayout, 0, sets, {});
+    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, m_wfPipelineLayout, 0, sets, {});
+
+    // raygen, miss, HIT_GROUP_COUNT hit groups
+    uint32_t groupSize = nvh::align_up(m_rtProperties.shaderGroupHandleSize, m_rtProperties.shaderGroupBaseAlignment);
+    vk::DeviceAddress sbtAddress = m_device.getBufferAddress({m_wfSBTBuffer.buffer});
+
+    using Stride = vk::StridedDeviceAddressRegionKHR;
+    std::array<Stride, 4> strideAddresses{
+        Stride{sbtAddress + 0u * groupSize, groupSize, groupSize * 1},                // raygen
+        Stride{sbtAddress + 1u * groupSize, groupSize, groupSize * 1},                // miss
+        Stride{sbtAddress + 2u * groupSize, groupSize, groupSize * HIT_GROUP_COUNT},  // hit
+        Stride{0u, 0u, 0u}};                                                          // callable
+
+    const uint32_t       imageGroupsX = divideUp(m_size.width, WAVEFRONT_IMAGE_GROUP_SIZE);
+    const uint32_t       imageGroupsY = divideUp(m_size.height, WAVEFRONT_IMAGE_GROUP_SIZE);
+    const vk::DeviceSize sortArgs     = offsetof(WavefrontState, sortArgs);
+    const vk::DeviceSize shadeArgs    = offsetof(WavefrontState, shadeArgs);
+    const uint32_t       sortPasses   = WavefrontSort::getPassCount(WAVEFRONT_SORT_KEY_BITS);
+
+    for (int wave = 0; wave < m_wavefrontSamplesPerFrame; ++wave) {
+        pc.wave     = wave;
+        pc.depth    = 0;
+        pc.sortPass = 0;
+        pushConstants();
+
+        cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_wfCameraPipeline);
+        cmdBuf.dispatch(imageGroupsX, imageGroupsY, 1);
+        barrier();
+
+        // The megakernel traces up to MAX_PATH_DEPTH bounces, the last one
+        // only gathers the sky
+        for (int depth = 0; depth <= m_maxPathDepth; ++depth) {
+            pc.depth    = depth;
+            pc.sortPass = 0;
+            pushConstants();
+
+            // The queue shrinks with the bounces, the raygen returns early
+            // past its size
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, m_wfExtendPipeline);
+            cmdBuf.traceRaysKHR(&strideAddresses[0], &strideAddresses[1], &strideAddresses[2], &strideAddresses[3],
+                                m_size.width, m_size.height, 1);
+            barrier();
+
+            cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_wfArgsPipeline);
+            cmdBuf.dispatch(1, 1, 1);
+            barrier();
+
+            for (uint32_t pass = 0; pass < sortPasses; ++pass) {
+                pc.sortPass = static_cast<int>(pass);
+                pushConstants();
+
+                cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_wfSortHistogramPipeline);
+                cmdBuf.dispatchIndirect(m_wfState.buffer, sortArgs);
+                barrier();
+                cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_wfSortScanPipeline);
+                cmdBuf.dispatch(1, 1, 1);
+                barrier();
+                cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_wfSortScatterPipeline);
+                cmdBuf.dispatchIndirect(m_wfState.buffer, sortArgs);
+                barrier();
+            }
+
+            // Models shade disjoint paths, only the ray counter is shared (atomic)
+            for (uint32_t model = 0; model < WAVEFRONT_MODEL_COUNT; ++model) {
+                cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_wfShadePipelines[model]);
+                cmdBuf.dispatchIndirect(m_wfState.buffer, shadeArgs + model * sizeof(vk::DispatchIndirectCommand));
+            }
+            barrier();
+        }
+    }
+
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_wfResolvePipeline);
+    cmdBuf.dispatch(imageGroupsX, imageGroupsY, 1);
+
+    // Accumulation and G-buffer are read by the denoiser or the post shader
+    vk::MemoryBarrier memBarrier{vkAF::eShaderWrite, vkAF::eShaderRead};
+    cmdBuf.pipelineBarrier(vkPS::eComputeShader, vkPS::eComputeShader | vkPS::eFragmentShader, {}, {memBarrier}, {}, {});
+}
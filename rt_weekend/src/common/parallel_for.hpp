@@ -0,0 +1,38 @@
+#ifndef PARALLEL_FOR_HPP
+#define PARALLEL_FOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Calls fct(i) for i in [0, count), items are distributed to the threads on
+// demand. numThreads = 0 uses all the cores, the calling thread is one of them.
+inline void parallelFor(uint32_t count, uint32_t numThreads, const std::function<void(uint32_t)>& fct)
+{
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    numThreads = std::min(numThreads, count);
+
+    std::atomic<uint32_t> next{0};
+    auto worker = [&]() {
+        for (uint32_t i = next++; i < count; i = next++) {
+            fct(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < numThreads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+
+#endif
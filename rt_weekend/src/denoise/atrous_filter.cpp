@@ -0,0 +1,336 @@
+#include "atrous_filter.hpp"
+#include "../render/accumulation.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+// Must match shaders/denoise_common.glsl
+static constexpr float ALBEDO_EPSILON = 1e-3f;
+static constexpr float DEPTH_EPSILON  = 1e-3f;
+static constexpr float LUM_EPSILON    = 1e-4f;
+
+// B3-spline coefficients, indexed by |offset|
+static constexpr float KERNEL[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+
+// Difference to the GPU output above which a pixel is counted as an outlier,
+// relative to its value, about 10 ulps of a half float. The reference rounds
+// its intermediates like the GPU, only the float arithmetic differs: an ulp
+// of difference in an intermediate, amplified by the edge-stopping weights
+// where the luminance changes sharply, makes the few outliers.
+static constexpr float  DUMP_PIXEL_TOLERANCE   = 0.005f;
+static constexpr double DUMP_OUTLIER_TOLERANCE = 0.0005;
+
+// -----------------------
+// PFM I/O
+// -----------------------
+
+static bool readPfmChannels(const std::string& filename, uint32_t& width, uint32_t& height, int& channels, std::vector<float>& data)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char  type[3] = {};
+    int   w = 0, h = 0;
+    float scale = 0.0f;
+    bool  valid = fscanf(file, "%2s %d %d %f", type, &w, &h, &scale) == 4 && w > 0 && h > 0 && scale < 0.0f;
+    valid &= fgetc(file) != EOF;  // Single whitespace before the data
+
+    if (valid && (strcmp(type, "PF") == 0 || strcmp(type, "Pf") == 0)) {
+        channels = (type[1] == 'F') ? 3 : 1;
+        width    = static_cast<uint32_t>(w);
+        height   = static_cast<uint32_t>(h);
+        data.resize(size_t(w) * h * channels);
+        valid = fread(data.data(), sizeof(float), data.size(), file) == data.size();
+    } else {
+        valid = false;
+    }
+
+    fclose(file);
+    return valid;
+}
+
+static bool writePfmChannels(const std::string& filename, const FloatImage& image, int channels, int firstChannel)
+{
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    // Negative scale: little endian. Rows are stored bottom to top.
+    fprintf(file, "%s\n%u %u\n-1.0\n", channels == 3 ? "PF" : "Pf", image.width, image.height);
+
+    std::vector<float> row(size_t(image.width) * channels);
+    bool               valid = true;
+    for (int y = int(image.height) - 1; y >= 0 && valid; --y) {
+        for (int x = 0; x < int(image.width); ++x) {
+            for (int c = 0; c < channels; ++c) {
+                row[size_t(x) * channels + c] = image.at(x, y)[firstChannel + c];
+            }
+        }
+        valid = fwrite(row.data(), sizeof(float), row.size(), file) == row.size();
+    }
+
+    fclose(file);
+    return valid;
+}
+
+bool FloatImage::loadPfm(const std::string& filename)
+{
+    uint32_t           w, h, aw, ah;
+    int                channels, alphaChannels;
+    std::vector<float> rgb, alpha;
+
+    if (!readPfmChannels(filename, w, h, channels, rgb) || channels != 3) {
+        return false;
+    }
+
+    bool hasAlpha = readPfmChannels(filename + ".alpha.pfm", aw, ah, alphaChannels, alpha) && aw == w && ah == h
+                    && alphaChannels == 1;
+
+    *this = FloatImage(w, h);
+    for (uint32_t y = 0; y < h; ++y) {
+        for (uint32_t x = 0; x < w; ++x) {
+            size_t src = size_t(h - 1 - y) * w + x;
+            at(x, y)   = nvmath::vec4f(rgb[3 * src + 0], rgb[3 * src + 1], rgb[3 * src + 2], hasAlpha ? alpha[src] : 1.0f);
+        }
+    }
+
+    return true;
+}
+
+bool FloatImage::savePfm(const std::string& filename) const
+{
+    return writePfmChannels(filename, *this, 3, 0) && writePfmChannels(filename + ".alpha.pfm", *this, 1, 3);
+}
+
+// -----------------------
+// Dump
+// -----------------------
+
+static std::string getDumpFilename(const std::string& directory, const char* name)
+{
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool AtrousDump::load(const std::string& directory)
+{
+    FILE* file = fopen(getDumpFilename(directory, "atrous.txt").c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+    bool valid = fscanf(file, "iterations %d sigmaLuminance %f sigmaNormal %f sigmaDepth %f", &settings.iterations,
+                        &settings.sigmaLuminance, &settings.sigmaNormal, &settings.sigmaDepth)
+                 == 4;
+    fclose(file);
+
+    valid = valid && colorVariance.loadPfm(getDumpFilename(directory, "color_variance.pfm"))
+            && normalDepth.loadPfm(getDumpFilename(directory, "normal_depth.pfm"))
+            && albedo.loadPfm(getDumpFilename(directory, "albedo.pfm"))
+            && denoised.loadPfm(getDumpFilename(directory, "denoised.pfm"));
+    if (!valid) {
+        return false;
+    }
+
+    for (const FloatImage* image : {&normalDepth, &albedo, &denoised}) {
+        if (image->width != colorVariance.width || image->height != colorVariance.height) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AtrousDump::save(const std::string& directory) const
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    FILE* file = fopen(getDumpFilename(directory, "atrous.txt").c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "iterations %d\nsigmaLuminance %.9g\nsigmaNormal %.9g\nsigmaDepth %.9g\n", settings.iterations,
+            settings.sigmaLuminance, settings.sigmaNormal, settings.sigmaDepth);
+    fclose(file);
+
+    return colorVariance.savePfm(getDumpFilename(directory, "color_variance.pfm"))
+           && normalDepth.savePfm(getDumpFilename(directory, "normal_depth.pfm"))
+           && albedo.savePfm(getDumpFilename(directory, "albedo.pfm"))
+           && denoised.savePfm(getDumpFilename(directory, "denoised.pfm"));
+}
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+float AtrousFilter::luminance(const nvmath::vec3f& color)
+{
+    return nvmath::dot(color, nvmath::vec3f(0.2126f, 0.7152f, 0.0722f));
+}
+
+FloatImage AtrousFilter::apply(const FloatImage& colorVariance, const FloatImage& normalDepth, const FloatImage& albedo) const
+{
+    FloatImage ping = colorVariance;
+    FloatImage pong(colorVariance.width, colorVariance.height);
+
+    for (int i = 0; i < _settings.iterations; ++i) {
+        iterate(ping, normalDepth, i, pong);
+        std::swap(ping, pong);
+
+        // Stored in the RGBA16F ping images between the GPU iterations
+        if (i + 1 < _settings.iterations) {
+            for (auto& pixel : ping.pixels) {
+                pixel = nvmath::vec4f(roundToHalf(pixel.x), roundToHalf(pixel.y), roundToHalf(pixel.z),
+                                      roundToHalf(pixel.w));
+            }
+        }
+    }
+
+    // Remodulation by the albedo, as done by the last GPU iteration before
+    // writing the RGBA16F output
+    FloatImage result(ping.width, ping.height);
+    for (size_t i = 0; i < ping.pixels.size(); ++i) {
+        const auto& a = albedo.pixels[i];
+        nvmath::vec3f color(roundToHalf(ping.pixels[i].x * std::max(a.x, ALBEDO_EPSILON)),
+                            roundToHalf(ping.pixels[i].y * std::max(a.y, ALBEDO_EPSILON)),
+                            roundToHalf(ping.pixels[i].z * std::max(a.z, ALBEDO_EPSILON)));
+        result.pixels[i] = nvmath::vec4f(color, 1.0f);
+    }
+
+    return result;
+}
+
+void AtrousFilter::iterate(const FloatImage& input, const FloatImage& normalDepth, int iteration, FloatImage& output) const
+{
+    const int step = 1 << iteration;
+
+    for (int y = 0; y < int(input.height); ++y) {
+        for (int x = 0; x < int(input.width); ++x) {
+            const nvmath::vec4f& center = input.at(x, y);
+            const nvmath::vec4f& nd     = normalDepth.at(x, y);
+
+            // Nothing to filter on the background
+            if (nd.w <= 0.0f) {
+                output.at(x, y) = center;
+                continue;
+            }
+
+            nvmath::vec3f normal(nd.x, nd.y, nd.z);
+            float         lumCenter = luminance(nvmath::vec3f(center));
+            float         lumScale  = 1.0f / (_settings.sigmaLuminance * std::sqrt(filteredVariance(input, x, y)) + LUM_EPSILON);
+            float         gradient  = depthGradient(normalDepth, x, y);
+
+            float         centerWeight = KERNEL[0] * KERNEL[0];
+            nvmath::vec3f colorSum     = nvmath::vec3f(center) * centerWeight;
+            float         varianceSum  = center.w * centerWeight * centerWeight;
+            float         weightSum    = centerWeight;
+
+            for (int dy = -2; dy <= 2; ++dy) {
+                for (int dx = -2; dx <= 2; ++dx) {
+                    int qx = x + dx * step;
+                    int qy = y + dy * step;
+                    if ((dx == 0 && dy == 0) || !input.inside(qx, qy)) {
+                        continue;
+                    }
+
+                    const nvmath::vec4f& sample = input.at(qx, qy);
+                    const nvmath::vec4f& ndq    = normalDepth.at(qx, qy);
+                    if (ndq.w <= 0.0f) {
+                        continue;
+                    }
+
+                    float distance = step * std::sqrt(float(dx * dx + dy * dy));
+                    float wDepth   = std::exp(-std::fabs(nd.w - ndq.w) / (_settings.sigmaDepth * gradient * distance + DEPTH_EPSILON));
+                    float wNormal  = std::pow(std::max(0.0f, nvmath::dot(normal, nvmath::vec3f(ndq.x, ndq.y, ndq.z))), _settings.sigmaNormal);
+                    float wLum     = std::exp(-std::fabs(lumCenter - luminance(nvmath::vec3f(sample))) * lumScale);
+                    float weight   = KERNEL[std::abs(dx)] * KERNEL[std::abs(dy)] * wDepth * wNormal * wLum;
+
+                    colorSum += nvmath::vec3f(sample) * weight;
+                    varianceSum += sample.w * weight * weight;
+                    weightSum += weight;
+                }
+            }
+
+            output.at(x, y) = nvmath::vec4f(colorSum / weightSum, varianceSum / (weightSum * weightSum));
+        }
+    }
+}
+
+// -----------------------
+// Private Methods
+// -----------------------
+
+float AtrousFilter::filteredVariance(const FloatImage& input, int x, int y) const
+{
+    // 3x3 gaussian, reduces the noise of the variance estimate itself
+    static constexpr float gaussian[2] = {1.0f / 4.0f, 1.0f / 8.0f};
+
+    float sum       = 0.0f;
+    float weightSum = 0.0f;
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            if (input.inside(x + dx, y + dy)) {
+                float w = gaussian[std::abs(dx)] * gaussian[std::abs(dy)] * 4.0f;
+                sum += input.at(x + dx, y + dy).w * w;
+                weightSum += w;
+            }
+        }
+    }
+
+    return std::max(0.0f, sum / weightSum);
+}
+
+float AtrousFilter::depthGradient(const FloatImage& normalDepth, int x, int y) const
+{
+    auto depthAt = [&](int px, int py) {
+        px = std::clamp(px, 0, int(normalDepth.width) - 1);
+        py = std::clamp(py, 0, int(normalDepth.height) - 1);
+        float d = normalDepth.at(px, py).w;
+        return d > 0.0f ? d : normalDepth.at(x, y).w;
+    };
+
+    float dzdx = 0.5f * std::fabs(depthAt(x + 1, y) - depthAt(x - 1, y));
+    float dzdy = 0.5f * std::fabs(depthAt(x, y + 1) - depthAt(x, y - 1));
+    return std::max(dzdx, dzdy);
+}
+
+// -----------------------
+// Public Functions
+// -----------------------
+
+bool checkAtrousDump(const AtrousDump& dump)
+{
+    AtrousFilter filter(dump.settings);
+    FloatImage   result = filter.apply(dump.colorVariance, dump.normalDepth, dump.albedo);
+
+    double errorSum   = 0.0;
+    float  errorMax   = 0.0f;
+    size_t nbOutliers = 0;
+    for (size_t i = 0; i < result.pixels.size(); ++i) {
+        float error = 0.0f;
+        for (int c = 0; c < 3; ++c) {
+            float expected = dump.denoised.pixels[i][c];
+            error = std::max(error, std::fabs(result.pixels[i][c] - expected) / std::max(std::fabs(expected), 1e-2f));
+        }
+        // NaN on either side is an outlier
+        if (!(error <= DUMP_PIXEL_TOLERANCE)) {
+            ++nbOutliers;
+        }
+        if (error == error) {
+            errorSum += error;
+            errorMax = std::max(errorMax, error);
+        }
+    }
+
+    size_t nbPixels = std::max<size_t>(result.pixels.size(), 1);
+    double outliers = double(nbOutliers) / nbPixels;
+    bool   ok       = outliers <= DUMP_OUTLIER_TOLERANCE;
+    LOGI("A-trous: %ux%u, %d iterations, mean error %.2e, max %.2e, %.3f%% outliers\n", result.width, result.height,
+         dump.settings.iterations, errorSum / nbPixels, errorMax, 100.0 * outliers);
+    LOGI("A-trous: %s\n", ok ? "OK" : "FAILED");
+    return ok;
+}
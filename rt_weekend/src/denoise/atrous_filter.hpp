@@ -0,0 +1,81 @@
+#ifndef ATROUS_FILTER_HPP
+#define ATROUS_FILTER_HPP
+
+#include <nvmath/nvmath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU reference of the edge-aware A-trous wavelet filter run by
+// shaders/denoise_atrous.comp. Both must be kept in sync: the CPU version is
+// meant to be run on buffers saved from the GPU to check for regressions, and
+// rounds its intermediates and output to half floats like the RGBA16F images
+// of the GPU.
+
+// Float RGBA image, row-major, (0, 0) is the top-left pixel
+struct FloatImage {
+    uint32_t                   width{0};
+    uint32_t                   height{0};
+    std::vector<nvmath::vec4f> pixels;
+
+    FloatImage() = default;
+    FloatImage(uint32_t w, uint32_t h) : width(w), height(h), pixels(size_t(w) * h, nvmath::vec4f(0.0f)) {}
+
+    nvmath::vec4f&       at(int x, int y) { return pixels[size_t(y) * width + x]; }
+    const nvmath::vec4f& at(int x, int y) const { return pixels[size_t(y) * width + x]; }
+    bool                 inside(int x, int y) const { return x >= 0 && y >= 0 && x < int(width) && y < int(height); }
+
+    // Portable float map (PF, little endian), alpha is written as a separate
+    // "<name>.alpha.pfm" file since PFM only stores RGB
+    bool loadPfm(const std::string& filename);
+    bool savePfm(const std::string& filename) const;
+};
+
+struct AtrousSettings {
+    int   iterations{5};
+    float sigmaLuminance{4.0f};
+    float sigmaNormal{128.0f};
+    float sigmaDepth{1.0f};
+};
+
+class AtrousFilter {
+public:
+    explicit AtrousFilter(const AtrousSettings& settings = AtrousSettings()) : _settings(settings) {}
+
+    // colorVariance: demodulated radiance in rgb, luminance variance in a
+    // normalDepth:   world normal in xyz, primary hit distance in w (<= 0 on miss)
+    // albedo:        used to remodulate the result of the last iteration
+    FloatImage apply(const FloatImage& colorVariance, const FloatImage& normalDepth, const FloatImage& albedo) const;
+
+    // One iteration with a footprint of 5x5 taps spaced by 2^iteration pixels
+    void iterate(const FloatImage& input, const FloatImage& normalDepth, int iteration, FloatImage& output) const;
+
+    static float luminance(const nvmath::vec3f& color);
+
+private:
+    float filteredVariance(const FloatImage& input, int x, int y) const;
+    float depthGradient(const FloatImage& normalDepth, int x, int y) const;
+
+    AtrousSettings _settings;
+};
+
+// Inputs and output of the GPU filter for one frame, read back by the headless
+// mode with -denoisedump. Saved as PFM files in a directory, with the settings
+// in a text file.
+struct AtrousDump {
+    AtrousSettings settings;
+    FloatImage     colorVariance;  // Written by the temporal pass, input of the first iteration
+    FloatImage     normalDepth;
+    FloatImage     albedo;
+    FloatImage     denoised;
+
+    bool load(const std::string& directory);
+    bool save(const std::string& directory) const;
+};
+
+// Runs the CPU filter on the inputs of the dump and compares it to the GPU
+// output, up to the differences of float arithmetic between them
+bool checkAtrousDump(const AtrousDump& dump);
+
+
+#endif
@@ -0,0 +1,273 @@
+#include "reprojection.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Must match shaders/reprojection.glsl
+static constexpr float DEPTH_TOLERANCE  = 0.05f;
+static constexpr float NORMAL_TOLERANCE = 0.9f;
+// Must match shaders/raytrace.rgen
+static constexpr float MIN_FOOTPRINT = 1e-3f;
+
+// -----------------------
+// Helpers
+// -----------------------
+
+namespace {
+
+// Plane y = 0 and a unit sphere resting on it, seen from above
+struct SyntheticScene {
+    nvmath::vec3f sphereCenter{0.0f, 1.0f, 0.0f};
+
+    // Distance along the unit direction, 0 on miss; `normal` of the hit
+    float intersect(const nvmath::vec3f& origin, const nvmath::vec3f& direction, nvmath::vec3f& normal) const
+    {
+        float         hitT = 0.0f;
+        nvmath::vec3f oc   = origin - sphereCenter;
+        float         b    = nvmath::dot(oc, direction);
+        float         disc = b * b - (nvmath::dot(oc, oc) - 1.0f);
+        if (disc >= 0.0f && -b - std::sqrt(disc) > 0.0f) {
+            hitT   = -b - std::sqrt(disc);
+            normal = nvmath::normalize(origin + direction * hitT - sphereCenter);
+        }
+
+        if (direction.y < 0.0f) {
+            float planeT = -origin.y / direction.y;
+            if (hitT == 0.0f || planeT < hitT) {
+                hitT   = planeT;
+                normal = nvmath::vec3f(0.0f, 1.0f, 0.0f);
+            }
+        }
+        return hitT;
+    }
+
+    // Smooth radiance, so that interpolated histories can be compared
+    nvmath::vec3f radiance(const nvmath::vec3f& pos) const
+    {
+        return nvmath::vec3f(0.5f + 0.25f * std::sin(pos.x), 0.5f + 0.25f * std::cos(pos.z), 0.5f + 0.1f * pos.y);
+    }
+};
+
+// Primary hits of the first sample in raytrace.rgen, jittered with `seed`,
+// and the radiance of the pixel centers accumulated over `frames` frames
+void traceSynthetic(const SyntheticScene& scene, const ReprojectionCamera& camera, float frames, uint32_t seed,
+                    FloatImage& normalDepth, FloatImage& accum)
+{
+    std::mt19937                          rng(seed);
+    std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+
+    const nvmath::vec2f size(float(normalDepth.width), float(normalDepth.height));
+    const nvmath::vec3f origin = cameraPosition(camera.view);
+    for (int y = 0; y < int(normalDepth.height); ++y) {
+        for (int x = 0; x < int(normalDepth.width); ++x) {
+            nvmath::vec2f pixel  = nvmath::vec2f(float(x), float(y));
+            nvmath::vec2f sample = pixel + nvmath::vec2f(jitter(rng), jitter(rng));
+            nvmath::vec3f direction = reconstructWorldPosition(sample, size, 1.0f, camera) - origin;
+
+            nvmath::vec3f normal(0.0f);
+            float         hitT = scene.intersect(origin, direction, normal);
+            if (hitT > 0.0f) {
+                hitT = pixelCenterHitT(pixel, size, origin + direction * hitT, normal, camera);
+            }
+            normalDepth.at(x, y) = nvmath::vec4f(normal, hitT > 0.0f ? hitT : -1.0f);
+
+            nvmath::vec3f center = reconstructWorldPosition(pixel, size, 1.0f, camera) - origin;
+            nvmath::vec3f centerNormal;
+            float         centerT = scene.intersect(origin, center, centerNormal);
+            nvmath::vec3f radiance = centerT > 0.0f ? scene.radiance(origin + center * centerT) : nvmath::vec3f(0.0f);
+            accum.at(x, y)         = nvmath::vec4f(radiance, frames);
+        }
+    }
+}
+
+}  // namespace
+
+// -----------------------
+// Public Functions
+// -----------------------
+
+nvmath::vec3f reconstructWorldPosition(const nvmath::vec2f& pixel, const nvmath::vec2f& size, float hitT,
+                                       const ReprojectionCamera& camera)
+{
+    nvmath::vec2f d((pixel.x + 0.5f) / size.x * 2.0f - 1.0f, (pixel.y + 0.5f) / size.y * 2.0f - 1.0f);
+
+    nvmath::vec4f origin    = camera.viewInverse * nvmath::vec4f(0.0f, 0.0f, 0.0f, 1.0f);
+    nvmath::vec4f target    = camera.projInverse * nvmath::vec4f(d.x, d.y, 1.0f, 1.0f);
+    nvmath::vec4f direction = camera.viewInverse * nvmath::vec4f(nvmath::normalize(nvmath::vec3f(target)), 0.0f);
+
+    return nvmath::vec3f(origin) + nvmath::vec3f(direction) * hitT;
+}
+
+float pixelCenterHitT(const nvmath::vec2f& pixel, const nvmath::vec2f& size, const nvmath::vec3f& hitPos,
+                      const nvmath::vec3f& normal, const ReprojectionCamera& camera)
+{
+    nvmath::vec3f origin    = cameraPosition(camera.view);
+    nvmath::vec3f direction = reconstructWorldPosition(pixel, size, 1.0f, camera) - origin;
+    float         hitT      = nvmath::length(hitPos - origin);
+    float         cosine    = nvmath::dot(direction, normal);
+    float         centerT   = std::abs(cosine) > 1e-6f ? nvmath::dot(hitPos - origin, normal) / cosine : -1.0f;
+    return (centerT > 0.5f * hitT && centerT < 2.0f * hitT) ? centerT : hitT;
+}
+
+nvmath::vec3f cameraPosition(const nvmath::mat4f& view)
+{
+    nvmath::mat3f rotation = view.get_rot_mat3();
+    nvmath::vec3f translation(view.a03, view.a13, view.a23);
+    return -(nvmath::transpose(rotation) * translation);
+}
+
+bool projectToPixel(const nvmath::vec3f& worldPos, const ReprojectionCamera& camera, const nvmath::vec2f& size,
+                    nvmath::vec2f& pixel)
+{
+    nvmath::vec4f clip = camera.proj * (camera.view * nvmath::vec4f(worldPos, 1.0f));
+    if (clip.w <= 0.0f) {
+        return false;
+    }
+
+    pixel.x = (clip.x / clip.w * 0.5f + 0.5f) * size.x - 0.5f;
+    pixel.y = (clip.y / clip.w * 0.5f + 0.5f) * size.y - 0.5f;
+    return true;
+}
+
+bool isHistoryConsistent(const nvmath::vec3f& normal, float expectedHitT, const nvmath::vec4f& prevNormalDepth)
+{
+    if (prevNormalDepth.w <= 0.0f) {
+        return false;
+    }
+
+    bool sameDepth  = std::abs(prevNormalDepth.w - expectedHitT) <= DEPTH_TOLERANCE * expectedHitT;
+    bool sameNormal = nvmath::dot(normal, nvmath::vec3f(prevNormalDepth)) >= NORMAL_TOLERANCE;
+    return sameDepth && sameNormal;
+}
+
+FloatImage reprojectAccumulation(const FloatImage& prevAccum, const FloatImage& prevNormalDepth,
+                                 const ReprojectionCamera& prevCamera, const FloatImage& normalDepth,
+                                 const ReprojectionCamera& camera)
+{
+    FloatImage          output(normalDepth.width, normalDepth.height);
+    const nvmath::vec2f size(float(normalDepth.width), float(normalDepth.height));
+
+    for (int y = 0; y < int(output.height); ++y) {
+        for (int x = 0; x < int(output.width); ++x) {
+            const nvmath::vec4f& current = normalDepth.at(x, y);
+            if (current.w <= 0.0f) {
+                continue;
+            }
+
+            nvmath::vec3f worldPos = reconstructWorldPosition(nvmath::vec2f(float(x), float(y)), size, current.w, camera);
+            nvmath::vec2f prevPixel;
+            if (!projectToPixel(worldPos, prevCamera, size, prevPixel)) {
+                continue;
+            }
+
+            nvmath::vec3f normal       = nvmath::vec3f(current);
+            float         expectedHitT = nvmath::length(worldPos - cameraPosition(prevCamera.view));
+
+            int   baseX = int(std::floor(prevPixel.x));
+            int   baseY = int(std::floor(prevPixel.y));
+            float fx    = prevPixel.x - float(baseX);
+            float fy    = prevPixel.y - float(baseY);
+
+            nvmath::vec4f sum(0.0f);
+            float         weightSum = 0.0f;
+            for (int i = 0; i < 4; ++i) {
+                int qx = baseX + (i & 1);
+                int qy = baseY + (i >> 1);
+                if (!prevAccum.inside(qx, qy) || !isHistoryConsistent(normal, expectedHitT, prevNormalDepth.at(qx, qy))) {
+                    continue;
+                }
+
+                float w = ((i & 1) ? fx : 1.0f - fx) * ((i >> 1) ? fy : 1.0f - fy);
+                sum += prevAccum.at(qx, qy) * w;
+                weightSum += w;
+            }
+
+            if (weightSum < MIN_FOOTPRINT) {
+                continue;
+            }
+
+            nvmath::vec4f history = sum / weightSum;
+            history.w *= weightSum;
+            output.at(x, y) = history;
+        }
+    }
+
+    return output;
+}
+
+bool checkReprojection()
+{
+    bool ok = true;
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition) {
+            LOGE("Reprojection: %s\n", what);
+            ok = false;
+        }
+    };
+
+    const uint32_t width  = 320;
+    const uint32_t height = 180;
+    const float    frames = 16.0f;
+
+    SyntheticScene     scene;
+    nvmath::mat4f      proj = nvmath::perspectiveVK(45.0f, float(width) / float(height), 0.1f, 1000.0f);
+    nvmath::vec3f      eye(0.0f, 2.0f, 6.0f);
+    nvmath::vec3f      center(0.0f, 0.5f, 0.0f);
+    nvmath::vec3f      up(0.0f, 1.0f, 0.0f);
+    ReprojectionCamera prevCamera(nvmath::look_at(eye, center, up), proj);
+
+    FloatImage prevNormalDepth(width, height), prevAccum(width, height);
+    traceSynthetic(scene, prevCamera, frames, 1, prevNormalDepth, prevAccum);
+
+    // Returns the fraction of the hit pixels keeping a history, the fraction
+    // of those whose radiance is not the one of their surface, and the number
+    // of pixels dropped though both G-buffers agree on the surface of the pixel
+    auto reproject = [&](const ReprojectionCamera& camera, double& wrong, size_t& nbDropped) {
+        FloatImage normalDepth(width, height), accum(width, height);
+        traceSynthetic(scene, camera, frames, 2, normalDepth, accum);
+        FloatImage history = reprojectAccumulation(prevAccum, prevNormalDepth, prevCamera, normalDepth, camera);
+
+        size_t nbHits = 0, nbKept = 0, nbWrong = 0;
+        nbDropped     = 0;
+        for (size_t i = 0; i < history.pixels.size(); ++i) {
+            if (normalDepth.pixels[i].w <= 0.0f) {
+                continue;
+            }
+            ++nbHits;
+            nbDropped += history.pixels[i].w <= 0.0f
+                         && isHistoryConsistent(nvmath::vec3f(normalDepth.pixels[i]), normalDepth.pixels[i].w,
+                                                prevNormalDepth.pixels[i]);
+            if (history.pixels[i].w > 0.0f) {
+                ++nbKept;
+                nvmath::vec3f error = nvmath::vec3f(history.pixels[i]) - nvmath::vec3f(accum.pixels[i]);
+                nbWrong += nvmath::length(error) > 0.05f;
+            }
+        }
+        wrong = double(nbWrong) / double(std::max<size_t>(nbKept, 1));
+        return double(nbKept) / double(std::max<size_t>(nbHits, 1));
+    };
+
+    // Still camera: the history is returned as is, but on the silhouettes
+    // where the jittered samples of the two frames hit different surfaces
+    double wrong;
+    size_t nbDropped;
+    double still = reproject(prevCamera, wrong, nbDropped);
+    expect(nbDropped == 0 && still >= 0.99 && wrong == 0.0, "still camera changes the history");
+
+    // 0.3 unit sideways move: only the band uncovered by the sphere and the
+    // border entering the view are disoccluded
+    nvmath::vec3f      side(0.3f, 0.0f, 0.0f);
+    ReprojectionCamera movedCamera(nvmath::look_at(eye + side, center + side, up), proj);
+    double             movedWrong;
+    double             moved = reproject(movedCamera, movedWrong, nbDropped);
+    expect(moved >= 0.95, "sideways move keeps less than 95% of the hit pixels");
+
+    // Bilinear taps across a silhouette passing the depth and normal tests
+    expect(wrong < 0.01 && movedWrong < 0.01, "reprojected radiance differs from the surface");
+
+    LOGI("Reprojection: kept %.2f%% still (%.2f%% wrong), %.2f%% after a 0.3 sideways move (%.2f%% wrong)\n",
+         100.0 * still, 100.0 * wrong, 100.0 * moved, 100.0 * movedWrong);
+    LOGI("Reprojection: %s\n", ok ? "OK" : "FAILED");
+    return ok;
+}
@@ -0,0 +1,63 @@
+#ifndef REPROJECTION_HPP
+#define REPROJECTION_HPP
+
+#include "atrous_filter.hpp"
+#include <nvmath/nvmath.h>
+
+// CPU mirror of shaders/reprojection.glsl and of the accumulation
+// reprojection done in shaders/raytrace.rgen. Both must be kept in sync.
+//
+// The G-buffer is written by the first sample of each frame, which is
+// jittered like the others. Its distance is moved to the pixel center by
+// pixelCenterHitT(): the jittered hit is up to half a pixel away, on a plane
+// seen at a grazing angle its distance leaves the depth tolerance and a still
+// camera would drop a few percent of its history.
+
+struct ReprojectionCamera {
+    nvmath::mat4f view;
+    nvmath::mat4f proj;
+    nvmath::mat4f viewInverse;
+    nvmath::mat4f projInverse;
+
+    ReprojectionCamera() = default;
+    ReprojectionCamera(const nvmath::mat4f& v, const nvmath::mat4f& p)
+        : view(v), proj(p), viewInverse(nvmath::invert(v)), projInverse(nvmath::invert(p)) {}
+};
+
+// World position of the primary hit of `pixel`, at `hitT` along the ray
+nvmath::vec3f reconstructWorldPosition(const nvmath::vec2f& pixel, const nvmath::vec2f& size, float hitT,
+                                       const ReprojectionCamera& camera);
+
+// Reprojection of the analytic G-buffers of a plane and a sphere, traced with
+// jittered rays, for a still and a sideways moving camera, without device
+bool checkReprojection();
+
+// Distance stored in the G-buffer for the primary hit of a jittered ray, at
+// `hitPos` with `normal`: where the ray through the center of `pixel` meets
+// the tangent plane of the hit, the jittered distance when it grazes it
+float pixelCenterHitT(const nvmath::vec2f& pixel, const nvmath::vec2f& size, const nvmath::vec3f& hitPos,
+                      const nvmath::vec3f& normal, const ReprojectionCamera& camera);
+
+// Camera position of a rigid view matrix
+nvmath::vec3f cameraPosition(const nvmath::mat4f& view);
+
+// Continuous pixel coordinates of `worldPos` seen from `camera`, returns
+// false when the point is behind it
+bool projectToPixel(const nvmath::vec3f& worldPos, const ReprojectionCamera& camera, const nvmath::vec2f& size,
+                    nvmath::vec2f& pixel);
+
+// Disocclusion test between the current surface and a history sample
+bool isHistoryConsistent(const nvmath::vec3f& normal, float expectedHitT, const nvmath::vec4f& prevNormalDepth);
+
+// Reprojects the accumulation of `prevCamera` (color in rgb, frame count in
+// a) onto the surfaces seen by `camera`. Pixels with no consistent history
+// get a frame count of 0.
+//   prevAccum:       accumulation image of the previous camera
+//   prevNormalDepth: its G-buffer, world normal in xyz and hit distance in w
+//   normalDepth:     G-buffer of the current camera
+FloatImage reprojectAccumulation(const FloatImage& prevAccum, const FloatImage& prevNormalDepth,
+                                 const ReprojectionCamera& prevCamera, const FloatImage& normalDepth,
+                                 const ReprojectionCamera& camera);
+
+
+#endif
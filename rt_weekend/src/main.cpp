@@ -1,14 +1,292 @@
 #include "application.hpp"
+#include "denoise/atrous_filter.hpp"
+#include "denoise/reprojection.hpp"
+#include "primitive/sphere_set.hpp"
+#include "render/accumulation.hpp"
+#include "render/accumulation_checkpoint.hpp"
+#include "render/image_writer.hpp"
+#include "render/shader_permutations.hpp"
+#include "render/slot_allocator.hpp"
+#include "render/tile_scheduler.hpp"
+#include "render/tone_mapping.hpp"
+#include "render/wavefront_sort.hpp"
+#include "sampling/environment.hpp"
+#include "sampling/sampler.hpp"
+#include "scene/csf_scene.hpp"
+#include "texture/texture_processor.hpp"
+#include "texture/virtual_texture.hpp"
+#include "fileformats/stb_image.h"
+#include <algorithm>
+#include <nvh/inputparser.h>
 #include <iostream>
 
-int main() {
+int main(int argc, char** argv) {
+    InputParser parser(argc, argv);
+    std::string csfFilename = parser.getString("-csf");
+
+    TextureSettings textureSettings;
+    if (parser.exist("-bc1")) {
+        textureSettings.compression = TextureCompression::Bc1;
+    } else if (parser.exist("-bc7")) {
+        textureSettings.compression = TextureCompression::Bc7;
+    }
+    if (parser.exist("-box")) {
+        textureSettings.filter = MipFilter::Box;
+    }
+    textureSettings.numThreads = static_cast<uint32_t>(std::max(0, parser.getInt("-threads")));
+
+    VirtualTextureSettings vtSettings;
+    vtSettings.enabled = parser.exist("-vt");
+    if (parser.exist("-vtpages")) {
+        vtSettings.residency.nbPhysicalPages = static_cast<uint32_t>(std::max(1, parser.getInt("-vtpages")));
+    }
+    vtSettings.traceFilename = parser.getString("-vtrecord");
+
+    SphereSettings sphereSettings;
+    if (parser.exist("-spheres")) {
+        sphereSettings.count = static_cast<uint32_t>(std::max(1, parser.getInt("-spheres")));
+    }
+    sphereSettings.clusterSize = static_cast<uint32_t>(std::max(0, parser.getInt("-sphereclusters")));
+    sphereSettings.numThreads  = textureSettings.numThreads;
+
+    EnvironmentSettings envSettings;
+    envSettings.filename = parser.getString("-envmap");
+    envSettings.cube     = parser.exist("-envcube");
+    envSettings.intensity  = std::max(0.0f, parser.getFloat("-envintensity", 1.0f));
+    envSettings.sun        = std::max(0.0f, parser.getFloat("-envsun"));
+    envSettings.numThreads = textureSettings.numThreads;
+
+    // Renders to the file without window, then exits
+    HeadlessSettings headlessSettings;
+    headlessSettings.enabled = parser.exist("-headless");
+    if (headlessSettings.enabled) {
+        std::string output = parser.getString("-headless");
+        if (!output.empty()) {
+            headlessSettings.output = output;
+        }
+    }
+    headlessSettings.width  = static_cast<uint32_t>(std::max(1, parser.getInt("-width", 1280)));
+    headlessSettings.height = static_cast<uint32_t>(std::max(1, parser.getInt("-height", 720)));
+    headlessSettings.frames = static_cast<uint32_t>(std::max(1, parser.getInt("-frames", 100)));
+    headlessSettings.denoiseDump = parser.getString("-denoisedump");
+
+    // Throughput of the megakernel and the wavefront mode on the same scene,
+    // e.g. -spheres 10000 for many materials, headless
+    if (parser.exist("-tracebench")) {
+        headlessSettings.enabled        = true;
+        headlessSettings.traceBenchmark = true;
+    }
+
+    // Time of the accumulation pass of each mode on the device next to the
+    // drift of the formats, with -headless: 10000 frames unless -accumframes
+    uint32_t accumulationFrames = 10000;
+    if (parser.exist("-accumframes")) {
+        accumulationFrames = static_cast<uint32_t>(std::max(1, parser.getInt("-accumframes")));
+    }
+    if (parser.exist("-accumbench") && headlessSettings.enabled) {
+        headlessSettings.accumulationBenchmark = true;
+        headlessSettings.frames                = accumulationFrames;
+    }
+
+    // Accumulation saved to and resumed from the file
+    CheckpointSettings checkpointSettings;
+    checkpointSettings.filename = parser.getString("-checkpoint");
+    checkpointSettings.interval = std::max(0.0f, parser.getFloat("-checkpointinterval", 60.0f));
+
+    // Import only, without window nor device: reports timings and counts
+    if (parser.exist("-stats")) {
+        CsfScene scene;
+        if (csfFilename.empty() || !scene.load(csfFilename)) {
+            std::cerr << "-stats requires a valid -csf <file>" << std::endl;
+            return 1;
+        }
+        scene.printStats();
+        return 0;
+    }
+
+    // Texture processing only, same settings as the application
+    if (parser.exist("-texbench")) {
+        std::string filename = parser.getString("-texbench");
+        int         width, height, channels;
+        stbi_uc*    pixels = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+        if (!pixels) {
+            std::cerr << "-texbench requires a valid image <file>" << std::endl;
+            return 1;
+        }
+
+        TextureProcessor processor(textureSettings);
+        ProcessedTexture processed = processor.process({pixels}, static_cast<uint32_t>(width),
+                                                       static_cast<uint32_t>(height), static_cast<uint32_t>(channels));
+        stbi_image_free(pixels);
+
+        std::cout << width << "x" << height << "x" << channels << ": " << processed.levels.size() << " levels, "
+                  << processed.data.size() << " bytes" << std::endl;
+        processor.printStats();
+        return 0;
+    }
+
+    // Sphere generation and BLAS inputs only, at 1M and 10M unless -spheres is given
+    if (parser.exist("-spherebench")) {
+        std::vector<uint32_t> counts = {1000000, 10000000};
+        if (parser.exist("-spheres")) {
+            counts = {sphereSettings.count};
+        }
+        for (uint32_t count : counts) {
+            SphereSettings settings = sphereSettings;
+            settings.count          = count;
+            SphereSet set;
+            set.build(settings);
+            set.printStats();
+        }
+        return 0;
+    }
+
+    // CPU reference of the wavefront hit sort, one key per pixel of 1280x720 unless -sortcount is given
+    if (parser.exist("-sortbench")) {
+        uint32_t count = 1280 * 720;
+        if (parser.exist("-sortcount")) {
+            count = static_cast<uint32_t>(std::max(0, parser.getInt("-sortcount")));
+        }
+        WavefrontSort sort;
+        bool          ok = sort.check(count, 16, textureSettings.numThreads);
+        sort.printStats();
+        return ok ? 0 : 1;
+    }
+
+    // Environment distribution checks and convergence of its sampling, on the
+    // -envmap file or on the procedural sky with a sun (of radiance 1000 unless -envsun is given)
+    if (parser.exist("-envbench")) {
+        Environment env;
+        if (!envSettings.filename.empty()) {
+            int    width, height, channels;
+            float* pixels = stbi_loadf(envSettings.filename.c_str(), &width, &height, &channels, 0);
+            if (!pixels) {
+                std::cerr << "-envbench requires a valid -envmap <file>" << std::endl;
+                return 1;
+            }
+            env.buildFromEquirect(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                                  static_cast<uint32_t>(channels), envSettings.intensity, envSettings.numThreads);
+            stbi_image_free(pixels);
+        } else {
+            float sun = envSettings.sun > 0.0f ? envSettings.sun : 1000.0f;
+            env.buildSky(envSettings.width, envSettings.intensity, sun, envSettings.numThreads);
+        }
+        std::cout << env.getWidth() << "x" << env.getHeight() << ": distribution built in " << env.getBuildMs()
+                  << " ms" << std::endl;
+
+        bool ok = checkEnvironment(env);
+        // The MIS estimator takes one sample of each strategy per sample
+        std::cout << "spp\tBSDF\tenvironment\tMIS" << std::endl;
+        for (const auto& point : benchmarkEnvironment(env, 256, envSettings.numThreads)) {
+            std::cout << point.spp << "\t" << point.rmseBsdf << "\t" << point.rmseLight << "\t" << point.rmseMis
+                      << std::endl;
+        }
+        return ok ? 0 : 1;
+    }
+
+    // Convergence of the samplers of the path tracer on a 128x128 integrand, without device: the
+    // low-discrepancy ones must end below the LCG
+    if (parser.exist("-samplerbench")) {
+        SamplerTables                              tables;
+        std::vector<std::vector<ConvergencePoint>> curves;
+        for (SamplerType type : {SamplerType::Lcg, SamplerType::SobolOwen, SamplerType::BlueNoise}) {
+            curves.push_back(benchmarkConvergence(tables, type, 128, 128, 256));
+        }
+        std::cout << "spp\tLCG\tSobol/Owen\tblue noise" << std::endl;
+        for (size_t i = 0; i < curves[0].size(); ++i) {
+            std::cout << curves[0][i].spp << "\t" << curves[0][i].rmse << "\t" << curves[1][i].rmse << "\t"
+                      << curves[2][i].rmse << std::endl;
+        }
+        float lcg = curves[0].back().rmse;
+        return curves[1].back().rmse < lcg && curves[2].back().rmse < lcg ? 0 : 1;
+    }
+
+    // Keys and cache of the shader permutations of the pipelines, without device
+    if (parser.exist("-permutations")) {
+        return checkShaderPermutations() ? 0 : 1;
+    }
+
+    // Encoders of the headless mode, without device
+    if (parser.exist("-imagecheck")) {
+        return checkImageWriter() ? 0 : 1;
+    }
+
+    // Order, budget and checkpoints of the tiled rendering on a simulated cost model, without device
+    if (parser.exist("-tilecheck")) {
+        return checkTileScheduler() ? 0 : 1;
+    }
+
+    // Packing and deferred release of the descriptor slots, without device
+    if (parser.exist("-slotcheck")) {
+        return checkSlotAllocator() ? 0 : 1;
+    }
+
+    // Format and resampling of the accumulation checkpoints, without device
+    if (parser.exist("-checkpointcheck")) {
+        return checkAccumulationCheckpoint() ? 0 : 1;
+    }
+
+    // CPU reference of the A-trous filter on the buffers of a -headless -denoisedump <dir> render, without device
+    if (parser.exist("-denoisecheck")) {
+        AtrousDump dump;
+        if (!dump.load(parser.getString("-denoisecheck"))) {
+            std::cerr << "-denoisecheck requires a valid dump <dir>" << std::endl;
+            return 1;
+        }
+        return checkAtrousDump(dump) ? 0 : 1;
+    }
+
+    // Accumulation reprojection on analytic depth buffers, without device
+    if (parser.exist("-reprojectcheck")) {
+        return checkReprojection() ? 0 : 1;
+    }
+
+    // Histogram, exposure and operators of the post-processing, without device
+    if (parser.exist("-tonemapcheck")) {
+        return checkToneMapping() ? 0 : 1;
+    }
+
+    // Drift of the accumulation formats over 10000 frames unless -accumframes is given, without device
+    if (parser.exist("-accumbench") && !headlessSettings.enabled) {
+        auto points = benchmarkAccumulation(accumulationFrames, 4096, textureSettings.numThreads);
+        std::cout << "frames\tbytes\trmse\tmax\tformat" << std::endl;
+        for (const auto& point : points) {
+            for (const auto& format : point.formats) {
+                std::cout << point.frames << "\t" << format.bytes << "\t" << format.rmseError << "\t"
+                          << format.maxError << "\t" << format.name << std::endl;
+            }
+        }
+        return checkAccumulation(points) ? 0 : 1;
+    }
+
+    // Load order and evictions of the residency on synthetic traces, without device
+    if (parser.exist("-vtcheck")) {
+        return checkVirtualTextures() ? 0 : 1;
+    }
+
+    // Residency decisions of a recorded feedback trace, same settings as the application
+    if (parser.exist("-vtreplay")) {
+        FeedbackTrace trace;
+        if (!trace.load(parser.getString("-vtreplay"))) {
+            std::cerr << "-vtreplay requires a valid trace <file>" << std::endl;
+            return 1;
+        }
+
+        auto stats = trace.replay(vtSettings.residency);
+        std::cout << trace.frames.size() << " frames, " << trace.textures.size() << " textures: " << stats.nbRequests
+                  << " requests, " << stats.getHitRate() * 100.0 << "% hits, " << stats.nbLoads << " loads, "
+                  << stats.nbEvictions << " evictions, " << stats.nbDeferred << " deferred" << std::endl;
+        return 0;
+    }
+
     try {
-        Application app;
+        Application app(csfFilename, textureSettings, vtSettings, sphereSettings, envSettings, headlessSettings,
+                        checkpointSettings);
         app.run();
     } catch (const std::exception& ex) {
         std::cerr << ex.what() << std::endl;
         return 1;
     }
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -1,55 +1,36 @@
 #include "sphere.hpp"
-#include "../material/material_obj.hpp"
 #include <algorithm>
-#include <random>
+#include <stdexcept>
 
-SphereHandler::SphereHandler(nvvk::CommandPool& cmdpool, nvvk::Allocator& alloc)
+SphereHandler::SphereHandler(nvvk::Allocator& alloc, Uploader& uploader, const SphereSettings& settings)
 {
-    std::random_device                    rd{};
-    std::mt19937                          gen{rd()};
-    std::normal_distribution<float>       xzd{0.f, 5.f};
-    std::normal_distribution<float>       yd{6.f, 3.f};
-    std::uniform_real_distribution<float> radd{0.05f, 0.2f};
-
-    int nb_spheres = 100;
-    // All spheres
-    Sphere s;
-    _spheres.resize(nb_spheres);
-
-    for (uint32_t i = 0; i < nb_spheres; i++)
-    {
-        s.center     = nvmath::vec3f(xzd(gen), yd(gen), xzd(gen));
-        s.radius     = radd(gen);
-        _spheres[i] = std::move(s);
+    // gl_InstanceCustomIndexEXT holds 24 bits, the first sphere of each
+    // cluster (there is at least one per material)
+    if (settings.count > (1U << 24)) {
+        throw std::runtime_error("Too many spheres, at most 16M");
     }
-    // // All spheres
-    // _spheres = {
-    //     Sphere { nvmath::vec3f( 0.0f, -100.5f, -1.0f), 100.0f },
-    //     Sphere { nvmath::vec3f( 0.0f, 0.0f, -1.0f), 0.25f },
-    //     Sphere { nvmath::vec3f(-1.0f, 0.0f, -1.0f), 0.15f },
-    //     Sphere { nvmath::vec3f( 1.0f, 0.0f, -1.0f), 0.15f }
-    // };
 
-    // Axis aligned bounding box of each sphere
-    std::vector<AABB> aabbs;
-    aabbs.reserve(_spheres.size());
-    for(const auto& s : _spheres)
-    {
-        AABB aabb;
-        aabb.min = s.center - nvmath::vec3f(s.radius);
-        aabb.max = s.center + nvmath::vec3f(s.radius);
-        aabbs.emplace_back(aabb);
-    }
+    // Spheres and AABBs are built on the CPU, only the clusters are kept
+    SphereSet set;
+    set.build(settings);
+    set.printStats();
+    _clusters = set.getClusters();
 
-    // Creating all buffers
+    // Creating all buffers, at least one sphere for the bindings
     using vkBU = vk::BufferUsageFlagBits;
-    auto cmdBuf = cmdpool.createCommandBuffer();
-    _spheres_buffer           = alloc.createBuffer(cmdBuf, _spheres, vkBU::eStorageBuffer);
-    _spheres_aabb_buffer      = alloc.createBuffer(cmdBuf, aabbs, vkBU::eShaderDeviceAddress);
-    cmdpool.submitAndWait(cmdBuf);
+    using vkMP = vk::MemoryPropertyFlagBits;
+    vk::DeviceSize nbSpheres = std::max<vk::DeviceSize>(1, set.getSpheres().size());
+    _spheres_buffer = alloc.createBuffer(nbSpheres * sizeof(Sphere), vkBU::eStorageBuffer | vkBU::eTransferDst,
+                                         vkMP::eDeviceLocal);
+    _spheres_aabb_buffer = alloc.createBuffer(nbSpheres * sizeof(AABB),
+                                              vkBU::eShaderDeviceAddress | vkBU::eTransferDst
+                                                  | vkBU::eAccelerationStructureBuildInputReadOnlyKHR,
+                                              vkMP::eDeviceLocal);
+    uploader.uploadBuffer(_spheres_buffer.buffer, 0, set.getSpheres());
+    uploader.uploadBuffer(_spheres_aabb_buffer.buffer, 0, set.getAabbs());
 }
 
-nvvk::RaytracingBuilderKHR::BlasInput SphereHandler::toVkGeometryKHR(vk::Device& device) {
+std::vector<nvvk::RaytracingBuilderKHR::BlasInput> SphereHandler::toVkGeometryKHR(vk::Device& device) {
     vk::DeviceAddress dataAddress = device.getBufferAddress({_spheres_aabb_buffer.buffer});
 
     vk::AccelerationStructureGeometryAabbsDataKHR aabbs;
@@ -59,21 +40,27 @@ nvvk::RaytracingBuilderKHR::BlasInput SphereHandler::toVkGeometryKHR(vk::Device&
     // Setting up the build info of the acceleration (C version, c++ gives wrong type)
     vk::AccelerationStructureGeometryKHR asGeom(vk::GeometryTypeKHR::eAabbs, aabbs,
                                                 vk::GeometryFlagBitsKHR::eOpaque);
-    //asGeom.geometryType   = vk::GeometryTypeKHR::eAabbs;
-    //asGeom.flags          = vk::GeometryFlagBitsKHR::eOpaque;
-    //asGeom.geometry.aabbs = aabbs;
 
+    std::vector<nvvk::RaytracingBuilderKHR::BlasInput> inputs;
+    inputs.reserve(_clusters.size());
+    for (const auto& cluster : _clusters) {
+        vk::AccelerationStructureBuildRangeInfoKHR offset;
+        offset.setFirstVertex(0);
+        offset.setPrimitiveCount(cluster.count);  // Nb aabb
+        offset.setPrimitiveOffset(cluster.first * static_cast<uint32_t>(sizeof(AABB)));
+        offset.setTransformOffset(0);
 
-    vk::AccelerationStructureBuildRangeInfoKHR offset;
-    offset.setFirstVertex(0);
-    offset.setPrimitiveCount((uint32_t)_spheres.size());  // Nb aabb
-    offset.setPrimitiveOffset(0);
-    offset.setTransformOffset(0);
+        nvvk::RaytracingBuilderKHR::BlasInput input;
+        input.asGeometry.emplace_back(asGeom);
+        input.asBuildOffsetInfo.emplace_back(offset);
+        inputs.emplace_back(input);
+    }
+    return inputs;
+}
 
-    nvvk::RaytracingBuilderKHR::BlasInput input;
-    input.asGeometry.emplace_back(asGeom);
-    input.asBuildOffsetInfo.emplace_back(offset);
-    return input;
+const std::vector<SphereSet::Cluster>& SphereHandler::getClusters() const
+{
+    return _clusters;
 }
 
 nvvk::Buffer& SphereHandler::getSpheresBuffer()
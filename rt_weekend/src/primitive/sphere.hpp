@@ -10,27 +10,24 @@
 #include <nvvk/raytraceKHR_vk.hpp>
 #include <vector>
 
-struct Sphere {
-    nvmath::vec3f center;
-    float radius;
-};
-
-struct AABB {
-    nvmath::vec3f min;
-    nvmath::vec3f max;
-};
+#include "sphere_set.hpp"
+#include "../render/uploader.hpp"
 
 class SphereHandler {
 private:
-    std::vector<Sphere> _spheres;
+    std::vector<SphereSet::Cluster> _clusters;
     nvvk::Buffer _spheres_buffer;
     nvvk::Buffer _spheres_aabb_buffer;
 
 
 public:
-    SphereHandler(nvvk::CommandPool& cmdpool, nvvk::Allocator& alloc);
+    // The copies go through `uploader`, they must complete before the BLAS are built
+    SphereHandler(nvvk::Allocator& alloc, Uploader& uploader, const SphereSettings& settings = SphereSettings());
 
-    nvvk::RaytracingBuilderKHR::BlasInput toVkGeometryKHR(vk::Device& device);
+    // One BLAS per cluster, over its range of the AABB buffer. The first
+    // sphere of the cluster is the custom index of its instance.
+    std::vector<nvvk::RaytracingBuilderKHR::BlasInput> toVkGeometryKHR(vk::Device& device);
+    const std::vector<SphereSet::Cluster>& getClusters() const;
     nvvk::Buffer& getSpheresBuffer();
     nvvk::Buffer& getSpheresAABBBuffer();
 
@@ -38,4 +35,4 @@ public:
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,247 @@
+#include "sphere_set.hpp"
+#include "../common/parallel_for.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+// Spheres per parallel work item
+static constexpr uint32_t CHUNK_SIZE = 1 << 16;
+
+// -----------------------
+// Helpers
+// -----------------------
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static uint32_t getChunkCount(size_t count)
+{
+    return static_cast<uint32_t>((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+// Counter based generator: the sequence of a sphere is seeded by its index
+struct SplitMix {
+    uint64_t state;
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z          = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    float uniform() { return static_cast<float>(next() >> 40) * (1.0f / 16777216.0f); }
+    float uniform(float a, float b) { return a + (b - a) * uniform(); }
+
+    // Box-Muller, one of the pair
+    float normal(float mean, float sigma)
+    {
+        float u1 = std::max(uniform(), 1e-7f);
+        float u2 = uniform();
+        return mean + sigma * std::sqrt(-2.0f * std::log(u1)) * std::cos(6.2831853f * u2);
+    }
+};
+
+// 10 bits per axis, interleaved
+static uint32_t expandBits(uint32_t v)
+{
+    v = (v * 0x00010001U) & 0xFF0000FFU;
+    v = (v * 0x00000101U) & 0x0F00F00FU;
+    v = (v * 0x00000011U) & 0xC30C30C3U;
+    v = (v * 0x00000005U) & 0x49249249U;
+    return v;
+}
+
+static uint32_t getMortonCode(const nvmath::vec3f& p, const nvmath::vec3f& origin, const nvmath::vec3f& scale)
+{
+    auto quantize = [](float v) { return static_cast<uint32_t>(std::min(std::max(v, 0.0f), 1023.0f)); };
+    return (expandBits(quantize((p.x - origin.x) * scale.x)) << 2) | (expandBits(quantize((p.y - origin.y) * scale.y)) << 1)
+           | expandBits(quantize((p.z - origin.z) * scale.z));
+}
+
+// Stable, bytes of the high word from `firstShift`
+static void radixSort(std::vector<uint64_t>& keys, uint32_t firstShift)
+{
+    std::vector<uint64_t> sorted(keys.size());
+    for (uint32_t shift = firstShift; shift < 64; shift += 8) {
+        std::array<size_t, 257> offsets{};
+        for (uint64_t key : keys) {
+            offsets[((key >> shift) & 0xFF) + 1]++;
+        }
+        for (size_t digit = 1; digit < offsets.size(); digit++) {
+            offsets[digit] += offsets[digit - 1];
+        }
+        for (uint64_t key : keys) {
+            sorted[offsets[(key >> shift) & 0xFF]++] = key;
+        }
+        keys.swap(sorted);
+    }
+}
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+void SphereSet::build(const SphereSettings& settings)
+{
+    using Clock = std::chrono::high_resolution_clock;
+    _stats      = Stats();
+    _stats.nbSpheres = settings.count;
+
+    auto start = Clock::now();
+    generate(settings);
+    _stats.generateMs = elapsedMs(start);
+
+    start = Clock::now();
+    sortByMaterial(settings.numThreads, settings.clusterSize > 0);
+    _stats.sortMs = elapsedMs(start);
+
+    // Range of each material, split in clusters
+    _clusters.clear();
+    uint32_t first = 0;
+    for (uint32_t m = 0; m < SPHERE_MATERIAL_COUNT; m++) {
+        auto material = static_cast<SphereMaterial>(m);
+        auto end      = std::partition_point(_spheres.begin() + first, _spheres.end(),
+                                             [&](const Sphere& s) { return getMaterial(s) == material; });
+        uint32_t last = static_cast<uint32_t>(end - _spheres.begin());
+        uint32_t size = settings.clusterSize > 0 ? settings.clusterSize : last - first;
+        while (first < last) {
+            uint32_t count = std::min(size, last - first);
+            _clusters.push_back({first, count, material});
+            first += count;
+        }
+    }
+
+    start = Clock::now();
+    computeAabbs(settings.numThreads);
+    _stats.aabbMs = elapsedMs(start);
+}
+
+void SphereSet::printStats() const
+{
+    LOGI("Spheres: %llu in %zu BLAS\n", static_cast<unsigned long long>(_stats.nbSpheres), _clusters.size());
+    LOGI("Spheres: generation %.1f ms (%.1f MSpheres/s), material and Morton sort %.1f ms, AABBs %.1f ms (%.1f MSpheres/s)\n",
+         _stats.generateMs, _stats.getThroughput(_stats.generateMs), _stats.sortMs, _stats.aabbMs,
+         _stats.getThroughput(_stats.aabbMs));
+}
+
+uint32_t SphereSet::packMaterial(SphereMaterial type, const nvmath::vec3f& albedo)
+{
+    auto toByte = [](float v) { return static_cast<uint32_t>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f); };
+    return static_cast<uint32_t>(type) | (toByte(albedo.x) << 8) | (toByte(albedo.y) << 16) | (toByte(albedo.z) << 24);
+}
+
+// -----------------------
+// Private Methods
+// -----------------------
+
+// The spread grows with the count, keeping the density of the default 100
+void SphereSet::generate(const SphereSettings& settings)
+{
+    float spread = std::max(1.0f, std::cbrt(settings.count / 100.0f));
+
+    _spheres.resize(settings.count);
+    parallelFor(getChunkCount(_spheres.size()), settings.numThreads, [&](uint32_t chunk) {
+        uint32_t end = std::min(settings.count, (chunk + 1) * CHUNK_SIZE);
+        for (uint32_t i = chunk * CHUNK_SIZE; i < end; i++) {
+            SplitMix rng{(uint64_t(settings.seed) << 32) ^ i};
+
+            Sphere& s  = _spheres[i];
+            s.center   = nvmath::vec3f(rng.normal(0.f, 5.f * spread), rng.normal(6.f * spread, 3.f * spread),
+                                       rng.normal(0.f, 5.f * spread));
+            s.radius   = rng.uniform(0.05f, 0.2f);
+
+            float          kind   = rng.uniform();
+            nvmath::vec3f  albedo = nvmath::vec3f(rng.uniform(), rng.uniform(), rng.uniform());
+            SphereMaterial type   = kind < 0.8f ? SphereMaterial::Diffuse : kind < 0.95f ? SphereMaterial::Metal : SphereMaterial::Glass;
+            if (type == SphereMaterial::Metal) {
+                albedo = albedo * 0.5f + nvmath::vec3f(0.5f);
+            }
+            s.material = packMaterial(type, albedo);
+        }
+    });
+}
+
+// Stable radix sort of (material, code, index) keys: the material in the top
+// 2 bits, the Morton code of 30 bits below. Without Morton order the codes are
+// 0, a single pass over the top byte groups the materials.
+void SphereSet::sortByMaterial(uint32_t numThreads, bool mortonOrder)
+{
+    uint32_t nbChunks = getChunkCount(_spheres.size());
+
+    std::vector<uint64_t> keys(_spheres.size());
+    if (!mortonOrder) {
+        parallelFor(nbChunks, numThreads, [&](uint32_t chunk) {
+            size_t end = std::min(_spheres.size(), size_t(chunk + 1) * CHUNK_SIZE);
+            for (size_t i = size_t(chunk) * CHUNK_SIZE; i < end; i++) {
+                keys[i] = (uint64_t(_spheres[i].material & 0xFF) << 62) | i;
+            }
+        });
+        radixSort(keys, 56);
+        reorder(keys, numThreads);
+        return;
+    }
+
+    // Bounds of the centers, per chunk then reduced
+    std::vector<nvmath::vec3f> chunkMin(nbChunks), chunkMax(nbChunks);
+    parallelFor(nbChunks, numThreads, [&](uint32_t chunk) {
+        size_t        end = std::min(_spheres.size(), size_t(chunk + 1) * CHUNK_SIZE);
+        nvmath::vec3f lo(FLT_MAX), hi(-FLT_MAX);
+        for (size_t i = size_t(chunk) * CHUNK_SIZE; i < end; i++) {
+            lo = nvmath::nv_min(lo, _spheres[i].center);
+            hi = nvmath::nv_max(hi, _spheres[i].center);
+        }
+        chunkMin[chunk] = lo;
+        chunkMax[chunk] = hi;
+    });
+    nvmath::vec3f lo(FLT_MAX), hi(-FLT_MAX);
+    for (uint32_t chunk = 0; chunk < nbChunks; chunk++) {
+        lo = nvmath::nv_min(lo, chunkMin[chunk]);
+        hi = nvmath::nv_max(hi, chunkMax[chunk]);
+    }
+    nvmath::vec3f extent = hi - lo;
+    nvmath::vec3f scale(extent.x > 0.f ? 1023.f / extent.x : 0.f, extent.y > 0.f ? 1023.f / extent.y : 0.f,
+                        extent.z > 0.f ? 1023.f / extent.z : 0.f);
+
+    parallelFor(nbChunks, numThreads, [&](uint32_t chunk) {
+        size_t end = std::min(_spheres.size(), size_t(chunk + 1) * CHUNK_SIZE);
+        for (size_t i = size_t(chunk) * CHUNK_SIZE; i < end; i++) {
+            keys[i] = (uint64_t(_spheres[i].material & 0xFF) << 62)
+                      | (uint64_t(getMortonCode(_spheres[i].center, lo, scale)) << 32) | i;
+        }
+    });
+    radixSort(keys, 32);
+    reorder(keys, numThreads);
+}
+
+// Sphere of index in the low word of each key
+void SphereSet::reorder(const std::vector<uint64_t>& keys, uint32_t numThreads)
+{
+    std::vector<Sphere> spheres(_spheres.size());
+    parallelFor(getChunkCount(_spheres.size()), numThreads, [&](uint32_t chunk) {
+        size_t end = std::min(_spheres.size(), size_t(chunk + 1) * CHUNK_SIZE);
+        for (size_t i = size_t(chunk) * CHUNK_SIZE; i < end; i++) {
+            spheres[i] = _spheres[keys[i] & 0xFFFFFFFFULL];
+        }
+    });
+    _spheres.swap(spheres);
+}
+
+void SphereSet::computeAabbs(uint32_t numThreads)
+{
+    _aabbs.resize(_spheres.size());
+    parallelFor(getChunkCount(_spheres.size()), numThreads, [&](uint32_t chunk) {
+        size_t end = std::min(_spheres.size(), size_t(chunk + 1) * CHUNK_SIZE);
+        for (size_t i = size_t(chunk) * CHUNK_SIZE; i < end; i++) {
+            const Sphere& s = _spheres[i];
+            _aabbs[i].min   = s.center - nvmath::vec3f(s.radius);
+            _aabbs[i].max   = s.center + nvmath::vec3f(s.radius);
+        }
+    });
+}
@@ -0,0 +1,90 @@
+#ifndef SPHERE_SET_HPP
+#define SPHERE_SET_HPP
+
+#include <nvmath/nvmath.h>
+#include <cstdint>
+#include <vector>
+
+// Low byte of Sphere::material, `SPHERE_*` in raycommon.glsl
+enum class SphereMaterial : uint32_t {
+    Diffuse = 0,
+    Metal   = 1,
+    Glass   = 2,
+};
+static constexpr uint32_t SPHERE_MATERIAL_COUNT = 3;
+
+// `Sphere` in raycommon.glsl, scalar layout
+struct Sphere {
+    nvmath::vec3f center;
+    float         radius;
+    uint32_t      material;  // SphereMaterial, RGB8 albedo in the upper bytes
+};
+
+// Layout of VkAabbPositionsKHR
+struct AABB {
+    nvmath::vec3f min;
+    nvmath::vec3f max;
+};
+
+struct SphereSettings {
+    uint32_t count{100};
+    uint32_t clusterSize{0};  // Spheres per BLAS, 0 for one BLAS per material
+    uint32_t seed{0};
+    uint32_t numThreads{0};   // 0 uses all the cores
+};
+
+// Random spheres and the build inputs of their acceleration structures,
+// prepared on the CPU. Each sphere only depends on the seed and its index:
+// the result is the same for any number of threads.
+//
+// Clustered, the spheres are sorted along a Morton curve of their centers and
+// split in ranges of clusterSize, each built as its own BLAS: the BLASes are
+// spatially compact and the TLAS separates them, where one BLAS over a
+// scattered set would have large overlapping nodes at the top.
+//
+// The spheres are grouped by material first, each cluster has a single
+// material: its instance selects the hit group specialized for it.
+class SphereSet {
+public:
+    // Range of `getSpheres()` built as one BLAS
+    struct Cluster {
+        uint32_t       first{0};
+        uint32_t       count{0};
+        SphereMaterial material{SphereMaterial::Diffuse};  // Of all its spheres
+    };
+
+    struct Stats {
+        uint64_t nbSpheres{0};
+        double   generateMs{0.0};
+        double   sortMs{0.0};
+        double   aabbMs{0.0};
+
+        double getThroughput(double ms) const { return ms > 0.0 ? nbSpheres / (ms * 1e3) : 0.0; }  // MSpheres/s
+    };
+
+    void build(const SphereSettings& settings);
+
+    const std::vector<Sphere>&  getSpheres() const { return _spheres; }
+    const std::vector<AABB>&    getAabbs() const { return _aabbs; }
+    const std::vector<Cluster>& getClusters() const { return _clusters; }
+
+    const Stats& getStats() const { return _stats; }
+    void         printStats() const;
+
+    static uint32_t       packMaterial(SphereMaterial type, const nvmath::vec3f& albedo);
+    static SphereMaterial getMaterial(const Sphere& sphere) { return static_cast<SphereMaterial>(sphere.material & 0xFF); }
+
+private:
+    void generate(const SphereSettings& settings);
+    void sortByMaterial(uint32_t numThreads, bool mortonOrder);
+    void reorder(const std::vector<uint64_t>& keys, uint32_t numThreads);
+    void computeAabbs(uint32_t numThreads);
+
+    std::vector<Sphere>  _spheres;
+    std::vector<AABB>    _aabbs;
+    std::vector<Cluster> _clusters;
+    Stats                _stats;
+};
+
+
+#endif
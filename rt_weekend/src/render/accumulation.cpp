@@ -0,0 +1,310 @@
+#include "accumulation.hpp"
+#include "../common/parallel_for.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+// -----------------------
+// Helpers
+// -----------------------
+
+// GLSL mix(), as the specification defines it
+static float mixFloat(float x, float y, float a)
+{
+    return x * (1.0f - a) + y * a;
+}
+
+static void accumulateAverage(float& mean, float count, float color)
+{
+    mean = mixFloat(mean, color, 1.0f / count);
+}
+
+// Error of the last update in half ulps of the mean and back: exact powers of
+// two, frexp() gives |x| in [2^(e-1), 2^e) whose ulp is 2^(e-24)
+static float errorToCompensation(float error, float mean)
+{
+    int exponent;
+    std::frexp(mean, &exponent);
+    float steps = std::nearbyint(std::ldexp(error, 25 - exponent) * float(ACCUMULATION_COMPENSATION_STEPS));
+    steps       = std::clamp(steps, -float(ACCUMULATION_COMPENSATION_STEPS), float(ACCUMULATION_COMPENSATION_STEPS));
+    return steps * (1.0f / float(ACCUMULATION_COMPENSATION_STEPS));
+}
+
+static float compensationToError(float compensation, float mean)
+{
+    int exponent;
+    std::frexp(mean, &exponent);
+    return std::ldexp(compensation, exponent - 25);
+}
+
+static void accumulateCompensated(float& mean, float& compensation, float count, float color, bool continued)
+{
+    float m = mean;
+    float c = continued ? compensationToError(compensation, m) : 0.0f;
+
+    float y = (color - m) / count - c;
+    float t = m + y;
+    float e = (t - m) - y;
+
+    mean         = t;
+    compensation = errorToCompensation(e, t);
+}
+
+// Frames of a pixel: exponentially distributed samples around a mean drawn
+// over 4 orders of magnitude, like the radiance of the paths
+struct FrameGenerator {
+    std::mt19937                          rng;
+    std::uniform_real_distribution<float> uniform{0.0f, 1.0f};
+    nvmath::vec3f                         base;
+
+    explicit FrameGenerator(uint32_t seed) :
+        rng(seed)
+    {
+        for (int c = 0; c < 3; c++) {
+            base[c] = std::pow(10.0f, uniform(rng) * 4.0f - 2.0f);
+        }
+    }
+
+    nvmath::vec3f next()
+    {
+        nvmath::vec3f color;
+        for (int c = 0; c < 3; c++) {
+            color[c] = -base[c] * std::log(1.0f - uniform(rng));
+        }
+        return color;
+    }
+};
+
+// -----------------------
+// Public Functions
+// -----------------------
+
+void accumulateFrame(AccumulationMode mode, AccumulationPixel& pixel, const nvmath::vec3f& color, bool continued)
+{
+    float count = pixel.count + 1.0f;
+    for (int c = 0; c < 3; c++) {
+        if (mode == AccumulationMode::Compensated) {
+            accumulateCompensated(pixel.mean[c], pixel.compensation[c], count, color[c], continued);
+        } else {
+            accumulateAverage(pixel.mean[c], count, color[c]);
+            pixel.compensation[c] = 0.0f;
+        }
+    }
+
+    // Stored in fixed point
+    pixel.count = std::min(std::nearbyint(count * ACCUMULATION_COUNT_SCALE), 65535.0f) / ACCUMULATION_COUNT_SCALE;
+}
+
+void encodeAccumulation(const AccumulationPixel& pixel, uint32_t texel[4])
+{
+    uint32_t alpha = uint32_t(pixel.count * ACCUMULATION_COUNT_SCALE) & 0xFFFFu;
+    for (int c = 0; c < 3; c++) {
+        memcpy(&texel[c], &pixel.mean[c], sizeof(float));
+        alpha |= (uint32_t(getCompensationSteps(pixel.compensation[c])) & 0x1Fu) << (16 + 5 * c);
+    }
+    texel[3] = alpha;
+}
+
+AccumulationPixel decodeAccumulation(const uint32_t texel[4])
+{
+    AccumulationPixel pixel;
+    pixel.count = float(texel[3] & 0xFFFFu) / ACCUMULATION_COUNT_SCALE;
+    for (int c = 0; c < 3; c++) {
+        memcpy(&pixel.mean[c], &texel[c], sizeof(float));
+
+        // Sign extended, as bitfieldExtract() of an int
+        int steps             = int((texel[3] >> (16 + 5 * c)) & 0x1Fu);
+        steps                 = steps >= 16 ? steps - 32 : steps;
+        pixel.compensation[c] = float(steps) * (1.0f / float(ACCUMULATION_COMPENSATION_STEPS));
+    }
+    return pixel;
+}
+
+int getCompensationSteps(float compensation)
+{
+    return int(std::nearbyint(compensation * float(ACCUMULATION_COMPENSATION_STEPS)));
+}
+
+float roundToHalf(float value)
+{
+    if (!std::isfinite(value)) {
+        return value;
+    }
+
+    // Above the largest half float plus half an ulp: infinity
+    float magnitude = std::abs(value);
+    if (magnitude >= 65520.0f) {
+        return std::copysign(std::numeric_limits<float>::infinity(), value);
+    }
+
+    // 11 significant bits, the subnormals have a fixed ulp of 2^-24
+    int exponent;
+    std::frexp(magnitude, &exponent);
+    float ulp = std::ldexp(1.0f, std::max(exponent - 11, -24));
+    return std::copysign(std::nearbyint(magnitude / ulp) * ulp, value);
+}
+
+uint32_t getAccumulationBytes()
+{
+    return 2 * ACCUMULATION_STATE_BYTES + ACCUMULATION_DISPLAY_BYTES;
+}
+
+std::vector<AccumulationBenchmarkPoint> benchmarkAccumulation(uint32_t maxFrames, uint32_t nbPixels,
+                                                              uint32_t numThreads)
+{
+    enum Format { AverageFloat, CompensatedFloat, SumFloat, AverageHalf, FormatCount };
+    const char* names[FormatCount] = {"Average RGBA32UI + RGBA16F", "Compensated RGBA32UI + RGBA16F", "Sum RGBA32F",
+                                      "Average RGBA16F"};
+    const uint32_t bytes[FormatCount] = {getAccumulationBytes(), getAccumulationBytes(), 2 * 16, 2 * 8};
+
+    // Reported frame counts: powers of two, then maxFrames
+    std::vector<uint32_t> checkpoints;
+    for (uint32_t frames = 16; frames < maxFrames; frames *= 2) {
+        checkpoints.push_back(frames);
+    }
+    checkpoints.push_back(maxFrames);
+
+    // Relative error of each channel of each pixel, per checkpoint and format
+    size_t             nbValues = size_t(nbPixels) * 3;
+    std::vector<float> errors(checkpoints.size() * FormatCount * nbValues, 0.0f);
+    auto errorAt = [&](size_t checkpoint, int format, uint32_t pixel, int c) -> float& {
+        return errors[(checkpoint * FormatCount + format) * nbValues + size_t(pixel) * 3 + c];
+    };
+
+    parallelFor(nbPixels, numThreads, [&](uint32_t pixel) {
+        FrameGenerator    generator(pixel * 7919u + 1u);
+        AccumulationPixel average;
+        AccumulationPixel compensated;
+        nvmath::vec3f     sum(0.0f);
+        nvmath::vec3f     averageHalf(0.0f);
+        double            reference[3] = {0.0, 0.0, 0.0};
+
+        size_t checkpoint = 0;
+        for (uint32_t frame = 0; frame < maxFrames; frame++) {
+            nvmath::vec3f color = generator.next();
+            float         count = float(frame + 1);
+
+            accumulateFrame(AccumulationMode::Average, average, color, frame > 0);
+            accumulateFrame(AccumulationMode::Compensated, compensated, color, frame > 0);
+            for (int c = 0; c < 3; c++) {
+                sum[c] += color[c];
+                averageHalf[c] = roundToHalf(mixFloat(averageHalf[c], color[c], 1.0f / count));
+                reference[c] += double(color[c]);
+            }
+
+            if (frame + 1 == checkpoints[checkpoint]) {
+                for (int c = 0; c < 3; c++) {
+                    double ref    = reference[c] / double(frame + 1);
+                    float  values[FormatCount] = {average.mean[c], compensated.mean[c], sum[c] / count,
+                                                  averageHalf[c]};
+                    for (int format = 0; format < FormatCount; format++) {
+                        errorAt(checkpoint, format, pixel, c) = float(std::abs(double(values[format]) - ref) / ref);
+                    }
+                }
+                checkpoint++;
+            }
+        }
+    });
+
+    std::vector<AccumulationBenchmarkPoint> points(checkpoints.size());
+    for (size_t checkpoint = 0; checkpoint < checkpoints.size(); checkpoint++) {
+        points[checkpoint].frames = checkpoints[checkpoint];
+        for (int format = 0; format < FormatCount; format++) {
+            AccumulationFormatResult result;
+            result.name  = names[format];
+            result.bytes = bytes[format];
+
+            double squares = 0.0;
+            for (size_t i = 0; i < nbValues; i++) {
+                float error     = errors[(checkpoint * FormatCount + format) * nbValues + i];
+                squares += double(error) * error;
+                result.maxError = std::max(result.maxError, error);
+            }
+            result.rmseError = float(std::sqrt(squares / double(std::max<size_t>(nbValues, 1))));
+            points[checkpoint].formats.push_back(result);
+        }
+    }
+    return points;
+}
+
+bool checkAccumulation(const std::vector<AccumulationBenchmarkPoint>& points)
+{
+    bool ok = true;
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition) {
+            LOGE("Accumulation: %s\n", what);
+            ok = false;
+        }
+    };
+
+    // Half floats: exact values, ties to even, subnormals and overflow
+    expect(roundToHalf(1.0f) == 1.0f && roundToHalf(-2.5f) == -2.5f, "exact half floats");
+    expect(roundToHalf(1.0f + 1.0f / 4096.0f) == 1.0f, "tie rounded to even");
+    expect(roundToHalf(1.0f + 3.0f / 2048.0f) == 1.0f + 1.0f / 512.0f, "tie rounded to even, odd");
+    expect(roundToHalf(std::ldexp(1.0f, -24)) == std::ldexp(1.0f, -24), "smallest subnormal");
+    expect(roundToHalf(std::ldexp(1.0f, -26)) == 0.0f, "underflow");
+    expect(roundToHalf(65504.0f) == 65504.0f && std::isinf(roundToHalf(65520.0f)), "overflow");
+
+    // Packing of the state: the mean is kept as is, the count and the
+    // compensation are rounded to their steps
+    {
+        float             step = 1.0f / float(ACCUMULATION_COMPENSATION_STEPS);
+        AccumulationPixel pixel;
+        pixel.mean         = nvmath::vec3f(0.3f, -1e-20f, 6e4f);
+        pixel.count        = 4321.75f;
+        pixel.compensation = nvmath::vec3f(-15.0f * step, 0.0f, 7.0f * step);
+
+        uint32_t texel[4];
+        encodeAccumulation(pixel, texel);
+        AccumulationPixel decoded = decodeAccumulation(texel);
+        expect(decoded.mean == pixel.mean && decoded.count == pixel.count, "packed mean and count");
+        expect(decoded.compensation == pixel.compensation, "packed compensation");
+        expect(getCompensationSteps(decoded.compensation.z) == 7, "compensation steps");
+
+        // Fractional counts of the reprojection, saturation
+        pixel.count = 2.3f;
+        accumulateFrame(AccumulationMode::Average, pixel, nvmath::vec3f(1.0f), false);
+        expect(pixel.count == 3.25f, "count rounded to its steps");
+        pixel.count = ACCUMULATION_MAX_COUNT;
+        accumulateFrame(AccumulationMode::Compensated, pixel, nvmath::vec3f(1.0f), true);
+        encodeAccumulation(pixel, texel);
+        expect(decodeAccumulation(texel).count == ACCUMULATION_MAX_COUNT, "saturated count");
+    }
+
+    // A constant is accumulated exactly by the compensated mode, mix() of the
+    // average rounds even then
+    {
+        AccumulationPixel average;
+        AccumulationPixel compensated;
+        for (int frame = 0; frame < 1000; frame++) {
+            accumulateFrame(AccumulationMode::Average, average, nvmath::vec3f(0.3f, 1.7f, 42.0f), frame > 0);
+            accumulateFrame(AccumulationMode::Compensated, compensated, nvmath::vec3f(0.3f, 1.7f, 42.0f), frame > 0);
+        }
+        expect(compensated.mean.x == 0.3f && compensated.mean.y == 1.7f && compensated.mean.z == 42.0f
+                   && compensated.count == 1000.0f,
+               "constant compensated accumulation");
+        expect(std::abs(average.mean.z - 42.0f) <= 1e-4f * 42.0f && average.count == 1000.0f,
+               "constant average accumulation");
+    }
+
+    if (points.empty() || points.back().formats.size() < 2) {
+        expect(false, "no benchmark results");
+        return ok;
+    }
+
+    // Long accumulations: the compensated mean stays within a few ulps of the
+    // double precision one, well below the drift of the average
+    const auto& last        = points.back();
+    const auto& average     = last.formats[0];
+    const auto& compensated = last.formats[1];
+    if (last.frames >= 1024) {
+        expect(compensated.rmseError < 0.25f * average.rmseError, "compensated below the average drift");
+    }
+    expect(compensated.maxError < 1e-6f, "compensated within the float precision");
+
+    LOGI("Accumulation: %s\n", ok ? "OK" : "FAILED");
+    return ok;
+}
@@ -0,0 +1,97 @@
+#ifndef ACCUMULATION_HPP
+#define ACCUMULATION_HPP
+
+#include <nvmath/nvmath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU reference of the accumulation of the frames by raytrace.rgen and
+// wavefront_resolve.comp, see shaders/accumulation.glsl. Both must be kept in
+// sync: the operations are the same, in the same float precision, so that the
+// drift of the running mean is reproduced.
+//
+// The accumulation is split in two images. The state, RGBA32UI, is only
+// accessed by the accumulation: the running mean of the frames as floats in
+// rgb and, packed in alpha, their count in 14.2 fixed point and the
+// compensation of the mean, 5 bits per channel. The display image, RGBA16F,
+// is written each frame with the mean and the count for the passes that read
+// the result: post-processing, exposure and denoiser.
+//
+// After thousands of frames the update of the mean, (sample - mean) / count,
+// falls below the precision of the mean and is rounded away: the mean drifts.
+// The compensated mode keeps the rounding error of each update (Kahan
+// summation) and subtracts it from the next one. The error of an addition is
+// at most half an ulp of the result, it is stored in steps of 1/30 ulp. Both
+// modes have the same traffic: the state read and written, the display
+// written.
+
+// `accumulation` push constant
+enum class AccumulationMode : int {
+    Average,      // mix(mean, sample, 1 / count)
+    Compensated,  // Kahan compensated mean
+};
+
+// Steps of the stored count per frame: reprojected histories have fractional
+// counts. The count saturates at 65535 steps, the next frames keep its weight.
+static constexpr float ACCUMULATION_COUNT_SCALE = 4.0f;
+static constexpr float ACCUMULATION_MAX_COUNT   = 65535.0f / ACCUMULATION_COUNT_SCALE;
+
+// Steps of the compensation per half ulp of the mean, in 5 signed bits
+static constexpr int ACCUMULATION_COMPENSATION_STEPS = 15;
+
+// Bytes per pixel of the state and display images
+static constexpr uint32_t ACCUMULATION_STATE_BYTES   = 16;
+static constexpr uint32_t ACCUMULATION_DISPLAY_BYTES = 8;
+
+// State of a pixel, as stored in the state image
+struct AccumulationPixel {
+    nvmath::vec3f mean{0.0f, 0.0f, 0.0f};
+    float         count{0.0f};                     // Multiple of 1 / ACCUMULATION_COUNT_SCALE
+    nvmath::vec3f compensation{0.0f, 0.0f, 0.0f};  // In half ulps of the mean, multiple of 1 / 15
+};
+
+// Adds the mean of the samples of a frame to the pixel. `continued` is false
+// on the first frame and after a reprojection, the compensation restarts.
+void accumulateFrame(AccumulationMode mode, AccumulationPixel& pixel, const nvmath::vec3f& color, bool continued);
+
+// RGBA32UI texel of the state image
+void              encodeAccumulation(const AccumulationPixel& pixel, uint32_t texel[4]);
+AccumulationPixel decodeAccumulation(const uint32_t texel[4]);
+
+// Signed 5-bit steps of a compensation channel, as packed in the texel
+int getCompensationSteps(float compensation);
+
+// Float rounded to the nearest half float, as stored in a RGBA16F image
+float roundToHalf(float value);
+
+// Bytes read and written per pixel and frame by the accumulation, in both
+// modes: the state image read and written, the display image written
+uint32_t getAccumulationBytes();
+
+// Storage formats of the accumulation compared by benchmarkAccumulation, the
+// modes of the device and alternatives considered for them
+struct AccumulationFormatResult {
+    std::string name;
+    uint32_t    bytes{0};       // Per pixel and frame
+    float       rmseError{0.f}; // Relative to the mean computed in double, over the pixels
+    float       maxError{0.f};
+};
+
+struct AccumulationBenchmarkPoint {
+    uint32_t                              frames{0};
+    std::vector<AccumulationFormatResult> formats;
+};
+
+// Accumulates random frames in `nbPixels` pixels of radiances spread over
+// several orders of magnitude, up to `maxFrames`, and reports the error of
+// each format at doubling frame counts
+std::vector<AccumulationBenchmarkPoint> benchmarkAccumulation(uint32_t maxFrames, uint32_t nbPixels,
+                                                              uint32_t numThreads);
+
+// The compensated mode stays close to the double precision mean where the
+// average drifts, without device
+bool checkAccumulation(const std::vector<AccumulationBenchmarkPoint>& points);
+
+
+#endif
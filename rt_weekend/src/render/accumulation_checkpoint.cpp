@@ -0,0 +1,470 @@
+#include "accumulation_checkpoint.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+static constexpr uint32_t CHECKPOINT_MAGIC   = 0x43415452;  // "RTAC"
+static constexpr uint32_t CHECKPOINT_VERSION = 2;
+
+static constexpr uint32_t CHECKPOINT_UNIFORM_COUNT = 1u << 0;  // One count for all the pixels
+static constexpr uint32_t CHECKPOINT_COMPENSATION  = 1u << 1;  // RGB8 compensation follows the counts
+
+// -----------------------
+// Helpers
+// -----------------------
+
+// Whole file in memory: hashed before being written, checked before being parsed
+class CheckpointWriter {
+public:
+    template <typename T>
+    void write(const T& value)
+    {
+        writeBytes(&value, sizeof(T));
+    }
+
+    void writeBytes(const void* data, size_t size)
+    {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+        _bytes.insert(_bytes.end(), bytes, bytes + size);
+    }
+
+    std::vector<uint8_t>& getBytes() { return _bytes; }
+
+private:
+    std::vector<uint8_t> _bytes;
+};
+
+class CheckpointReader {
+public:
+    CheckpointReader(const std::vector<uint8_t>& bytes, size_t size) :
+        _bytes(bytes), _size(size)
+    {
+    }
+
+    template <typename T>
+    bool read(T& value)
+    {
+        return readBytes(&value, sizeof(T));
+    }
+
+    bool readBytes(void* data, size_t size)
+    {
+        if (size > _size - _offset) {
+            return false;
+        }
+        std::memcpy(data, _bytes.data() + _offset, size);
+        _offset += size;
+        return true;
+    }
+
+    bool isComplete() const { return _offset == _size; }
+
+private:
+    const std::vector<uint8_t>& _bytes;
+    size_t                      _size;
+    size_t                      _offset{0};
+};
+
+static bool hasUniformCount(const std::vector<float>& color)
+{
+    for (size_t i = 7; i < color.size(); i += 4) {
+        if (color[i] != color[3]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkpointEquals(const AccumulationCheckpoint& a, const AccumulationCheckpoint& b)
+{
+    return a.width == b.width && a.height == b.height && a.sceneHash == b.sceneHash && a.frameId == b.frameId
+           && a.sampleFrame == b.sampleFrame && a.accumulation == b.accumulation && a.eye == b.eye
+           && a.center == b.center && a.up == b.up && a.fov == b.fov && a.color == b.color
+           && a.compensation == b.compensation;
+}
+
+// Random means of a few orders of magnitude, `uniformCount` or not
+static AccumulationCheckpoint makeRandomCheckpoint(uint32_t width, uint32_t height, bool uniformCount,
+                                                   bool compensation, uint32_t seed)
+{
+    std::mt19937                          rng(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    AccumulationCheckpoint checkpoint;
+    checkpoint.width        = width;
+    checkpoint.height       = height;
+    checkpoint.sceneHash    = hashSceneBytes(SCENE_HASH_SEED, &seed, sizeof(seed));
+    checkpoint.frameId      = 4321;
+    checkpoint.sampleFrame  = 9876;
+    checkpoint.accumulation = compensation ? 1 : 0;
+    checkpoint.eye          = nvmath::vec3f(1.0f, 2.0f, 3.0f);
+    checkpoint.center       = nvmath::vec3f(0.0f, 0.5f, 0.0f);
+    checkpoint.fov          = 60.0f;
+
+    size_t nbPixels = size_t(width) * height;
+    checkpoint.color.resize(4 * nbPixels);
+    for (size_t i = 0; i < nbPixels; i++) {
+        for (int c = 0; c < 3; c++) {
+            checkpoint.color[4 * i + c] = std::pow(10.0f, uniform(rng) * 4.0f - 2.0f);
+        }
+        checkpoint.color[4 * i + 3] = uniformCount ? 4322.0f : std::floor(uniform(rng) * 4322.0f);
+    }
+    if (compensation) {
+        checkpoint.compensation.resize(4 * nbPixels);
+        for (size_t i = 0; i < checkpoint.compensation.size(); i++) {
+            checkpoint.compensation[i] = (i % 4 == 3) ? 0 : static_cast<int8_t>(int(rng() % 31) - 15);  // Alpha unused
+        }
+    }
+    return checkpoint;
+}
+
+// -----------------------
+// Public Functions
+// -----------------------
+
+uint64_t hashSceneBytes(uint64_t hash, const void* data, size_t size)
+{
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+bool saveAccumulationCheckpoint(const std::string& filename, const AccumulationCheckpoint& checkpoint)
+{
+    size_t nbPixels = size_t(checkpoint.width) * checkpoint.height;
+    if (checkpoint.color.size() != 4 * nbPixels
+        || (!checkpoint.compensation.empty() && checkpoint.compensation.size() != 4 * nbPixels)) {
+        return false;
+    }
+
+    uint32_t flags = 0;
+    if (hasUniformCount(checkpoint.color)) {
+        flags |= CHECKPOINT_UNIFORM_COUNT;
+    }
+    if (!checkpoint.compensation.empty()) {
+        flags |= CHECKPOINT_COMPENSATION;
+    }
+
+    CheckpointWriter writer;
+    writer.write(CHECKPOINT_MAGIC);
+    writer.write(CHECKPOINT_VERSION);
+    writer.write(checkpoint.width);
+    writer.write(checkpoint.height);
+    writer.write(checkpoint.sceneHash);
+    writer.write(checkpoint.frameId);
+    writer.write(checkpoint.sampleFrame);
+    writer.write(checkpoint.accumulation);
+    writer.write(checkpoint.eye);
+    writer.write(checkpoint.center);
+    writer.write(checkpoint.up);
+    writer.write(checkpoint.fov);
+    writer.write(flags);
+
+    // Alpha, the count, separately: it is often the same for all the pixels
+    for (size_t i = 0; i < nbPixels; i++) {
+        writer.writeBytes(&checkpoint.color[4 * i], 3 * sizeof(float));
+    }
+    size_t nbCounts = (flags & CHECKPOINT_UNIFORM_COUNT) ? std::min<size_t>(nbPixels, 1) : nbPixels;
+    for (size_t i = 0; i < nbCounts; i++) {
+        writer.write(checkpoint.color[4 * i + 3]);
+    }
+    if (flags & CHECKPOINT_COMPENSATION) {
+        for (size_t i = 0; i < nbPixels; i++) {
+            writer.writeBytes(&checkpoint.compensation[4 * i], 3 * sizeof(int8_t));
+        }
+    }
+
+    auto& bytes = writer.getBytes();
+    writer.write(hashSceneBytes(SCENE_HASH_SEED, bytes.data(), bytes.size()));
+
+    std::string temporary = filename + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        if (!out) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, filename, error);
+    return !error;
+}
+
+bool loadAccumulationCheckpoint(const std::string& filename, AccumulationCheckpoint& checkpoint)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    uint64_t hash;
+    if (bytes.size() < sizeof(hash)) {
+        return false;
+    }
+    size_t size = bytes.size() - sizeof(hash);
+    std::memcpy(&hash, bytes.data() + size, sizeof(hash));
+    if (hash != hashSceneBytes(SCENE_HASH_SEED, bytes.data(), size)) {
+        return false;
+    }
+
+    CheckpointReader       reader(bytes, size);
+    AccumulationCheckpoint loaded;
+    uint32_t               magic, version, flags;
+    if (!reader.read(magic) || magic != CHECKPOINT_MAGIC || !reader.read(version) || version != CHECKPOINT_VERSION
+        || !reader.read(loaded.width) || !reader.read(loaded.height) || !reader.read(loaded.sceneHash)
+        || !reader.read(loaded.frameId) || !reader.read(loaded.sampleFrame) || !reader.read(loaded.accumulation)
+        || !reader.read(loaded.eye) || !reader.read(loaded.center) || !reader.read(loaded.up)
+        || !reader.read(loaded.fov) || !reader.read(flags)) {
+        return false;
+    }
+
+    // Bounds the allocations by the size of the file
+    size_t nbPixels = size_t(loaded.width) * loaded.height;
+    if (nbPixels > size / (3 * sizeof(float))) {
+        return false;
+    }
+
+    loaded.color.resize(4 * nbPixels);
+    for (size_t i = 0; i < nbPixels; i++) {
+        if (!reader.readBytes(&loaded.color[4 * i], 3 * sizeof(float))) {
+            return false;
+        }
+    }
+    if (flags & CHECKPOINT_UNIFORM_COUNT) {
+        float count = 0.0f;
+        if (nbPixels > 0 && !reader.read(count)) {
+            return false;
+        }
+        for (size_t i = 0; i < nbPixels; i++) {
+            loaded.color[4 * i + 3] = count;
+        }
+    } else {
+        for (size_t i = 0; i < nbPixels; i++) {
+            if (!reader.read(loaded.color[4 * i + 3])) {
+                return false;
+            }
+        }
+    }
+    if (flags & CHECKPOINT_COMPENSATION) {
+        loaded.compensation.resize(4 * nbPixels, 0);
+        for (size_t i = 0; i < nbPixels; i++) {
+            if (!reader.readBytes(&loaded.compensation[4 * i], 3 * sizeof(int8_t))) {
+                return false;
+            }
+        }
+    }
+    if (!reader.isComplete()) {
+        return false;
+    }
+
+    checkpoint = std::move(loaded);
+    return true;
+}
+
+AccumulationCheckpoint resampleAccumulationCheckpoint(const AccumulationCheckpoint& checkpoint, uint32_t width,
+                                                      uint32_t height)
+{
+    AccumulationCheckpoint resampled = checkpoint;
+    resampled.width                  = width;
+    resampled.height                 = height;
+    resampled.color.assign(4 * size_t(width) * height, 0.0f);
+    if (!checkpoint.compensation.empty()) {
+        resampled.compensation.assign(4 * size_t(width) * height, 0);
+    }
+    if (checkpoint.width == 0 || checkpoint.height == 0 || width == 0 || height == 0) {
+        return resampled;
+    }
+
+    // Same vertical field of view: the pixels of both images have the same
+    // angular size vertically and horizontally, the previous image is scaled
+    // by the ratio of the heights around the center
+    const double scale      = double(checkpoint.height) / double(height);
+    const float  countScale = static_cast<float>(std::min(1.0, scale * scale));
+    const int    srcWidth   = static_cast<int>(checkpoint.width);
+    const int    srcHeight  = static_cast<int>(checkpoint.height);
+
+    auto texel = [&](int x, int y) {
+        x = std::clamp(x, 0, srcWidth - 1);
+        y = std::clamp(y, 0, srcHeight - 1);
+        return &checkpoint.color[4 * (size_t(y) * checkpoint.width + x)];
+    };
+
+    for (uint32_t y = 0; y < height; y++) {
+        // Position in the previous image, its texel centers at integers
+        double sy = (y + 0.5 - 0.5 * height) * scale + 0.5 * checkpoint.height;
+        for (uint32_t x = 0; x < width; x++) {
+            double sx = (x + 0.5 - 0.5 * width) * scale + 0.5 * checkpoint.width;
+            if (sx < 0.0 || sx > checkpoint.width || sy < 0.0 || sy > checkpoint.height) {
+                continue;  // Not seen before
+            }
+
+            double px = sx - 0.5;
+            double py = sy - 0.5;
+            int    x0 = static_cast<int>(std::floor(px));
+            int    y0 = static_cast<int>(std::floor(py));
+            double fx = px - x0;
+            double fy = py - y0;
+
+            // Bilinear, each texel weighted by its frame count: the samples
+            // of all the taps are pooled
+            double sum[3]  = {0.0, 0.0, 0.0};
+            double samples = 0.0;
+            for (int tap = 0; tap < 4; tap++) {
+                int          dx = tap & 1;
+                int          dy = tap >> 1;
+                double       w  = (dx ? fx : 1.0 - fx) * (dy ? fy : 1.0 - fy);
+                const float* t  = texel(x0 + dx, y0 + dy);
+                double       n  = w * std::max(t[3], 0.0f);
+                for (int c = 0; c < 3; c++) {
+                    sum[c] += n * t[c];
+                }
+                samples += n;
+            }
+            if (samples <= 0.0) {
+                continue;
+            }
+
+            float* out = &resampled.color[4 * (size_t(y) * width + x)];
+            for (int c = 0; c < 3; c++) {
+                out[c] = static_cast<float>(sum[c] / samples);
+            }
+            out[3] = static_cast<float>(samples) * countScale;
+        }
+    }
+    return resampled;
+}
+
+bool checkAccumulationCheckpoint()
+{
+    bool ok = true;
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition) {
+            LOGE("Accumulation checkpoint: %s\n", what);
+            ok = false;
+        }
+    };
+
+    std::string filename =
+        (std::filesystem::temp_directory_path() / "rt_weekend_checkpoint_check.bin").string();
+
+    // Round trips: uniform counts and compensation, per pixel counts without
+    AccumulationCheckpoint uniform   = makeRandomCheckpoint(67, 31, true, true, 1);
+    AccumulationCheckpoint perPixel  = makeRandomCheckpoint(67, 31, false, false, 2);
+    AccumulationCheckpoint loaded;
+    uintmax_t              uniformSize  = 0;
+    uintmax_t              perPixelSize = 0;
+
+    expect(saveAccumulationCheckpoint(filename, uniform) && loadAccumulationCheckpoint(filename, loaded)
+               && checkpointEquals(uniform, loaded),
+           "round trip with uniform counts and compensation");
+    uniformSize = std::filesystem::file_size(filename);
+    expect(saveAccumulationCheckpoint(filename, perPixel) && loadAccumulationCheckpoint(filename, loaded)
+               && checkpointEquals(perPixel, loaded),
+           "round trip with per pixel counts");
+    perPixelSize = std::filesystem::file_size(filename);
+    expect(!std::filesystem::exists(filename + ".tmp"), "temporary file renamed");
+
+    // 12 bytes per pixel and a count, + 3 bytes of compensation
+    size_t nbPixels = 67 * 31;
+    expect(uniformSize + nbPixels * 4 == perPixelSize + 4 + nbPixels * 3, "size of the counts and compensation");
+
+    // Damaged files are rejected, the destination is left untouched
+    {
+        std::ifstream        in(filename, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+
+        auto writeBytes = [&](const std::vector<uint8_t>& content) {
+            std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(content.data()), content.size());
+        };
+
+        AccumulationCheckpoint untouched = uniform;
+        std::vector<uint8_t>   damaged   = bytes;
+        damaged[damaged.size() / 2] ^= 0x10;
+        writeBytes(damaged);
+        expect(!loadAccumulationCheckpoint(filename, untouched), "flipped bit rejected");
+
+        damaged.assign(bytes.begin(), bytes.begin() + bytes.size() / 3);
+        writeBytes(damaged);
+        expect(!loadAccumulationCheckpoint(filename, untouched), "truncated file rejected");
+
+        writeBytes({});
+        expect(!loadAccumulationCheckpoint(filename, untouched), "empty file rejected");
+        expect(checkpointEquals(untouched, uniform), "checkpoint untouched on failure");
+    }
+    std::filesystem::remove(filename);
+    expect(!loadAccumulationCheckpoint(filename, loaded), "missing file rejected");
+
+    // Same size: unchanged but the compensation, restarted
+    {
+        AccumulationCheckpoint same = resampleAccumulationCheckpoint(perPixel, perPixel.width, perPixel.height);
+        expect(same.color == perPixel.color, "resampling to the same size");
+
+        AccumulationCheckpoint restarted = resampleAccumulationCheckpoint(uniform, 10, 10);
+        expect(restarted.compensation.size() == 4 * 100
+                   && std::all_of(restarted.compensation.begin(), restarted.compensation.end(),
+                                  [](int8_t steps) { return steps == 0; }),
+               "compensation restarted");
+    }
+
+    // Tangent of the direction of each pixel, in units of tan(fov / 2): linear
+    // in the pixels, reproduced by the bilinear interpolation for any size
+    AccumulationCheckpoint directions;
+    directions.width  = 64;
+    directions.height = 48;
+    directions.color.resize(4 * 64 * 48);
+    for (uint32_t y = 0; y < directions.height; y++) {
+        for (uint32_t x = 0; x < directions.width; x++) {
+            float* texel = &directions.color[4 * (y * directions.width + x)];
+            texel[0]     = (2.0f * (x + 0.5f) - directions.width) / directions.height;
+            texel[1]     = (2.0f * (y + 0.5f) - directions.height) / directions.height;
+            texel[2]     = 1.0f;
+            texel[3]     = 100.0f;
+        }
+    }
+
+    const uint32_t sizes[][2] = {{128, 96}, {32, 24}, {100, 48}, {40, 60}};
+    for (const auto& size : sizes) {
+        uint32_t               width     = size[0];
+        uint32_t               height    = size[1];
+        AccumulationCheckpoint resampled = resampleAccumulationCheckpoint(directions, width, height);
+        float                  scale     = float(directions.height) / float(height);
+        float                  maxError  = 0.0f;
+        bool                   seen      = true;
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                const float* texel = &resampled.color[4 * (y * width + x)];
+                float        tx    = (2.0f * (x + 0.5f) - width) / height;
+                float        ty    = (2.0f * (y + 0.5f) - height) / height;
+
+                // Inside the previous view, away from the clamped border texels
+                bool inside = std::abs(tx) * directions.height <= directions.width - 1.0f - 1e-3f
+                              && std::abs(ty) * directions.height <= directions.height - 1.0f - 1e-3f;
+                bool outside = std::abs(tx) * directions.height > float(directions.width);
+                if (inside) {
+                    maxError = std::max({maxError, std::abs(texel[0] - tx), std::abs(texel[1] - ty)});
+                    seen     = seen && std::abs(texel[3] - 100.0f * std::min(1.0f, scale * scale)) < 1e-3f;
+                } else if (outside) {
+                    seen = seen && texel[3] == 0.0f;
+                }
+            }
+        }
+        expect(maxError < 1e-5f, "resampled pixels keep their directions");
+        expect(seen, "resampled frame counts");
+    }
+
+    LOGI("Accumulation checkpoint: %s\n", ok ? "OK" : "FAILED");
+    return ok;
+}
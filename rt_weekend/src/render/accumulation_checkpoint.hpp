@@ -0,0 +1,68 @@
+#ifndef ACCUMULATION_CHECKPOINT_HPP
+#define ACCUMULATION_CHECKPOINT_HPP
+
+#include <nvmath/nvmath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// State of a long accumulation in the offscreen image, read back from the
+// device to resume it after a restart or a resize, see render/accumulation.hpp
+// for the content of the images.
+//
+// File layout, little-endian as written by the host:
+// - header: magic, version, size, scene hash, frame indices, mode, camera and
+//   flags
+// - running mean of the pixels, RGB32F
+// - frame count of the pixels, one float when they all have the same (the
+//   whole image traced each frame), else one per pixel
+// - compensation of the mean, RGB8 steps, in the compensated mode only
+// - FNV-1a hash of all the above: a file cut short by a crash or damaged is
+//   rejected instead of resuming garbage
+// The file is written next to the destination then renamed over it, a crash
+// while saving keeps the previous checkpoint.
+
+struct AccumulationCheckpoint {
+    uint32_t      width{0};
+    uint32_t      height{0};
+    uint64_t      sceneHash{0};     // Of what the accumulated image depends on, see hashSceneBytes()
+    int32_t       frameId{-1};      // Of the last accumulated frame
+    int32_t       sampleFrame{0};   // Next frame in the sample sequence
+    int32_t       accumulation{0};  // AccumulationMode
+    nvmath::vec3f eye{0.0f, 0.0f, 0.0f};
+    nvmath::vec3f center{0.0f, 0.0f, 0.0f};
+    nvmath::vec3f up{0.0f, 1.0f, 0.0f};
+    float         fov{0.0f};  // Vertical, in degrees
+
+    std::vector<float>    color;         // RGBA32F texels: mean and count, row-major
+    std::vector<int8_t>   compensation;  // RGBA8 texels, see getCompensationSteps(), empty in the average mode
+};
+
+// Seed of hashSceneBytes()
+static constexpr uint64_t SCENE_HASH_SEED = 0xCBF29CE484222325ULL;
+
+// FNV-1a of `size` bytes, continuing `hash`
+uint64_t hashSceneBytes(uint64_t hash, const void* data, size_t size);
+
+// False if the file can't be written, the previous one is then kept
+bool saveAccumulationCheckpoint(const std::string& filename, const AccumulationCheckpoint& checkpoint);
+
+// False if the file is missing, of another version, truncated or damaged;
+// `checkpoint` is only modified on success
+bool loadAccumulationCheckpoint(const std::string& filename, AccumulationCheckpoint& checkpoint);
+
+// Accumulation resampled to `width` x `height` with the same camera: the
+// vertical field of view is kept, the horizontal one follows the aspect ratio.
+// The pixels are interpolated from the nearest ones of the same direction,
+// weighted by their frame counts; those outside of the previous view start
+// with no history. Upscaled pixels keep proportionally fewer frames, the new
+// ones refine them faster. The compensation restarts from 0.
+AccumulationCheckpoint resampleAccumulationCheckpoint(const AccumulationCheckpoint& checkpoint, uint32_t width,
+                                                      uint32_t height);
+
+// Round trip through files in the temporary directory, rejection of damaged
+// files and resampling of analytic images, without device
+bool checkAccumulationCheckpoint();
+
+
+#endif
@@ -0,0 +1,188 @@
+#include "geometry_arena.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <cassert>
+
+static const char* streamName(GeometryArena::Stream stream)
+{
+    switch (stream) {
+        case GeometryArena::VERTICES: return "vertices";
+        case GeometryArena::INDICES: return "indices";
+        case GeometryArena::MATERIALS: return "materials";
+        case GeometryArena::MAT_INDICES: return "material indices";
+        default: return "unknown";
+    }
+}
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+void GeometryArena::init(vk::Device device, nvvk::AllocatorDedicated* alloc, vk::DeviceSize blockSize)
+{
+    _device    = device;
+    _alloc     = alloc;
+    // Offsets of the range allocator are 32 bits
+    blockSize  = std::min<vk::DeviceSize>(blockSize, UINT32_MAX - 255);
+    _blockSize = nvh::TRangeAllocator<256>::alignedSize(static_cast<uint32_t>(blockSize));
+}
+
+void GeometryArena::deinit()
+{
+    for (auto& blocks : _blocks) {
+        for (auto& block : blocks) {
+            destroyBlock(block);
+        }
+        blocks.clear();
+    }
+}
+
+GeometryArena::Range GeometryArena::allocate(Stream stream, vk::DeviceSize size, uint32_t alignment)
+{
+    Range range;
+    range.stream = stream;
+
+    // Empty models still get a valid address
+    vk::DeviceSize reserved = std::max<vk::DeviceSize>(size, 4) + alignment;
+    if (reserved > UINT32_MAX - 255) {
+        return range;
+    }
+
+    auto& blocks = _blocks[stream];
+    uint32_t dataSize = static_cast<uint32_t>(std::max<vk::DeviceSize>(size, 4));
+
+    // First block with room for it, a new one otherwise
+    uint32_t b = 0;
+    for (; b < blocks.size(); b++) {
+        Block& block = blocks[b];
+        if (block.buffer.buffer != VK_NULL_HANDLE
+            && block.range.subAllocate(dataSize, alignment, range.allocOffset, range.offset, range.allocSize)) {
+            break;
+        }
+    }
+    if (b == blocks.size()) {
+        vk::DeviceSize blockSize = nvh::TRangeAllocator<256>::alignedSize(static_cast<uint32_t>(reserved));
+        b = createBlock(stream, std::max(_blockSize, blockSize));
+        bool allocated = blocks[b].range.subAllocate(dataSize, alignment, range.allocOffset, range.offset, range.allocSize);
+        assert(allocated);
+        (void)allocated;
+    }
+
+    Block& block = blocks[b];
+    block.nbRanges++;
+    block.usedBytes += size;
+    block.reservedBytes += range.allocSize;
+
+    range.block   = b;
+    range.size    = static_cast<uint32_t>(size);
+    range.buffer  = block.buffer.buffer;
+    range.address = block.address + range.offset;
+    return range;
+}
+
+void GeometryArena::free(Range& range)
+{
+    if (!range.isValid()) {
+        return;
+    }
+
+    auto&  blocks = _blocks[range.stream];
+    Block& block  = blocks[range.block];
+    assert(block.nbRanges > 0);
+
+    block.range.subFree(range.allocOffset, range.allocSize);
+    block.nbRanges--;
+    block.usedBytes -= range.size;
+    block.reservedBytes -= range.allocSize;
+
+    if (block.nbRanges == 0 && range.block > 0) {
+        destroyBlock(block);
+    }
+
+    range = Range{};
+}
+
+Uploader::Ticket GeometryArena::upload(Uploader& uploader, const Range& range, const void* data, vk::DeviceSize size)
+{
+    assert(range.isValid() && size <= range.size);
+    return uploader.uploadBuffer(range.buffer, range.offset, data, size);
+}
+
+GeometryArena::StreamStats GeometryArena::getStats(Stream stream) const
+{
+    StreamStats stats;
+    for (const auto& block : _blocks[stream]) {
+        if (block.buffer.buffer == VK_NULL_HANDLE) {
+            continue;
+        }
+        stats.nbBlocks++;
+        stats.nbRanges += block.nbRanges;
+        stats.allocatedBytes += block.size;
+        stats.usedBytes += block.usedBytes;
+        stats.reservedBytes += block.reservedBytes;
+    }
+    return stats;
+}
+
+void GeometryArena::printStats() const
+{
+    for (uint32_t s = 0; s < NB_STREAMS; s++) {
+        StreamStats stats = getStats(static_cast<Stream>(s));
+        LOGI("Geometry arena, %s: %u ranges in %u blocks, %.1f / %.1f MB used (%.1f MB reserved)\n",
+             streamName(static_cast<Stream>(s)), stats.nbRanges, stats.nbBlocks, stats.usedBytes / (1024.0 * 1024.0),
+             stats.allocatedBytes / (1024.0 * 1024.0), stats.reservedBytes / (1024.0 * 1024.0));
+    }
+}
+
+// -----------------------
+// Private Methods
+// -----------------------
+
+uint32_t GeometryArena::createBlock(Stream stream, vk::DeviceSize size)
+{
+    auto& blocks = _blocks[stream];
+
+    // Reuse the slot of a destroyed block, so that the indices of the others stay valid
+    uint32_t b = 0;
+    while (b < blocks.size() && blocks[b].buffer.buffer != VK_NULL_HANDLE) {
+        b++;
+    }
+    if (b == blocks.size()) {
+        blocks.emplace_back();
+    }
+
+    Block& block  = blocks[b];
+    block.buffer  = _alloc->createBuffer(size, getUsage(stream), vk::MemoryPropertyFlagBits::eDeviceLocal);
+    block.address = _device.getBufferAddress({block.buffer.buffer});
+    block.size    = size;
+    block.range.init(static_cast<uint32_t>(size));
+    return b;
+}
+
+void GeometryArena::destroyBlock(Block& block)
+{
+    if (block.buffer.buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    block.range.deinit();
+    _alloc->destroy(block.buffer);
+    block.address       = 0;
+    block.size          = 0;
+    block.nbRanges      = 0;
+    block.usedBytes     = 0;
+    block.reservedBytes = 0;
+}
+
+vk::BufferUsageFlags GeometryArena::getUsage(Stream stream)
+{
+    using vkBU = vk::BufferUsageFlagBits;
+    vk::BufferUsageFlags usage = vkBU::eStorageBuffer | vkBU::eShaderDeviceAddress | vkBU::eTransferDst;
+    switch (stream) {
+        case VERTICES:
+            return usage | vkBU::eVertexBuffer | vkBU::eAccelerationStructureBuildInputReadOnlyKHR;
+        case INDICES:
+            return usage | vkBU::eIndexBuffer | vkBU::eAccelerationStructureBuildInputReadOnlyKHR;
+        default:
+            return usage;
+    }
+}
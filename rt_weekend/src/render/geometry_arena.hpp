@@ -0,0 +1,106 @@
+#ifndef GEOMETRY_ARENA_HPP
+#define GEOMETRY_ARENA_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#define NVVK_ALLOC_DEDICATED
+
+#include <nvh/trangeallocator.hpp>
+#include <nvvk/allocator_vk.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "uploader.hpp"
+
+// Sub-allocates the mesh data of all the models from a few large device
+// buffers, one list of blocks per stream. A model takes one range in each
+// stream instead of four dedicated buffers, the ranges of the models loaded
+// together end up next to each other.
+//
+// Blocks are created on demand with the default block size, or the size of
+// the range if larger. A freed range can be reused right away: the caller
+// makes sure the GPU is done with it, as for a destroyed buffer. Empty blocks
+// other than the first of each stream are released.
+class GeometryArena {
+public:
+    enum Stream : uint32_t {
+        VERTICES = 0,
+        INDICES,
+        MATERIALS,
+        MAT_INDICES,
+        NB_STREAMS
+    };
+
+    static constexpr uint32_t       INVALID_BLOCK      = ~0U;
+    static constexpr vk::DeviceSize DEFAULT_BLOCK_SIZE = 64ULL * 1024 * 1024;
+
+    struct Range {
+        Stream            stream{VERTICES};
+        uint32_t          block{INVALID_BLOCK};
+        uint32_t          allocOffset{0};  // Granularity aligned, as returned by the range allocator
+        uint32_t          allocSize{0};
+        uint32_t          offset{0};       // Of the data in the buffer
+        uint32_t          size{0};         // Of the data
+        vk::Buffer        buffer;
+        vk::DeviceAddress address{0};      // Of the data
+
+        bool isValid() const { return block != INVALID_BLOCK; }
+    };
+
+    struct StreamStats {
+        uint32_t       nbBlocks{0};
+        uint32_t       nbRanges{0};
+        vk::DeviceSize allocatedBytes{0};  // Device memory of the blocks
+        vk::DeviceSize usedBytes{0};       // Data of the ranges
+        vk::DeviceSize reservedBytes{0};   // Including the granularity and alignment padding
+    };
+
+    void init(vk::Device device, nvvk::AllocatorDedicated* alloc, vk::DeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    void deinit();
+
+    // Invalid range if the size cannot be held by a block (4 GB)
+    Range allocate(Stream stream, vk::DeviceSize size, uint32_t alignment = 16);
+    void  free(Range& range);
+
+    // Copies `size` bytes to the beginning of the range, the range must not
+    // be read before the returned ticket completed
+    Uploader::Ticket upload(Uploader& uploader, const Range& range, const void* data, vk::DeviceSize size);
+
+    template <typename T>
+    Range allocateAndUpload(Uploader& uploader, Stream stream, const std::vector<T>& data, uint32_t alignment = 16)
+    {
+        Range range = allocate(stream, sizeof(T) * data.size(), alignment);
+        if (range.isValid()) {
+            upload(uploader, range, data.data(), sizeof(T) * data.size());
+        }
+        return range;
+    }
+
+    StreamStats getStats(Stream stream) const;
+    void        printStats() const;
+
+private:
+    struct Block {
+        nvvk::Buffer              buffer;
+        vk::DeviceAddress         address{0};
+        vk::DeviceSize            size{0};
+        uint32_t                  nbRanges{0};
+        vk::DeviceSize            usedBytes{0};
+        vk::DeviceSize            reservedBytes{0};
+        nvh::TRangeAllocator<256> range;
+    };
+
+    uint32_t createBlock(Stream stream, vk::DeviceSize size);
+    void     destroyBlock(Block& block);
+
+    static vk::BufferUsageFlags getUsage(Stream stream);
+
+    vk::Device                                 _device;
+    nvvk::AllocatorDedicated*                  _alloc{nullptr};
+    vk::DeviceSize                             _blockSize{DEFAULT_BLOCK_SIZE};
+    std::array<std::vector<Block>, NB_STREAMS> _blocks;  // Destroyed blocks stay as empty slots
+};
+
+
+#endif
@@ -0,0 +1,266 @@
+#include "image_writer.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "fileformats/stb_image_write.h"
+#include "fileformats/stb_image.h"
+
+// -----------------------
+// Helpers
+// -----------------------
+
+static std::string getExtension(const std::string& filename)
+{
+    size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos) {
+        return "";
+    }
+    std::string extension = filename.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+// Negative and NaN values to 0
+static float toRadiance(float value)
+{
+    return value > 0.0f ? value : 0.0f;
+}
+
+// Same transfer as post.frag
+static uint8_t toDisplay(float value)
+{
+    float encoded = std::pow(std::min(toRadiance(value), 1.0f), 1.0f / 2.2f);
+    return static_cast<uint8_t>(encoded * 255.0f + 0.5f);
+}
+
+// -----------------------
+// Public Functions
+// -----------------------
+
+void writeImage(const std::string& filename, uint32_t width, uint32_t height, const std::vector<float>& rgba)
+{
+    if (rgba.size() < size_t(width) * height * 4) {
+        throw std::runtime_error("Not enough texels to write " + filename);
+    }
+
+    const size_t nbPixels  = size_t(width) * height;
+    std::string  extension = getExtension(filename);
+    int          w         = static_cast<int>(width);
+    int          h         = static_cast<int>(height);
+    int          written   = 0;
+
+    if (isLinearImageFormat(filename)) {
+        // RGBE can't hold negative values, they would wrap around
+        std::vector<float> rgb(nbPixels * 3);
+        for (size_t i = 0; i < nbPixels; i++) {
+            for (size_t c = 0; c < 3; c++) {
+                rgb[i * 3 + c] = toRadiance(rgba[i * 4 + c]);
+            }
+        }
+        written = stbi_write_hdr(filename.c_str(), w, h, 3, rgb.data());
+    } else {
+        std::vector<uint8_t> rgb(nbPixels * 3);
+        for (size_t i = 0; i < nbPixels; i++) {
+            for (size_t c = 0; c < 3; c++) {
+                rgb[i * 3 + c] = toDisplay(rgba[i * 4 + c]);
+            }
+        }
+        if (extension == "png") {
+            written = stbi_write_png(filename.c_str(), w, h, 3, rgb.data(), w * 3);
+        } else if (extension == "jpg" || extension == "jpeg") {
+            written = stbi_write_jpg(filename.c_str(), w, h, 3, rgb.data(), 95);
+        } else if (extension == "bmp") {
+            written = stbi_write_bmp(filename.c_str(), w, h, 3, rgb.data());
+        } else if (extension == "tga") {
+            written = stbi_write_tga(filename.c_str(), w, h, 3, rgb.data());
+        } else {
+            throw std::runtime_error("Unsupported image format: " + filename);
+        }
+    }
+
+    if (!written) {
+        throw std::runtime_error("Could not write " + filename);
+    }
+}
+
+bool isLinearImageFormat(const std::string& filename)
+{
+    return getExtension(filename) == "hdr";
+}
+
+float halfToFloat(uint16_t value)
+{
+    uint32_t sign     = uint32_t(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+
+    uint32_t bits;
+    if (exponent == 0x1F) {
+        // Infinity or NaN
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+        // Subnormal, normalized as a float
+        exponent = 113;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    } else {
+        bits = sign;
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+std::vector<float> halfToFloat(const std::vector<uint16_t>& values)
+{
+    std::vector<float> result(values.size());
+    std::transform(values.begin(), values.end(), result.begin(), [](uint16_t v) { return halfToFloat(v); });
+    return result;
+}
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign      = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    if (magnitude >= 0x7F800000) {
+        // Infinity or NaN, kept quiet
+        return static_cast<uint16_t>(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+    }
+    if (magnitude >= 0x477FF000) {
+        // 65520, the largest half plus half an ulp, and above
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    if (magnitude < 0x38800000) {
+        // Below 2^-14: subnormal, in steps of 2^-24
+        float subnormal;
+        std::memcpy(&subnormal, &magnitude, sizeof(subnormal));
+        return static_cast<uint16_t>(sign | uint32_t(std::nearbyint(subnormal * 16777216.0f)));
+    }
+
+    // Exponent rebiased, 13 bits of mantissa dropped, ties to even. A carry
+    // out of the mantissa increments the exponent.
+    uint32_t half      = (magnitude >> 13) - (112 << 10);
+    uint32_t remainder = magnitude & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+bool checkImageWriter()
+{
+    bool ok = true;
+
+    // Every half against its definition
+    uint32_t mismatches = 0;
+    for (uint32_t h = 0; h < 0x10000; h++) {
+        uint32_t exponent = (h >> 10) & 0x1F;
+        uint32_t mantissa = h & 0x3FF;
+        if (exponent == 0x1F) {
+            continue;
+        }
+        float expected = exponent == 0 ? std::ldexp(float(mantissa), -24)
+                                       : std::ldexp(1.0f + float(mantissa) / 1024.0f, int(exponent) - 15);
+        if (h & 0x8000) {
+            expected = -expected;
+        }
+        mismatches += halfToFloat(static_cast<uint16_t>(h)) != expected;
+    }
+    bool specials = std::isinf(halfToFloat(0x7C00)) && std::isnan(halfToFloat(0x7E00));
+    LOGI("Half to float: %u mismatches%s\n", mismatches, specials ? "" : ", wrong infinity or NaN");
+    ok = ok && mismatches == 0 && specials;
+
+    // And back: every half exactly, the midpoints between two halves to the
+    // even one, overflow
+    mismatches = 0;
+    for (uint32_t h = 0; h < 0x7C00; h++) {
+        for (uint32_t sign : {0u, 0x8000u}) {
+            mismatches += floatToHalf(halfToFloat(static_cast<uint16_t>(h | sign))) != (h | sign);
+        }
+        float midpoint = 0.5f * (halfToFloat(static_cast<uint16_t>(h)) + halfToFloat(static_cast<uint16_t>(h + 1)));
+        mismatches += floatToHalf(midpoint) != ((h & 1) ? h + 1 : h);
+    }
+    specials = floatToHalf(65519.0f) == 0x7BFF && floatToHalf(65520.0f) == 0x7C00
+               && floatToHalf(-std::numeric_limits<float>::infinity()) == 0xFC00
+               && (floatToHalf(std::numeric_limits<float>::quiet_NaN()) & 0x7E00) == 0x7E00;
+    LOGI("Float to half: %u mismatches%s\n", mismatches, specials ? "" : ", wrong overflow, infinity or NaN");
+    ok = ok && mismatches == 0 && specials;
+
+    // Gradient with values out of the displayable range
+    const uint32_t     width = 67, height = 33;
+    std::vector<float> rgba(size_t(width) * height * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            float* texel = &rgba[(size_t(y) * width + x) * 4];
+            texel[0]     = float(x) / float(width - 1);
+            texel[1]     = float(y) / float(height - 1) * 4.0f;
+            texel[2]     = 0.5f - float(x + y) / 64.0f;
+            texel[3]     = 1.0f;
+        }
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    for (const char* extension : {"png", "bmp", "tga", "hdr"}) {
+        std::string filename = (directory / (std::string("image_writer_check.") + extension)).string();
+        float       maxError = 0.0f;
+        bool        loaded   = false;
+        try {
+            writeImage(filename, width, height, rgba);
+            int w = 0, h = 0, channels = 0;
+            if (std::strcmp(extension, "hdr") == 0) {
+                float* pixels = stbi_loadf(filename.c_str(), &w, &h, &channels, 3);
+                loaded        = pixels && uint32_t(w) == width && uint32_t(h) == height;
+                for (size_t i = 0; loaded && i < size_t(width) * height * 3; i++) {
+                    float expected = rgba[(i / 3) * 4 + i % 3];
+                    // RGBE shares the exponent of the largest channel
+                    float scale = std::max({rgba[(i / 3) * 4], rgba[(i / 3) * 4 + 1], rgba[(i / 3) * 4 + 2]});
+                    maxError    = std::max(maxError, std::abs(toRadiance(expected) - pixels[i]) / std::max(scale, 1e-3f));
+                }
+                stbi_image_free(pixels);
+            } else {
+                stbi_uc* pixels = stbi_load(filename.c_str(), &w, &h, &channels, 3);
+                loaded          = pixels && uint32_t(w) == width && uint32_t(h) == height;
+                for (size_t i = 0; loaded && i < size_t(width) * height * 3; i++) {
+                    maxError = std::max(maxError, std::abs(float(toDisplay(rgba[(i / 3) * 4 + i % 3])) - float(pixels[i])));
+                }
+                stbi_image_free(pixels);
+            }
+        } catch (const std::exception& e) {
+            LOGE("%s\n", e.what());
+        }
+        std::remove(filename.c_str());
+
+        // Lossless encoders, RGBE keeps 8 bits of mantissa
+        bool pass = loaded && maxError <= (std::strcmp(extension, "hdr") == 0 ? 1.0f / 128.0f : 0.0f);
+        LOGI("%s: %ux%u, max error %g%s\n", extension, width, height, maxError, pass ? "" : "  FAILED");
+        ok = ok && pass;
+    }
+
+    // Unknown formats are refused
+    bool refused = false;
+    try {
+        writeImage((directory / "image_writer_check.xyz").string(), width, height, rgba);
+    } catch (const std::runtime_error&) {
+        refused = true;
+    }
+    LOGI("Unknown format %s\n", refused ? "refused" : "accepted  FAILED");
+    return ok && refused;
+}
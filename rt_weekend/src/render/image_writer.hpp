@@ -0,0 +1,34 @@
+#ifndef IMAGE_WRITER_HPP
+#define IMAGE_WRITER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Encoding of the images read back from the device by the headless mode.
+// The texels are linear RGBA, row-major from the top row, as the ray tracing
+// writes them; only RGB is kept.
+//
+// The extension of the file selects the format: .hdr keeps the linear
+// radiance, .png, .jpg, .bmp and .tga are gamma corrected as post.frag does
+// and quantized to 8 bits. Throws std::runtime_error if the extension is not
+// supported or the file can't be written.
+void writeImage(const std::string& filename, uint32_t width, uint32_t height, const std::vector<float>& rgba);
+
+// Whether writeImage keeps the linear radiance in `filename`, the other
+// formats expect a tone mapped image
+bool isLinearImageFormat(const std::string& filename);
+
+// IEEE 754 half floats, the texels of the 16-bit float images, to floats
+float              halfToFloat(uint16_t value);
+std::vector<float> halfToFloat(const std::vector<uint16_t>& values);
+
+// And back, rounded to the nearest even half float as uploaded to them
+uint16_t floatToHalf(float value);
+
+// Round trip of the conversions and of the encoders through files in the
+// temporary directory, without device
+bool checkImageWriter();
+
+
+#endif
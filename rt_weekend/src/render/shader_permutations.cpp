@@ -0,0 +1,163 @@
+#include "shader_permutations.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+static constexpr uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+static constexpr uint64_t FNV_PRIME        = 0x100000001B3ULL;
+
+// -----------------------
+// Helpers
+// -----------------------
+
+static uint64_t hashBytes(uint64_t hash, const uint8_t* bytes, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Little endian whatever the platform
+static uint64_t hashWord(uint64_t hash, uint32_t word)
+{
+    const uint8_t bytes[4] = {uint8_t(word), uint8_t(word >> 8), uint8_t(word >> 16), uint8_t(word >> 24)};
+    return hashBytes(hash, bytes, sizeof(bytes));
+}
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+ShaderPermutationKey::ShaderPermutationKey(std::string shader)
+    : _shader(std::move(shader))
+{
+    updateHash();
+}
+
+ShaderPermutationKey& ShaderPermutationKey::set(uint32_t id, uint32_t value)
+{
+    auto it = std::lower_bound(_constants.begin(), _constants.end(), id,
+                               [](const Constant& constant, uint32_t id) { return constant.id < id; });
+    if (it != _constants.end() && it->id == id) {
+        it->value = value;
+    } else {
+        _constants.insert(it, {id, value});
+    }
+    updateHash();
+    return *this;
+}
+
+bool ShaderPermutationKey::operator==(const ShaderPermutationKey& other) const
+{
+    if (_hash != other._hash || _shader != other._shader || _constants.size() != other._constants.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < _constants.size(); ++i) {
+        if (_constants[i].id != other._constants[i].id || _constants[i].value != other._constants[i].value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkShaderPermutations()
+{
+    bool ok    = true;
+    auto check = [&](bool condition, const char* what) {
+        if (!condition) {
+            LOGE("Shader permutations: %s\n", what);
+            ok = false;
+        }
+    };
+
+    // FNV-1a reference values
+    check(ShaderPermutationKey().getHash() == FNV_OFFSET_BASIS, "hash of the empty key");
+    check(ShaderPermutationKey("a").getHash() == 0xAF63DC4C8601EC8CULL, "hash of \"a\"");
+
+    // Order of the constants and overrides
+    ShaderPermutationKey a("spv/raytrace_sphere.rchit.spv");
+    ShaderPermutationKey b("spv/raytrace_sphere.rchit.spv");
+    a.set(SHADER_CONSTANT_PATH_ITERATIVE, 1).set(SHADER_CONSTANT_MAX_PATH_DEPTH, 8).set(SHADER_CONSTANT_MATERIAL, 2);
+    b.set(SHADER_CONSTANT_MATERIAL, 0).set(SHADER_CONSTANT_MAX_PATH_DEPTH, 8).set(SHADER_CONSTANT_PATH_ITERATIVE, 1);
+    check(a != b && a.getHash() != b.getHash(), "keys differing by a value");
+    b.set(SHADER_CONSTANT_MATERIAL, 2);
+    check(a == b && a.getHash() == b.getHash(), "keys set in a different order");
+    check(b.getConstants().size() == 3, "override of a constant");
+    check(a != ShaderPermutationKey("spv/raytrace_mesh.rchit.spv").set(SHADER_CONSTANT_PATH_ITERATIVE, 1)
+                      .set(SHADER_CONSTANT_MAX_PATH_DEPTH, 8).set(SHADER_CONSTANT_MATERIAL, 2),
+          "keys of different shaders");
+
+    // Every permutation the application can request: path depths up to 16,
+    // iterative or not, with environment sampling or not, the sphere
+    // materials and the wavefront shading models
+    std::vector<ShaderPermutationKey> keys;
+    for (uint32_t depth = 1; depth <= 16; ++depth) {
+        for (uint32_t iterative = 0; iterative < 2; ++iterative) {
+            for (uint32_t environment = 0; environment < 2; ++environment) {
+                for (const char* shader :
+                     {"spv/raytrace.rgen.spv", "spv/raytrace.rmiss.spv", "spv/raytrace_mesh.rchit.spv"}) {
+                    keys.push_back(ShaderPermutationKey(shader)
+                                       .set(SHADER_CONSTANT_PATH_ITERATIVE, iterative)
+                                       .set(SHADER_CONSTANT_MAX_PATH_DEPTH, depth)
+                                       .set(SHADER_CONSTANT_SAMPLE_ENVIRONMENT, environment));
+                }
+                for (uint32_t material = 0; material < 3; ++material) {
+                    keys.push_back(ShaderPermutationKey("spv/raytrace_sphere.rchit.spv")
+                                       .set(SHADER_CONSTANT_PATH_ITERATIVE, iterative)
+                                       .set(SHADER_CONSTANT_MAX_PATH_DEPTH, depth)
+                                       .set(SHADER_CONSTANT_MATERIAL, material)
+                                       .set(SHADER_CONSTANT_SAMPLE_ENVIRONMENT, environment));
+                }
+            }
+        }
+        for (uint32_t model = 0; model < 5; ++model) {
+            keys.push_back(ShaderPermutationKey("spv/wavefront_shade.comp.spv")
+                               .set(SHADER_CONSTANT_MATERIAL, model)
+                               .set(SHADER_CONSTANT_MAX_PATH_DEPTH, depth));
+        }
+    }
+    std::unordered_set<uint64_t> hashes;
+    for (const auto& key : keys) {
+        hashes.insert(key.getHash());
+    }
+    check(hashes.size() == keys.size(), "hash collision between the permutations");
+
+    // Created once, then found
+    ShaderPermutationCache<uint32_t> cache;
+    uint32_t                         created = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto& key : keys) {
+            uint32_t& variant = cache.get(key, [&](const ShaderPermutationKey&) { return created++; });
+            check(cache.find(key) == &variant, "variant not found after creation");
+        }
+    }
+    check(created == keys.size() && cache.size() == keys.size(), "variants created more than once");
+    check(cache.getStats().misses == keys.size() && cache.getStats().hits == keys.size(), "hit and miss counts");
+    LOGI("Shader permutations: %zu variants, %u misses, %u hits\n", cache.size(), cache.getStats().misses,
+         cache.getStats().hits);
+
+    uint32_t destroyed = 0;
+    cache.clear([&](uint32_t&) { destroyed++; });
+    check(destroyed == keys.size() && cache.size() == 0 && cache.find(keys[0]) == nullptr, "clear");
+
+    if (ok) {
+        LOGI("Shader permutations: OK\n");
+    }
+    return ok;
+}
+
+// -----------------------
+// Private Methods
+// -----------------------
+
+void ShaderPermutationKey::updateHash()
+{
+    uint64_t hash = hashBytes(FNV_OFFSET_BASIS, reinterpret_cast<const uint8_t*>(_shader.data()), _shader.size());
+    for (const Constant& constant : _constants) {
+        hash = hashWord(hash, constant.id);
+        hash = hashWord(hash, constant.value);
+    }
+    _hash = hash;
+}
@@ -0,0 +1,111 @@
+#ifndef SHADER_PERMUTATIONS_HPP
+#define SHADER_PERMUTATIONS_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// `constant_id` of the specialization constants of the shaders, see raycommon.glsl
+enum ShaderConstant : uint32_t {
+    SHADER_CONSTANT_PATH_ITERATIVE     = 0,
+    SHADER_CONSTANT_MAX_PATH_DEPTH     = 1,
+    SHADER_CONSTANT_MATERIAL           = 2,  // SPHERE_MATERIAL of the sphere hits, SHADE_MODEL of wavefront_shade.comp
+    SHADER_CONSTANT_SAMPLE_ENVIRONMENT = 3,
+};
+
+// One variant of a shader: its SPIR-V file and the values of its
+// specialization constants. The constants are kept sorted by id, the key does
+// not depend on the order they are set in. The hash is FNV-1a over the file
+// name and the (id, value) pairs: stable across runs and platforms.
+class ShaderPermutationKey {
+public:
+    struct Constant {
+        uint32_t id;
+        uint32_t value;  // 32 bits, VkBool32 for booleans
+    };
+
+    ShaderPermutationKey() : ShaderPermutationKey(std::string()) {}
+    explicit ShaderPermutationKey(std::string shader);
+
+    // Sets `constant_id = id`, replaces its previous value
+    ShaderPermutationKey& set(uint32_t id, uint32_t value);
+
+    const std::string&           getShader() const { return _shader; }
+    const std::vector<Constant>& getConstants() const { return _constants; }
+    uint64_t                     getHash() const { return _hash; }
+
+    bool operator==(const ShaderPermutationKey& other) const;
+    bool operator!=(const ShaderPermutationKey& other) const { return !(*this == other); }
+
+    struct Hasher {
+        size_t operator()(const ShaderPermutationKey& key) const { return static_cast<size_t>(key.getHash()); }
+    };
+
+private:
+    void updateHash();
+
+    std::string           _shader;
+    std::vector<Constant> _constants;  // Sorted by id
+    uint64_t              _hash;
+};
+
+struct ShaderPermutationStats {
+    uint32_t hits{0};
+    uint32_t misses{0};  // Variants created
+};
+
+// Variants created on their first use and kept until clear(): switching
+// between permutations only creates the ones never used before. T holds what
+// the pipelines need of a variant (see ShaderVariants), the cache itself does
+// not depend on Vulkan.
+template <typename T>
+class ShaderPermutationCache {
+public:
+    using Stats = ShaderPermutationStats;
+
+    // Variant of `key`, made by `create(key)` on a miss. References stay
+    // valid until clear().
+    template <typename Create>
+    T& get(const ShaderPermutationKey& key, Create&& create)
+    {
+        auto it = _variants.find(key);
+        if (it != _variants.end()) {
+            _stats.hits++;
+            return it->second;
+        }
+        _stats.misses++;
+        return _variants.emplace(key, create(key)).first->second;
+    }
+
+    const T* find(const ShaderPermutationKey& key) const
+    {
+        auto it = _variants.find(key);
+        return it != _variants.end() ? &it->second : nullptr;
+    }
+
+    // `destroy(variant)` is called on each variant
+    template <typename Destroy>
+    void clear(Destroy&& destroy)
+    {
+        for (auto& variant : _variants) {
+            destroy(variant.second);
+        }
+        _variants.clear();
+    }
+
+    size_t       size() const { return _variants.size(); }
+    const Stats& getStats() const { return _stats; }
+    void         resetStats() { _stats = Stats(); }
+
+private:
+    std::unordered_map<ShaderPermutationKey, T, ShaderPermutationKey::Hasher> _variants;
+    Stats                                                                     _stats;
+};
+
+// Checks the keys of all the permutations of the application and the cache
+// behaviour, without device
+bool checkShaderPermutations();
+
+
+#endif
@@ -0,0 +1,70 @@
+#include "shader_variants.hpp"
+#include <nvh/nvprint.hpp>
+#include <stdexcept>
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+void ShaderVariants::init(vk::Device device, const std::vector<std::string>& searchPaths)
+{
+    _modules.init(device);
+    for (const auto& path : searchPaths) {
+        _modules.addDirectory(path);
+    }
+}
+
+void ShaderVariants::deinit()
+{
+    // The modules are only referenced while creating the pipelines
+    _variants.clear([](Variant&) {});
+    _moduleIds.clear();
+    _modules.deinit();
+}
+
+vk::PipelineShaderStageCreateInfo ShaderVariants::getStage(vk::ShaderStageFlagBits stage, const ShaderPermutationKey& key)
+{
+    Variant& variant = _variants.get(key, [&](const ShaderPermutationKey& key) {
+        Variant created;
+        created.module = getModule(stage, key.getShader());
+        for (const auto& constant : key.getConstants()) {
+            created.entries.emplace_back(constant.id, static_cast<uint32_t>(created.data.size() * sizeof(uint32_t)),
+                                         sizeof(uint32_t));
+            created.data.push_back(constant.value);
+        }
+        return created;
+    });
+
+    // Set once in the cache, the vectors of the variant don't move anymore
+    variant.info = vk::SpecializationInfo(static_cast<uint32_t>(variant.entries.size()), variant.entries.data(),
+                                          variant.data.size() * sizeof(uint32_t), variant.data.data());
+
+    return vk::PipelineShaderStageCreateInfo({}, stage, _modules.get(variant.module), "main",
+                                             variant.entries.empty() ? nullptr : &variant.info);
+}
+
+void ShaderVariants::printStats() const
+{
+    LOGI("Shader variants: %zu of %zu modules, %u created, %u reused\n", getVariantCount(), getModuleCount(),
+         getStats().misses, getStats().hits);
+}
+
+// -----------------------
+// Private Methods
+// -----------------------
+
+nvvk::ShaderModuleID ShaderVariants::getModule(vk::ShaderStageFlagBits stage, const std::string& filename)
+{
+    auto it = _moduleIds.find(filename);
+    if (it != _moduleIds.end()) {
+        return it->second;
+    }
+
+    nvvk::ShaderModuleID id = _modules.createShaderModule(static_cast<uint32_t>(stage), filename, "",
+                                                          nvvk::ShaderModuleManager::FILETYPE_SPIRV);
+    if (!_modules.isValid(id)) {
+        throw std::runtime_error("Could not load shader " + filename);
+    }
+    _moduleIds.emplace(filename, id);
+    return id;
+}
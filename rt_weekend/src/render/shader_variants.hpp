@@ -0,0 +1,49 @@
+#ifndef SHADER_VARIANTS_HPP
+#define SHADER_VARIANTS_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <nvvk/shadermodulemanager_vk.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader_permutations.hpp"
+
+// Specialized shader stages of the pipelines. The SPIR-V files are loaded
+// once through nvvk::ShaderModuleManager, each permutation of the
+// specialization constants of a file is a variant of its module, cached by
+// key: the pipelines pick the variant of each hit group instead of branching
+// on the material or the depth at run time.
+class ShaderVariants {
+public:
+    // The SPIR-V files are searched in `searchPaths`
+    void init(vk::Device device, const std::vector<std::string>& searchPaths);
+    void deinit();
+
+    // Stage of the variant `key`, valid until deinit(). Throws if its file
+    // can't be loaded.
+    vk::PipelineShaderStageCreateInfo getStage(vk::ShaderStageFlagBits stage, const ShaderPermutationKey& key);
+
+    size_t                        getModuleCount() const { return _moduleIds.size(); }
+    size_t                        getVariantCount() const { return _variants.size(); }
+    const ShaderPermutationStats& getStats() const { return _variants.getStats(); }
+    void                          printStats() const;
+
+private:
+    struct Variant {
+        nvvk::ShaderModuleID                    module;
+        std::vector<uint32_t>                   data;  // One word per constant
+        std::vector<vk::SpecializationMapEntry> entries;
+        vk::SpecializationInfo                  info;  // Points to data and entries
+    };
+
+    nvvk::ShaderModuleID getModule(vk::ShaderStageFlagBits stage, const std::string& filename);
+
+    nvvk::ShaderModuleManager                             _modules;
+    std::unordered_map<std::string, nvvk::ShaderModuleID> _moduleIds;  // By SPIR-V file
+    ShaderPermutationCache<Variant>                       _variants;
+};
+
+
+#endif
@@ -0,0 +1,260 @@
+#include "slot_allocator.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <random>
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+void SlotAllocator::reset(uint32_t capacity)
+{
+    _capacity  = capacity;
+    _allocated = 0;
+    _pending.clear();
+    _free.clear();
+    if (capacity > 0) {
+        _free.push_back({0, capacity});
+    }
+}
+
+uint32_t SlotAllocator::allocate(uint32_t count)
+{
+    if (count == 0) {
+        return INVALID_SLOT;
+    }
+
+    for (auto it = _free.begin(); it != _free.end(); ++it) {
+        if (it->count < count) {
+            continue;
+        }
+
+        uint32_t first = it->first;
+        it->first += count;
+        it->count -= count;
+        if (it->count == 0) {
+            _free.erase(it);
+        }
+        _allocated += count;
+        return first;
+    }
+
+    return INVALID_SLOT;
+}
+
+void SlotAllocator::free(uint32_t first, uint32_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    assert(first + count <= _capacity);
+    assert(_allocated >= count);
+
+    // First free range after the released one
+    auto next = std::lower_bound(_free.begin(), _free.end(), first,
+                                 [](const Range& range, uint32_t slot) { return range.first < slot; });
+    assert(next == _free.end() || first + count <= next->first);
+    assert(next == _free.begin() || std::prev(next)->first + std::prev(next)->count <= first);
+
+    bool mergePrev = next != _free.begin() && std::prev(next)->first + std::prev(next)->count == first;
+    bool mergeNext = next != _free.end() && first + count == next->first;
+
+    if (mergePrev && mergeNext) {
+        auto prev = std::prev(next);
+        prev->count += count + next->count;
+        _free.erase(next);
+    } else if (mergePrev) {
+        std::prev(next)->count += count;
+    } else if (mergeNext) {
+        next->first = first;
+        next->count += count;
+    } else {
+        _free.insert(next, {first, count});
+    }
+
+    _allocated -= count;
+}
+
+void SlotAllocator::release(uint32_t first, uint32_t count, uint64_t frame)
+{
+    if (count > 0) {
+        _pending.push_back({{first, count}, frame});
+    }
+}
+
+void SlotAllocator::collect(uint64_t completedFrame)
+{
+    auto done = std::stable_partition(_pending.begin(), _pending.end(),
+                                      [completedFrame](const Pending& p) { return p.frame > completedFrame; });
+    for (auto it = done; it != _pending.end(); ++it) {
+        free(it->range.first, it->range.count);
+    }
+    _pending.erase(done, _pending.end());
+}
+
+bool SlotAllocator::isAllocated(uint32_t slot) const
+{
+    if (slot >= _capacity) {
+        return false;
+    }
+
+    auto next = std::upper_bound(_free.begin(), _free.end(), slot,
+                                 [](uint32_t s, const Range& range) { return s < range.first; });
+    if (next == _free.begin()) {
+        return true;
+    }
+    auto prev = std::prev(next);
+    return slot >= prev->first + prev->count;
+}
+
+uint32_t SlotAllocator::getPendingCount() const
+{
+    uint32_t count = 0;
+    for (const auto& pending : _pending) {
+        count += pending.range.count;
+    }
+    return count;
+}
+
+uint32_t SlotAllocator::getHighWater() const
+{
+    if (_free.empty()) {
+        return _capacity;
+    }
+    const Range& last = _free.back();
+    return last.first + last.count == _capacity ? last.first : _capacity;
+}
+
+// -----------------------
+// Public Functions
+// -----------------------
+
+bool checkSlotAllocator()
+{
+    bool ok = true;
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition) {
+            LOGE("Slot allocator: %s\n", what);
+            ok = false;
+        }
+    };
+
+    const uint32_t INVALID = SlotAllocator::INVALID_SLOT;
+
+    // First fit, packed at the beginning
+    SlotAllocator slots;
+    slots.reset(16);
+    expect(slots.allocate(0) == INVALID, "empty range allocated");
+    uint32_t a = slots.allocate(4);
+    uint32_t b = slots.allocate(4);
+    uint32_t c = slots.allocate(4);
+    expect(a == 0 && b == 4 && c == 8, "ranges are not packed");
+    expect(slots.allocate(5) == INVALID, "range larger than the free space allocated");
+    expect(slots.getHighWater() == 12, "wrong high water");
+
+    // A hole is filled before the end of the array
+    slots.free(b, 4);
+    expect(!slots.isAllocated(5) && slots.isAllocated(8), "freed slot still allocated");
+    expect(slots.allocate(2) == 4, "first fit skips the hole");
+    slots.free(4, 2);
+
+    // Coalescing with both neighbors leaves a single range
+    slots.free(a, 4);
+    slots.free(c, 4);
+    expect(slots.getFreeRanges().size() == 1 && slots.getFreeRanges()[0].count == 16, "free ranges not coalesced");
+    expect(slots.getAllocatedCount() == 0 && slots.getHighWater() == 0, "slots leaked");
+
+    // Deferred release: the range stays allocated until its frame completes,
+    // in any order of the frames
+    a = slots.allocate(3);
+    b = slots.allocate(2);
+    slots.release(a, 3, 7);
+    slots.release(b, 2, 6);
+    expect(slots.getPendingCount() == 5 && slots.getAllocatedCount() == 5, "released slots not pending");
+    slots.collect(5);
+    expect(slots.isAllocated(a) && slots.isAllocated(b), "slot reused before its frame completed");
+    slots.collect(6);
+    expect(slots.isAllocated(a) && !slots.isAllocated(b), "slot of a completed frame not returned");
+    expect(slots.allocate(16) == INVALID, "pending slot reused");
+    slots.collect(7);
+    expect(slots.getPendingCount() == 0 && slots.allocate(16) == 0, "pending slots not returned");
+
+    // Random sequences against a reference
+    struct Released {
+        SlotAllocator::Range range;
+        uint64_t             frame{0};
+    };
+    std::mt19937                      rng(1);
+    std::vector<bool>                 reference(256, false);
+    std::vector<SlotAllocator::Range> live;
+    std::vector<Released>             released;
+    uint64_t                          frame = 0;
+    auto setReference = [&](const SlotAllocator::Range& range, bool allocated) {
+        std::fill(reference.begin() + range.first, reference.begin() + range.first + range.count, allocated);
+    };
+    slots.reset(256);
+    for (int step = 0; step < 20000 && ok; ++step) {
+        uint32_t op = rng() % 4;
+        if (op <= 1) {
+            uint32_t count = 1 + rng() % 8;
+            uint32_t first = slots.allocate(count);
+
+            // The reference finds the same first fit
+            uint32_t expected = INVALID;
+            for (uint32_t i = 0, run = 0; i < 256 && expected == INVALID; ++i) {
+                run      = reference[i] ? 0 : run + 1;
+                expected = run == count ? i + 1 - count : INVALID;
+            }
+            expect(first == expected, "allocation differs from the first fit");
+            if (first != INVALID) {
+                live.push_back({first, count});
+                setReference(live.back(), true);
+            }
+        } else if (op == 2 && !live.empty()) {
+            size_t               index = rng() % live.size();
+            SlotAllocator::Range range = live[index];
+            live.erase(live.begin() + index);
+            // Freed now, or once the next frame completes
+            if (rng() % 2) {
+                slots.free(range.first, range.count);
+                setReference(range, false);
+            } else {
+                slots.release(range.first, range.count, frame + 1);
+                released.push_back({range, frame + 1});
+            }
+        } else {
+            ++frame;
+            slots.collect(frame - 1);
+            auto done = std::partition(released.begin(), released.end(),
+                                       [&](const Released& r) { return r.frame > frame - 1; });
+            for (auto it = done; it != released.end(); ++it) {
+                setReference(it->range, false);
+            }
+            released.erase(done, released.end());
+        }
+
+        uint32_t allocated = 0;
+        bool     same      = true;
+        for (uint32_t i = 0; i < 256; ++i) {
+            allocated += reference[i] ? 1 : 0;
+            same &= slots.isAllocated(i) == reference[i];
+        }
+        expect(same && allocated == slots.getAllocatedCount(), "allocated slots differ from the reference");
+
+        uint32_t pending = 0;
+        for (const auto& r : released) {
+            pending += r.range.count;
+        }
+        expect(pending == slots.getPendingCount(), "pending slots differ from the reference");
+
+        const auto& ranges = slots.getFreeRanges();
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            expect(ranges[i - 1].first + ranges[i - 1].count < ranges[i].first, "free ranges unsorted or adjacent");
+        }
+    }
+
+    LOGI("Slot allocator: %s\n", ok ? "OK" : "FAILED");
+    return ok;
+}
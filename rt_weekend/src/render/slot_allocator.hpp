@@ -0,0 +1,63 @@
+#ifndef SLOT_ALLOCATOR_HPP
+#define SLOT_ALLOCATOR_HPP
+
+#include <cstdint>
+#include <vector>
+
+// Hands out ranges of slots in a fixed size descriptor array. Free ranges are
+// kept sorted and coalesced, allocation is first-fit so that the used slots
+// stay packed at the beginning of the array.
+//
+// A descriptor may still be read by frames in flight when its resource is
+// destroyed: release() only queues the range, which becomes available again
+// once collect() is called with a frame at least as recent.
+class SlotAllocator {
+public:
+    static constexpr uint32_t INVALID_SLOT = ~0U;
+
+    struct Range {
+        uint32_t first{0};
+        uint32_t count{0};
+    };
+
+    void reset(uint32_t capacity);
+
+    // First slot of `count` contiguous slots, INVALID_SLOT if none is large enough
+    uint32_t allocate(uint32_t count = 1);
+
+    // Returns the range immediately, the caller guarantees it is not in use anymore
+    void free(uint32_t first, uint32_t count = 1);
+
+    // Returns the range once `frame` has completed on the GPU
+    void release(uint32_t first, uint32_t count, uint64_t frame);
+    void collect(uint64_t completedFrame);
+
+    bool isAllocated(uint32_t slot) const;
+
+    uint32_t getCapacity() const { return _capacity; }
+    uint32_t getAllocatedCount() const { return _allocated; }
+    uint32_t getPendingCount() const;
+
+    // One past the highest allocated slot, the part of the array to write on a full update
+    uint32_t getHighWater() const;
+
+    const std::vector<Range>& getFreeRanges() const { return _free; }
+
+private:
+    struct Pending {
+        Range    range;
+        uint64_t frame{0};
+    };
+
+    std::vector<Range>   _free;  // Sorted by first slot, never adjacent
+    std::vector<Pending> _pending;
+    uint32_t             _capacity{0};
+    uint32_t             _allocated{0};  // Including the pending ranges
+};
+
+// First-fit order, coalescing, deferred release and random sequences checked
+// against a per-slot reference, without device
+bool checkSlotAllocator();
+
+
+#endif
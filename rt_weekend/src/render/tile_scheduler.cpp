@@ -0,0 +1,395 @@
+#include "tile_scheduler.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+// -----------------------
+// Checkpoint Format
+// -----------------------
+
+static constexpr uint32_t CHECKPOINT_MAGIC   = 0x53545452;  // "RTTS"
+static constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+// Weight of the newest measurement in the per-tile cost estimates
+static constexpr float COST_SMOOTHING = 0.5f;
+
+template <typename T>
+static void writeValue(std::ofstream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& in, T& value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+void TileScheduler::reset(uint32_t width, uint32_t height, uint32_t tileSize)
+{
+    _width    = width;
+    _height   = height;
+    _tileSize = std::max(1U, tileSize);
+    _tiles.clear();
+
+    for (uint32_t y = 0; y < _height; y += _tileSize) {
+        for (uint32_t x = 0; x < _width; x += _tileSize) {
+            Tile tile;
+            tile.x      = x;
+            tile.y      = y;
+            tile.width  = std::min(_tileSize, _width - x);
+            tile.height = std::min(_tileSize, _height - y);
+            _tiles.push_back(tile);
+        }
+    }
+}
+
+void TileScheduler::resetSamples()
+{
+    // The cost model stays valid, only the accumulation restarts
+    for (auto& tile : _tiles) {
+        tile.samples  = 0;
+        tile.variance = 1.0f;
+    }
+}
+
+std::vector<uint32_t> TileScheduler::nextBatch() const
+{
+    std::vector<uint32_t> candidates;
+    candidates.reserve(_tiles.size());
+    for (uint32_t i = 0; i < static_cast<uint32_t>(_tiles.size()); ++i) {
+        if (_tiles[i].samples < _targetSamples) {
+            candidates.push_back(i);
+        }
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+        return priority(_tiles[a]) < priority(_tiles[b]);
+    });
+
+    // Without any measurement, probe the cost with a single tile
+    if (_defaultCostPerPixel <= 0.0f && !candidates.empty()) {
+        candidates.resize(1);
+        return candidates;
+    }
+
+    std::vector<uint32_t> batch;
+    float                 batchCost = 0.0f;
+    for (uint32_t index : candidates) {
+        float cost = estimateCostMs(_tiles[index]);
+        if (!batch.empty() && batchCost + cost > _budgetMs) {
+            break;
+        }
+        batch.push_back(index);
+        batchCost += cost;
+    }
+
+    return batch;
+}
+
+void TileScheduler::markDispatched(const std::vector<uint32_t>& batch)
+{
+    for (uint32_t index : batch) {
+        _tiles[index].samples++;
+    }
+}
+
+void TileScheduler::reportSubmit(const std::vector<uint32_t>& batch, float elapsedMs)
+{
+    if (batch.empty() || elapsedMs <= 0.0f) {
+        return;
+    }
+
+    // Predicted share of each tile in the submit. Pixel count is used as weight
+    // as long as nothing has been measured.
+    std::vector<float> predicted(batch.size());
+    float              predictedSum = 0.0f;
+    float              pixelSum     = 0.0f;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const Tile& tile   = _tiles[batch[i]];
+        float       pixels = static_cast<float>(tile.width * tile.height);
+        predicted[i]       = (_defaultCostPerPixel > 0.0f) ? estimateCostMs(tile) : pixels;
+        predictedSum += predicted[i];
+        pixelSum += pixels;
+    }
+
+    // Distribute the measured time according to the prediction
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Tile& tile         = _tiles[batch[i]];
+        float pixels       = static_cast<float>(tile.width * tile.height);
+        float measuredCost = elapsedMs * (predicted[i] / predictedSum) / pixels;
+
+        if (tile.costPerPixel <= 0.0f) {
+            tile.costPerPixel = measuredCost;
+        } else {
+            tile.costPerPixel += COST_SMOOTHING * (measuredCost - tile.costPerPixel);
+        }
+    }
+
+    float averageCost = elapsedMs / pixelSum;
+    if (_defaultCostPerPixel <= 0.0f) {
+        _defaultCostPerPixel = averageCost;
+    } else {
+        _defaultCostPerPixel += COST_SMOOTHING * (averageCost - _defaultCostPerPixel);
+    }
+}
+
+void TileScheduler::updateVariance(uint32_t index, float variance)
+{
+    _tiles[index].variance = variance;
+}
+
+float TileScheduler::estimateCostMs(const Tile& tile) const
+{
+    float costPerPixel = (tile.costPerPixel > 0.0f) ? tile.costPerPixel : _defaultCostPerPixel;
+    return costPerPixel * static_cast<float>(tile.width * tile.height);
+}
+
+uint32_t TileScheduler::getCompletedTiles() const
+{
+    return static_cast<uint32_t>(std::count_if(_tiles.begin(), _tiles.end(), [&](const Tile& tile) {
+        return tile.samples >= _targetSamples;
+    }));
+}
+
+bool TileScheduler::isComplete() const
+{
+    return getCompletedTiles() == _tiles.size();
+}
+
+float TileScheduler::getProgress() const
+{
+    if (_tiles.empty() || _targetSamples == 0) {
+        return 1.0f;
+    }
+
+    uint64_t done = 0;
+    for (const auto& tile : _tiles) {
+        done += std::min(tile.samples, _targetSamples);
+    }
+
+    return static_cast<float>(done) / static_cast<float>(uint64_t(_targetSamples) * _tiles.size());
+}
+
+bool TileScheduler::saveCheckpoint(const std::string& filename) const
+{
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+
+    writeValue(out, CHECKPOINT_MAGIC);
+    writeValue(out, CHECKPOINT_VERSION);
+    writeValue(out, _width);
+    writeValue(out, _height);
+    writeValue(out, _tileSize);
+    writeValue(out, _targetSamples);
+    writeValue(out, static_cast<uint32_t>(_order));
+    writeValue(out, _defaultCostPerPixel);
+    writeValue(out, static_cast<uint32_t>(_tiles.size()));
+
+    for (const auto& tile : _tiles) {
+        writeValue(out, tile.samples);
+        writeValue(out, tile.variance);
+        writeValue(out, tile.costPerPixel);
+    }
+
+    return static_cast<bool>(out);
+}
+
+bool TileScheduler::loadCheckpoint(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    uint32_t magic, version, width, height, tileSize, targetSamples, order, tileCount;
+    float    defaultCost;
+
+    if (!readValue(in, magic) || magic != CHECKPOINT_MAGIC || !readValue(in, version)
+        || version != CHECKPOINT_VERSION) {
+        return false;
+    }
+
+    if (!readValue(in, width) || !readValue(in, height) || !readValue(in, tileSize)
+        || !readValue(in, targetSamples) || !readValue(in, order) || !readValue(in, defaultCost)
+        || !readValue(in, tileCount)) {
+        return false;
+    }
+
+    // Rebuild the tiling and make sure it matches what has been saved
+    TileScheduler loaded;
+    loaded.reset(width, height, tileSize);
+    if (loaded._tiles.size() != tileCount || order > static_cast<uint32_t>(Order::Variance)) {
+        return false;
+    }
+
+    for (auto& tile : loaded._tiles) {
+        if (!readValue(in, tile.samples) || !readValue(in, tile.variance)
+            || !readValue(in, tile.costPerPixel)) {
+            return false;
+        }
+    }
+
+    loaded._targetSamples       = targetSamples;
+    loaded._budgetMs            = _budgetMs;
+    loaded._defaultCostPerPixel = defaultCost;
+    loaded._order               = static_cast<Order>(order);
+
+    *this = std::move(loaded);
+    return true;
+}
+
+TileScheduler::SimulationResult TileScheduler::simulate(const CostFunction& cost, uint32_t maxSubmits)
+{
+    SimulationResult result;
+
+    while (result.submits < maxSubmits) {
+        auto batch = nextBatch();
+        if (batch.empty()) {
+            break;
+        }
+
+        float elapsedMs = 0.0f;
+        for (uint32_t index : batch) {
+            elapsedMs += cost(_tiles[index]);
+        }
+
+        reportSubmit(batch, elapsedMs);
+        markDispatched(batch);
+
+        result.submits++;
+        result.totalMs += elapsedMs;
+        result.maxSubmitMs = std::max(result.maxSubmitMs, elapsedMs);
+    }
+
+    result.complete = isComplete();
+    return result;
+}
+
+// -----------------------
+// Private Methods
+// -----------------------
+
+std::pair<float, float> TileScheduler::priority(const Tile& tile) const
+{
+    // Distance of the tile center to the image center, normalized to [0, 1]
+    float cx       = (static_cast<float>(tile.x) + 0.5f * tile.width) / std::max(1U, _width) - 0.5f;
+    float cy       = (static_cast<float>(tile.y) + 0.5f * tile.height) / std::max(1U, _height) - 0.5f;
+    float distance = std::sqrt(cx * cx + cy * cy) / std::sqrt(0.5f);
+
+    // Tiles with fewer samples always go first, so that the whole image keeps
+    // a roughly uniform sample count
+    if (_order == Order::CenterFirst) {
+        return {static_cast<float>(tile.samples), distance};
+    }
+
+    // Untouched tiles first, then by expected error reduction of one more frame
+    if (tile.samples == 0) {
+        return {0.0f, distance};
+    }
+
+    return {1.0f, -tile.variance / static_cast<float>(tile.samples + 1)};
+}
+
+// -----------------------
+// Public Functions
+// -----------------------
+
+bool checkTileScheduler()
+{
+    bool ok = true;
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition) {
+            LOGE("Tile scheduler: %s\n", what);
+            ok = false;
+        }
+    };
+
+    const uint32_t width    = 1280;
+    const uint32_t height   = 720;
+    const uint32_t target   = 16;
+    const float    budgetMs = 8.0f;
+
+    // The center of the image is 4 times as expensive as its borders
+    TileScheduler::CostFunction cost = [&](const Tile& tile) {
+        float cx = (tile.x + 0.5f * tile.width) / width - 0.5f;
+        float cy = (tile.y + 0.5f * tile.height) / height - 0.5f;
+        float w  = 1.0f + 3.0f * std::max(0.0f, 1.0f - 2.0f * std::sqrt(cx * cx + cy * cy));
+        return 1e-5f * w * static_cast<float>(tile.width * tile.height);
+    };
+    auto distance = [&](const Tile& tile) {
+        float cx = (tile.x + 0.5f * tile.width) - 0.5f * width;
+        float cy = (tile.y + 0.5f * tile.height) - 0.5f * height;
+        return cx * cx + cy * cy;
+    };
+
+    // Center first: the first probe is the most central tile
+    TileScheduler scheduler;
+    scheduler.reset(width, height, 128);
+    scheduler.setBudgetMs(budgetMs);
+    scheduler.setTargetSamples(target);
+    expect(scheduler.getTiles().size() == 10 * 6, "tiling");
+
+    auto probe = scheduler.nextBatch();
+    expect(probe.size() == 1, "single tile probed without cost measurement");
+    float closest = distance(scheduler.getTiles()[0]);
+    for (const auto& tile : scheduler.getTiles()) {
+        closest = std::min(closest, distance(tile));
+    }
+    expect(!probe.empty() && distance(scheduler.getTile(probe[0])) == closest, "center tile first");
+
+    // All the tiles converge, the submits fill the budget without exceeding it
+    // once the cost of the tiles was measured
+    float expectedMs = 0.0f;
+    for (const auto& tile : scheduler.getTiles()) {
+        expectedMs += cost(tile) * target;
+    }
+    auto result = scheduler.simulate(cost, 10000);
+    expect(result.complete && scheduler.getProgress() == 1.0f, "center first completes");
+    expect(std::abs(result.totalMs - expectedMs) <= 1e-3f * expectedMs, "simulated time of the frames");
+    expect(result.maxSubmitMs <= 1.5f * budgetMs, "submits within the budget");
+    expect(result.totalMs / result.submits >= 0.5f * budgetMs, "submits filling the budget");
+    expect(scheduler.nextBatch().empty(), "nothing dispatched once complete");
+
+    // Variance: once every tile has a frame, the noisiest goes first
+    TileScheduler noisy;
+    noisy.reset(width, height, 128);
+    noisy.setOrder(TileScheduler::Order::Variance);
+    noisy.setBudgetMs(budgetMs);
+    noisy.setTargetSamples(1);
+    expect(noisy.simulate(cost, 10000).complete, "variance order completes a frame");
+    noisy.setTargetSamples(target);
+    for (uint32_t i = 0; i < noisy.getTiles().size(); i++) {
+        noisy.updateVariance(i, i == 37 ? 4.0f : 0.01f);
+    }
+    auto batch = noisy.nextBatch();
+    expect(!batch.empty() && batch[0] == 37, "noisiest tile first");
+
+    // Checkpoint round trip of the scheduling state
+    std::string filename = (std::filesystem::temp_directory_path() / "rt_weekend_tiles_check.bin").string();
+    TileScheduler loaded;
+    expect(noisy.saveCheckpoint(filename) && loaded.loadCheckpoint(filename), "checkpoint round trip");
+    bool same = loaded.getTiles().size() == noisy.getTiles().size() && loaded.getOrder() == noisy.getOrder()
+                && loaded.getTileSize() == noisy.getTileSize();
+    for (size_t i = 0; same && i < loaded.getTiles().size(); i++) {
+        const Tile& a = loaded.getTiles()[i];
+        const Tile& b = noisy.getTiles()[i];
+        same          = a.samples == b.samples && a.variance == b.variance && a.costPerPixel == b.costPerPixel;
+    }
+    expect(same, "checkpoint content");
+    std::filesystem::remove(filename);
+
+    LOGI("Tile scheduler: %u submits, %.2f ms max, %.2f ms average, %s\n", result.submits, result.maxSubmitMs,
+         result.totalMs / std::max(result.submits, 1u), ok ? "OK" : "FAILED");
+    return ok;
+}
@@ -0,0 +1,102 @@
+#ifndef TILE_SCHEDULER_HPP
+#define TILE_SCHEDULER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A rectangular region of the output image, dispatched as one traceRaysKHR call
+struct Tile {
+    uint32_t x{0};
+    uint32_t y{0};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t samples{0};          // Accumulated frames in this tile
+    float    variance{1.0f};      // Relative variance of a frame, measured by raytrace.rgen, used by Order::Variance
+    float    costPerPixel{0.0f};  // Estimated GPU time per pixel and frame (ms), 0 = unknown
+};
+
+// Splits the output image into tiles and selects, for each submit, the set of
+// tiles that fits into a GPU time budget. The scheduler only manipulates CPU
+// state: the caller reports measured submit times back through reportSubmit(),
+// which makes it possible to drive it with a simulated cost model.
+class TileScheduler {
+public:
+    enum class Order {
+        CenterFirst,  // Converge the center of the image first, then spiral outwards
+        Variance      // Dispatch the noisiest tiles first
+    };
+
+    struct SimulationResult {
+        uint32_t submits{0};
+        float    totalMs{0.0f};
+        float    maxSubmitMs{0.0f};
+        bool     complete{false};
+    };
+
+    using CostFunction = std::function<float(const Tile&)>;
+
+    void reset(uint32_t width, uint32_t height, uint32_t tileSize);
+    void resetSamples();
+
+    void setOrder(Order order) { _order = order; }
+    void setBudgetMs(float budgetMs) { _budgetMs = budgetMs; }
+    void setTargetSamples(uint32_t samples) { _targetSamples = samples; }
+
+    Order    getOrder() const { return _order; }
+    float    getBudgetMs() const { return _budgetMs; }
+    uint32_t getTargetSamples() const { return _targetSamples; }
+    uint32_t getTileSize() const { return _tileSize; }
+    uint32_t getWidth() const { return _width; }
+    uint32_t getHeight() const { return _height; }
+
+    const std::vector<Tile>& getTiles() const { return _tiles; }
+    const Tile&              getTile(uint32_t index) const { return _tiles[index]; }
+
+    // Indices of the tiles to dispatch in the next submit. Always contains at
+    // least one tile unless all tiles reached the target sample count.
+    std::vector<uint32_t> nextBatch() const;
+
+    // Records one more accumulated frame for each tile of the batch
+    void markDispatched(const std::vector<uint32_t>& batch);
+
+    // Feeds back the measured GPU time of a batch to refine the cost model
+    void reportSubmit(const std::vector<uint32_t>& batch, float elapsedMs);
+
+    void  updateVariance(uint32_t index, float variance);
+    float estimateCostMs(const Tile& tile) const;
+
+    uint32_t getCompletedTiles() const;
+    bool     isComplete() const;
+    float    getProgress() const;
+
+    // Scheduling state only, saved next to the accumulation checkpoint of the
+    // image (render/accumulation_checkpoint.hpp) of a tiled render
+    bool saveCheckpoint(const std::string& filename) const;
+    bool loadCheckpoint(const std::string& filename);
+
+    // Runs the scheduler until completion (or maxSubmits), using `cost` as the
+    // actual GPU time of each tile instead of measurements.
+    SimulationResult simulate(const CostFunction& cost, uint32_t maxSubmits);
+
+private:
+    std::pair<float, float> priority(const Tile& tile) const;
+
+    std::vector<Tile> _tiles;
+    uint32_t          _width{0};
+    uint32_t          _height{0};
+    uint32_t          _tileSize{256};
+    uint32_t          _targetSamples{100};
+    float             _budgetMs{30.0f};
+    float             _defaultCostPerPixel{0.0f};  // Average of all measurements
+    Order             _order{Order::CenterFirst};
+};
+
+// Drives the scheduler with a simulated cost model: order of the tiles, budget
+// of the submits, completion and checkpoints, without device
+bool checkTileScheduler();
+
+
+#endif
@@ -0,0 +1,338 @@
+#include "tone_mapping.hpp"
+#include "../common/parallel_for.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <cmath>
+
+// -----------------------
+// Helpers
+// -----------------------
+
+// Rows of a chunk of the histogram, the height of the workgroups of exposure_histogram.comp
+static constexpr uint32_t HISTOGRAM_CHUNK_ROWS = 16;
+
+static float luminance(float r, float g, float b)
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+static float exposureLog2(const std::vector<float>& rgba, uint32_t width, uint32_t height,
+                          const ExposureSettings& settings, uint32_t numThreads)
+{
+    float averageLog2;
+    if (!settings.autoExposure
+        || !meterHistogram(buildLuminanceHistogram(rgba, width, height, settings, numThreads), settings, averageLog2)) {
+        return settings.compensation;
+    }
+    return targetExposureLog2(averageLog2, settings);
+}
+
+// ACES fit, row-major matrices applied to column vectors
+static nvmath::vec3f mulRows(const float m[3][3], const nvmath::vec3f& v)
+{
+    return nvmath::vec3f(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                         m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                         m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+}
+
+static float rrtAndOdtFit(float v)
+{
+    float a = v * (v + 0.0245786f) - 0.000090537f;
+    float b = v * (0.983729f * v + 0.4329510f) + 0.238081f;
+    return a / b;
+}
+
+static float hableCurve(float x)
+{
+    const float A = 0.15f;  // Shoulder strength
+    const float B = 0.50f;  // Linear strength
+    const float C = 0.10f;  // Linear angle
+    const float D = 0.20f;  // Toe strength
+    const float E = 0.02f;  // Toe numerator
+    const float F = 0.30f;  // Toe denominator
+    return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+}
+
+static float clamp01(float x)
+{
+    return std::min(std::max(x, 0.0f), 1.0f);
+}
+
+// -----------------------
+// Public Functions
+// -----------------------
+
+uint32_t luminanceBin(float luminance, float minLog2, float maxLog2)
+{
+    if (!(luminance > 0.0f)) {
+        return 0;
+    }
+    float value = std::log2(luminance);
+    if (value < minLog2) {
+        return 0;
+    }
+    float t = (value - minLog2) / (maxLog2 - minLog2) * float(EXPOSURE_HISTOGRAM_BINS - 1);
+    return 1 + std::min(static_cast<uint32_t>(t), EXPOSURE_HISTOGRAM_BINS - 2);
+}
+
+float binLog2(uint32_t bin, float minLog2, float maxLog2)
+{
+    return minLog2 + (float(bin) - 0.5f) * (maxLog2 - minLog2) / float(EXPOSURE_HISTOGRAM_BINS - 1);
+}
+
+std::vector<uint32_t> buildLuminanceHistogram(const std::vector<float>& rgba, uint32_t width, uint32_t height,
+                                              const ExposureSettings& settings, uint32_t numThreads)
+{
+    // Chunks of rows counted apart then merged, as the workgroups do in shared memory
+    uint32_t              nbChunks = (height + HISTOGRAM_CHUNK_ROWS - 1) / HISTOGRAM_CHUNK_ROWS;
+    std::vector<uint32_t> chunks(size_t(nbChunks) * EXPOSURE_HISTOGRAM_BINS, 0);
+    parallelFor(nbChunks, numThreads, [&](uint32_t chunk) {
+        uint32_t* histogram = &chunks[size_t(chunk) * EXPOSURE_HISTOGRAM_BINS];
+        uint32_t  end       = std::min(height, (chunk + 1) * HISTOGRAM_CHUNK_ROWS);
+        for (uint32_t y = chunk * HISTOGRAM_CHUNK_ROWS; y < end; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                const float* texel = &rgba[(size_t(y) * width + x) * 4];
+                histogram[luminanceBin(luminance(texel[0], texel[1], texel[2]), settings.minLog2, settings.maxLog2)]++;
+            }
+        }
+    });
+
+    std::vector<uint32_t> histogram(EXPOSURE_HISTOGRAM_BINS, 0);
+    for (uint32_t chunk = 0; chunk < nbChunks; chunk++) {
+        for (uint32_t bin = 0; bin < EXPOSURE_HISTOGRAM_BINS; bin++) {
+            histogram[bin] += chunks[size_t(chunk) * EXPOSURE_HISTOGRAM_BINS + bin];
+        }
+    }
+    return histogram;
+}
+
+bool meterHistogram(const std::vector<uint32_t>& histogram, const ExposureSettings& settings, float& averageLog2)
+{
+    float count = 0.0f;
+    for (uint32_t bin = 1; bin < EXPOSURE_HISTOGRAM_BINS; bin++) {
+        count += float(histogram[bin]);
+    }
+
+    // Part of each bin between the percentiles, in pixels
+    float low        = settings.lowPercentile * count;
+    float high       = settings.highPercentile * count;
+    float cumulative = 0.0f;
+    float sum        = 0.0f;
+    float weight     = 0.0f;
+    for (uint32_t bin = 1; bin < EXPOSURE_HISTOGRAM_BINS; bin++) {
+        float n     = float(histogram[bin]);
+        float first = std::max(cumulative, low);
+        float last  = std::min(cumulative + n, high);
+        if (last > first) {
+            sum += (last - first) * binLog2(bin, settings.minLog2, settings.maxLog2);
+            weight += last - first;
+        }
+        cumulative += n;
+    }
+
+    if (!(weight > 0.0f)) {
+        return false;
+    }
+    averageLog2 = sum / weight;
+    return true;
+}
+
+float targetExposureLog2(float averageLog2, const ExposureSettings& settings)
+{
+    return std::log2(settings.keyValue) - averageLog2 + settings.compensation;
+}
+
+float adaptExposureLog2(float currentLog2, float targetLog2, float deltaSeconds, const ExposureSettings& settings)
+{
+    float speed = targetLog2 > currentLog2 ? settings.speedUp : settings.speedDown;
+    float t     = 1.0f - std::exp(-std::max(deltaSeconds, 0.0f) * speed);
+    return currentLog2 + (targetLog2 - currentLog2) * t;
+}
+
+nvmath::vec3f toneMap(ToneMapper toneMapper, const nvmath::vec3f& color)
+{
+    nvmath::vec3f c(std::max(color.x, 0.0f), std::max(color.y, 0.0f), std::max(color.z, 0.0f));
+
+    switch (toneMapper) {
+        case ToneMapper::Reinhard:
+            c = nvmath::vec3f(c.x / (1.0f + c.x), c.y / (1.0f + c.y), c.z / (1.0f + c.z));
+            break;
+        case ToneMapper::Aces: {
+            static const float input[3][3]  = {{0.59719f, 0.35458f, 0.04823f},
+                                               {0.07600f, 0.90834f, 0.01566f},
+                                               {0.02840f, 0.13383f, 0.83777f}};
+            static const float output[3][3] = {{1.60475f, -0.53108f, -0.07367f},
+                                               {-0.10208f, 1.10813f, -0.00605f},
+                                               {-0.00327f, -0.07276f, 1.07602f}};
+            c = mulRows(input, c);
+            c = nvmath::vec3f(rrtAndOdtFit(c.x), rrtAndOdtFit(c.y), rrtAndOdtFit(c.z));
+            c = mulRows(output, c);
+            break;
+        }
+        case ToneMapper::Filmic: {
+            const float white = 11.2f;
+            float       scale = 1.0f / hableCurve(white);
+            c = nvmath::vec3f(hableCurve(c.x) * scale, hableCurve(c.y) * scale, hableCurve(c.z) * scale);
+            break;
+        }
+        case ToneMapper::Clamp:
+            break;
+    }
+
+    return nvmath::vec3f(clamp01(c.x), clamp01(c.y), clamp01(c.z));
+}
+
+void toneMapImage(std::vector<float>& rgba, uint32_t width, uint32_t height, ToneMapper toneMapper,
+                  const ExposureSettings& settings, uint32_t numThreads)
+{
+    float exposure = std::exp2(exposureLog2(rgba, width, height, settings, numThreads));
+    parallelFor(height, numThreads, [&](uint32_t y) {
+        for (uint32_t x = 0; x < width; x++) {
+            float*        texel  = &rgba[(size_t(y) * width + x) * 4];
+            nvmath::vec3f mapped = toneMap(toneMapper, nvmath::vec3f(texel[0], texel[1], texel[2]) * exposure);
+            texel[0]             = mapped.x;
+            texel[1]             = mapped.y;
+            texel[2]             = mapped.z;
+        }
+    });
+}
+
+bool checkToneMapping()
+{
+    bool             ok = true;
+    ExposureSettings settings;
+    const float      binWidth = (settings.maxLog2 - settings.minLog2) / float(EXPOSURE_HISTOGRAM_BINS - 1);
+
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition) {
+            LOGE("Tone mapping: %s\n", what);
+            ok = false;
+        }
+    };
+
+    // Image of `count` pixels of each luminance
+    auto makeImage = [](const std::vector<std::pair<float, uint32_t>>& content, uint32_t width) {
+        std::vector<float> rgba;
+        for (const auto& [value, count] : content) {
+            for (uint32_t i = 0; i < count; i++) {
+                rgba.insert(rgba.end(), {value, value, value, 1.0f});
+            }
+        }
+        rgba.resize(((rgba.size() / 4 + width - 1) / width) * width * 4, 0.0f);
+        return rgba;
+    };
+
+    // Bins
+    expect(luminanceBin(0.0f, settings.minLog2, settings.maxLog2) == 0, "black in bin 0");
+    expect(luminanceBin(-1.0f, settings.minLog2, settings.maxLog2) == 0, "negative in bin 0");
+    expect(luminanceBin(std::nanf(""), settings.minLog2, settings.maxLog2) == 0, "NaN in bin 0");
+    expect(luminanceBin(std::exp2(settings.minLog2 - 0.1f), settings.minLog2, settings.maxLog2) == 0,
+           "below the range in bin 0");
+    expect(luminanceBin(std::exp2(settings.minLog2), settings.minLog2, settings.maxLog2) == 1, "range start in bin 1");
+    expect(luminanceBin(1e30f, settings.minLog2, settings.maxLog2) == EXPOSURE_HISTOGRAM_BINS - 1,
+           "above the range in the last bin");
+    for (float value = settings.minLog2; value < settings.maxLog2; value += 0.37f) {
+        uint32_t bin = luminanceBin(std::exp2(value), settings.minLog2, settings.maxLog2);
+        expect(std::abs(binLog2(bin, settings.minLog2, settings.maxLog2) - value) <= 0.5f * binWidth + 1e-4f,
+               "bin center");
+    }
+
+    // Uniform image, metered at its luminance whatever the percentiles
+    {
+        auto  rgba      = makeImage({{0.125f, 64 * 64}}, 64);
+        auto  histogram = buildLuminanceHistogram(rgba, 64, 64, settings, 4);
+        float average   = 0.0f;
+        expect(histogram == buildLuminanceHistogram(rgba, 64, 64, settings, 1), "histogram independent of threads");
+        expect(meterHistogram(histogram, settings, average) && std::abs(average + 3.0f) <= 0.5f * binWidth,
+               "uniform image metering");
+        expect(std::abs(targetExposureLog2(average, settings) - (std::log2(settings.keyValue) + 3.0f))
+                   <= 0.5f * binWidth,
+               "uniform image exposure");
+    }
+
+    // Black pixels are not metered, no pixel left: no metering
+    {
+        auto  rgba    = makeImage({{0.0f, 32 * 64}, {1.0f, 32 * 64}}, 64);
+        float average = 0.0f;
+        expect(meterHistogram(buildLuminanceHistogram(rgba, 64, 64, settings), settings, average)
+                   && std::abs(average) <= 0.5f * binWidth,
+               "black pixels ignored");
+        rgba = makeImage({{0.0f, 64 * 64}}, 64);
+        expect(!meterHistogram(buildLuminanceHistogram(rgba, 64, 64, settings), settings, average), "black image");
+    }
+
+    // 10% of very bright pixels, ignored above the high percentile
+    {
+        auto  rgba      = makeImage({{1.0f, 90 * 64}, {1000.0f, 10 * 64}}, 64);
+        auto  histogram = buildLuminanceHistogram(rgba, 64, 100, settings);
+        float average   = 0.0f;
+
+        ExposureSettings clipped = settings;
+        clipped.highPercentile   = 0.85f;
+        expect(meterHistogram(histogram, clipped, average) && std::abs(average) <= 0.5f * binWidth,
+               "bright pixels above the percentile");
+
+        ExposureSettings all = settings;
+        all.lowPercentile    = 0.0f;
+        all.highPercentile   = 1.0f;
+        float expected       = 0.9f * binLog2(luminanceBin(1.0f, all.minLog2, all.maxLog2), all.minLog2, all.maxLog2)
+                         + 0.1f * binLog2(EXPOSURE_HISTOGRAM_BINS - 1, all.minLog2, all.maxLog2);
+        expect(meterHistogram(histogram, all, average) && std::abs(average - expected) <= 1e-4f,
+               "all pixels metered");
+    }
+
+    // Adaptation: monotonic, no overshoot, converged, faster to brighter images
+    {
+        float up   = 0.0f;
+        float down = 0.0f;
+        bool  monotonic = true;
+        for (int frame = 0; frame < 600; frame++) {
+            float nextUp   = adaptExposureLog2(up, 4.0f, 1.0f / 60.0f, settings);
+            float nextDown = adaptExposureLog2(down, -4.0f, 1.0f / 60.0f, settings);
+            monotonic &= nextUp >= up && nextUp <= 4.0f && nextDown <= down && nextDown >= -4.0f;
+            up   = nextUp;
+            down = nextDown;
+            if (frame == 29) {
+                expect(4.0f - up < down + 4.0f, "faster adaptation to brighter");
+            }
+        }
+        expect(monotonic, "monotonic adaptation");
+        expect(std::abs(up - 4.0f) < 1e-3f && std::abs(down + 4.0f) < 1e-3f, "converged adaptation");
+        expect(adaptExposureLog2(1.0f, 4.0f, 0.0f, settings) == 1.0f, "no adaptation without time");
+    }
+
+    // Operators: black stays black, monotonic on a grey ramp, within [0, 1]
+    const ToneMapper operators[] = {ToneMapper::Clamp, ToneMapper::Reinhard, ToneMapper::Aces, ToneMapper::Filmic};
+    for (ToneMapper op : operators) {
+        expect(toneMap(op, nvmath::vec3f(0.0f)).x <= 1e-6f, "black to black");
+        float previous = 0.0f;
+        bool  valid    = true;
+        for (float x = 0.0f; x < 64.0f; x = x * 1.1f + 1e-3f) {
+            nvmath::vec3f y = toneMap(op, nvmath::vec3f(x));
+            valid &= y.x >= previous - 1e-6f && y.x >= 0.0f && y.x <= 1.0f;
+            previous = y.x;
+        }
+        expect(valid, "monotonic operator within [0, 1]");
+    }
+    expect(std::abs(toneMap(ToneMapper::Reinhard, nvmath::vec3f(1.0f)).x - 0.5f) < 1e-6f, "Reinhard of 1");
+    expect(std::abs(toneMap(ToneMapper::Filmic, nvmath::vec3f(11.2f)).x - 1.0f) < 1e-5f, "Filmic white point");
+    expect(toneMap(ToneMapper::Aces, nvmath::vec3f(100.0f)).x > 0.99f, "ACES saturation");
+    expect(toneMap(ToneMapper::Clamp, nvmath::vec3f(2.0f)).x == 1.0f, "clamp");
+
+    // Converged chain: the middle grey lands on the key value before the operator
+    {
+        auto rgba = makeImage({{0.125f, 64 * 64}}, 64);
+        toneMapImage(rgba, 64, 64, ToneMapper::Clamp, settings);
+        expect(std::abs(std::log2(rgba[0]) - std::log2(settings.keyValue)) <= 0.5f * binWidth, "exposed key value");
+
+        ExposureSettings manual = settings;
+        manual.autoExposure     = false;
+        manual.compensation     = 1.0f;
+        rgba                    = makeImage({{0.125f, 64 * 64}}, 64);
+        toneMapImage(rgba, 64, 64, ToneMapper::Clamp, manual);
+        expect(std::abs(rgba[0] - 0.25f) < 1e-6f, "manual exposure");
+    }
+
+    LOGI("Tone mapping: %s\n", ok ? "OK" : "FAILED");
+    return ok;
+}
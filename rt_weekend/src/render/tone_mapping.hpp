@@ -0,0 +1,74 @@
+#ifndef TONE_MAPPING_HPP
+#define TONE_MAPPING_HPP
+
+#include <nvmath/nvmath.h>
+#include <cstdint>
+#include <vector>
+
+// CPU reference of the post-processing chain, run on the GPU by
+// exposure_histogram.comp, exposure_adapt.comp and post.frag with the
+// functions of shaders/tone_mapping.glsl. Both must be kept in sync.
+//
+// - histogram: the log2 luminance of the pixels is binned between minLog2 and
+//   maxLog2; bin 0 holds the pixels darker than minLog2 (black background,
+//   not yet traced) and is left out of the metering
+// - exposure: the average log2 luminance of the pixels between the low and
+//   high percentiles is mapped to the middle grey keyValue, then shifted by
+//   the compensation in EV
+// - adaptation: the exposure moves exponentially towards the target in log2
+//   space, faster when the image gets brighter than darker
+// - tone mapping: the exposed radiance is mapped to [0, 1] by the operator,
+//   the gamma of the display is applied afterwards
+
+// Bins of the histogram, one per invocation of exposure_adapt.comp
+static constexpr uint32_t EXPOSURE_HISTOGRAM_BINS = 256;
+
+// `toneMapper` in post.frag
+enum class ToneMapper : int {
+    Clamp,     // Exposure only
+    Reinhard,  // x / (1 + x)
+    Aces,      // Fit of the ACES RRT and ODT by Stephen Hill
+    Filmic,    // Uncharted 2 curve by John Hable
+};
+
+struct ExposureSettings {
+    bool  autoExposure{true};
+    float compensation{0.0f};  // EV, the exposure itself when not automatic
+    float minLog2{-10.0f};     // Luminance range of the histogram
+    float maxLog2{8.0f};
+    float lowPercentile{0.5f};  // Metered pixels, the darkest and brightest are ignored
+    float highPercentile{0.95f};
+    float keyValue{0.18f};  // Middle grey
+    float speedUp{3.0f};    // Adaptation rates per second, to brighter and darker images
+    float speedDown{1.0f};
+};
+
+// Bin of a pixel of luminance `luminance`
+uint32_t luminanceBin(float luminance, float minLog2, float maxLog2);
+// Log2 luminance of the center of bin `bin` > 0
+float binLog2(uint32_t bin, float minLog2, float maxLog2);
+
+// Histogram of the linear RGBA texels, row-major
+std::vector<uint32_t> buildLuminanceHistogram(const std::vector<float>& rgba, uint32_t width, uint32_t height,
+                                              const ExposureSettings& settings, uint32_t numThreads = 0);
+// Average log2 luminance of the metered pixels, false when there are none
+bool meterHistogram(const std::vector<uint32_t>& histogram, const ExposureSettings& settings, float& averageLog2);
+// Log2 of the exposure bringing `averageLog2` to the key value
+float targetExposureLog2(float averageLog2, const ExposureSettings& settings);
+// Next log2 exposure, `deltaSeconds` after `currentLog2`
+float adaptExposureLog2(float currentLog2, float targetLog2, float deltaSeconds, const ExposureSettings& settings);
+
+// Exposed radiance to display [0, 1], before the gamma
+nvmath::vec3f toneMap(ToneMapper toneMapper, const nvmath::vec3f& color);
+
+// Converged chain applied to the texels in place, as post.frag displays them
+// once the exposure settled: the result is then only gamma corrected
+void toneMapImage(std::vector<float>& rgba, uint32_t width, uint32_t height, ToneMapper toneMapper,
+                  const ExposureSettings& settings, uint32_t numThreads = 0);
+
+// Checks the histogram, the metering, the adaptation and the operators
+// against analytic values, without device
+bool checkToneMapping();
+
+
+#endif
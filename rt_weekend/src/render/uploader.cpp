@@ -0,0 +1,326 @@
+#include "uploader.hpp"
+#include <nvh/nvprint.hpp>
+#include <nvvk/images_vk.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+void Uploader::init(vk::Device         device,
+                    vk::PhysicalDevice physicalDevice,
+                    vk::Queue          queue,
+                    uint32_t           queueFamily,
+                    vk::DeviceSize     budget)
+{
+    _device = device;
+    _queue  = queue;
+    _cmdPool = device.createCommandPool(
+        {vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient, queueFamily});
+
+    // A few chunks can be in flight while the next one is staged, the
+    // staging blocks are kept for the next batches instead of being freed
+    _budget    = std::max<vk::DeviceSize>(budget, 4 * 1024 * 1024);
+    _chunkSize = _budget / 4;
+    _staging.init(device, physicalDevice, _chunkSize);
+    _staging.setFreeUnusedOnRelease(false);
+}
+
+void Uploader::deinit()
+{
+    waitAll();
+
+    for (auto fence : _freeFences) {
+        _device.destroy(fence);
+    }
+    _freeFences.clear();
+    _freeCmdBufs.clear();
+    _device.destroy(_cmdPool);
+    _staging.deinit();
+}
+
+Uploader::Ticket Uploader::uploadBuffer(vk::Buffer buffer, vk::DeviceSize offset, const void* data, vk::DeviceSize size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    while (size > 0) {
+        vk::DeviceSize    chunk  = std::min(size, _chunkSize);
+        vk::CommandBuffer cmdBuf = reserve(chunk);
+        _staging.cmdToBuffer(cmdBuf, buffer, offset, chunk, bytes);
+        account(chunk);
+
+        bytes += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+    return getLastTicket();
+}
+
+Uploader::Ticket Uploader::uploadImage(vk::Image                        image,
+                                       const vk::ImageSubresourceRange& range,
+                                       const std::vector<ImageRegion>&  regions,
+                                       uint32_t                         blockSize,
+                                       vk::ImageLayout                  finalLayout,
+                                       vk::ImageLayout                  currentLayout)
+{
+    // The transition is recorded before the first copy, in the same batch
+    bool transitioned = false;
+    auto transition   = [&](vk::CommandBuffer cmdBuf) {
+        if (!transitioned) {
+            nvvk::cmdBarrierImageLayout(cmdBuf, image, currentLayout, vk::ImageLayout::eTransferDstOptimal, range);
+            transitioned = true;
+        }
+    };
+
+    for (const auto& region : regions) {
+        const uint8_t* bytes    = static_cast<const uint8_t*>(region.data);
+        uint32_t       nbRows   = (region.extent.height + blockSize - 1) / blockSize;
+        vk::DeviceSize rowBytes = region.size / nbRows;
+        uint32_t       rowsPerChunk = static_cast<uint32_t>(std::max<vk::DeviceSize>(1, _chunkSize / rowBytes));
+
+        vk::ImageSubresourceLayers subresource{range.aspectMask, region.mipLevel, region.layer, 1};
+        for (uint32_t row = 0; row < nbRows; row += rowsPerChunk) {
+            uint32_t       rows  = std::min(rowsPerChunk, nbRows - row);
+            vk::DeviceSize chunk = rowBytes * rows;
+            uint32_t       y     = row * blockSize;
+            uint32_t       h     = std::min(rows * blockSize, region.extent.height - y);
+
+            vk::CommandBuffer cmdBuf = reserve(chunk);
+            transition(cmdBuf);
+            _staging.cmdToImage(cmdBuf, image, {region.offset.x, region.offset.y + static_cast<int32_t>(y), 0},
+                                {region.extent.width, h, 1}, subresource, chunk, bytes + rowBytes * row);
+            account(chunk);
+        }
+    }
+
+    // Nothing can be flushed between the last copy and the final transition
+    vk::CommandBuffer cmdBuf = reserve(0);
+    transition(cmdBuf);
+    nvvk::cmdBarrierImageLayout(cmdBuf, image, vk::ImageLayout::eTransferDstOptimal, finalLayout, range);
+    return getLastTicket();
+}
+
+// Outside of the batches: the staging space must stay mapped until the
+// texels are copied out, retiring a batch would release it
+void Uploader::readImage(vk::Image                         image,
+                         vk::ImageLayout                   layout,
+                         const vk::ImageSubresourceLayers& subresource,
+                         const vk::Offset2D&               offset,
+                         const vk::Extent2D&               extent,
+                         void*                             data,
+                         vk::DeviceSize                    size)
+{
+    // The staging of the uploads recorded so far stays in their batch
+    flush();
+
+    vk::CommandBuffer cmdBuf = getCommandBuffer();
+    cmdBuf.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    vk::MemoryBarrier before{vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferRead};
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {},
+                           {before}, {}, {});
+    const void* mapped = _staging.cmdFromImage(cmdBuf, image, {offset.x, offset.y, 0}, {extent.width, extent.height, 1},
+                                               subresource, size, static_cast<VkImageLayout>(layout));
+    vk::MemoryBarrier after{vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead};
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, {after}, {},
+                           {});
+    cmdBuf.end();
+
+    nvvk::StagingMemoryManager::SetID stagingSet = _staging.finalizeResourceSet();
+    vk::Fence                         fence      = _device.createFence({});
+    vk::SubmitInfo                    submit;
+    submit.setCommandBufferCount(1);
+    submit.setPCommandBuffers(&cmdBuf);
+    _queue.submit({submit}, fence);
+
+    vk::Result result = _device.waitForFences({fence}, VK_TRUE, UINT64_MAX);
+    if (result == vk::Result::eSuccess) {
+        std::memcpy(data, mapped, size);
+    }
+    _staging.releaseResourceSet(stagingSet);
+    _device.destroy(fence);
+    _freeCmdBufs.push_back(cmdBuf);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to wait for an image read back");
+    }
+}
+
+Uploader::Ticket Uploader::flush()
+{
+    if (!_recording.cmdBuf) {
+        return getLastTicket();
+    }
+
+    // Makes the copies visible to whatever reads the buffers next: vertex
+    // input, shaders or acceleration structure builds
+    vk::MemoryBarrier barrier{vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead};
+    _recording.cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+                                      {}, {barrier}, {}, {});
+    _recording.cmdBuf.end();
+
+    if (_freeFences.empty()) {
+        _recording.fence = _device.createFence({});
+    } else {
+        _recording.fence = _freeFences.back();
+        _freeFences.pop_back();
+    }
+    _recording.stagingSet = _staging.finalizeResourceSet();
+
+    vk::SubmitInfo submit;
+    submit.setCommandBufferCount(1);
+    submit.setPCommandBuffers(&_recording.cmdBuf);
+    _queue.submit({submit}, _recording.fence);
+
+    _stats.nbBatches++;
+    _inFlight.push_back(_recording);
+    _recording = Batch{};
+    return _inFlight.back().ticket;
+}
+
+void Uploader::poll()
+{
+    while (!_inFlight.empty() && _device.getFenceStatus(_inFlight.front().fence) == vk::Result::eSuccess) {
+        retire(_inFlight.front());
+        _inFlight.pop_front();
+    }
+    updateBusy();
+}
+
+bool Uploader::isComplete(Ticket ticket)
+{
+    poll();
+    if (_recording.cmdBuf && ticket >= _recording.ticket) {
+        return false;
+    }
+    return _inFlight.empty() || _inFlight.front().ticket > ticket;
+}
+
+void Uploader::wait(Ticket ticket)
+{
+    if (_recording.cmdBuf && ticket >= _recording.ticket) {
+        flush();
+    }
+    while (!_inFlight.empty() && _inFlight.front().ticket <= ticket) {
+        waitOldest();
+    }
+}
+
+// Also frees the staging blocks, kept for reuse while uploads go on
+void Uploader::waitAll()
+{
+    flush();
+    while (!_inFlight.empty()) {
+        waitOldest();
+    }
+    _staging.freeUnused();
+}
+
+void Uploader::printStats() const
+{
+    LOGI("Uploader: %.1f MB in %u batches, %.2f GB/s\n", _stats.nbBytes / (1024.0 * 1024.0), _stats.nbBatches,
+         _stats.getThroughput());
+    LOGI("Uploader: peak staging %.1f MB staged, %.1f MB allocated (budget %.1f MB)\n",
+         _stats.peakStagedBytes / (1024.0 * 1024.0), _stats.peakAllocatedBytes / (1024.0 * 1024.0),
+         _budget / (1024.0 * 1024.0));
+}
+
+// -----------------------
+// Private Methods
+// -----------------------
+
+// Makes room in the budget for `size` staged bytes: submits what was
+// recorded, then waits for the oldest batches. Returns the command buffer of
+// the batch being recorded, begun if needed.
+vk::CommandBuffer Uploader::reserve(vk::DeviceSize size)
+{
+    while (_stagedBytes + size > _budget) {
+        if (_recording.cmdBuf) {
+            flush();
+        } else {
+            assert(!_inFlight.empty());
+            waitOldest();
+        }
+    }
+
+    if (!_recording.cmdBuf) {
+        _recording.ticket = _nextTicket++;
+        _recording.cmdBuf = getCommandBuffer();
+        _recording.cmdBuf.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        updateBusy();
+    }
+    return _recording.cmdBuf;
+}
+
+// Counts a copy of `size` bytes staged in the batch being recorded
+void Uploader::account(vk::DeviceSize size)
+{
+    _recording.stagedBytes += size;
+    _stagedBytes += size;
+    _stats.nbBytes += size;
+
+    vk::DeviceSize allocatedSize = 0;
+    vk::DeviceSize usedSize      = 0;
+    _staging.getUtilization(allocatedSize, usedSize);
+    _stats.peakAllocatedBytes = std::max(_stats.peakAllocatedBytes, allocatedSize);
+    _stats.peakStagedBytes    = std::max(_stats.peakStagedBytes, _stagedBytes);
+}
+
+// Of the batch being recorded, else of the last one submitted
+Uploader::Ticket Uploader::getLastTicket() const
+{
+    if (_recording.cmdBuf) {
+        return _recording.ticket;
+    }
+    return _inFlight.empty() ? 0 : _inFlight.back().ticket;
+}
+
+vk::CommandBuffer Uploader::getCommandBuffer()
+{
+    if (_freeCmdBufs.empty()) {
+        return _device.allocateCommandBuffers({_cmdPool, vk::CommandBufferLevel::ePrimary, 1})[0];
+    }
+    vk::CommandBuffer cmdBuf = _freeCmdBufs.back();
+    _freeCmdBufs.pop_back();
+    cmdBuf.reset({});
+    return cmdBuf;
+}
+
+// The batch has completed: gives its staging space, fence and command buffer back
+void Uploader::retire(Batch& batch)
+{
+    _staging.releaseResourceSet(batch.stagingSet);
+    _device.resetFences({batch.fence});
+    _freeFences.push_back(batch.fence);
+    _freeCmdBufs.push_back(batch.cmdBuf);
+    _stagedBytes -= batch.stagedBytes;
+}
+
+void Uploader::waitOldest()
+{
+    Batch& batch = _inFlight.front();
+    if (_device.waitForFences({batch.fence}, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to wait for an upload batch");
+    }
+    retire(batch);
+    _inFlight.pop_front();
+    updateBusy();
+}
+
+// Accumulates the time during which uploads are recorded or in flight
+void Uploader::updateBusy()
+{
+    bool busy = _recording.cmdBuf || !_inFlight.empty();
+    if (busy == _busy) {
+        return;
+    }
+
+    auto now = std::chrono::high_resolution_clock::now();
+    if (busy) {
+        _busyStart = now;
+    } else {
+        _stats.busySeconds += std::chrono::duration<double>(now - _busyStart).count();
+    }
+    _busy = busy;
+}
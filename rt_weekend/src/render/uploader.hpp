@@ -0,0 +1,137 @@
+#ifndef UPLOADER_HPP
+#define UPLOADER_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <nvvk/memorymanagement_vk.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Uploads data to device buffers and images with a bounded amount of staging
+// memory.
+// Copies are recorded in batches submitted to the queue on flush(), large
+// uploads are split in chunks so that the staged bytes of the batches not yet
+// completed never exceed the budget: the caller blocks on the oldest batch
+// when needed. Staging blocks are recycled once the fence of their batch has
+// signaled.
+//
+// Each upload returns the ticket of the batch holding its last chunk, which
+// can be polled or waited on. The destination must not be used by the GPU
+// before its ticket completed.
+class Uploader {
+public:
+    using Ticket = uint64_t;
+
+    static constexpr vk::DeviceSize DEFAULT_BUDGET = 256ULL * 1024 * 1024;
+
+    struct Stats {
+        uint64_t       nbBytes{0};
+        uint32_t       nbBatches{0};
+        double         busySeconds{0.0};    // Time with batches recording or in flight
+        vk::DeviceSize peakStagedBytes{0};  // Of the batches not yet completed
+        vk::DeviceSize peakAllocatedBytes{0};
+
+        double getThroughput() const { return busySeconds > 0.0 ? nbBytes / busySeconds * 1e-9 : 0.0; }  // GB/s
+    };
+
+    // Part of one mip level of one layer, tightly packed rows of texels or blocks
+    struct ImageRegion {
+        uint32_t       mipLevel{0};
+        uint32_t       layer{0};
+        vk::Offset2D   offset;
+        vk::Extent2D   extent;
+        const void*    data{nullptr};
+        vk::DeviceSize size{0};
+    };
+
+    void init(vk::Device         device,
+              vk::PhysicalDevice physicalDevice,
+              vk::Queue          queue,
+              uint32_t           queueFamily,
+              vk::DeviceSize     budget = DEFAULT_BUDGET);
+    void deinit();
+
+    Ticket uploadBuffer(vk::Buffer buffer, vk::DeviceSize offset, const void* data, vk::DeviceSize size);
+
+    template <typename T>
+    Ticket uploadBuffer(vk::Buffer buffer, vk::DeviceSize offset, const std::vector<T>& data)
+    {
+        return uploadBuffer(buffer, offset, data.data(), sizeof(T) * data.size());
+    }
+
+    // `range` in `finalLayout` once the ticket completed. Its previous content
+    // is discarded when `currentLayout` is undefined, else only the regions
+    // are overwritten. Regions larger than a chunk are split in rows of
+    // `blockSize` texels (4 for BC formats).
+    Ticket uploadImage(vk::Image                        image,
+                       const vk::ImageSubresourceRange& range,
+                       const std::vector<ImageRegion>&  regions,
+                       uint32_t                         blockSize     = 1,
+                       vk::ImageLayout                  finalLayout   = vk::ImageLayout::eShaderReadOnlyOptimal,
+                       vk::ImageLayout                  currentLayout = vk::ImageLayout::eUndefined);
+
+    // Copies a region of one mip level of one layer of `image`, in `layout`,
+    // to `data`: `size` bytes of tightly packed texels. Submits what was
+    // recorded and blocks until the copy completed. The writes of the work
+    // submitted before to the queue are visible to the copy.
+    void readImage(vk::Image                         image,
+                   vk::ImageLayout                   layout,
+                   const vk::ImageSubresourceLayers& subresource,
+                   const vk::Offset2D&               offset,
+                   const vk::Extent2D&               extent,
+                   void*                             data,
+                   vk::DeviceSize                    size);
+
+    // Submits the batch being recorded, returns its ticket
+    Ticket flush();
+
+    // Recycles the staging space of the completed batches
+    void poll();
+    bool isComplete(Ticket ticket);
+    void wait(Ticket ticket);
+    void waitAll();
+
+    const Stats& getStats() const { return _stats; }
+    void         printStats() const;
+
+private:
+    struct Batch {
+        Ticket                            ticket{0};
+        vk::CommandBuffer                 cmdBuf;
+        vk::Fence                         fence;
+        nvvk::StagingMemoryManager::SetID stagingSet;
+        vk::DeviceSize                    stagedBytes{0};
+    };
+
+    vk::CommandBuffer reserve(vk::DeviceSize size);
+    void              account(vk::DeviceSize size);
+    Ticket            getLastTicket() const;
+    vk::CommandBuffer getCommandBuffer();
+    void              retire(Batch& batch);
+    void              waitOldest();
+    void              updateBusy();
+
+    vk::Device                 _device;
+    vk::Queue                  _queue;
+    vk::CommandPool            _cmdPool;
+    nvvk::StagingMemoryManager _staging;
+    vk::DeviceSize             _budget{DEFAULT_BUDGET};
+    vk::DeviceSize             _chunkSize{DEFAULT_BUDGET / 4};
+
+    Batch             _recording;       // cmdBuf is null when nothing is recorded
+    std::deque<Batch> _inFlight;        // In submission order
+    vk::DeviceSize    _stagedBytes{0};  // Recording and in flight
+    Ticket            _nextTicket{1};
+
+    std::vector<vk::CommandBuffer> _freeCmdBufs;
+    std::vector<vk::Fence>         _freeFences;
+
+    Stats                                          _stats;
+    bool                                           _busy{false};
+    std::chrono::high_resolution_clock::time_point _busyStart;
+};
+
+
+#endif
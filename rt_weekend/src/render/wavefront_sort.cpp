@@ -0,0 +1,158 @@
+#include "wavefront_sort.hpp"
+#include "../common/parallel_for.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <nvh/radixsort.hpp>
+
+// -----------------------
+// Helpers
+// -----------------------
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+void WavefrontSort::sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, uint32_t keyBits, uint32_t numThreads)
+{
+    using Clock = std::chrono::high_resolution_clock;
+    assert(keys.size() == values.size());
+
+    const uint32_t count    = static_cast<uint32_t>(keys.size());
+    const uint32_t nbBlocks = getBlockCount(count);
+
+    _stats          = Stats();
+    _stats.nbKeys   = count;
+    _stats.nbPasses = getPassCount(keyBits);
+
+    _blockHistograms.resize(size_t(nbBlocks) * WAVEFRONT_SORT_RADIX);
+    _keysOut.resize(count);
+    _valuesOut.resize(count);
+
+    for (uint32_t pass = 0; pass < _stats.nbPasses; ++pass) {
+        const uint32_t shift = pass * 8;
+
+        // wavefront_sort_histogram.comp: one block per workgroup
+        auto start = Clock::now();
+        parallelFor(nbBlocks, numThreads, [&](uint32_t block) {
+            uint32_t* histogram = &_blockHistograms[size_t(block) * WAVEFRONT_SORT_RADIX];
+            std::fill_n(histogram, WAVEFRONT_SORT_RADIX, 0u);
+
+            uint32_t end = std::min(count, (block + 1) * WAVEFRONT_SORT_BLOCK_SIZE);
+            for (uint32_t i = block * WAVEFRONT_SORT_BLOCK_SIZE; i < end; ++i) {
+                histogram[(keys[i] >> shift) & 0xFF]++;
+            }
+        });
+        _stats.histogramMs += elapsedMs(start);
+
+        // wavefront_sort_scan.comp, where each thread walks the blocks for one
+        // digit value. Blocks are the outer loop here to read them in order.
+        start = Clock::now();
+        std::array<uint32_t, WAVEFRONT_SORT_RADIX> digitNext{};
+        for (uint32_t block = 0; block < nbBlocks; ++block) {
+            const uint32_t* histogram = &_blockHistograms[size_t(block) * WAVEFRONT_SORT_RADIX];
+            for (uint32_t digit = 0; digit < WAVEFRONT_SORT_RADIX; ++digit) {
+                digitNext[digit] += histogram[digit];
+            }
+        }
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < WAVEFRONT_SORT_RADIX; ++digit) {
+            uint32_t total   = digitNext[digit];
+            digitNext[digit] = offset;
+            offset += total;
+        }
+        for (uint32_t block = 0; block < nbBlocks; ++block) {
+            uint32_t* histogram = &_blockHistograms[size_t(block) * WAVEFRONT_SORT_RADIX];
+            for (uint32_t digit = 0; digit < WAVEFRONT_SORT_RADIX; ++digit) {
+                uint32_t total   = histogram[digit];
+                histogram[digit] = digitNext[digit];
+                digitNext[digit] += total;
+            }
+        }
+        _stats.scanMs += elapsedMs(start);
+
+        // wavefront_sort_scatter.comp: the rank of a key among the keys of the
+        // block with the same digit, counted by its thread
+        start = Clock::now();
+        parallelFor(nbBlocks, numThreads, [&](uint32_t block) {
+            const uint32_t* blockStart = &_blockHistograms[size_t(block) * WAVEFRONT_SORT_RADIX];
+            std::array<uint32_t, WAVEFRONT_SORT_RADIX> rank{};
+
+            uint32_t end = std::min(count, (block + 1) * WAVEFRONT_SORT_BLOCK_SIZE);
+            for (uint32_t i = block * WAVEFRONT_SORT_BLOCK_SIZE; i < end; ++i) {
+                uint32_t digit = (keys[i] >> shift) & 0xFF;
+                uint32_t dst   = blockStart[digit] + rank[digit]++;
+                _keysOut[dst]   = keys[i];
+                _valuesOut[dst] = values[i];
+            }
+        });
+        _stats.scatterMs += elapsedMs(start);
+
+        // The GPU passes ping-pong between two pairs of buffers
+        keys.swap(_keysOut);
+        values.swap(_valuesOut);
+    }
+}
+
+bool WavefrontSort::check(uint32_t count, uint32_t keyBits, uint32_t numThreads)
+{
+    // Few distinct values in the high bits, like the shading models of the
+    // queue, uniform in the low ones
+    std::vector<uint32_t> keys(count);
+    std::vector<uint32_t> values(count);
+    uint32_t              state = 0x9E3779B9U;
+    for (uint32_t i = 0; i < count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        uint32_t model = (state >> 29) % 5;
+        keys[i]        = ((model << 13) | (state & 0x1FFF)) & ((keyBits >= 32) ? ~0u : ((1u << keyBits) - 1));
+        values[i]      = i;
+    }
+
+    // nvh::radixsort compares bytes of the keys, little endian
+    std::vector<uint32_t> indicesIn(count);
+    std::vector<uint32_t> indicesTemp(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        indicesIn[i] = i;
+    }
+    auto      start = std::chrono::high_resolution_clock::now();
+    uint32_t* reference;
+    switch (getPassCount(keyBits)) {
+        case 1: reference = nvh::radixsort<0, 1>(count, keys.data(), indicesIn.data(), indicesTemp.data()); break;
+        case 2: reference = nvh::radixsort<0, 2>(count, keys.data(), indicesIn.data(), indicesTemp.data()); break;
+        case 3: reference = nvh::radixsort<0, 3>(count, keys.data(), indicesIn.data(), indicesTemp.data()); break;
+        default: reference = nvh::radixsort<0, 4>(count, keys.data(), indicesIn.data(), indicesTemp.data()); break;
+    }
+    double referenceMs = elapsedMs(start);
+
+    std::vector<uint32_t> sortedKeys = keys;
+    sort(sortedKeys, values, keyBits, numThreads);
+    _stats.referenceMs = referenceMs;
+
+    bool ok = std::equal(values.begin(), values.end(), reference);
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        ok = sortedKeys[i] == keys[values[i]] && (i == 0 || sortedKeys[i - 1] <= sortedKeys[i]);
+    }
+    if (!ok) {
+        LOGE("Wavefront sort: order differs from nvh::radixsort on %u keys of %u bits\n", count, keyBits);
+    }
+    return ok;
+}
+
+void WavefrontSort::printStats() const
+{
+    LOGI("Wavefront sort: %u keys, %u passes, %u blocks\n", _stats.nbKeys, _stats.nbPasses,
+         getBlockCount(_stats.nbKeys));
+    LOGI("Wavefront sort: histogram %.2f ms, scan %.2f ms, scatter %.2f ms, total %.2f ms (%.1f MKeys/s), "
+         "nvh::radixsort %.2f ms (%.1f MKeys/s)\n",
+         _stats.histogramMs, _stats.scanMs, _stats.scatterMs, _stats.getTotalMs(),
+         _stats.getThroughput(_stats.getTotalMs()), _stats.referenceMs, _stats.getThroughput(_stats.referenceMs));
+}
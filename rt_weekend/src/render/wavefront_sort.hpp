@@ -0,0 +1,59 @@
+#ifndef WAVEFRONT_SORT_HPP
+#define WAVEFRONT_SORT_HPP
+
+#include <cstdint>
+#include <vector>
+
+// Keys per block, the workgroup size of the sort passes
+static constexpr uint32_t WAVEFRONT_SORT_BLOCK_SIZE = 256;
+// Digit values of a pass, 8 bits per pass
+static constexpr uint32_t WAVEFRONT_SORT_RADIX = 256;
+
+// CPU reference of the sort of the wavefront hit queue by material key, run
+// on the GPU by wavefront_sort_histogram.comp, wavefront_sort_scan.comp and
+// wavefront_sort_scatter.comp. Both must be kept in sync.
+//
+// Same algorithm as nvh::radixsort: least significant byte first, one pass
+// per byte of the keys. Each pass is split in blocks of keys so that it maps
+// to three dispatches:
+// - histogram: each block counts its keys per digit value
+// - scan: exclusive prefix sum of the counts in (digit, block) order, gives
+//   where each block writes its first key of each digit value
+// - scatter: a key goes to that offset plus its rank among the keys of the
+//   block with the same digit value before it, which keeps the sort stable
+class WavefrontSort {
+public:
+    struct Stats {
+        uint32_t nbKeys{0};
+        uint32_t nbPasses{0};
+        double   histogramMs{0.0};
+        double   scanMs{0.0};
+        double   scatterMs{0.0};
+        double   referenceMs{0.0};  // nvh::radixsort
+
+        double getTotalMs() const { return histogramMs + scanMs + scatterMs; }
+        double getThroughput(double ms) const { return ms > 0.0 ? nbKeys / (ms * 1e3) : 0.0; }  // MKeys/s
+    };
+
+    static uint32_t getPassCount(uint32_t keyBits) { return (keyBits + 7) / 8; }
+    static uint32_t getBlockCount(uint32_t count) { return (count + WAVEFRONT_SORT_BLOCK_SIZE - 1) / WAVEFRONT_SORT_BLOCK_SIZE; }
+
+    // Sorts `keys` and moves `values` along, only the low `keyBits` of the keys are compared.
+    // The blocks of a dispatch are spread over numThreads, 0 uses all the cores.
+    void sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, uint32_t keyBits, uint32_t numThreads = 0);
+
+    // Sorts `count` random keys and checks the order against nvh::radixsort
+    bool check(uint32_t count, uint32_t keyBits, uint32_t numThreads = 0);
+
+    const Stats& getStats() const { return _stats; }
+    void         printStats() const;
+
+private:
+    std::vector<uint32_t> _blockHistograms;  // Block major: [block * RADIX + digit]
+    std::vector<uint32_t> _keysOut;
+    std::vector<uint32_t> _valuesOut;
+    Stats                 _stats;
+};
+
+
+#endif
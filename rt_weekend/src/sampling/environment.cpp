@@ -0,0 +1,494 @@
+#include "environment.hpp"
+#include "sampler.hpp"
+#include "../common/parallel_for.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+static constexpr float MATH_PI           = 3.14159265358979f;
+static constexpr float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+// Rows per parallel work item
+static constexpr uint32_t ROWS_PER_CHUNK = 16;
+
+// Sun of the procedural sky, the cosine of its angular radius (2 degrees)
+static const nvmath::vec3f SUN_DIRECTION = nvmath::normalize(nvmath::vec3f(0.3f, 0.8f, -0.5f));
+static constexpr float     SUN_COS_RADIUS = 0.99939083f;
+
+// -----------------------
+// Helpers
+// -----------------------
+
+static float luminance(const nvmath::vec3f& c)
+{
+    return std::max(0.0f, 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z);
+}
+
+static uint32_t getChunkCount(uint32_t rows)
+{
+    return (rows + ROWS_PER_CHUNK - 1) / ROWS_PER_CHUNK;
+}
+
+// Index of the interval of `u` in the CDF of `count` intervals, the first one
+// whose upper bound is above `u`: empty intervals are never picked. Same
+// search as findInterval in environment.glsl.
+static uint32_t findInterval(const float* cdf, uint32_t count, float u)
+{
+    uint32_t first = 0;
+    while (count > 0) {
+        uint32_t step = count / 2;
+        uint32_t it   = first + step;
+        if (cdf[it + 1] <= u) {
+            first = it + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+// Bilinear, clamped at the edges of the face
+static nvmath::vec3f sampleCube(const std::array<const float*, 6>& faces, uint32_t size, uint32_t channels,
+                                const nvmath::vec3f& d)
+{
+    // Face selection and (sc, tc, ma) of the Vulkan specification
+    float    ax = std::fabs(d.x), ay = std::fabs(d.y), az = std::fabs(d.z);
+    uint32_t face;
+    float    sc, tc, ma;
+    if (ax >= ay && ax >= az) {
+        face = d.x >= 0.0f ? 0 : 1;
+        sc   = d.x >= 0.0f ? -d.z : d.z;
+        tc   = -d.y;
+        ma   = ax;
+    } else if (ay >= az) {
+        face = d.y >= 0.0f ? 2 : 3;
+        sc   = d.x;
+        tc   = d.y >= 0.0f ? d.z : -d.z;
+        ma   = ay;
+    } else {
+        face = d.z >= 0.0f ? 4 : 5;
+        sc   = d.z >= 0.0f ? d.x : -d.x;
+        tc   = -d.y;
+        ma   = az;
+    }
+
+    float s  = std::min(std::max(0.5f * (sc / ma + 1.0f) * size - 0.5f, 0.0f), float(size - 1));
+    float t  = std::min(std::max(0.5f * (tc / ma + 1.0f) * size - 0.5f, 0.0f), float(size - 1));
+    auto  x0 = static_cast<uint32_t>(s), y0 = static_cast<uint32_t>(t);
+    auto  x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+    float fx = s - float(x0), fy = t - float(y0);
+
+    auto texel = [&](uint32_t x, uint32_t y) {
+        const float* p = faces[face] + (size_t(y) * size + x) * channels;
+        return channels >= 3 ? nvmath::vec3f(p[0], p[1], p[2]) : nvmath::vec3f(p[0]);
+    };
+    return (texel(x0, y0) * (1.0f - fx) + texel(x1, y0) * fx) * (1.0f - fy)
+           + (texel(x0, y1) * (1.0f - fx) + texel(x1, y1) * fx) * fy;
+}
+
+static float toUnitFloat(uint32_t bits)
+{
+    return std::min(float(bits >> 8) * (1.0f / 16777216.0f), ONE_MINUS_EPSILON);
+}
+
+// Independent stream per seed, for the checks and the benchmark
+struct HashRng {
+    uint32_t seed;
+    uint32_t counter{0};
+
+    float         next() { return toUnitFloat(Sampler::hash(Sampler::hashCombine(seed, counter++))); }
+    nvmath::vec2f next2D()
+    {
+        float x = next();
+        return nvmath::vec2f(x, next());
+    }
+};
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+void Environment::buildFromEquirect(const float* texels, uint32_t width, uint32_t height, uint32_t channels,
+                                    float intensity, uint32_t numThreads)
+{
+    resize(width, height);
+    for (size_t i = 0; i < size_t(width) * height; i++) {
+        const float* p = texels + i * channels;
+        for (uint32_t c = 0; c < 3; c++) {
+            _texels[i * 4 + c] = intensity * (channels >= 3 ? p[c] : p[0]);
+        }
+    }
+    buildDistribution(numThreads);
+}
+
+void Environment::buildFromCube(const std::array<const float*, 6>& faces, uint32_t faceSize, uint32_t channels,
+                                float intensity, uint32_t width, uint32_t numThreads)
+{
+    resize(width, std::max(1u, width / 2));
+    parallelFor(getChunkCount(_height), numThreads, [&](uint32_t chunk) {
+        uint32_t end = std::min(_height, (chunk + 1) * ROWS_PER_CHUNK);
+        for (uint32_t y = chunk * ROWS_PER_CHUNK; y < end; y++) {
+            for (uint32_t x = 0; x < _width; x++) {
+                nvmath::vec2f uv((x + 0.5f) / _width, (y + 0.5f) / _height);
+                nvmath::vec3f c = intensity * sampleCube(faces, faceSize, channels, uvToDirection(uv));
+                std::memcpy(&_texels[(size_t(y) * _width + x) * 4], &c.x, 3 * sizeof(float));
+            }
+        }
+    });
+    buildDistribution(numThreads);
+}
+
+void Environment::buildSky(uint32_t width, float intensity, float sun, uint32_t numThreads)
+{
+    resize(width, std::max(1u, width / 2));
+    parallelFor(getChunkCount(_height), numThreads, [&](uint32_t chunk) {
+        uint32_t end = std::min(_height, (chunk + 1) * ROWS_PER_CHUNK);
+        for (uint32_t y = chunk * ROWS_PER_CHUNK; y < end; y++) {
+            for (uint32_t x = 0; x < _width; x++) {
+                nvmath::vec3f d = uvToDirection(nvmath::vec2f((x + 0.5f) / _width, (y + 0.5f) / _height));
+                float         t = 0.5f * (d.y + 1.0f);
+                nvmath::vec3f c = (1.0f - t) * nvmath::vec3f(1.0f) + t * nvmath::vec3f(0.5f, 0.7f, 1.0f);
+                if (sun > 0.0f && nvmath::dot(d, SUN_DIRECTION) >= SUN_COS_RADIUS) {
+                    c = nvmath::vec3f(sun, sun * 0.95f, sun * 0.85f);
+                }
+                c = intensity * c;
+                std::memcpy(&_texels[(size_t(y) * _width + x) * 4], &c.x, 3 * sizeof(float));
+            }
+        }
+    });
+    buildDistribution(numThreads);
+}
+
+// u = 0.5 looks down -Z, v = 0 up +Y
+nvmath::vec2f Environment::directionToUv(const nvmath::vec3f& direction)
+{
+    float u = std::atan2(direction.x, -direction.z) / (2.0f * MATH_PI) + 0.5f;
+    float v = std::acos(std::min(std::max(direction.y, -1.0f), 1.0f)) / MATH_PI;
+    return nvmath::vec2f(u, v);
+}
+
+nvmath::vec3f Environment::uvToDirection(const nvmath::vec2f& uv)
+{
+    float phi      = (uv.x - 0.5f) * 2.0f * MATH_PI;
+    float theta    = uv.y * MATH_PI;
+    float sinTheta = std::sin(theta);
+    return nvmath::vec3f(sinTheta * std::sin(phi), std::cos(theta), -sinTheta * std::cos(phi));
+}
+
+nvmath::vec3f Environment::eval(const nvmath::vec3f& direction) const
+{
+    nvmath::vec2f uv = directionToUv(direction);
+    uint32_t      x  = std::min(static_cast<uint32_t>(uv.x * _width), _width - 1);
+    uint32_t      y  = std::min(static_cast<uint32_t>(uv.y * _height), _height - 1);
+    const float*  p  = &_texels[(size_t(y) * _width + x) * 4];
+    return nvmath::vec3f(p[0], p[1], p[2]);
+}
+
+// Row from the marginal, column from the conditional of the row, uniform in
+// the texel: the density in the map is constant per texel, divided by the
+// Jacobian 2 pi^2 sin(theta) of the mapping to get it per solid angle
+EnvironmentSample Environment::sample(const nvmath::vec2f& u) const
+{
+    uint32_t y  = findInterval(_marginalCdf.data(), _height, u.y);
+    float    py = _marginalCdf[y + 1] - _marginalCdf[y];
+    float    v  = (y + std::min((u.y - _marginalCdf[y]) / py, ONE_MINUS_EPSILON)) / _height;
+
+    const float* row = &_conditionalCdf[size_t(y) * (_width + 1)];
+    uint32_t     x   = findInterval(row, _width, u.x);
+    float        px  = row[x + 1] - row[x];
+    float        s   = (x + std::min((u.x - row[x]) / px, ONE_MINUS_EPSILON)) / _width;
+
+    EnvironmentSample result;
+    result.direction = uvToDirection(nvmath::vec2f(s, v));
+
+    float sinTheta = std::sin(v * MATH_PI);
+    result.pdf = sinTheta > 0.0f ? py * _height * px * _width / (2.0f * MATH_PI * MATH_PI * sinTheta) : 0.0f;
+
+    const float* p  = &_texels[(size_t(y) * _width + x) * 4];
+    result.radiance = nvmath::vec3f(p[0], p[1], p[2]);
+    return result;
+}
+
+float Environment::pdf(const nvmath::vec3f& direction) const
+{
+    nvmath::vec2f uv = directionToUv(direction);
+    uint32_t      x  = std::min(static_cast<uint32_t>(uv.x * _width), _width - 1);
+    uint32_t      y  = std::min(static_cast<uint32_t>(uv.y * _height), _height - 1);
+
+    // From the angle rather than the direction, precise near the poles
+    const float* row      = &_conditionalCdf[size_t(y) * (_width + 1)];
+    float        pdfUv    = (_marginalCdf[y + 1] - _marginalCdf[y]) * _height * (row[x + 1] - row[x]) * _width;
+    float        sinTheta = std::sin(uv.y * MATH_PI);
+    return sinTheta > 0.0f ? pdfUv / (2.0f * MATH_PI * MATH_PI * sinTheta) : 0.0f;
+}
+
+std::vector<uint32_t> Environment::pack() const
+{
+    std::vector<uint32_t> data = {_width, _height, 0, 0};
+    data.reserve(4 + _marginalCdf.size() + _conditionalCdf.size());
+    for (const auto* cdf : {&_marginalCdf, &_conditionalCdf}) {
+        for (float value : *cdf) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            data.push_back(bits);
+        }
+    }
+    return data;
+}
+
+// -----------------------
+// Private Methods
+// -----------------------
+
+void Environment::resize(uint32_t width, uint32_t height)
+{
+    _width  = width;
+    _height = height;
+    _texels.assign(size_t(width) * height * 4, 1.0f);
+}
+
+// The rows are independent, built in parallel; the marginal over their
+// integrals is a prefix sum of `_height` values. The sums are in double: the
+// CDFs of large maps would drift in float. A row, or the whole map, without
+// any radiance gets a uniform CDF so that the density never vanishes where
+// the BSDF could still find light.
+void Environment::buildDistribution(uint32_t numThreads)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<double> rowIntegrals(_height);
+    _conditionalCdf.resize(size_t(_height) * (_width + 1));
+    parallelFor(getChunkCount(_height), numThreads, [&](uint32_t chunk) {
+        uint32_t end = std::min(_height, (chunk + 1) * ROWS_PER_CHUNK);
+        for (uint32_t y = chunk * ROWS_PER_CHUNK; y < end; y++) {
+            float  sinTheta = std::sin((y + 0.5f) / _height * MATH_PI);
+            float* cdf      = &_conditionalCdf[size_t(y) * (_width + 1)];
+            double sum      = 0.0;
+
+            cdf[0] = 0.0f;
+            for (uint32_t x = 0; x < _width; x++) {
+                const float* p = &_texels[(size_t(y) * _width + x) * 4];
+                sum += double(luminance(nvmath::vec3f(p[0], p[1], p[2]))) * sinTheta;
+                cdf[x + 1] = float(sum);
+            }
+            for (uint32_t x = 1; x <= _width; x++) {
+                cdf[x] = sum > 0.0 ? float(cdf[x] / sum) : float(x) / _width;
+            }
+            cdf[_width]     = 1.0f;
+            rowIntegrals[y] = sum;
+        }
+    });
+
+    _marginalCdf.resize(_height + 1);
+    double total    = 0.0;
+    _marginalCdf[0] = 0.0f;
+    for (uint32_t y = 0; y < _height; y++) {
+        total += rowIntegrals[y];
+        _marginalCdf[y + 1] = float(total);
+    }
+    for (uint32_t y = 1; y <= _height; y++) {
+        _marginalCdf[y] = total > 0.0 ? float(_marginalCdf[y] / total) : float(y) / _height;
+    }
+    _marginalCdf[_height] = 1.0f;
+
+    _buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// -----------------------
+// Check and Benchmark
+// -----------------------
+
+bool checkEnvironment(const Environment& env)
+{
+    bool ok    = true;
+    auto check = [&](bool condition, const char* what, double value) {
+        LOGI("Environment: %s %g\n", what, value);
+        if (!condition) {
+            LOGE("Environment: %s out of tolerance\n", what);
+            ok = false;
+        }
+    };
+
+    const uint32_t width = env.getWidth(), height = env.getHeight();
+
+    // Integral of the density over the sphere, stratified uniform directions
+    const uint32_t strata   = 1024;
+    double         integral = 0.0;
+    HashRng        rng{1};
+    for (uint32_t i = 0; i < strata * strata; i++) {
+        nvmath::vec2f u((i % strata + rng.next()) / strata, (i / strata + rng.next()) / strata);
+        integral += env.pdf(sampleUniformSphere(u));
+    }
+    integral *= 4.0 * MATH_PI / (double(strata) * strata);
+    check(std::fabs(integral - 1.0) < 0.01, "integral of the pdf", integral);
+
+    // Density proportional to the luminance: pdf / luminance is the inverse of
+    // the integral of the luminance, at the center of each texel. The float
+    // CDFs lose a few bits on the dim texels of a map with a bright sun.
+    double lumIntegral = 0.0;
+    for (uint32_t y = 0; y < height; y++) {
+        double sinTheta = std::sin((y + 0.5) / height * MATH_PI);
+        for (uint32_t x = 0; x < width; x++) {
+            const float* p = &env.getTexels()[(size_t(y) * width + x) * 4];
+            lumIntegral += luminance(nvmath::vec3f(p[0], p[1], p[2])) * sinTheta;
+        }
+    }
+    lumIntegral *= 2.0 * MATH_PI * MATH_PI / (double(width) * height);
+    double maxRatioError = 0.0;
+    if (lumIntegral > 0.0) {
+        for (uint32_t y = 0; y < height; y += std::max(1u, height / 64)) {
+            for (uint32_t x = 0; x < width; x += std::max(1u, width / 64)) {
+                nvmath::vec3f d   = Environment::uvToDirection(nvmath::vec2f((x + 0.5f) / width, (y + 0.5f) / height));
+                float         lum = luminance(env.eval(d));
+                double        expected = lum / lumIntegral;
+                maxRatioError = std::max(maxRatioError, std::fabs(env.pdf(d) - expected) / std::max(expected, 1e-3));
+            }
+        }
+    }
+    check(maxRatioError < 1e-2, "max relative error of pdf / luminance", maxRatioError);
+
+    // Histogram of the samples over a coarse grid of the map against the
+    // probability of each cell, and the density of each sample against pdf()
+    const uint32_t cellsX = std::min(width, 32u), cellsY = std::min(height, 16u);
+    const uint32_t chunks = 64, samplesPerChunk = 1 << 17;
+
+    std::vector<std::vector<uint32_t>> histograms(chunks, std::vector<uint32_t>(cellsX * cellsY, 0));
+    std::vector<uint32_t>              mismatches(chunks, 0);
+    parallelFor(chunks, 0, [&](uint32_t chunk) {
+        HashRng rng{Sampler::hash(chunk + 2)};
+        for (uint32_t i = 0; i < samplesPerChunk; i++) {
+            EnvironmentSample s = env.sample(rng.next2D());
+            nvmath::vec2f     uv = Environment::directionToUv(s.direction);
+            uint32_t cx = std::min(static_cast<uint32_t>(uv.x * cellsX), cellsX - 1);
+            uint32_t cy = std::min(static_cast<uint32_t>(uv.y * cellsY), cellsY - 1);
+            histograms[chunk][cy * cellsX + cx]++;
+
+            // Samples landing on a texel edge may be looked up in the
+            // neighbour, the latitude of the direction is imprecise at the poles
+            float pdf = env.pdf(s.direction);
+            if (std::fabs(pdf - s.pdf) > 1e-2f * std::max(pdf, s.pdf)) {
+                mismatches[chunk]++;
+            }
+        }
+    });
+
+    std::vector<double> expected(cellsX * cellsY, 0.0);
+    for (uint32_t y = 0; y < height; y++) {
+        double sinTheta = std::sin((y + 0.5) / height * MATH_PI);
+        for (uint32_t x = 0; x < width; x++) {
+            nvmath::vec3f d = Environment::uvToDirection(nvmath::vec2f((x + 0.5f) / width, (y + 0.5f) / height));
+            uint32_t      cell = (y * cellsY / height) * cellsX + x * cellsX / width;
+            // Probability of the texel: density times its solid angle
+            expected[cell] += env.pdf(d) * sinTheta * 2.0 * MATH_PI * MATH_PI / (double(width) * height);
+        }
+    }
+
+    const double total     = double(chunks) * samplesPerChunk;
+    double       variation = 0.0;
+    uint32_t     mismatch  = 0;
+    for (uint32_t cell = 0; cell < cellsX * cellsY; cell++) {
+        uint32_t count = 0;
+        for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+            count += histograms[chunk][cell];
+        }
+        variation += 0.5 * std::fabs(count / total - expected[cell]);
+    }
+    for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+        mismatch += mismatches[chunk];
+    }
+    check(variation < 0.005, "total variation between the histogram and the pdf", variation);
+    check(mismatch < total * 1e-3, "fraction of samples whose pdf differs from pdf()", mismatch / total);
+
+    if (ok) {
+        LOGI("Environment: OK\n");
+    }
+    return ok;
+}
+
+std::vector<EnvironmentConvergencePoint> benchmarkEnvironment(const Environment& env, uint32_t maxSpp,
+                                                              uint32_t numThreads)
+{
+    const uint32_t nbNormals = 64, trials = 64;
+
+    // Normals spread over the sphere, Fibonacci lattice
+    std::vector<nvmath::vec3f> normals(nbNormals);
+    for (uint32_t i = 0; i < nbNormals; i++) {
+        float z    = 1.0f - (2.0f * i + 1.0f) / nbNormals;
+        float r    = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        float phi  = 2.39996323f * i;
+        normals[i] = nvmath::vec3f(r * std::cos(phi), z, r * std::sin(phi));
+    }
+
+    // Reference: outgoing radiance of a white Lambertian surface, midpoint
+    // rule over 2x2 points per texel of the (nearest filtered) map
+    const uint32_t      width = env.getWidth(), height = env.getHeight();
+    std::vector<double> reference(nbNormals, 0.0);
+    parallelFor(nbNormals, numThreads, [&](uint32_t n) {
+        double sum = 0.0;
+        for (uint32_t y = 0; y < height * 2; y++) {
+            double sinTheta = std::sin((y + 0.5) / (height * 2) * MATH_PI);
+            for (uint32_t x = 0; x < width * 2; x++) {
+                nvmath::vec3f d = Environment::uvToDirection(
+                    nvmath::vec2f((x + 0.5f) / (width * 2), (y + 0.5f) / (height * 2)));
+                float cosTheta = nvmath::dot(d, normals[n]);
+                if (cosTheta > 0.0f) {
+                    sum += luminance(env.eval(d)) * cosTheta / MATH_PI * sinTheta;
+                }
+            }
+        }
+        reference[n] = sum * 2.0 * MATH_PI * MATH_PI / (4.0 * width * height);
+    });
+
+    // Running sums of the three estimators of each (normal, trial)
+    struct Sums {
+        double bsdf{0.0}, light{0.0}, mis{0.0};
+    };
+    std::vector<Sums> sums(nbNormals * trials);
+
+    std::vector<EnvironmentConvergencePoint> result;
+    uint32_t                                 done = 0;
+    for (uint32_t spp = 1; spp <= maxSpp; spp *= 2) {
+        parallelFor(nbNormals * trials, numThreads, [&](uint32_t i) {
+            const nvmath::vec3f& normal = normals[i / trials];
+            HashRng              rng{Sampler::hash(i), done * 4};
+            Sums&                s = sums[i];
+            for (uint32_t k = done; k < spp; k++) {
+                // BSDF sampling: the cosine cancels out, the estimate is the radiance
+                nvmath::vec3f wb       = sampleCosineHemisphere(rng.next2D(), normal);
+                float         lb       = luminance(env.eval(wb));
+                float         bsdfPdfB = std::max(0.0f, nvmath::dot(wb, normal)) / MATH_PI;
+                float         lightPdfB = env.pdf(wb);
+                s.bsdf += lb;
+
+                // Environment sampling
+                EnvironmentSample ls       = env.sample(rng.next2D());
+                float             cosL     = nvmath::dot(ls.direction, normal);
+                float             fL       = cosL > 0.0f ? cosL / MATH_PI : 0.0f;
+                float             estimate = ls.pdf > 0.0f ? luminance(ls.radiance) * fL / ls.pdf : 0.0f;
+                s.light += estimate;
+
+                // Both, power heuristic
+                float wB = bsdfPdfB * bsdfPdfB / (bsdfPdfB * bsdfPdfB + lightPdfB * lightPdfB);
+                float wL = ls.pdf > 0.0f ? ls.pdf * ls.pdf / (ls.pdf * ls.pdf + fL * fL) : 0.0f;
+                s.mis += (bsdfPdfB > 0.0f ? wB * lb : 0.0f) + wL * estimate;
+            }
+        });
+        done = spp;
+
+        double errBsdf = 0.0, errLight = 0.0, errMis = 0.0;
+        for (uint32_t i = 0; i < nbNormals * trials; i++) {
+            double ref = reference[i / trials];
+            errBsdf += (sums[i].bsdf / spp - ref) * (sums[i].bsdf / spp - ref);
+            errLight += (sums[i].light / spp - ref) * (sums[i].light / spp - ref);
+            errMis += (sums[i].mis / spp - ref) * (sums[i].mis / spp - ref);
+        }
+        double count = double(nbNormals) * trials;
+        result.push_back({spp, float(std::sqrt(errBsdf / count)), float(std::sqrt(errLight / count)),
+                          float(std::sqrt(errMis / count))});
+    }
+
+    return result;
+}
@@ -0,0 +1,97 @@
+#ifndef ENVIRONMENT_HPP
+#define ENVIRONMENT_HPP
+
+#include <nvmath/nvmath.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU mirror of shaders/environment.glsl. The sky is an equirectangular
+// radiance map (u along the azimuth, v from +Y down to -Y), importance
+// sampled through a piecewise constant 2D distribution proportional to the
+// luminance of each texel times the sine of its latitude: a marginal CDF over
+// the rows, then a conditional CDF per row. The CDFs are uploaded as is to
+// the storage buffer read by the shaders; the mapping and the sampling
+// functions must be kept in sync with their GLSL counterparts.
+
+struct EnvironmentSettings {
+    std::string filename;          // Equirectangular image (HDR or LDR), empty: procedural sky or cube
+    bool        cube{false};       // Skybox cube faces of media/textures/skybox, resampled to equirect
+    float       intensity{1.0f};   // Scale of the radiance
+    float       sun{0.0f};         // Radiance of a sun disk added to the procedural sky
+    uint32_t    width{1024};       // Of the resampled map, the height is half of it
+    uint32_t    numThreads{0};     // 0: hardware concurrency
+};
+
+struct EnvironmentSample {
+    nvmath::vec3f direction;
+    nvmath::vec3f radiance;
+    float         pdf{0.0f};  // Solid angle
+};
+
+class Environment {
+public:
+    // Linear RGB(A) texels, row-major from the top row. Builds the distribution.
+    void buildFromEquirect(const float* texels, uint32_t width, uint32_t height, uint32_t channels, float intensity,
+                           uint32_t numThreads);
+    // Faces +X, -X, +Y, -Y, +Z, -Z of a cube, as sampled by Vulkan, resampled to width x width / 2
+    void buildFromCube(const std::array<const float*, 6>& faces, uint32_t faceSize, uint32_t channels, float intensity,
+                       uint32_t width, uint32_t numThreads);
+    // Gradient of raytrace.rmiss before the environment map, the default sky,
+    // with a sun of radiance `sun` when not 0
+    void buildSky(uint32_t width, float intensity, float sun, uint32_t numThreads);
+
+    // Mapping between the unit directions and the [0, 1)^2 map coordinates
+    static nvmath::vec2f directionToUv(const nvmath::vec3f& direction);
+    static nvmath::vec3f uvToDirection(const nvmath::vec2f& uv);
+
+    // Nearest texel, the shaders filter bilinearly
+    nvmath::vec3f eval(const nvmath::vec3f& direction) const;
+    // `u` in [0, 1)^2
+    EnvironmentSample sample(const nvmath::vec2f& u) const;
+    // Solid angle density of sample() in `direction`
+    float pdf(const nvmath::vec3f& direction) const;
+
+    uint32_t                  getWidth() const { return _width; }
+    uint32_t                  getHeight() const { return _height; }
+    const std::vector<float>& getTexels() const { return _texels; }  // RGBA
+    double                    getBuildMs() const { return _buildMs; }
+
+    // Content of the EnvironmentDistribution storage buffer: width, height and
+    // 2 words of padding, the marginal CDF (height + 1), then the conditional
+    // CDF of each row (width + 1 each)
+    std::vector<uint32_t> pack() const;
+
+private:
+    void resize(uint32_t width, uint32_t height);
+    void buildDistribution(uint32_t numThreads);
+
+    uint32_t           _width{0};
+    uint32_t           _height{0};
+    std::vector<float> _texels;          // RGBA, row-major
+    std::vector<float> _marginalCdf;     // _height + 1
+    std::vector<float> _conditionalCdf;  // (_width + 1) per row
+    double             _buildMs{0.0};    // Distribution only
+};
+
+// Checks the distribution without device: the density integrates to one,
+// sample() and pdf() agree, the histogram of the samples follows the density
+bool checkEnvironment(const Environment& env);
+
+// Irradiance at a few normals of a diffuse surface lit by `env` only, for
+// sample counts doubling up to `maxSpp`: RMSE against a converged reference
+// for BSDF sampling, environment sampling and both combined with the power
+// heuristic, as traceLambertianMaterial does
+struct EnvironmentConvergencePoint {
+    uint32_t spp{0};
+    float    rmseBsdf{0.0f};
+    float    rmseLight{0.0f};
+    float    rmseMis{0.0f};
+};
+
+std::vector<EnvironmentConvergencePoint> benchmarkEnvironment(const Environment& env, uint32_t maxSpp,
+                                                              uint32_t numThreads);
+
+
+#endif
@@ -0,0 +1,411 @@
+#include "sampler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static constexpr float MATH_PI            = 3.14159265358979f;
+static constexpr float ONE_MINUS_EPSILON  = 0x1.fffffep-1f;
+static constexpr float BLUE_NOISE_SIGMA   = 1.5f;
+static constexpr float INITIAL_DENSITY    = 0.1f;
+static constexpr uint32_t BLUE_NOISE_SEED = 0x68bc21ebu;  // Shared scrambling of SamplerType::BlueNoise
+
+// Joe & Kuo primitive polynomials (degree s, coefficients a) and initial
+// direction numbers m, for dimensions 1 to SOBOL_DIMENSIONS - 1.
+// Dimension 0 is the van der Corput sequence.
+struct SobolInitializer {
+    uint32_t s;
+    uint32_t a;
+    uint32_t m[6];
+};
+
+static const SobolInitializer SOBOL_INITIALIZERS[SamplerTables::SOBOL_DIMENSIONS - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+};
+
+// Maps 32 random bits to [0, 1), keeping the 24 bits a float can hold
+static float toUnitFloat(uint32_t bits)
+{
+    return std::min(float(bits >> 8) * (1.0f / 16777216.0f), ONE_MINUS_EPSILON);
+}
+
+static uint32_t reverseBits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// -----------------------
+// SamplerTables
+// -----------------------
+
+SamplerTables::SamplerTables(uint32_t blueNoiseSeed)
+{
+    buildSobolMatrices();
+    buildBlueNoise(blueNoiseSeed);
+}
+
+void SamplerTables::buildSobolMatrices()
+{
+    _sobolMatrices.assign(SOBOL_DIMENSIONS * SOBOL_BITS, 0);
+
+    for (uint32_t bit = 0; bit < SOBOL_BITS; ++bit) {
+        _sobolMatrices[bit] = 1u << (31 - bit);
+    }
+
+    for (uint32_t dim = 1; dim < SOBOL_DIMENSIONS; ++dim) {
+        const SobolInitializer& init    = SOBOL_INITIALIZERS[dim - 1];
+        uint32_t*               columns = &_sobolMatrices[dim * SOBOL_BITS];
+
+        for (uint32_t k = 0; k < SOBOL_BITS; ++k) {
+            if (k < init.s) {
+                columns[k] = init.m[k] << (31 - k);
+                continue;
+            }
+
+            uint32_t v = columns[k - init.s] ^ (columns[k - init.s] >> init.s);
+            for (uint32_t i = 1; i < init.s; ++i) {
+                if ((init.a >> (init.s - 1 - i)) & 1u) {
+                    v ^= columns[k - i];
+                }
+            }
+            columns[k] = v;
+        }
+    }
+}
+
+// Void-and-cluster (Ulichney 1993) on a torus. The energy of a pixel is the
+// gaussian-weighted count of set pixels around it: the tightest cluster is
+// the set pixel of highest energy, the largest void the empty one of lowest.
+void SamplerTables::buildBlueNoise(uint32_t seed)
+{
+    const int N = int(BLUE_NOISE_SIZE);
+    const int P = N * N;
+
+    std::vector<float> kernel(P);
+    for (int dy = 0; dy < N; ++dy) {
+        for (int dx = 0; dx < N; ++dx) {
+            int wx = std::min(dx, N - dx);
+            int wy = std::min(dy, N - dy);
+            kernel[dy * N + dx] = std::exp(-float(wx * wx + wy * wy) / (2.0f * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+        }
+    }
+
+    std::vector<uint8_t> pattern(P, 0);
+    std::vector<float>   energy(P, 0.0f);
+
+    auto toggle = [&](std::vector<uint8_t>& bits, std::vector<float>& field, int index) {
+        float sign = bits[index] ? -1.0f : 1.0f;
+        bits[index] ^= 1;
+        int   ix = index % N, iy = index / N;
+        for (int y = 0; y < N; ++y) {
+            const float* row = &kernel[((y - iy + N) % N) * N];
+            for (int x = 0; x < N; ++x) {
+                field[y * N + x] += sign * row[(x - ix + N) % N];
+            }
+        }
+    };
+    auto tightestCluster = [&](const std::vector<uint8_t>& bits, const std::vector<float>& field) {
+        int best = -1;
+        for (int i = 0; i < P; ++i) {
+            if (bits[i] && (best < 0 || field[i] > field[best])) {
+                best = i;
+            }
+        }
+        return best;
+    };
+    auto largestVoid = [&](const std::vector<uint8_t>& bits, const std::vector<float>& field) {
+        int best = -1;
+        for (int i = 0; i < P; ++i) {
+            if (!bits[i] && (best < 0 || field[i] < field[best])) {
+                best = i;
+            }
+        }
+        return best;
+    };
+
+    // Initial random pattern, relaxed until stable
+    uint32_t state = Sampler::hash(seed);
+    int      ones  = int(float(P) * INITIAL_DENSITY);
+    for (int count = 0; count < ones;) {
+        state     = Sampler::hash(state);
+        int index = int(state % uint32_t(P));
+        if (!pattern[index]) {
+            toggle(pattern, energy, index);
+            ++count;
+        }
+    }
+
+    for (int iteration = 0; iteration < P; ++iteration) {
+        int cluster = tightestCluster(pattern, energy);
+        toggle(pattern, energy, cluster);
+        int hole = largestVoid(pattern, energy);
+        toggle(pattern, energy, hole);
+        if (hole == cluster) {
+            break;
+        }
+    }
+
+    std::vector<int> rank(P, 0);
+
+    // Ranks below the initial pattern: remove clusters
+    {
+        std::vector<uint8_t> bits  = pattern;
+        std::vector<float>   field = energy;
+        for (int r = ones - 1; r >= 0; --r) {
+            int cluster   = tightestCluster(bits, field);
+            rank[cluster] = r;
+            toggle(bits, field, cluster);
+        }
+    }
+
+    // Ranks above: fill voids. Past half the pixels, the largest void of the
+    // ones is also the tightest cluster of the zeros, the kernel being normalized.
+    for (int r = ones; r < P; ++r) {
+        int hole   = largestVoid(pattern, energy);
+        rank[hole] = r;
+        toggle(pattern, energy, hole);
+    }
+
+    _blueNoise.resize(P);
+    for (int i = 0; i < P; ++i) {
+        _blueNoise[i] = (float(rank[i]) + 0.5f) / float(P);
+    }
+}
+
+uint32_t SamplerTables::sobol(uint32_t index, uint32_t dim) const
+{
+    const uint32_t* columns = &_sobolMatrices[dim * SOBOL_BITS];
+
+    uint32_t result = 0;
+    for (uint32_t bit = 0; index != 0; index >>= 1, ++bit) {
+        if (index & 1u) {
+            result ^= columns[bit];
+        }
+    }
+    return result;
+}
+
+float SamplerTables::blueNoise(uint32_t x, uint32_t y) const
+{
+    return _blueNoise[(y % BLUE_NOISE_SIZE) * BLUE_NOISE_SIZE + (x % BLUE_NOISE_SIZE)];
+}
+
+std::vector<uint32_t> SamplerTables::pack() const
+{
+    std::vector<uint32_t> data(_sobolMatrices);
+    data.reserve(_sobolMatrices.size() + _blueNoise.size());
+    for (float value : _blueNoise) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        data.push_back(bits);
+    }
+    return data;
+}
+
+// -----------------------
+// Sampler
+// -----------------------
+
+Sampler::Sampler(const SamplerTables& tables, SamplerType type, uint32_t x, uint32_t y, uint32_t width,
+                 uint32_t sampleIndex)
+    : _tables(&tables), _type(type), _index(sampleIndex), _x(x), _y(y)
+{
+    uint32_t pixelIndex = y * width + x;
+
+    switch (type) {
+    case SamplerType::Lcg:
+        _seed = tea(pixelIndex, sampleIndex);
+        break;
+    case SamplerType::SobolOwen:
+        _seed = hash(pixelIndex);
+        break;
+    case SamplerType::BlueNoise:
+    default:
+        _seed = BLUE_NOISE_SEED;
+        break;
+    }
+}
+
+float Sampler::next()
+{
+    uint32_t dim = _dimension++;
+
+    if (_type == SamplerType::Lcg) {
+        // Numerical Recipes LCG, as random.glsl
+        _seed = 1664525u * _seed + 1013904223u;
+        return float(_seed & 0x00FFFFFFu) / float(0x01000000);
+    }
+
+    // Dimensions past the tables are padded with independently scrambled
+    // copies; the index is shuffled per group to decorrelate them
+    uint32_t groupSeed = hashCombine(_seed, dim / SamplerTables::SOBOL_DIMENSIONS);
+    uint32_t shuffled  = nestedUniformScramble(_index, groupSeed);
+    uint32_t bits      = _tables->sobol(shuffled, dim % SamplerTables::SOBOL_DIMENSIONS);
+    bits               = nestedUniformScramble(bits, hashCombine(groupSeed, dim + 1));
+
+    float u = toUnitFloat(bits);
+    if (_type == SamplerType::BlueNoise) {
+        // Cranley-Patterson rotation, the texture is shifted for every dimension
+        u += _tables->blueNoise(_x + dim * 41u, _y + dim * 23u);
+        u = std::min(u >= 1.0f ? u - 1.0f : u, ONE_MINUS_EPSILON);
+    }
+    return u;
+}
+
+nvmath::vec2f Sampler::next2D()
+{
+    float x = next();
+    float y = next();
+    return nvmath::vec2f(x, y);
+}
+
+uint32_t Sampler::hash(uint32_t x)
+{
+    // lowbias32, Chris Wellons
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint32_t Sampler::hashCombine(uint32_t seed, uint32_t value)
+{
+    return seed ^ (hash(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// Burley 2020, "Practical Hash-based Owen Scrambling"
+uint32_t Sampler::nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+    x = reverseBits(x);
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return reverseBits(x);
+}
+
+uint32_t Sampler::tea(uint32_t val0, uint32_t val1)
+{
+    uint32_t v0 = val0;
+    uint32_t v1 = val1;
+    uint32_t s0 = 0;
+
+    for (uint32_t n = 0; n < 16; n++) {
+        s0 += 0x9e3779b9u;
+        v0 += ((v1 << 4) + 0xa341316cu) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4u);
+        v1 += ((v0 << 4) + 0xad90777du) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761eu);
+    }
+
+    return v0;
+}
+
+// -----------------------
+// Warps
+// -----------------------
+
+// Duff et al. 2017, "Building an Orthonormal Basis, Revisited"
+static nvmath::vec3f toWorld(const nvmath::vec3f& local, const nvmath::vec3f& n)
+{
+    float sign = std::copysign(1.0f, n.z);
+    float a    = -1.0f / (sign + n.z);
+    float b    = n.x * n.y * a;
+
+    nvmath::vec3f tangent(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    nvmath::vec3f bitangent(b, sign + n.y * n.y * a, -n.y);
+    return tangent * local.x + bitangent * local.y + n * local.z;
+}
+
+nvmath::vec3f sampleUniformSphere(const nvmath::vec2f& u)
+{
+    float z   = 1.0f - 2.0f * u.x;
+    float r   = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    float phi = 2.0f * MATH_PI * u.y;
+    return nvmath::vec3f(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+nvmath::vec3f sampleUniformHemisphere(const nvmath::vec2f& u, const nvmath::vec3f& normal)
+{
+    float z   = u.x;
+    float r   = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    float phi = 2.0f * MATH_PI * u.y;
+    return toWorld(nvmath::vec3f(r * std::cos(phi), r * std::sin(phi), z), normal);
+}
+
+nvmath::vec3f sampleCosineHemisphere(const nvmath::vec2f& u, const nvmath::vec3f& normal)
+{
+    float r   = std::sqrt(u.x);
+    float phi = 2.0f * MATH_PI * u.y;
+    float z   = std::sqrt(std::max(0.0f, 1.0f - u.x));
+    return toWorld(nvmath::vec3f(r * std::cos(phi), r * std::sin(phi), z), normal);
+}
+
+// -----------------------
+// Benchmark
+// -----------------------
+
+std::vector<ConvergencePoint> benchmarkConvergence(const SamplerTables& tables, SamplerType type, uint32_t width,
+                                                   uint32_t height, uint32_t maxSpp)
+{
+    const nvmath::vec3f up(0.0f, 0.0f, 1.0f);
+    const uint32_t      pixels = width * height;
+
+    std::vector<double> sums(pixels, 0.0);
+    std::vector<float>  edges(pixels), caps(pixels);
+    for (uint32_t i = 0; i < pixels; ++i) {
+        edges[i] = toUnitFloat(Sampler::hash(i));
+        caps[i]  = toUnitFloat(Sampler::hash(i ^ 0x5bd1e995u));
+    }
+
+    std::vector<ConvergencePoint> result;
+    for (uint32_t spp = 1; spp <= maxSpp; ++spp) {
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                uint32_t i = y * width + x;
+
+                // One sample per frame, like the accumulation does
+                Sampler       sampler(tables, type, x, y, width, spp - 1);
+                nvmath::vec2f jitter    = sampler.next2D();
+                nvmath::vec3f direction = sampleUniformHemisphere(sampler.next2D(), up);
+
+                bool covered = jitter.x < edges[i];
+                bool visible = direction.z > caps[i];
+                sums[i] += (covered && visible) ? 1.0 : 0.0;
+            }
+        }
+
+        if ((spp & (spp - 1)) != 0) {
+            continue;
+        }
+
+        // Expected value: edge coverage times the solid angle fraction of the cap
+        double squaredError = 0.0;
+        for (uint32_t i = 0; i < pixels; ++i) {
+            double expected = double(edges[i]) * (1.0 - double(caps[i]));
+            double error    = sums[i] / double(spp) - expected;
+            squaredError += error * error;
+        }
+        result.push_back({spp, float(std::sqrt(squaredError / double(pixels)))});
+    }
+
+    return result;
+}
@@ -0,0 +1,93 @@
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include <nvmath/nvmath.h>
+#include <cstdint>
+#include <vector>
+
+// CPU mirror of shaders/sampling.glsl. The tables are generated here and
+// uploaded as is to the storage buffer read by the shaders; the sampling
+// functions must be kept in sync with their GLSL counterparts.
+
+// Must match the SAMPLER_* defines of sampling.glsl
+enum class SamplerType : int {
+    Lcg       = 0,  // tea seeded LCG, the original sampler
+    SobolOwen = 1,  // Sobol sequence, hash-based Owen scrambling per pixel
+    BlueNoise = 2   // Sobol sequence, one global Owen scrambling, blue-noise rotation per pixel
+};
+
+// Precomputed Sobol generator matrices and blue-noise rotation texture
+class SamplerTables {
+public:
+    static constexpr uint32_t SOBOL_DIMENSIONS = 16;
+    static constexpr uint32_t SOBOL_BITS       = 32;
+    static constexpr uint32_t BLUE_NOISE_SIZE  = 64;
+
+    explicit SamplerTables(uint32_t blueNoiseSeed = 1);
+
+    // Sobol point `index` in dimension `dim` (< SOBOL_DIMENSIONS), as 0.32 fixed point
+    uint32_t sobol(uint32_t index, uint32_t dim) const;
+
+    // Blue-noise value in [0, 1) of the toroidally wrapped pixel (x, y)
+    float blueNoise(uint32_t x, uint32_t y) const;
+
+    const std::vector<uint32_t>& getSobolMatrices() const { return _sobolMatrices; }
+    const std::vector<float>&    getBlueNoise() const { return _blueNoise; }
+
+    // Content of the SamplerTables storage buffer: matrices then blue noise
+    std::vector<uint32_t> pack() const;
+
+private:
+    void buildSobolMatrices();
+    void buildBlueNoise(uint32_t seed);
+
+    std::vector<uint32_t> _sobolMatrices;  // SOBOL_BITS columns per dimension
+    std::vector<float>    _blueNoise;      // BLUE_NOISE_SIZE^2, row-major
+};
+
+// Random number stream of one sample of one pixel. Each call to next()
+// consumes one dimension of the sequence.
+class Sampler {
+public:
+    // frame * samplesPerFrame + sample is the index of the sample in the pixel
+    Sampler(const SamplerTables& tables, SamplerType type, uint32_t x, uint32_t y, uint32_t width,
+            uint32_t sampleIndex);
+
+    float         next();
+    nvmath::vec2f next2D();
+
+    uint32_t getDimension() const { return _dimension; }
+
+    static uint32_t hash(uint32_t x);
+    static uint32_t hashCombine(uint32_t seed, uint32_t value);
+    static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed);
+    static uint32_t tea(uint32_t val0, uint32_t val1);
+
+private:
+    const SamplerTables* _tables;
+    SamplerType          _type;
+    uint32_t             _index;
+    uint32_t             _dimension{0};
+    uint32_t             _seed;  // Scrambling seed, or LCG state
+    uint32_t             _x;
+    uint32_t             _y;
+};
+
+// Sample warps, `u` in [0, 1)^2
+nvmath::vec3f sampleUniformSphere(const nvmath::vec2f& u);
+nvmath::vec3f sampleUniformHemisphere(const nvmath::vec2f& u, const nvmath::vec3f& normal);
+nvmath::vec3f sampleCosineHemisphere(const nvmath::vec2f& u, const nvmath::vec3f& normal);
+
+// Convergence of a sampler on a discontinuous 4D integrand with a known
+// integral per pixel (pixel footprint edge x hemisphere visibility cap),
+// similar to what the primary ray and the first bounce do.
+struct ConvergencePoint {
+    uint32_t spp{0};
+    float    rmse{0.0f};
+};
+
+std::vector<ConvergencePoint> benchmarkConvergence(const SamplerTables& tables, SamplerType type, uint32_t width,
+                                                   uint32_t height, uint32_t maxSpp);
+
+
+#endif
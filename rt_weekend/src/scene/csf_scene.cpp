@@ -0,0 +1,218 @@
+#include "csf_scene.hpp"
+#include "../common/parallel_for.hpp"
+#include <fileformats/cadscenefile.h>
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// -----------------------
+// Helpers
+// -----------------------
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Converts one geometry to the packed arrays, `partMaterials` has one entry per part
+static void convertGeometry(
+        const CSFGeometry&      geo,
+        const int*              partMaterials,
+        const CsfGeometryRange& range,
+        VertexObj*              vertices,
+        uint32_t*               indices,
+        int32_t*                matIndices)
+{
+    const float* normals   = CSFGeometry_getNormalChannel(&geo, CSFGEOMETRY_NORMALCHANNEL_NORMAL);
+    const float* texCoords = CSFGeometry_getTexChannel(&geo, CSFGEOMETRY_TEXCHANNEL_GENERIC);
+
+    for (uint32_t v = 0; v < range.nbVertices; v++) {
+        VertexObj& vertex = vertices[v];
+        vertex.pos      = nvmath::vec3f(geo.vertex[3 * v + 0], geo.vertex[3 * v + 1], geo.vertex[3 * v + 2]);
+        vertex.nrm      = normals ? nvmath::vec3f(normals[3 * v + 0], normals[3 * v + 1], normals[3 * v + 2])
+                                  : nvmath::vec3f(0.f);
+        vertex.color    = nvmath::vec3f(1.f);
+        vertex.texCoord = texCoords ? nvmath::vec2f(texCoords[2 * v + 0], texCoords[2 * v + 1]) : nvmath::vec2f(0.f);
+    }
+
+    std::copy(geo.indexSolid, geo.indexSolid + range.nbIndices, indices);
+
+    // Parts are stored one after the other in the index buffer
+    uint32_t triangle = 0;
+    for (int p = 0; p < geo.numParts; p++) {
+        uint32_t nbTriangles = std::min(static_cast<uint32_t>(geo.parts[p].numIndexSolid) / 3,
+                                        range.nbIndices / 3 - triangle);
+        std::fill(matIndices + triangle, matIndices + triangle + nbTriangles, partMaterials[p]);
+        triangle += nbTriangles;
+    }
+
+    if (normals) {
+        return;
+    }
+
+    // No normal channel: area weighted face normals
+    for (uint32_t t = 0; t < range.nbIndices / 3; t++) {
+        VertexObj&    v0 = vertices[indices[3 * t + 0]];
+        VertexObj&    v1 = vertices[indices[3 * t + 1]];
+        VertexObj&    v2 = vertices[indices[3 * t + 2]];
+        nvmath::vec3f n  = nvmath::cross(v1.pos - v0.pos, v2.pos - v0.pos);
+        v0.nrm += n;
+        v1.nrm += n;
+        v2.nrm += n;
+    }
+    for (uint32_t v = 0; v < range.nbVertices; v++) {
+        float length = nvmath::length(vertices[v].nrm);
+        vertices[v].nrm = length > 0.f ? vertices[v].nrm / length : nvmath::vec3f(0.f, 1.f, 0.f);
+    }
+}
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+bool CsfScene::load(const std::string& filename, uint32_t numThreads)
+{
+    clear();
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Secondary arrays (vertices, indices, parts...) stay in the file mapping,
+    // only the primary structs are copied
+    CSFLoaderConfig config{};
+    config.secondariesReadOnly = 1;
+#if CSF_GLTF2_SUPPORT
+    config.gltfFindUniqueGeometries = 1;
+#endif
+    CSFileMemoryPTR mem = CSFileMemory_newCfg(&config);
+    CSFile*         csf = nullptr;
+    if (CSFile_loadExt(&csf, filename.c_str(), mem) != CADSCENEFILE_NOERROR || !csf) {
+        LOGE("Could not load CSF file %s\n", filename.c_str());
+        CSFileMemory_delete(mem);
+        return false;
+    }
+    _stats.loadMs = elapsedMs(start);
+    start = std::chrono::high_resolution_clock::now();
+
+    _materials.resize(std::max(1, csf->numMaterials));
+    for (int m = 0; m < csf->numMaterials; m++) {
+        const float* color = csf->materials[m].color;
+        _materials[m].diffuse  = nvmath::vec3f(color[0], color[1], color[2]);
+        _materials[m].dissolve = color[3];
+    }
+
+    // Materials of a geometry are taken from the first node referencing it
+    std::vector<int> geometryNode(csf->numGeometries, -1);
+    for (int n = 0; n < csf->numNodes; n++) {
+        int geometry = csf->nodes[n].geometryIDX;
+        if (geometry >= 0 && geometryNode[geometry] < 0) {
+            geometryNode[geometry] = n;
+        }
+    }
+
+    // Ranges of the referenced geometries in the packed arrays, wireframe-only
+    // geometries have no triangle to trace and are dropped
+    std::vector<int32_t> geometryRange(csf->numGeometries, -1);
+    std::vector<int>     rangeGeometry;
+    uint64_t nbVertices = 0;
+    uint64_t nbIndices  = 0;
+    for (int g = 0; g < csf->numGeometries; g++) {
+        const CSFGeometry& geo = csf->geometries[g];
+        if (geometryNode[g] < 0 || geo.numIndexSolid < 3 || geo.numVertices == 0) {
+            continue;
+        }
+
+        CsfGeometryRange range;
+        range.firstIndex   = static_cast<uint32_t>(nbIndices);
+        range.nbIndices    = static_cast<uint32_t>(geo.numIndexSolid) / 3 * 3;
+        range.vertexOffset = static_cast<uint32_t>(nbVertices);
+        range.nbVertices   = static_cast<uint32_t>(geo.numVertices);
+        nbIndices += range.nbIndices;
+        nbVertices += range.nbVertices;
+
+        geometryRange[g] = static_cast<int32_t>(_geometries.size());
+        rangeGeometry.push_back(g);
+        _geometries.push_back(range);
+    }
+
+    if (nbIndices > UINT32_MAX || nbVertices > UINT32_MAX) {
+        LOGE("CSF file %s is too large for 32 bits offsets\n", filename.c_str());
+        CSFileMemory_delete(mem);
+        clear();
+        return false;
+    }
+
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _vertices.resize(nbVertices);
+    _indices.resize(nbIndices);
+    _matIndices.resize(nbIndices / 3);
+    parallelFor(static_cast<uint32_t>(_geometries.size()), numThreads, [&](uint32_t r) {
+        const CsfGeometryRange& range = _geometries[r];
+        const CSFGeometry&      geo   = csf->geometries[rangeGeometry[r]];
+        const CSFNode&          node  = csf->nodes[geometryNode[rangeGeometry[r]]];
+
+        std::vector<int> partMaterials(geo.numParts, 0);
+        for (int p = 0; p < std::min(geo.numParts, node.numParts); p++) {
+            partMaterials[p] = std::min(std::max(node.parts[p].materialIDX, 0), static_cast<int>(_materials.size()) - 1);
+        }
+
+        convertGeometry(geo, partMaterials.data(), range, &_vertices[range.vertexOffset],
+                        &_indices[range.firstIndex], &_matIndices[range.firstIndex / 3]);
+    });
+
+    // One instance per node with a geometry, in node order
+    std::vector<int> instanceNode;
+    for (int n = 0; n < csf->numNodes; n++) {
+        int geometry = csf->nodes[n].geometryIDX;
+        if (geometry >= 0 && geometryRange[geometry] >= 0) {
+            instanceNode.push_back(n);
+        }
+    }
+
+    _instances.resize(instanceNode.size());
+    parallelFor(static_cast<uint32_t>(_instances.size()), numThreads, [&](uint32_t i) {
+        const CSFNode& node     = csf->nodes[instanceNode[i]];
+        CsfInstance&   instance = _instances[i];
+        instance.geometry    = static_cast<uint32_t>(geometryRange[node.geometryIDX]);
+        instance.transform   = nvmath::mat4f(node.worldTM);
+        instance.transformIT = nvmath::transpose(nvmath::invert(instance.transform));
+    });
+
+    _stats.convertMs    = elapsedMs(start);
+    _stats.nbNodes      = static_cast<uint32_t>(csf->numNodes);
+    _stats.nbGeometries = static_cast<uint32_t>(_geometries.size());
+    _stats.nbInstances  = static_cast<uint32_t>(_instances.size());
+    _stats.nbMaterials  = static_cast<uint32_t>(csf->numMaterials);
+    _stats.nbTriangles  = nbIndices / 3;
+    for (const auto& instance : _instances) {
+        _stats.nbInstancedTriangles += _geometries[instance.geometry].nbIndices / 3;
+    }
+
+    CSFileMemory_delete(mem);
+    return true;
+}
+
+void CsfScene::clear()
+{
+    _vertices.clear();
+    _indices.clear();
+    _matIndices.clear();
+    _materials.clear();
+    _geometries.clear();
+    _instances.clear();
+    _stats = Stats{};
+}
+
+void CsfScene::printStats() const
+{
+    LOGI("CSF: %u nodes, %u geometries, %u instances, %u materials\n", _stats.nbNodes, _stats.nbGeometries,
+         _stats.nbInstances, _stats.nbMaterials);
+    LOGI("CSF: %llu unique triangles, %llu instanced triangles\n",
+         static_cast<unsigned long long>(_stats.nbTriangles),
+         static_cast<unsigned long long>(_stats.nbInstancedTriangles));
+    LOGI("CSF: load %.1f ms, conversion %.1f ms\n", _stats.loadMs, _stats.convertMs);
+}
@@ -0,0 +1,77 @@
+#ifndef CSF_SCENE_HPP
+#define CSF_SCENE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nvmath/nvmath.h>
+
+#include "../common/obj_loader.h"
+#include "../material/material_obj.hpp"
+
+// Range of the packed vertex and index arrays holding one CSFGeometry. Indices
+// are relative to vertexOffset, so that a range can be built as a BLAS as-is.
+struct CsfGeometryRange {
+    uint32_t firstIndex{0};
+    uint32_t nbIndices{0};
+    uint32_t vertexOffset{0};
+    uint32_t nbVertices{0};
+};
+
+// A node referencing a geometry, i.e. one TLAS instance
+struct CsfInstance {
+    uint32_t      geometry{0};  // Index in getGeometries()
+    nvmath::mat4f transform{1};
+    nvmath::mat4f transformIT{1};
+};
+
+// Loads a cadscenefile (.csf) into flat arrays ready for upload: all the
+// geometries are packed in a single vertex and index array, every node with a
+// geometry becomes an instance of that range. The file is loaded by
+// CSFile_loadExt with secondariesReadOnly: a .csf is memory mapped, only its
+// primary structs are copied and the vertex and index arrays are read from the
+// mapping (.gz and .gltf files are decoded to memory first). The conversion to
+// VertexObj is spread over numThreads (0 = all cores).
+//
+// Per-part node state is reduced to what a shared BLAS can express: parts use
+// the matrix of their node, and the materials of a geometry are the ones of
+// the first node referencing it.
+class CsfScene {
+public:
+    struct Stats {
+        uint32_t nbNodes{0};
+        uint32_t nbGeometries{0};         // Unique geometries with triangles
+        uint32_t nbInstances{0};
+        uint32_t nbMaterials{0};
+        uint64_t nbTriangles{0};          // Unique triangles
+        uint64_t nbInstancedTriangles{0};
+        double   loadMs{0.0};             // Mapping and pointer fixups
+        double   convertMs{0.0};          // Conversion to the flat arrays
+    };
+
+    bool load(const std::string& filename, uint32_t numThreads = 0);
+    void clear();
+
+    void        printStats() const;
+    const Stats& getStats() const { return _stats; }
+
+    const std::vector<VertexObj>&        getVertices() const { return _vertices; }
+    const std::vector<uint32_t>&         getIndices() const { return _indices; }
+    const std::vector<int32_t>&          getMatIndices() const { return _matIndices; }  // One per triangle
+    const std::vector<MaterialObj>&      getMaterials() const { return _materials; }
+    const std::vector<CsfGeometryRange>& getGeometries() const { return _geometries; }
+    const std::vector<CsfInstance>&      getInstances() const { return _instances; }
+
+private:
+    std::vector<VertexObj>        _vertices;
+    std::vector<uint32_t>         _indices;
+    std::vector<int32_t>          _matIndices;
+    std::vector<MaterialObj>      _materials;
+    std::vector<CsfGeometryRange> _geometries;
+    std::vector<CsfInstance>      _instances;
+    Stats                         _stats;
+};
+
+
+#endif
@@ -0,0 +1,620 @@
+#include "texture_processor.hpp"
+#include "../common/parallel_for.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// -----------------------
+// Helpers
+// -----------------------
+
+static constexpr uint32_t ROWS_PER_JOB = 16;
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static float srgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+// Linear value of each 8 bits sRGB value
+static const std::array<float, 256>& getDecodeTable()
+{
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> t{};
+        for (int i = 0; i < 256; i++) {
+            t[i] = srgbToLinear(i / 255.f);
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Linear value halfway between consecutive 8 bits sRGB values: the encoding
+// of x is the number of thresholds below it, exact without any pow()
+static const std::array<float, 255>& getEncodeThresholds()
+{
+    static const std::array<float, 255> table = []() {
+        std::array<float, 255> t{};
+        for (int i = 0; i < 255; i++) {
+            t[i] = srgbToLinear((i + 0.5f) / 255.f);
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Encoding of the bottom of each of ENCODE_STEPS linear intervals, the exact
+// value is then at most a few thresholds further
+static constexpr int ENCODE_STEPS = 4096;
+
+static const std::array<uint8_t, ENCODE_STEPS + 1>& getEncodeTable()
+{
+    static const std::array<uint8_t, ENCODE_STEPS + 1> table = []() {
+        const auto&                           thresholds = getEncodeThresholds();
+        std::array<uint8_t, ENCODE_STEPS + 1> t{};
+        for (int i = 0; i <= ENCODE_STEPS; i++) {
+            float x = float(i) / ENCODE_STEPS;
+            t[i]    = static_cast<uint8_t>(std::upper_bound(thresholds.begin(), thresholds.end(), x) - thresholds.begin());
+        }
+        return t;
+    }();
+    return table;
+}
+
+// x in [0, 1]
+static uint8_t encodeLinear(float x, bool srgb)
+{
+    if (!srgb) {
+        return static_cast<uint8_t>(x * 255.f + 0.5f);
+    }
+    const auto& thresholds = getEncodeThresholds();
+    uint32_t    value      = getEncodeTable()[static_cast<int>(x * ENCODE_STEPS)];
+    while (value < 255 && x >= thresholds[value]) {
+        value++;
+    }
+    return static_cast<uint8_t>(value);
+}
+
+// Zeroth order modified Bessel function of the first kind
+static float besselI0(float x)
+{
+    float sum  = 1.f;
+    float term = 1.f;
+    for (int k = 1; k < 20; k++) {
+        term *= (x * 0.5f / k) * (x * 0.5f / k);
+        sum += term;
+    }
+    return sum;
+}
+
+static float sinc(float x)
+{
+    if (std::abs(x) < 1e-4f) {
+        return 1.f;
+    }
+    float px = 3.14159265f * x;
+    return std::sin(px) / px;
+}
+
+// Source taps of each destination pixel along one axis, weights sum to one
+struct AxisTaps {
+    std::vector<uint32_t> count;  // Per destination pixel
+    std::vector<uint32_t> index;  // Flattened source indices, clamped to the edge
+    std::vector<float>    weight;
+    std::vector<uint32_t> start;  // Offset in index/weight of each destination pixel
+};
+
+static AxisTaps computeTaps(uint32_t srcSize, uint32_t dstSize, MipFilter filter)
+{
+    const float kaiserWidth = 2.f;  // In destination pixels
+    const float kaiserAlpha = 4.f;
+    const float scale       = float(srcSize) / float(dstSize);
+
+    AxisTaps taps;
+    taps.start.resize(dstSize);
+    taps.count.resize(dstSize);
+    for (uint32_t i = 0; i < dstSize; i++) {
+        std::vector<std::pair<int, float>> weights;
+        if (filter == MipFilter::Box) {
+            float begin = i * scale;
+            float end   = (i + 1) * scale;
+            for (int j = int(std::floor(begin)); j < int(std::ceil(end)); j++) {
+                float overlap = std::min(float(j + 1), end) - std::max(float(j), begin);
+                if (overlap > 0.f) {
+                    weights.emplace_back(j, overlap);
+                }
+            }
+        } else {
+            float center = (i + 0.5f) * scale;
+            float radius = kaiserWidth * scale;
+            for (int j = int(std::floor(center - radius)); j <= int(std::ceil(center + radius)); j++) {
+                float t = ((j + 0.5f) - center) / scale;
+                if (std::abs(t) >= kaiserWidth) {
+                    continue;
+                }
+                float r      = t / kaiserWidth;
+                float window = besselI0(kaiserAlpha * std::sqrt(1.f - r * r)) / besselI0(kaiserAlpha);
+                weights.emplace_back(j, sinc(t) * window);
+            }
+        }
+
+        float sum = 0.f;
+        for (const auto& w : weights) {
+            sum += w.second;
+        }
+        taps.start[i] = static_cast<uint32_t>(taps.index.size());
+        taps.count[i] = static_cast<uint32_t>(weights.size());
+        for (const auto& w : weights) {
+            taps.index.push_back(static_cast<uint32_t>(std::min(std::max(w.first, 0), int(srcSize) - 1)));
+            taps.weight.push_back(w.second / sum);
+        }
+    }
+    return taps;
+}
+
+// Horizontal pass over one row of RGBA float pixels. The four channels of a pixel are
+// processed together in the inner loops, which the compiler vectorizes.
+static void filterRow(const float* src, const AxisTaps& taps, uint32_t dstCount, float* dst)
+{
+    for (uint32_t i = 0; i < dstCount; i++) {
+        float acc[4] = {0.f, 0.f, 0.f, 0.f};
+        for (uint32_t t = 0; t < taps.count[i]; t++) {
+            const float* s = src + size_t(taps.index[taps.start[i] + t]) * 4;
+            float        w = taps.weight[taps.start[i] + t];
+            for (int c = 0; c < 4; c++) {
+                acc[c] += w * s[c];
+            }
+        }
+        float* d = dst + size_t(i) * 4;
+        for (int c = 0; c < 4; c++) {
+            d[c] = acc[c];
+        }
+    }
+}
+
+// Copies the 4x4 block at (bx, by), the pixels outside are clamped to the edge
+static void fetchBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t* block)
+{
+    for (uint32_t y = 0; y < 4; y++) {
+        uint32_t sy = std::min(by * 4 + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t sx = std::min(bx * 4 + x, width - 1);
+            std::memcpy(block + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+        }
+    }
+}
+
+// Principal axis of the block colors, `dims` channels, from the mean
+static void principalAxis(const float (*pixels)[4], int dims, float* mean, float* axis)
+{
+    for (int c = 0; c < dims; c++) {
+        mean[c] = 0.f;
+        for (int p = 0; p < 16; p++) {
+            mean[c] += pixels[p][c];
+        }
+        mean[c] /= 16.f;
+    }
+
+    float cov[4][4] = {};
+    for (int p = 0; p < 16; p++) {
+        for (int a = 0; a < dims; a++) {
+            for (int b = 0; b < dims; b++) {
+                cov[a][b] += (pixels[p][a] - mean[a]) * (pixels[p][b] - mean[b]);
+            }
+        }
+    }
+
+    // Power iteration
+    for (int c = 0; c < dims; c++) {
+        axis[c] = 1.f;
+    }
+    for (int it = 0; it < 8; it++) {
+        float next[4] = {};
+        float norm    = 0.f;
+        for (int a = 0; a < dims; a++) {
+            for (int b = 0; b < dims; b++) {
+                next[a] += cov[a][b] * axis[b];
+            }
+            norm += next[a] * next[a];
+        }
+        if (norm < 1e-12f) {
+            break;
+        }
+        norm = 1.f / std::sqrt(norm);
+        for (int c = 0; c < dims; c++) {
+            axis[c] = next[c] * norm;
+        }
+    }
+}
+
+// Endpoints at the extreme projections of the pixels on the principal axis
+static void fitEndpoints(const float (*pixels)[4], int dims, float* e0, float* e1)
+{
+    float mean[4];
+    float axis[4];
+    principalAxis(pixels, dims, mean, axis);
+
+    float minT = 0.f;
+    float maxT = 0.f;
+    for (int p = 0; p < 16; p++) {
+        float t = 0.f;
+        for (int c = 0; c < dims; c++) {
+            t += (pixels[p][c] - mean[c]) * axis[c];
+        }
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    for (int c = 0; c < dims; c++) {
+        e0[c] = std::min(std::max(mean[c] + axis[c] * minT, 0.f), 255.f);
+        e1[c] = std::min(std::max(mean[c] + axis[c] * maxT, 0.f), 255.f);
+    }
+}
+
+// Index of the nearest palette entry of each pixel
+static void selectIndices(const float (*pixels)[4], int dims, const float (*palette)[4], int nbEntries, uint8_t* indices)
+{
+    for (int p = 0; p < 16; p++) {
+        float best = 1e30f;
+        for (int e = 0; e < nbEntries; e++) {
+            float err = 0.f;
+            for (int c = 0; c < dims; c++) {
+                float d = pixels[p][c] - palette[e][c];
+                err += d * d;
+            }
+            if (err < best) {
+                best       = err;
+                indices[p] = static_cast<uint8_t>(e);
+            }
+        }
+    }
+}
+
+// LSB first, as BC7 is specified
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* block) : _block(block) { std::memset(block, 0, 16); }
+
+    void write(uint32_t value, uint32_t nbBits)
+    {
+        for (uint32_t b = 0; b < nbBits; b++, _pos++) {
+            _block[_pos / 8] |= static_cast<uint8_t>(((value >> b) & 1) << (_pos % 8));
+        }
+    }
+
+private:
+    uint8_t* _block;
+    uint32_t _pos{0};
+};
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+ProcessedTexture TextureProcessor::process(const std::vector<const uint8_t*>& layers,
+                                           uint32_t                           width,
+                                           uint32_t                           height,
+                                           uint32_t                           channels)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const uint32_t nbLayers   = static_cast<uint32_t>(layers.size());
+    const uint32_t nbLevels   = _settings.mipmaps ? getMipCount(width, height) : 1;
+    const uint32_t blockBytes = getBlockBytes(_settings.compression);
+    const auto&    decode     = getDecodeTable();
+
+    ProcessedTexture result;
+    result.compression = _settings.compression;
+    result.nbLayers    = nbLayers;
+
+    size_t totalSize = 0;
+    for (uint32_t l = 0; l < nbLevels; l++) {
+        ProcessedTexture::Level level;
+        level.width     = std::max(1u, width >> l);
+        level.height    = std::max(1u, height >> l);
+        level.offset    = totalSize;
+        level.layerSize = blockBytes ? size_t((level.width + 3) / 4) * ((level.height + 3) / 4) * blockBytes
+                                     : size_t(level.width) * level.height * 4;
+        totalSize += level.layerSize * nbLayers;
+        result.levels.push_back(level);
+    }
+    result.data.resize(totalSize);
+
+    // RGBA8 of the current level of each layer, and its linear float version
+    // from which the next level is filtered
+    std::vector<std::vector<uint8_t>> rgba(nbLayers);
+    std::vector<std::vector<float>>   linear(nbLayers);
+    parallelFor(nbLayers, _settings.numThreads, [&](uint32_t layer) {
+        rgba[layer] = expandToRgba(layers[layer], size_t(width) * height, channels);
+        linear[layer].resize(size_t(width) * height * 4);
+        for (size_t p = 0; p < size_t(width) * height; p++) {
+            for (int c = 0; c < 4; c++) {
+                uint8_t v = rgba[layer][p * 4 + c];
+                linear[layer][p * 4 + c] = (_settings.srgb && c < 3) ? decode[v] : v / 255.f;
+            }
+        }
+    });
+
+    double encodeMs = 0.0;
+    for (uint32_t l = 0; l < nbLevels; l++) {
+        const ProcessedTexture::Level& level = result.levels[l];
+
+        if (l > 0) {
+            const ProcessedTexture::Level& prev = result.levels[l - 1];
+            AxisTaps tapsX = computeTaps(prev.width, level.width, _settings.filter);
+            AxisTaps tapsY = computeTaps(prev.height, level.height, _settings.filter);
+
+            // Horizontal then vertical pass, jobs of a few rows of one layer
+            std::vector<std::vector<float>> horizontal(nbLayers);
+            std::vector<std::vector<float>> next(nbLayers);
+            for (uint32_t layer = 0; layer < nbLayers; layer++) {
+                horizontal[layer].resize(size_t(level.width) * prev.height * 4);
+                next[layer].resize(size_t(level.width) * level.height * 4);
+            }
+
+            uint32_t jobsX = (prev.height + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+            parallelFor(jobsX * nbLayers, _settings.numThreads, [&](uint32_t job) {
+                uint32_t layer = job / jobsX;
+                uint32_t row0  = (job % jobsX) * ROWS_PER_JOB;
+                for (uint32_t y = row0; y < std::min(row0 + ROWS_PER_JOB, prev.height); y++) {
+                    filterRow(&linear[layer][size_t(y) * prev.width * 4], tapsX, level.width,
+                          &horizontal[layer][size_t(y) * level.width * 4]);
+                }
+            });
+
+            uint32_t jobsY = (level.height + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+            parallelFor(jobsY * nbLayers, _settings.numThreads, [&](uint32_t job) {
+                uint32_t layer = job / jobsY;
+                uint32_t row0  = (job % jobsY) * ROWS_PER_JOB;
+                size_t   rowSize = size_t(level.width) * 4;
+                for (uint32_t y = row0; y < std::min(row0 + ROWS_PER_JOB, level.height); y++) {
+                    // Whole source rows are accumulated to stay cache friendly
+                    float* dst = &next[layer][y * rowSize];
+                    for (uint32_t t = 0; t < tapsY.count[y]; t++) {
+                        const float* src = &horizontal[layer][tapsY.index[tapsY.start[y] + t] * rowSize];
+                        float        w   = tapsY.weight[tapsY.start[y] + t];
+                        for (size_t i = 0; i < rowSize; i++) {
+                            dst[i] += w * src[i];
+                        }
+                    }
+                    for (size_t i = 0; i < rowSize; i++) {
+                        dst[i] = std::min(std::max(dst[i], 0.f), 1.f);
+                    }
+                }
+            });
+
+            linear.swap(next);
+
+            uint32_t jobsQ = (level.height + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+            parallelFor(jobsQ * nbLayers, _settings.numThreads, [&](uint32_t job) {
+                uint32_t layer = job / jobsQ;
+                uint32_t row0  = (job % jobsQ) * ROWS_PER_JOB;
+                rgba[layer].resize(size_t(level.width) * level.height * 4);
+                for (uint32_t y = row0; y < std::min(row0 + ROWS_PER_JOB, level.height); y++) {
+                    for (size_t i = size_t(y) * level.width * 4; i < size_t(y + 1) * level.width * 4; i++) {
+                        rgba[layer][i] = encodeLinear(linear[layer][i], _settings.srgb && (i % 4) < 3);
+                    }
+                }
+            });
+        }
+
+        if (!blockBytes) {
+            for (uint32_t layer = 0; layer < nbLayers; layer++) {
+                std::memcpy(result.data.data() + level.offset + level.layerSize * layer, rgba[layer].data(),
+                            level.layerSize);
+            }
+            continue;
+        }
+
+        auto     encodeStart = std::chrono::high_resolution_clock::now();
+        uint32_t blocksX     = (level.width + 3) / 4;
+        uint32_t blocksY     = (level.height + 3) / 4;
+        parallelFor(blocksY * nbLayers, _settings.numThreads, [&](uint32_t job) {
+            uint32_t layer = job / blocksY;
+            uint32_t by    = job % blocksY;
+            uint8_t* out   = result.data.data() + level.offset + level.layerSize * layer + size_t(by) * blocksX * blockBytes;
+            uint8_t  pixels[64];
+            for (uint32_t bx = 0; bx < blocksX; bx++) {
+                fetchBlock(rgba[layer].data(), level.width, level.height, bx, by, pixels);
+                if (_settings.compression == TextureCompression::Bc1) {
+                    encodeBc1Block(pixels, out + size_t(bx) * blockBytes);
+                } else {
+                    encodeBc7Block(pixels, out + size_t(bx) * blockBytes);
+                }
+            }
+        });
+        encodeMs += elapsedMs(encodeStart);
+        _stats.nbEncodedPixels += uint64_t(level.width) * level.height * nbLayers;
+    }
+
+    _stats.nbTextures++;
+    _stats.nbPixels += uint64_t(width) * height * nbLayers;
+    _stats.mipMs += elapsedMs(start) - encodeMs;
+    _stats.encodeMs += encodeMs;
+    return result;
+}
+
+std::vector<uint8_t> TextureProcessor::expandToRgba(const uint8_t* pixels, size_t nbPixels, uint32_t channels)
+{
+    std::vector<uint8_t> rgba(nbPixels * 4);
+    if (channels == 4) {
+        std::memcpy(rgba.data(), pixels, rgba.size());
+        return rgba;
+    }
+
+    for (size_t p = 0; p < nbPixels; p++) {
+        const uint8_t* src = pixels + p * channels;
+        uint8_t*       dst = rgba.data() + p * 4;
+        switch (channels) {
+            case 1: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = 255; break;
+            case 2: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = src[1]; break;
+            default: dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 255; break;
+        }
+    }
+    return rgba;
+}
+
+uint32_t TextureProcessor::getMipCount(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+        count++;
+    }
+    return count;
+}
+
+uint32_t TextureProcessor::getBlockBytes(TextureCompression compression)
+{
+    switch (compression) {
+        case TextureCompression::Bc1: return 8;
+        case TextureCompression::Bc7: return 16;
+        default: return 0;
+    }
+}
+
+// Endpoints on the principal axis, four color mode only
+void TextureProcessor::encodeBc1Block(const uint8_t* rgba, uint8_t* block)
+{
+    float pixels[16][4];
+    for (int p = 0; p < 16; p++) {
+        for (int c = 0; c < 4; c++) {
+            pixels[p][c] = rgba[p * 4 + c];
+        }
+    }
+
+    float e0[4];
+    float e1[4];
+    fitEndpoints(pixels, 3, e0, e1);
+
+    auto pack565 = [](const float* e) {
+        uint32_t r = static_cast<uint32_t>(e[0] * 31.f / 255.f + 0.5f);
+        uint32_t g = static_cast<uint32_t>(e[1] * 63.f / 255.f + 0.5f);
+        uint32_t b = static_cast<uint32_t>(e[2] * 31.f / 255.f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    };
+    auto unpack565 = [](uint16_t c, float* e) {
+        uint32_t r = (c >> 11) & 31;
+        uint32_t g = (c >> 5) & 63;
+        uint32_t b = c & 31;
+        e[0]       = float((r << 3) | (r >> 2));
+        e[1]       = float((g << 2) | (g >> 4));
+        e[2]       = float((b << 3) | (b >> 2));
+        e[3]       = 255.f;
+    };
+
+    // color0 > color1 selects the four color mode
+    uint16_t c0 = pack565(e1);
+    uint16_t c1 = pack565(e0);
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+
+    uint8_t indices[16] = {};
+    if (c0 != c1) {
+        float palette[4][4];
+        unpack565(c0, palette[0]);
+        unpack565(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+            palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+        }
+        selectIndices(pixels, 3, palette, 4, indices);
+    }
+
+    uint32_t bits = 0;
+    for (int p = 0; p < 16; p++) {
+        bits |= uint32_t(indices[p]) << (2 * p);
+    }
+    block[0] = static_cast<uint8_t>(c0 & 0xff);
+    block[1] = static_cast<uint8_t>(c0 >> 8);
+    block[2] = static_cast<uint8_t>(c1 & 0xff);
+    block[3] = static_cast<uint8_t>(c1 >> 8);
+    for (int i = 0; i < 4; i++) {
+        block[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+// Mode 6: one subset, RGBA endpoints of 7 bits plus one p-bit each, 4 bits indices
+void TextureProcessor::encodeBc7Block(const uint8_t* rgba, uint8_t* block)
+{
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float pixels[16][4];
+    for (int p = 0; p < 16; p++) {
+        for (int c = 0; c < 4; c++) {
+            pixels[p][c] = rgba[p * 4 + c];
+        }
+    }
+
+    float e[2][4];
+    fitEndpoints(pixels, 4, e[0], e[1]);
+
+    // 7 bits per channel and the p-bit giving the closest 8 bits endpoint
+    uint32_t q[2][4];
+    uint32_t pbit[2];
+    for (int i = 0; i < 2; i++) {
+        float bestErr = 1e30f;
+        for (uint32_t pb = 0; pb < 2; pb++) {
+            uint32_t qc[4];
+            float    err = 0.f;
+            for (int c = 0; c < 4; c++) {
+                float v = std::round((e[i][c] - pb) / 2.f);
+                qc[c]   = static_cast<uint32_t>(std::min(std::max(v, 0.f), 127.f));
+                float d = float((qc[c] << 1) | pb) - e[i][c];
+                err += d * d;
+            }
+            if (err < bestErr) {
+                bestErr = err;
+                pbit[i] = pb;
+                std::copy(qc, qc + 4, q[i]);
+            }
+        }
+    }
+
+    float palette[16][4];
+    for (int w = 0; w < 16; w++) {
+        for (int c = 0; c < 4; c++) {
+            int a         = int((q[0][c] << 1) | pbit[0]);
+            int b         = int((q[1][c] << 1) | pbit[1]);
+            palette[w][c] = float(((64 - weights[w]) * a + weights[w] * b + 32) >> 6);
+        }
+    }
+    uint8_t indices[16];
+    selectIndices(pixels, 4, palette, 16, indices);
+
+    // The MSB of the first index is implicit: swap the endpoints when it is set
+    if (indices[0] & 8) {
+        std::swap(q[0], q[1]);
+        std::swap(pbit[0], pbit[1]);
+        for (auto& index : indices) {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    BitWriter writer(block);
+    writer.write(1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.write(q[0][c], 7);
+        writer.write(q[1][c], 7);
+    }
+    writer.write(pbit[0], 1);
+    writer.write(pbit[1], 1);
+    writer.write(indices[0], 3);
+    for (int p = 1; p < 16; p++) {
+        writer.write(indices[p], 4);
+    }
+}
+
+void TextureProcessor::printStats() const
+{
+    LOGI("Textures: %llu processed, %.1f MPix, mips %.1f ms (%.1f MPix/s), encoding %.1f ms (%.1f MPix/s)\n",
+         static_cast<unsigned long long>(_stats.nbTextures), _stats.nbPixels * 1e-6, _stats.mipMs,
+         _stats.getMipThroughput(), _stats.encodeMs, _stats.getEncodeThroughput());
+}
@@ -0,0 +1,95 @@
+#ifndef TEXTURE_PROCESSOR_HPP
+#define TEXTURE_PROCESSOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU preparation of textures before upload: expansion to RGBA8, mip chain
+// generation and optional block compression. Nothing here depends on Vulkan,
+// so that the same code can run headless, e.g. to fill an offline cache.
+//
+// Mips are filtered in linear space from the previous level kept as floats,
+// color channels are decoded from and encoded back to sRGB when `srgb` is set,
+// alpha is always linear. Layers (cubemap faces) and rows of each pass are
+// spread over numThreads (0 = all cores).
+
+enum class MipFilter {
+    Box,    // Area weighted average of the source footprint
+    Kaiser  // Windowed sinc, sharper, slight ringing is clamped
+};
+
+enum class TextureCompression {
+    None,  // RGBA8
+    Bc1,   // 4 bpp, opaque
+    Bc7    // 8 bpp, mode 6 only
+};
+
+struct TextureSettings {
+    MipFilter          filter{MipFilter::Kaiser};
+    TextureCompression compression{TextureCompression::None};
+    bool               srgb{true};
+    bool               mipmaps{true};
+    uint32_t           numThreads{0};
+};
+
+// All the levels of all the layers, level after level, in the layout
+// expected by the copies to the image
+struct ProcessedTexture {
+    struct Level {
+        uint32_t width{0};
+        uint32_t height{0};
+        size_t   offset{0};     // Of layer 0 in `data`
+        size_t   layerSize{0};  // Bytes of one layer, the layers are contiguous
+    };
+
+    TextureCompression   compression{TextureCompression::None};
+    uint32_t             nbLayers{1};
+    std::vector<Level>   levels;
+    std::vector<uint8_t> data;
+
+    const uint8_t* getData(uint32_t level, uint32_t layer) const
+    {
+        return data.data() + levels[level].offset + levels[level].layerSize * layer;
+    }
+};
+
+class TextureProcessor {
+public:
+    struct Stats {
+        uint64_t nbTextures{0};
+        uint64_t nbPixels{0};         // Of the base levels
+        uint64_t nbEncodedPixels{0};  // Of all the compressed levels
+        double   mipMs{0.0};
+        double   encodeMs{0.0};
+
+        double getMipThroughput() const { return mipMs > 0.0 ? nbPixels / (mipMs * 1e3) : 0.0; }  // MPix/s
+        double getEncodeThroughput() const { return encodeMs > 0.0 ? nbEncodedPixels / (encodeMs * 1e3) : 0.0; }
+    };
+
+    explicit TextureProcessor(const TextureSettings& settings = TextureSettings()) : _settings(settings) {}
+
+    // `layers` point to width * height pixels of `channels` (1 to 4) bytes each
+    ProcessedTexture process(const std::vector<const uint8_t*>& layers, uint32_t width, uint32_t height, uint32_t channels);
+
+    // Grey is replicated, missing alpha is opaque
+    static std::vector<uint8_t> expandToRgba(const uint8_t* pixels, size_t nbPixels, uint32_t channels);
+
+    static uint32_t getMipCount(uint32_t width, uint32_t height);
+    static uint32_t getBlockBytes(TextureCompression compression);  // 0 when not compressed
+
+    // 4x4 RGBA8 pixels, row-major
+    static void encodeBc1Block(const uint8_t* rgba, uint8_t* block);
+    static void encodeBc7Block(const uint8_t* rgba, uint8_t* block);
+
+    const TextureSettings& getSettings() const { return _settings; }
+    const Stats&           getStats() const { return _stats; }
+    void                   printStats() const;
+
+private:
+    TextureSettings _settings;
+    Stats           _stats;
+};
+
+
+#endif
@@ -0,0 +1,189 @@
+#include "tile_cache.hpp"
+#include "virtual_texture.hpp"
+#include <algorithm>
+#include <cstring>
+
+// -----------------------
+// Cache Format
+// -----------------------
+
+static constexpr uint32_t CACHE_MAGIC   = 0x31435456;  // "VTC1"
+static constexpr uint32_t CACHE_VERSION = 1;
+
+static constexpr uint32_t PAGE_SIZE   = ResidencyManager::PAGE_SIZE;
+static constexpr uint32_t PAGE_BORDER = ResidencyManager::PAGE_BORDER;
+static constexpr uint32_t PAGE_STRIDE = PAGE_SIZE + 2 * PAGE_BORDER;  // Texels per side, border included
+
+// Magic, version, width, height, virtual levels, page size, border, tail levels
+static constexpr uint64_t HEADER_SIZE = 8 * sizeof(uint32_t);
+
+template <typename T>
+static void writeValue(std::ofstream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& in, T& value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+static ResidencyManager::TextureInfo makeInfo(uint32_t width, uint32_t height)
+{
+    ResidencyManager::TextureInfo info;
+    info.width    = width;
+    info.height   = height;
+    info.nbLevels = ResidencyManager::getLevelCount(width, height);
+    return info;
+}
+
+// -----------------------
+// Public Methods
+// -----------------------
+
+size_t TileCache::getPageBytes()
+{
+    return size_t(PAGE_STRIDE) * PAGE_STRIDE * 4;
+}
+
+bool TileCache::build(const std::string& filename, const ProcessedTexture& texture)
+{
+    if (texture.compression != TextureCompression::None || texture.levels.empty()) {
+        return false;
+    }
+
+    auto info = makeInfo(texture.levels[0].width, texture.levels[0].height);
+    if (info.nbLevels == 0 || info.nbLevels > ResidencyManager::MAX_LEVELS || texture.levels.size() <= info.nbLevels) {
+        return false;
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+
+    writeValue(out, CACHE_MAGIC);
+    writeValue(out, CACHE_VERSION);
+    writeValue(out, info.width);
+    writeValue(out, info.height);
+    writeValue(out, info.nbLevels);
+    writeValue(out, PAGE_SIZE);
+    writeValue(out, PAGE_BORDER);
+    writeValue(out, static_cast<uint32_t>(texture.levels.size()) - info.nbLevels);
+
+    // Pages row by row, the texels outside the level are clamped to its edge
+    std::vector<uint8_t> page(getPageBytes());
+    for (uint32_t level = 0; level < info.nbLevels; level++) {
+        const auto&    source = texture.levels[level];
+        const uint8_t* texels = texture.getData(level, 0);
+
+        for (uint32_t py = 0; py < ResidencyManager::getPageCountY(info, level); py++) {
+            for (uint32_t px = 0; px < ResidencyManager::getPageCountX(info, level); px++) {
+                for (uint32_t ty = 0; ty < PAGE_STRIDE; ty++) {
+                    int sy = std::min(std::max(int(py * PAGE_SIZE + ty) - int(PAGE_BORDER), 0), int(source.height) - 1);
+                    for (uint32_t tx = 0; tx < PAGE_STRIDE; tx++) {
+                        int sx = std::min(std::max(int(px * PAGE_SIZE + tx) - int(PAGE_BORDER), 0), int(source.width) - 1);
+                        std::memcpy(&page[(size_t(ty) * PAGE_STRIDE + tx) * 4], texels + (size_t(sy) * source.width + sx) * 4, 4);
+                    }
+                }
+                out.write(reinterpret_cast<const char*>(page.data()), page.size());
+            }
+        }
+    }
+
+    const auto& firstTail = texture.levels[info.nbLevels];
+    out.write(reinterpret_cast<const char*>(texture.data.data() + firstTail.offset), texture.data.size() - firstTail.offset);
+
+    return static_cast<bool>(out);
+}
+
+bool TileCache::open(const std::string& filename)
+{
+    close();
+    _file.open(filename, std::ios::binary);
+    if (!_file) {
+        return false;
+    }
+
+    uint32_t magic, version, pageSize, border, tailLevels;
+    if (!readValue(_file, magic) || magic != CACHE_MAGIC || !readValue(_file, version) || version != CACHE_VERSION
+        || !readValue(_file, _width) || !readValue(_file, _height) || !readValue(_file, _nbLevels)
+        || !readValue(_file, pageSize) || !readValue(_file, border) || !readValue(_file, tailLevels)) {
+        close();
+        return false;
+    }
+
+    // Written with other page settings, or not matching its own size
+    auto info = makeInfo(_width, _height);
+    if (pageSize != PAGE_SIZE || border != PAGE_BORDER || info.nbLevels != _nbLevels || _nbLevels == 0
+        || tailLevels != TextureProcessor::getMipCount(_width, _height) - _nbLevels) {
+        close();
+        return false;
+    }
+
+    uint64_t offset = HEADER_SIZE;
+    for (uint32_t level = 0; level < _nbLevels; level++) {
+        _levelOffsets.push_back(offset);
+        offset += uint64_t(ResidencyManager::getPageCountX(info, level)) * ResidencyManager::getPageCountY(info, level)
+                  * getPageBytes();
+    }
+    _tailOffset = offset;
+
+    size_t tailSize = 0;
+    for (uint32_t level = _nbLevels; level < _nbLevels + tailLevels; level++) {
+        ProcessedTexture::Level tailLevel;
+        tailLevel.width     = std::max(1U, _width >> level);
+        tailLevel.height    = std::max(1U, _height >> level);
+        tailLevel.offset    = tailSize;
+        tailLevel.layerSize = size_t(tailLevel.width) * tailLevel.height * 4;
+        tailSize += tailLevel.layerSize;
+        _tail.levels.push_back(tailLevel);
+    }
+    return true;
+}
+
+void TileCache::close()
+{
+    if (_file.is_open()) {
+        _file.close();
+    }
+    _file.clear();
+    _width = _height = _nbLevels = 0;
+    _levelOffsets.clear();
+    _tail = ProcessedTexture();
+}
+
+ProcessedTexture TileCache::readTail()
+{
+    ProcessedTexture tail = _tail;
+    const auto&      last = tail.levels.back();
+    tail.data.resize(last.offset + last.layerSize);
+
+    _file.seekg(static_cast<std::streamoff>(_tailOffset));
+    _file.read(reinterpret_cast<char*>(tail.data.data()), tail.data.size());
+    if (!_file) {
+        _file.clear();
+        return ProcessedTexture();
+    }
+    return tail;
+}
+
+bool TileCache::readPage(uint32_t level, uint32_t x, uint32_t y, uint8_t* page)
+{
+    auto info = makeInfo(_width, _height);
+    if (level >= _nbLevels || x >= ResidencyManager::getPageCountX(info, level)
+        || y >= ResidencyManager::getPageCountY(info, level)) {
+        return false;
+    }
+
+    uint64_t index = uint64_t(y) * ResidencyManager::getPageCountX(info, level) + x;
+    _file.seekg(static_cast<std::streamoff>(_levelOffsets[level] + index * getPageBytes()));
+    _file.read(reinterpret_cast<char*>(page), getPageBytes());
+    if (!_file) {
+        _file.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef TILE_CACHE_HPP
+#define TILE_CACHE_HPP
+
+#include "texture_processor.hpp"
+#include <fstream>
+#include <string>
+#include <vector>
+
+// On-disk cache of a virtual texture: the pages of its virtual levels, each
+// with the border of ResidencyManager::PAGE_BORDER texels clamped at the
+// texture edges, then its tail levels. Pages are RGBA8 and read one at a
+// time at a computed offset, so only the requested ones are ever loaded.
+class TileCache {
+public:
+    // Bytes of one page, border included
+    static size_t getPageBytes();
+
+    // `texture` holds all the levels of one RGBA8 layer, as generated by
+    // TextureProcessor without compression
+    static bool build(const std::string& filename, const ProcessedTexture& texture);
+
+    bool open(const std::string& filename);
+    void close();
+
+    uint32_t getWidth() const { return _width; }
+    uint32_t getHeight() const { return _height; }
+    uint32_t getLevelCount() const { return _nbLevels; }
+
+    // Levels after the virtual ones, fully resident
+    ProcessedTexture readTail();
+    bool             readPage(uint32_t level, uint32_t x, uint32_t y, uint8_t* page);
+
+private:
+    std::ifstream         _file;
+    uint32_t              _width{0};
+    uint32_t              _height{0};
+    uint32_t              _nbLevels{0};
+    std::vector<uint64_t> _levelOffsets;  // Of the first page of each virtual level
+    uint64_t              _tailOffset{0};
+    ProcessedTexture      _tail;  // Layout of the tail, without data
+};
+
+
+#endif
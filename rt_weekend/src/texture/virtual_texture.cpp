@@ -0,0 +1,561 @@
+#include "virtual_texture.hpp"
+#include <nvh/nvprint.hpp>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <tuple>
+
+// -----------------------
+// Trace Format
+// -----------------------
+
+static constexpr uint32_t TRACE_MAGIC   = 0x52544656;  // "VFTR"
+static constexpr uint32_t TRACE_VERSION = 1;
+
+template <typename T>
+static void writeValue(std::ofstream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& in, T& value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+static uint32_t encodeEntry(uint32_t physicalPage, uint32_t level)
+{
+    return physicalPage | (level << 16);
+}
+
+// -----------------------
+// ResidencyManager
+// -----------------------
+
+void ResidencyManager::init(const Settings& settings)
+{
+    _settings = settings;
+    _settings.nbPhysicalPages = std::min(_settings.nbPhysicalPages, 1U << 16);
+
+    _textures.clear();
+    _pageTable.clear();
+    _resident.clear();
+    _lru.clear();
+    _physical.assign(_settings.nbPhysicalPages, PhysicalPage());
+    _freePages.clear();
+    for (uint32_t i = _settings.nbPhysicalPages; i > 0; i--) {
+        _freePages.push_back(i - 1);
+    }
+    _stats = Stats();
+    clearDirty();
+}
+
+uint32_t ResidencyManager::getLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 0;
+    while (std::max(width >> levels, height >> levels) > PAGE_SIZE) {
+        levels++;
+    }
+    return levels;
+}
+
+uint32_t ResidencyManager::getPageCountX(const TextureInfo& info, uint32_t level)
+{
+    return (std::max(1U, info.width >> level) + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+uint32_t ResidencyManager::getPageCountY(const TextureInfo& info, uint32_t level)
+{
+    return (std::max(1U, info.height >> level) + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+bool ResidencyManager::addTexture(uint32_t texture, uint32_t width, uint32_t height)
+{
+    TextureInfo info;
+    info.width           = width;
+    info.height          = height;
+    info.nbLevels        = getLevelCount(width, height);
+    info.pageTableOffset = static_cast<uint32_t>(_pageTable.size());
+
+    if (info.nbLevels == 0 || info.nbLevels > MAX_LEVELS || texture >= MAX_TEXTURES || _textures.count(texture)) {
+        return false;
+    }
+
+    uint32_t nbEntries = 0;
+    for (uint32_t level = 0; level < info.nbLevels; level++) {
+        nbEntries += getPageCountX(info, level) * getPageCountY(info, level);
+    }
+    if (_pageTable.size() + nbEntries > _settings.pageTableCapacity) {
+        return false;
+    }
+
+    _pageTable.resize(_pageTable.size() + nbEntries, INVALID_ENTRY);
+    _dirtyBegin = std::min(_dirtyBegin, info.pageTableOffset);
+    _dirtyEnd   = static_cast<uint32_t>(_pageTable.size());
+    _textures[texture] = info;
+    return true;
+}
+
+std::vector<ResidencyManager::Load> ResidencyManager::update(const uint32_t* feedback, size_t count, uint64_t frame)
+{
+    // Distinct requests, with how many pixels asked for them
+    std::unordered_map<uint32_t, uint32_t> requests;
+    for (size_t i = 0; i < count; i++) {
+        if (feedback[i] != NO_FEEDBACK && isValid(Page::unpack(feedback[i]))) {
+            requests[feedback[i]]++;
+        }
+    }
+
+    // The requested pages and their ancestors are kept, the missing ones are
+    // queued: coarsest level, then most requested first
+    std::unordered_map<uint32_t, uint32_t> missing;
+    for (const auto& request : requests) {
+        Page page = Page::unpack(request.first);
+        const TextureInfo& info = _textures.at(page.texture);
+
+        _stats.nbRequests++;
+        _stats.nbHits += _resident.count(request.first);
+
+        for (; page.level < info.nbLevels; page.level++, page.x >>= 1, page.y >>= 1) {
+            auto it = _resident.find(page.pack());
+            if (it != _resident.end()) {
+                touch(it->second, frame);
+            } else {
+                missing[page.pack()] += request.second;
+            }
+        }
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> queue(missing.begin(), missing.end());
+    std::sort(queue.begin(), queue.end(), [](const auto& a, const auto& b) {
+        uint32_t levelA = Page::unpack(a.first).level;
+        uint32_t levelB = Page::unpack(b.first).level;
+        return std::make_tuple(levelB, b.second, a.first) < std::make_tuple(levelA, a.second, b.first);
+    });
+
+    std::vector<Load> loads;
+    for (size_t i = 0; i < queue.size(); i++) {
+        uint32_t physicalPage = loads.size() < _settings.maxLoadsPerUpdate ? acquire(frame) : INVALID_ENTRY;
+        if (physicalPage == INVALID_ENTRY) {
+            _stats.nbDeferred += queue.size() - i;
+            break;
+        }
+
+        uint32_t packed = queue[i].first;
+        _physical[physicalPage].page = packed;
+        _resident[packed]            = physicalPage;
+        touch(physicalPage, frame);
+        updateEntries(Page::unpack(packed));
+
+        loads.push_back({Page::unpack(packed), physicalPage});
+        _stats.nbLoads++;
+    }
+
+    return loads;
+}
+
+bool ResidencyManager::isResident(const Page& page) const
+{
+    return _resident.count(page.pack()) != 0;
+}
+
+const ResidencyManager::TextureInfo* ResidencyManager::getTexture(uint32_t texture) const
+{
+    auto it = _textures.find(texture);
+    return it == _textures.end() ? nullptr : &it->second;
+}
+
+bool ResidencyManager::getDirtyRange(uint32_t& first, uint32_t& count) const
+{
+    if (_dirtyBegin >= _dirtyEnd) {
+        return false;
+    }
+    first = _dirtyBegin;
+    count = _dirtyEnd - _dirtyBegin;
+    return true;
+}
+
+void ResidencyManager::clearDirty()
+{
+    _dirtyBegin = ~0U;
+    _dirtyEnd   = 0;
+}
+
+void ResidencyManager::printStats() const
+{
+    LOGI("Virtual textures: %zu textures, %u / %u pages resident, hit rate %.1f%%\n", _textures.size(),
+         getResidentCount(), _settings.nbPhysicalPages, 100.0 * _stats.getHitRate());
+    LOGI("Virtual textures: %llu loads, %llu evictions, %llu deferred\n",
+         static_cast<unsigned long long>(_stats.nbLoads), static_cast<unsigned long long>(_stats.nbEvictions),
+         static_cast<unsigned long long>(_stats.nbDeferred));
+}
+
+// Feedback comes from the GPU: anything outside the textures is ignored
+bool ResidencyManager::isValid(const Page& page) const
+{
+    auto it = _textures.find(page.texture);
+    if (it == _textures.end() || page.level >= it->second.nbLevels) {
+        return false;
+    }
+    return page.x < getPageCountX(it->second, page.level) && page.y < getPageCountY(it->second, page.level);
+}
+
+uint32_t ResidencyManager::getEntryIndex(const TextureInfo& info, uint32_t level, uint32_t x, uint32_t y) const
+{
+    uint32_t index = info.pageTableOffset;
+    for (uint32_t l = 0; l < level; l++) {
+        index += getPageCountX(info, l) * getPageCountY(info, l);
+    }
+    return index + y * getPageCountX(info, level) + x;
+}
+
+void ResidencyManager::touch(uint32_t physicalPage, uint64_t frame)
+{
+    PhysicalPage& physical = _physical[physicalPage];
+    if (physical.inLru) {
+        if (physical.lastUsed == frame) {
+            return;
+        }
+        _lru.erase(physical.lru);
+    }
+    physical.lastUsed = frame;
+    physical.inLru    = true;
+    physical.lru      = _lru.insert(_lru.end(), physicalPage);
+}
+
+// A free physical page, else the least recently requested one if no frame in
+// flight can still sample it. INVALID_ENTRY when none is available.
+uint32_t ResidencyManager::acquire(uint64_t frame)
+{
+    if (!_freePages.empty()) {
+        uint32_t physicalPage = _freePages.back();
+        _freePages.pop_back();
+        return physicalPage;
+    }
+
+    if (_lru.empty()) {
+        return INVALID_ENTRY;
+    }
+    uint32_t      physicalPage = _lru.front();
+    PhysicalPage& physical     = _physical[physicalPage];
+    if (physical.lastUsed + _settings.framesInFlight > frame) {
+        return INVALID_ENTRY;
+    }
+
+    _lru.pop_front();
+    physical.inLru = false;
+
+    Page evicted = Page::unpack(physical.page);
+    _resident.erase(physical.page);
+    physical.page = NO_FEEDBACK;
+    updateEntries(evicted);
+    _stats.nbEvictions++;
+    return physicalPage;
+}
+
+// Entries covered by `page`, from its level to level 0: each one points to
+// its own page when resident, else inherits the entry of its parent
+void ResidencyManager::updateEntries(const Page& page)
+{
+    const TextureInfo& info = _textures.at(page.texture);
+
+    for (int level = static_cast<int>(page.level); level >= 0; level--) {
+        uint32_t shift = page.level - level;
+        uint32_t x0    = page.x << shift;
+        uint32_t y0    = page.y << shift;
+        uint32_t x1    = std::min((page.x + 1) << shift, getPageCountX(info, level));
+        uint32_t y1    = std::min((page.y + 1) << shift, getPageCountY(info, level));
+
+        for (uint32_t y = y0; y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                auto     it    = _resident.find(Page{page.texture, uint32_t(level), x, y}.pack());
+                uint32_t entry = INVALID_ENTRY;
+                if (it != _resident.end()) {
+                    entry = encodeEntry(it->second, level);
+                } else if (uint32_t(level) + 1 < info.nbLevels) {
+                    entry = _pageTable[getEntryIndex(info, level + 1, x >> 1, y >> 1)];
+                }
+
+                uint32_t index    = getEntryIndex(info, level, x, y);
+                _pageTable[index] = entry;
+                _dirtyBegin       = std::min(_dirtyBegin, index);
+                _dirtyEnd         = std::max(_dirtyEnd, index + 1);
+            }
+        }
+    }
+}
+
+// -----------------------
+// FeedbackTrace
+// -----------------------
+
+void FeedbackTrace::addFrame(const uint32_t* feedback, size_t count)
+{
+    std::vector<uint32_t> frame;
+    for (size_t i = 0; i < count; i++) {
+        if (feedback[i] != ResidencyManager::NO_FEEDBACK) {
+            frame.push_back(feedback[i]);
+        }
+    }
+    frames.push_back(std::move(frame));
+}
+
+bool FeedbackTrace::save(const std::string& filename) const
+{
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+
+    writeValue(out, TRACE_MAGIC);
+    writeValue(out, TRACE_VERSION);
+    writeValue(out, static_cast<uint32_t>(textures.size()));
+    for (const auto& texture : textures) {
+        writeValue(out, texture);
+    }
+
+    writeValue(out, static_cast<uint32_t>(frames.size()));
+    for (const auto& frame : frames) {
+        writeValue(out, static_cast<uint32_t>(frame.size()));
+        out.write(reinterpret_cast<const char*>(frame.data()), frame.size() * sizeof(uint32_t));
+    }
+
+    return static_cast<bool>(out);
+}
+
+bool FeedbackTrace::load(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    uint32_t magic, version, textureCount, frameCount;
+    if (!readValue(in, magic) || magic != TRACE_MAGIC || !readValue(in, version) || version != TRACE_VERSION
+        || !readValue(in, textureCount)) {
+        return false;
+    }
+
+    FeedbackTrace loaded;
+    loaded.textures.resize(textureCount);
+    for (auto& texture : loaded.textures) {
+        if (!readValue(in, texture)) {
+            return false;
+        }
+    }
+
+    if (!readValue(in, frameCount)) {
+        return false;
+    }
+    loaded.frames.resize(frameCount);
+    for (auto& frame : loaded.frames) {
+        uint32_t size;
+        if (!readValue(in, size)) {
+            return false;
+        }
+        frame.resize(size);
+        in.read(reinterpret_cast<char*>(frame.data()), size * sizeof(uint32_t));
+        if (!in) {
+            return false;
+        }
+    }
+
+    *this = std::move(loaded);
+    return true;
+}
+
+ResidencyManager::Stats FeedbackTrace::replay(const ResidencyManager::Settings& settings) const
+{
+    ResidencyManager manager;
+    manager.init(settings);
+    for (const auto& texture : textures) {
+        manager.addTexture(texture.id, texture.width, texture.height);
+    }
+
+    uint64_t frameIndex = 0;
+    for (const auto& frame : frames) {
+        manager.update(frame.data(), frame.size(), frameIndex++);
+    }
+    return manager.getStats();
+}
+
+// -----------------------
+// Public Functions
+// -----------------------
+
+using Page = ResidencyManager::Page;
+
+// Replays `trace` one frame at a time, following the loads and evictions in a
+// model of the pool. The model touches the requested pages and their resident
+// ancestors like the manager does.
+static bool checkTrace(const FeedbackTrace& trace, const ResidencyManager::Settings& settings)
+{
+    bool ok = true;
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition && ok) {
+            LOGE("Virtual textures: %u pages, %u frames in flight: %s\n", settings.nbPhysicalPages,
+                 settings.framesInFlight, what);
+        }
+        ok &= condition;
+    };
+
+    ResidencyManager manager;
+    manager.init(settings);
+    for (const auto& texture : trace.textures) {
+        expect(manager.addTexture(texture.id, texture.width, texture.height), "texture not added");
+    }
+
+    std::unordered_map<uint32_t, uint64_t> lastUsed;  // Resident packed pages
+    std::vector<uint32_t>                  physical(settings.nbPhysicalPages, ResidencyManager::NO_FEEDBACK);
+    uint64_t                               nbLoads = 0;
+
+    for (uint64_t frame = 0; frame < trace.frames.size() && ok; frame++) {
+        const auto& feedback = trace.frames[frame];
+        for (uint32_t packed : feedback) {
+            Page page = Page::unpack(packed);
+            const ResidencyManager::TextureInfo* info = manager.getTexture(page.texture);
+            for (; info && page.level < info->nbLevels; page.level++, page.x >>= 1, page.y >>= 1) {
+                auto it = lastUsed.find(page.pack());
+                if (it != lastUsed.end()) {
+                    it->second = frame;
+                }
+            }
+        }
+
+        for (const auto& load : manager.update(feedback.data(), feedback.size(), frame)) {
+            uint32_t packed = load.page.pack();
+            expect(lastUsed.count(packed) == 0, "resident page loaded again");
+
+            Page parent = load.page;
+            parent.level++;
+            parent.x >>= 1;
+            parent.y >>= 1;
+            expect(parent.level >= manager.getTexture(parent.texture)->nbLevels || lastUsed.count(parent.pack()),
+                   "page loaded before its parent");
+
+            uint32_t evicted = physical[load.physicalPage];
+            if (evicted != ResidencyManager::NO_FEEDBACK) {
+                uint64_t evictedUse = lastUsed.at(evicted);
+                expect(evictedUse + settings.framesInFlight <= frame,
+                       "page requested by a frame in flight evicted");
+                for (const auto& resident : lastUsed) {
+                    expect(evictedUse <= resident.second, "page evicted before a less recently requested one");
+                }
+                expect(!manager.isResident(Page::unpack(evicted)), "evicted page still resident");
+                lastUsed.erase(evicted);
+            }
+
+            physical[load.physicalPage] = packed;
+            lastUsed[packed]            = frame;
+            nbLoads++;
+        }
+        expect(manager.getResidentCount() == lastUsed.size(), "resident pages differ from the model");
+    }
+
+    expect(!ok || trace.replay(settings).nbLoads == nbLoads, "replay differs");
+    return ok;
+}
+
+bool checkVirtualTextures()
+{
+    bool ok = true;
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition) {
+            LOGE("Virtual textures: %s\n", what);
+            ok = false;
+        }
+    };
+
+    ResidencyManager::Settings settings;
+
+    // Coarsest first: the two ancestors of a level 0 page, then the page
+    {
+        settings.nbPhysicalPages   = 8;
+        settings.maxLoadsPerUpdate = 2;
+        ResidencyManager manager;
+        manager.init(settings);
+        manager.addTexture(0, 1024, 1024);
+
+        uint32_t request = Page{0, 0, 5, 3}.pack();
+        auto     loads   = manager.update(&request, 1, 0);
+        expect(loads.size() == 2 && loads[0].page.pack() == Page{0, 2, 1, 0}.pack()
+                   && loads[1].page.pack() == Page{0, 1, 2, 1}.pack(),
+               "ancestors not loaded first");
+        loads = manager.update(&request, 1, 1);
+        expect(loads.size() == 1 && loads[0].page.pack() == request, "page not loaded after its ancestors");
+    }
+
+    // Pages without ancestors: 2 x 2 pages of a single level
+    uint32_t a = Page{0, 0, 0, 0}.pack();
+    uint32_t b = Page{0, 0, 1, 0}.pack();
+    uint32_t c = Page{0, 0, 0, 1}.pack();
+
+    // B is the least recently requested when C comes
+    {
+        settings.nbPhysicalPages   = 2;
+        settings.maxLoadsPerUpdate = 32;
+        settings.framesInFlight    = 1;
+        ResidencyManager manager;
+        manager.init(settings);
+        manager.addTexture(0, 256, 256);
+
+        manager.update(&a, 1, 0);
+        manager.update(&b, 1, 1);
+        manager.update(&a, 1, 2);
+        manager.update(&c, 1, 3);
+        expect(manager.isResident(Page::unpack(a)) && !manager.isResident(Page::unpack(b))
+                   && manager.isResident(Page::unpack(c)),
+               "least recently requested page not evicted");
+    }
+
+    // A is still sampled by the frames in flight at frame 2, not at frame 3
+    {
+        settings.framesInFlight = 3;
+        ResidencyManager manager;
+        manager.init(settings);
+        manager.addTexture(0, 256, 256);
+
+        manager.update(&a, 1, 0);
+        manager.update(&b, 1, 1);
+        expect(manager.update(&c, 1, 2).empty() && manager.getStats().nbDeferred == 1,
+               "page of a frame in flight evicted");
+        expect(manager.update(&c, 1, 3).size() == 1 && !manager.isResident(Page::unpack(a)),
+               "page evicted once its frames completed");
+    }
+
+    // A window sweeping over level 0 of a large texture, and scattered
+    // requests at all levels of a smaller one, many pixels per page
+    FeedbackTrace trace;
+    trace.textures = {{0, 2048, 2048}, {1, 1024, 512}};
+    std::mt19937 rng(1);
+    auto         random = [&rng](uint32_t count) { return static_cast<uint32_t>(rng() % count); };
+    for (uint32_t frame = 0; frame < 300; frame++) {
+        std::vector<uint32_t> feedback;
+        uint32_t              x0 = (frame / 4) % 14;
+        uint32_t              y0 = (frame / 30) % 14;
+        for (uint32_t i = 0; i < 400; i++) {
+            feedback.push_back(Page{0, 0, x0 + random(3), y0 + random(3)}.pack());
+        }
+        for (uint32_t i = 0, count = random(8); i < count; i++) {
+            uint32_t level = random(3);
+            feedback.push_back(Page{1, level, random(8U >> level), random(std::max(1U, 4U >> level))}.pack());
+        }
+        feedback.push_back(ResidencyManager::NO_FEEDBACK);
+        feedback.push_back(Page{7, 0, 0, 0}.pack());  // Unknown texture, ignored
+        trace.addFrame(feedback.data(), feedback.size());
+    }
+
+    // From a pool that holds the working set to one smaller than the frames
+    // in flight request
+    const ResidencyManager::Settings pools[] = {{64, 32, 1}, {24, 6, 3}, {12, 4, 2}, {6, 32, 4}};
+    for (const auto& pool : pools) {
+        ok &= checkTrace(trace, pool);
+    }
+    auto stats = trace.replay(pools[2]);
+    expect(stats.nbEvictions > 0 && stats.nbDeferred > 0, "synthetic trace without evictions or deferred loads");
+
+    LOGI("Virtual textures: %s\n", ok ? "OK" : "FAILED");
+    return ok;
+}
@@ -0,0 +1,169 @@
+#ifndef VIRTUAL_TEXTURE_HPP
+#define VIRTUAL_TEXTURE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Residency of virtual textures in a pool of physical pages. Nothing here
+// depends on Vulkan: the manager is driven by feedback entries and can be
+// replayed on the CPU from a recorded trace.
+//
+// The levels of a texture larger than one page are split in pages of
+// PAGE_SIZE texels, the smaller levels (the tail) stay resident in an
+// ordinary texture. The page table has one entry per page of every virtual
+// level, pointing to the physical page of the finest resident level covering
+// it, or INVALID_ENTRY to fall back to the tail.
+//
+// Missing pages are loaded coarsest first, along with their missing
+// ancestors, a bounded number per update. A full pool evicts the least
+// recently requested page, never one requested by the frames in flight.
+class ResidencyManager {
+public:
+    static constexpr uint32_t PAGE_SIZE     = 128;  // Payload texels per side
+    static constexpr uint32_t PAGE_BORDER   = 4;    // Texels repeated from the neighbours, for filtering
+    static constexpr uint32_t MAX_LEVELS    = 8;    // Level 0 has at most 128 x 128 pages
+    static constexpr uint32_t MAX_TEXTURES  = 1 << 14;
+    static constexpr uint32_t NO_FEEDBACK   = ~0U;  // Empty feedback entry
+    static constexpr uint32_t INVALID_ENTRY = ~0U;  // Page table entry without a resident page
+
+    // Packed in 32 bits by pack(): texture 14, level 4, x 7, y 7
+    struct Page {
+        uint32_t texture{0};
+        uint32_t level{0};
+        uint32_t x{0};
+        uint32_t y{0};
+
+        uint32_t    pack() const { return (texture << 18) | (level << 14) | (x << 7) | y; }
+        static Page unpack(uint32_t packed)
+        {
+            return {packed >> 18, (packed >> 14) & 0xF, (packed >> 7) & 0x7F, packed & 0x7F};
+        }
+    };
+
+    struct Load {
+        Page     page;
+        uint32_t physicalPage{0};
+    };
+
+    struct Settings {
+        uint32_t nbPhysicalPages{1024};
+        uint32_t maxLoadsPerUpdate{32};
+        uint32_t framesInFlight{3};  // Pages requested by the last frames are not evicted
+        uint32_t pageTableCapacity{1 << 20};
+    };
+
+    struct TextureInfo {
+        uint32_t width{0};
+        uint32_t height{0};
+        uint32_t nbLevels{0};         // Virtual levels, the tail starts after them
+        uint32_t pageTableOffset{0};  // Entries of level 0, then level 1...
+    };
+
+    struct Stats {
+        uint64_t nbRequests{0};   // Distinct pages requested, per update
+        uint64_t nbHits{0};       // Of them, already resident
+        uint64_t nbLoads{0};
+        uint64_t nbEvictions{0};
+        uint64_t nbDeferred{0};   // Missing pages left for a later update
+
+        double getHitRate() const { return nbRequests ? double(nbHits) / nbRequests : 1.0; }
+    };
+
+    void init(const Settings& settings);
+
+    // Levels larger than one page, 0 when the texture fits in its tail
+    static uint32_t getLevelCount(uint32_t width, uint32_t height);
+    static uint32_t getPageCountX(const TextureInfo& info, uint32_t level);
+    static uint32_t getPageCountY(const TextureInfo& info, uint32_t level);
+
+    // `texture` is the caller's identifier, below MAX_TEXTURES. Returns false
+    // when the texture cannot be virtual: too small, too large, or the page
+    // table is full.
+    bool addTexture(uint32_t texture, uint32_t width, uint32_t height);
+
+    // Processes the feedback of one frame, `frame` increases by one per call.
+    // Returns the pages to copy to their physical page before the page table
+    // is used.
+    std::vector<Load> update(const uint32_t* feedback, size_t count, uint64_t frame);
+
+    bool               isResident(const Page& page) const;
+    const TextureInfo* getTexture(uint32_t texture) const;
+    uint32_t           getResidentCount() const { return static_cast<uint32_t>(_resident.size()); }
+
+    // Entries changed since the last clearDirty(), [first, first + count)
+    const std::vector<uint32_t>& getPageTable() const { return _pageTable; }
+    bool                         getDirtyRange(uint32_t& first, uint32_t& count) const;
+    void                         clearDirty();
+
+    const Settings& getSettings() const { return _settings; }
+    const Stats&    getStats() const { return _stats; }
+    void            printStats() const;
+
+private:
+    struct PhysicalPage {
+        uint32_t                      page{NO_FEEDBACK};  // Packed, NO_FEEDBACK when free
+        uint64_t                      lastUsed{0};
+        bool                          inLru{false};
+        std::list<uint32_t>::iterator lru;
+    };
+
+    bool     isValid(const Page& page) const;
+    uint32_t getEntryIndex(const TextureInfo& info, uint32_t level, uint32_t x, uint32_t y) const;
+    void     touch(uint32_t physicalPage, uint64_t frame);
+    uint32_t acquire(uint64_t frame);
+    void     updateEntries(const Page& page);
+
+    Settings                                  _settings;
+    std::unordered_map<uint32_t, TextureInfo> _textures;
+    std::vector<uint32_t>                     _pageTable;
+    uint32_t                                  _dirtyBegin{~0U};
+    uint32_t                                  _dirtyEnd{0};
+
+    std::vector<PhysicalPage>              _physical;
+    std::vector<uint32_t>                  _freePages;
+    std::list<uint32_t>                    _lru;  // Least recently requested first
+    std::unordered_map<uint32_t, uint32_t> _resident;  // Packed page to physical page
+
+    Stats _stats;
+};
+
+// Options of the application: virtual textures are off by default, all the
+// textures are then fully resident
+struct VirtualTextureSettings {
+    bool                       enabled{false};
+    ResidencyManager::Settings residency;
+    std::string                traceFilename;  // Feedback recorded to when set, written on exit
+};
+
+// Feedback of consecutive frames, with the textures they refer to, to replay
+// the residency decisions without a device
+struct FeedbackTrace {
+    struct Texture {
+        uint32_t id{0};
+        uint32_t width{0};
+        uint32_t height{0};
+    };
+
+    std::vector<Texture>               textures;
+    std::vector<std::vector<uint32_t>> frames;  // Without the empty entries
+
+    void addFrame(const uint32_t* feedback, size_t count);
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename);
+
+    // Feeds all the frames to a new manager
+    ResidencyManager::Stats replay(const ResidencyManager::Settings& settings) const;
+};
+
+// Synthetic traces replayed against a model of the residency: missing
+// ancestors are loaded before their children, the least recently requested
+// page is evicted first and never one requested by the frames in flight,
+// without device
+bool checkVirtualTextures();
+
+
+#endif
@@ -26,15 +26,47 @@
  */
 
 #include "gltfscene.hpp"
+#include "filemapping.hpp"
 #include "nvprint.hpp"
+#include "fileformats/cgltf.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <numeric>
 #include <set>
+#include <thread>
 
 namespace nvh {
 
 #define EXTENSION_ATTRIB_IRAY "NV_attributes_iray"
 
+//--------------------------------------------------------------------------------------------------
+// Identify the accessors the vertices of a primitive are made of: primitives with the same key
+// get the same vertices. Missing normals and tangents are generated from the indices, which
+// then become part of the key.
+//
+static std::string vertexAccessorKey(std::vector<std::pair<std::string, int>> attribs, int indices)
+{
+  std::sort(attribs.begin(), attribs.end());
+
+  std::string key;
+  for(const auto& attrib : attribs)
+    key += attrib.first + ":" + std::to_string(attrib.second) + ";";
+  bool hasNormal  = std::any_of(attribs.begin(), attribs.end(), [](const auto& a) { return a.first == "NORMAL"; });
+  bool hasTangent = std::any_of(attribs.begin(), attribs.end(), [](const auto& a) { return a.first == "TANGENT"; });
+  if(!hasNormal || !hasTangent)
+    key += "indices:" + std::to_string(indices);
+  return key;
+}
+
+static std::string vertexAccessorKey(const tinygltf::Primitive& primitive)
+{
+  return vertexAccessorKey({primitive.attributes.begin(), primitive.attributes.end()}, primitive.indices);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Collect the value of all materials
 //
@@ -176,11 +208,13 @@ void GltfScene::importDrawableNodes(const tinygltf::Model& tmodel, GltfAttribute
 {
   checkRequiredExtensions(tmodel);
 
-  // Find the number of vertex(attributes) and index
-  uint32_t nbVert{0};
-  uint32_t nbIndex{0};
-  uint32_t meshCnt{0};  // use for mesh to new meshes
-  uint32_t primCnt{0};  //  "   "  "  "
+  // Find the number of vertex(attributes) and index, shared accessors counted once
+  uint32_t              nbVert{0};
+  uint32_t              nbIndex{0};
+  uint32_t              meshCnt{0};  // use for mesh to new meshes
+  uint32_t              primCnt{0};  //  "   "  "  "
+  std::set<std::string> vertexKeys;
+  std::set<int>         indexAccessors;
   for(const auto& mesh : tmodel.meshes)
   {
     std::vector<uint32_t> vprim;
@@ -189,11 +223,13 @@ void GltfScene::importDrawableNodes(const tinygltf::Model& tmodel, GltfAttribute
       if(primitive.mode != 4)  // Triangle
         continue;
       const auto& posAccessor = tmodel.accessors[primitive.attributes.find("POSITION")->second];
-      nbVert += static_cast<uint32_t>(posAccessor.count);
+      if(vertexKeys.insert(vertexAccessorKey(primitive)).second)
+        nbVert += static_cast<uint32_t>(posAccessor.count);
       if(primitive.indices > -1)
       {
         const auto& indexAccessor = tmodel.accessors[primitive.indices];
-        nbIndex += static_cast<uint32_t>(indexAccessor.count);
+        if(indexAccessors.insert(primitive.indices).second)
+          nbIndex += static_cast<uint32_t>(indexAccessor.count);
       }
       else
       {
@@ -237,6 +273,8 @@ void GltfScene::importDrawableNodes(const tinygltf::Model& tmodel, GltfAttribute
   computeCamera();
 
   m_meshToPrimMeshes.clear();
+  m_cacheVertices.clear();
+  m_cacheIndices.clear();
   primitiveIndices32u.clear();
   primitiveIndices16u.clear();
   primitiveIndices8u.clear();
@@ -311,6 +349,183 @@ void GltfScene::processNode(const tinygltf::Model& tmodel, int& nodeIdx, const n
   }
 }
 
+//--------------------------------------------------------------------------------------------------
+// Generating missing attributes of one primitive.
+// All pointers are relative to the primitive: indices are local, arrays hold `vertexCount` elements.
+//
+static void computeNormals(const uint32_t* indices, uint32_t indexCount, const nvmath::vec3f* positions, uint32_t vertexCount, nvmath::vec3f* normals)
+{
+  std::fill(normals, normals + vertexCount, nvmath::vec3f(0.f));
+  for(size_t i = 0; i < indexCount; i += 3)
+  {
+    uint32_t    ind0 = indices[i + 0];
+    uint32_t    ind1 = indices[i + 1];
+    uint32_t    ind2 = indices[i + 2];
+    const auto& pos0 = positions[ind0];
+    const auto& pos1 = positions[ind1];
+    const auto& pos2 = positions[ind2];
+    const auto  v1   = nvmath::normalize(pos1 - pos0);  // Many normalize, but when objects are really small the
+    const auto  v2   = nvmath::normalize(pos2 - pos0);  // cross will go below nv_eps and the normal will be (0,0,0)
+    const auto  n    = nvmath::cross(v2, v1);
+    normals[ind0] += n;
+    normals[ind1] += n;
+    normals[ind2] += n;
+  }
+  for(uint32_t i = 0; i < vertexCount; i++)
+    normals[i] = nvmath::normalize(normals[i]);
+}
+
+static void computeCubeTexcoords(const nvmath::vec3f* positions, uint32_t vertexCount, nvmath::vec2f* texcoords)
+{
+  for(uint32_t i = 0; i < vertexCount; i++)
+  {
+    const auto& pos  = positions[i];
+    float       absX = fabs(pos.x);
+    float       absY = fabs(pos.y);
+    float       absZ = fabs(pos.z);
+
+    int isXPositive = pos.x > 0 ? 1 : 0;
+    int isYPositive = pos.y > 0 ? 1 : 0;
+    int isZPositive = pos.z > 0 ? 1 : 0;
+
+    float maxAxis, uc, vc;
+
+    // POSITIVE X
+    if(isXPositive && absX >= absY && absX >= absZ)
+    {
+      // u (0 to 1) goes from +z to -z
+      // v (0 to 1) goes from -y to +y
+      maxAxis = absX;
+      uc      = -pos.z;
+      vc      = pos.y;
+    }
+    // NEGATIVE X
+    if(!isXPositive && absX >= absY && absX >= absZ)
+    {
+      // u (0 to 1) goes from -z to +z
+      // v (0 to 1) goes from -y to +y
+      maxAxis = absX;
+      uc      = pos.z;
+      vc      = pos.y;
+    }
+    // POSITIVE Y
+    if(isYPositive && absY >= absX && absY >= absZ)
+    {
+      // u (0 to 1) goes from -x to +x
+      // v (0 to 1) goes from +z to -z
+      maxAxis = absY;
+      uc      = pos.x;
+      vc      = -pos.z;
+    }
+    // NEGATIVE Y
+    if(!isYPositive && absY >= absX && absY >= absZ)
+    {
+      // u (0 to 1) goes from -x to +x
+      // v (0 to 1) goes from -z to +z
+      maxAxis = absY;
+      uc      = pos.x;
+      vc      = pos.z;
+    }
+    // POSITIVE Z
+    if(isZPositive && absZ >= absX && absZ >= absY)
+    {
+      // u (0 to 1) goes from -x to +x
+      // v (0 to 1) goes from -y to +y
+      maxAxis = absZ;
+      uc      = pos.x;
+      vc      = pos.y;
+    }
+    // NEGATIVE Z
+    if(!isZPositive && absZ >= absX && absZ >= absY)
+    {
+      // u (0 to 1) goes from +x to -x
+      // v (0 to 1) goes from -y to +y
+      maxAxis = absZ;
+      uc      = -pos.x;
+      vc      = pos.y;
+    }
+
+    // Convert range from -1 to 1 to 0 to 1
+    float u = 0.5f * (uc / maxAxis + 1.0f);
+    float v = 0.5f * (vc / maxAxis + 1.0f);
+
+    texcoords[i] = nvmath::vec2f(u, v);
+  }
+}
+
+static void computeTangents(const uint32_t*      indices,
+                            uint32_t             indexCount,
+                            const nvmath::vec3f* positions,
+                            const nvmath::vec3f* normals,
+                            const nvmath::vec2f* texcoords,
+                            uint32_t             vertexCount,
+                            nvmath::vec4f*       tangents)
+{
+  // #TODO - Should calculate tangents using default MikkTSpace algorithms
+  // See: https://github.com/mmikk/MikkTSpace
+
+  std::vector<nvmath::vec3f> tangent(vertexCount);
+  std::vector<nvmath::vec3f> bitangent(vertexCount);
+
+  // Current implementation
+  // http://foundationsofgameenginedev.com/FGED2-sample.pdf
+  for(size_t i = 0; i < indexCount; i += 3)
+  {
+    uint32_t i0 = indices[i + 0];
+    uint32_t i1 = indices[i + 1];
+    uint32_t i2 = indices[i + 2];
+    assert(i0 < vertexCount);
+    assert(i1 < vertexCount);
+    assert(i2 < vertexCount);
+
+    const auto& p0 = positions[i0];
+    const auto& p1 = positions[i1];
+    const auto& p2 = positions[i2];
+
+    const auto& uv0 = texcoords[i0];
+    const auto& uv1 = texcoords[i1];
+    const auto& uv2 = texcoords[i2];
+
+    nvmath::vec3f e1 = p1 - p0;
+    nvmath::vec3f e2 = p2 - p0;
+
+    nvmath::vec2f duvE1 = uv1 - uv0;
+    nvmath::vec2f duvE2 = uv2 - uv0;
+
+    float r = 1.0F;
+    float a = duvE1.x * duvE2.y - duvE2.x * duvE1.y;
+    if(fabs(a) > 0)  // Catch degenerated UV
+    {
+      r = 1.0f / a;
+    }
+
+    nvmath::vec3f t = (e1 * duvE2.y - e2 * duvE1.y) * r;
+    nvmath::vec3f b = (e2 * duvE1.x - e1 * duvE2.x) * r;
+
+    tangent[i0] += t;
+    tangent[i1] += t;
+    tangent[i2] += t;
+
+    bitangent[i0] += b;
+    bitangent[i1] += b;
+    bitangent[i2] += b;
+  }
+
+  for(uint32_t a = 0; a < vertexCount; a++)
+  {
+    const auto& t = tangent[a];
+    const auto& b = bitangent[a];
+    const auto& n = normals[a];
+
+    // Gram-Schmidt orthogonalize
+    nvmath::vec3f otangent = nvmath::normalize(t - (nvmath::dot(n, t) * n));
+
+    // Calculate handedness
+    float handedness = (nvmath::dot(nvmath::cross(n, t), b) < 0.0F) ? -1.0F : 1.0F;
+    tangents[a]      = nvmath::vec4f(otangent.x, otangent.y, otangent.z, handedness);
+  }
+}
+
 //--------------------------------------------------------------------------------------------------
 // Extracting the values to a linear buffer
 //
@@ -327,8 +542,20 @@ void GltfScene::processMesh(const tinygltf::Model& tmodel, const tinygltf::Primi
   if(tmesh.mode != 4)
     return;
 
+  // Primitives built from the same accessors share the same vertices
+  std::string vertexKey = vertexAccessorKey(tmesh);
+  auto        itVertex  = m_cacheVertices.find(vertexKey);
+
   // INDICES
-  if(tmesh.indices > -1)
+  auto itIndex = tmesh.indices > -1 ? m_cacheIndices.find(tmesh.indices) : m_cacheIndices.end();
+  if(itIndex != m_cacheIndices.end())
+  {
+    // Indices are local to the primitive, they can be shared even if the vertices are not
+    const auto& sharedMesh = m_primMeshes[itIndex->second];
+    resultMesh.firstIndex  = sharedMesh.firstIndex;
+    resultMesh.indexCount  = sharedMesh.indexCount;
+  }
+  else if(tmesh.indices > -1)
   {
     const tinygltf::Accessor&   indexAccessor = tmodel.accessors[tmesh.indices];
     const tinygltf::BufferView& bufferView    = tmodel.bufferViews[indexAccessor.bufferView];
@@ -363,6 +590,7 @@ void GltfScene::processMesh(const tinygltf::Model& tmodel, const tinygltf::Primi
         std::cerr << "Index component type " << indexAccessor.componentType << " not supported!" << std::endl;
         return;
     }
+    m_cacheIndices[tmesh.indices] = static_cast<uint32_t>(m_primMeshes.size());
   }
   else
   {
@@ -373,6 +601,18 @@ void GltfScene::processMesh(const tinygltf::Model& tmodel, const tinygltf::Primi
     resultMesh.indexCount = static_cast<uint32_t>(accessor.count);
   }
 
+  if(itVertex != m_cacheVertices.end())
+  {
+    const auto& sharedMesh  = m_primMeshes[itVertex->second];
+    resultMesh.vertexOffset = sharedMesh.vertexOffset;
+    resultMesh.vertexCount  = sharedMesh.vertexCount;
+    resultMesh.posMin       = sharedMesh.posMin;
+    resultMesh.posMax       = sharedMesh.posMax;
+    m_primMeshes.emplace_back(resultMesh);
+    return;
+  }
+  m_cacheVertices[vertexKey] = static_cast<uint32_t>(m_primMeshes.size());
+
   // POSITION
   {
     bool result = getAttribute<nvmath::vec3f>(tmodel, tmesh, m_positions, "POSITION");
@@ -393,25 +633,9 @@ void GltfScene::processMesh(const tinygltf::Model& tmodel, const tinygltf::Primi
     if(!getAttribute<nvmath::vec3f>(tmodel, tmesh, m_normals, "NORMAL"))
     {
       // Need to compute the normals
-      std::vector<nvmath::vec3> geonormal(resultMesh.vertexCount);
-      for(size_t i = 0; i < resultMesh.indexCount; i += 3)
-      {
-        uint32_t    ind0 = m_indices[resultMesh.firstIndex + i + 0];
-        uint32_t    ind1 = m_indices[resultMesh.firstIndex + i + 1];
-        uint32_t    ind2 = m_indices[resultMesh.firstIndex + i + 2];
-        const auto& pos0 = m_positions[ind0 + resultMesh.vertexOffset];
-        const auto& pos1 = m_positions[ind1 + resultMesh.vertexOffset];
-        const auto& pos2 = m_positions[ind2 + resultMesh.vertexOffset];
-        const auto  v1   = nvmath::normalize(pos1 - pos0);  // Many normalize, but when objects are really small the
-        const auto  v2   = nvmath::normalize(pos2 - pos0);  // cross will go below nv_eps and the normal will be (0,0,0)
-        const auto  n    = nvmath::cross(v2, v1);
-        geonormal[ind0] += n;
-        geonormal[ind1] += n;
-        geonormal[ind2] += n;
-      }
-      for(auto& n : geonormal)
-        n = nvmath::normalize(n);
-      m_normals.insert(m_normals.end(), geonormal.begin(), geonormal.end());
+      m_normals.resize(m_normals.size() + resultMesh.vertexCount);
+      computeNormals(&m_indices[resultMesh.firstIndex], resultMesh.indexCount, &m_positions[resultMesh.vertexOffset],
+                     resultMesh.vertexCount, &m_normals[resultMesh.vertexOffset]);
     }
   }
 
@@ -420,84 +644,9 @@ void GltfScene::processMesh(const tinygltf::Model& tmodel, const tinygltf::Primi
   {
     if(!getAttribute<nvmath::vec2f>(tmodel, tmesh, m_texcoords0, "TEXCOORD_0"))
     {
-      // Set them all to zero
-      //      m_texcoords0.insert(m_texcoords0.end(), resultMesh.vertexCount, nvmath::vec2f(0, 0));
-
       // Cube map projection
-      for(uint32_t i = 0; i < resultMesh.vertexCount; i++)
-      {
-        const auto& pos  = m_positions[resultMesh.vertexOffset + i];
-        float       absX = fabs(pos.x);
-        float       absY = fabs(pos.y);
-        float       absZ = fabs(pos.z);
-
-        int isXPositive = pos.x > 0 ? 1 : 0;
-        int isYPositive = pos.y > 0 ? 1 : 0;
-        int isZPositive = pos.z > 0 ? 1 : 0;
-
-        float maxAxis, uc, vc;
-
-        // POSITIVE X
-        if(isXPositive && absX >= absY && absX >= absZ)
-        {
-          // u (0 to 1) goes from +z to -z
-          // v (0 to 1) goes from -y to +y
-          maxAxis = absX;
-          uc      = -pos.z;
-          vc      = pos.y;
-        }
-        // NEGATIVE X
-        if(!isXPositive && absX >= absY && absX >= absZ)
-        {
-          // u (0 to 1) goes from -z to +z
-          // v (0 to 1) goes from -y to +y
-          maxAxis = absX;
-          uc      = pos.z;
-          vc      = pos.y;
-        }
-        // POSITIVE Y
-        if(isYPositive && absY >= absX && absY >= absZ)
-        {
-          // u (0 to 1) goes from -x to +x
-          // v (0 to 1) goes from +z to -z
-          maxAxis = absY;
-          uc      = pos.x;
-          vc      = -pos.z;
-        }
-        // NEGATIVE Y
-        if(!isYPositive && absY >= absX && absY >= absZ)
-        {
-          // u (0 to 1) goes from -x to +x
-          // v (0 to 1) goes from -z to +z
-          maxAxis = absY;
-          uc      = pos.x;
-          vc      = pos.z;
-        }
-        // POSITIVE Z
-        if(isZPositive && absZ >= absX && absZ >= absY)
-        {
-          // u (0 to 1) goes from -x to +x
-          // v (0 to 1) goes from -y to +y
-          maxAxis = absZ;
-          uc      = pos.x;
-          vc      = pos.y;
-        }
-        // NEGATIVE Z
-        if(!isZPositive && absZ >= absX && absZ >= absY)
-        {
-          // u (0 to 1) goes from +x to -x
-          // v (0 to 1) goes from -y to +y
-          maxAxis = absZ;
-          uc      = -pos.x;
-          vc      = pos.y;
-        }
-
-        // Convert range from -1 to 1 to 0 to 1
-        float u = 0.5f * (uc / maxAxis + 1.0f);
-        float v = 0.5f * (vc / maxAxis + 1.0f);
-
-        m_texcoords0.emplace_back(u, v);
-      }
+      m_texcoords0.resize(m_texcoords0.size() + resultMesh.vertexCount);
+      computeCubeTexcoords(&m_positions[resultMesh.vertexOffset], resultMesh.vertexCount, &m_texcoords0[resultMesh.vertexOffset]);
     }
   }
 
@@ -507,76 +656,10 @@ void GltfScene::processMesh(const tinygltf::Model& tmodel, const tinygltf::Primi
   {
     if(!getAttribute<nvmath::vec4f>(tmodel, tmesh, m_tangents, "TANGENT"))
     {
-      // #TODO - Should calculate tangents using default MikkTSpace algorithms
-      // See: https://github.com/mmikk/MikkTSpace
-
-      std::vector<nvmath::vec3f> tangent(resultMesh.vertexCount);
-      std::vector<nvmath::vec3f> bitangent(resultMesh.vertexCount);
-
-      // Current implementation
-      // http://foundationsofgameenginedev.com/FGED2-sample.pdf
-      for(size_t i = 0; i < resultMesh.indexCount; i += 3)
-      {
-        // local index
-        uint32_t i0 = m_indices[resultMesh.firstIndex + i + 0];
-        uint32_t i1 = m_indices[resultMesh.firstIndex + i + 1];
-        uint32_t i2 = m_indices[resultMesh.firstIndex + i + 2];
-        assert(i0 < resultMesh.vertexCount);
-        assert(i1 < resultMesh.vertexCount);
-        assert(i2 < resultMesh.vertexCount);
-
-
-        // global index
-        uint32_t gi0 = i0 + resultMesh.vertexOffset;
-        uint32_t gi1 = i1 + resultMesh.vertexOffset;
-        uint32_t gi2 = i2 + resultMesh.vertexOffset;
-
-        const auto& p0 = m_positions[gi0];
-        const auto& p1 = m_positions[gi1];
-        const auto& p2 = m_positions[gi2];
-
-        const auto& uv0 = m_texcoords0[gi0];
-        const auto& uv1 = m_texcoords0[gi1];
-        const auto& uv2 = m_texcoords0[gi2];
-
-        nvmath::vec3f e1 = p1 - p0;
-        nvmath::vec3f e2 = p2 - p0;
-
-        nvmath::vec2f duvE1 = uv1 - uv0;
-        nvmath::vec2f duvE2 = uv2 - uv0;
-
-        float r = 1.0F;
-        float a = duvE1.x * duvE2.y - duvE2.x * duvE1.y;
-        if(fabs(a) > 0)  // Catch degenerated UV
-        {
-          r = 1.0f / a;
-        }
-
-        nvmath::vec3f t = (e1 * duvE2.y - e2 * duvE1.y) * r;
-        nvmath::vec3f b = (e2 * duvE1.x - e1 * duvE2.x) * r;
-
-        tangent[i0] += t;
-        tangent[i1] += t;
-        tangent[i2] += t;
-
-        bitangent[i0] += b;
-        bitangent[i1] += b;
-        bitangent[i2] += b;
-      }
-
-      for(uint32_t a = 0; a < resultMesh.vertexCount; a++)
-      {
-        const auto& t = tangent[a];
-        const auto& b = bitangent[a];
-        const auto& n = m_normals[resultMesh.vertexOffset + a];
-
-        // Gram-Schmidt orthogonalize
-        nvmath::vec3f tangent = nvmath::normalize(t - (nvmath::dot(n, t) * n));
-
-        // Calculate handedness
-        float handedness = (nvmath::dot(nvmath::cross(n, t), b) < 0.0F) ? -1.0F : 1.0F;
-        m_tangents.emplace_back(tangent.x, tangent.y, tangent.z, handedness);
-      }
+      m_tangents.resize(m_tangents.size() + resultMesh.vertexCount);
+      computeTangents(&m_indices[resultMesh.firstIndex], resultMesh.indexCount, &m_positions[resultMesh.vertexOffset],
+                      &m_normals[resultMesh.vertexOffset], &m_texcoords0[resultMesh.vertexOffset], resultMesh.vertexCount,
+                      &m_tangents[resultMesh.vertexOffset]);
     }
   }
 
@@ -713,23 +796,33 @@ GltfStats GltfScene::getStatistics(const tinygltf::Model& tinyModel)
     stats.imageMem += image.width * image.height * image.component * image.bits / 8;
   }
 
-  // Computing the number of triangles
+  // Computing the number of triangles, and the vertices and indices saved by sharing accessors
   std::vector<uint32_t> meshTriangle(tinyModel.meshes.size());
   uint32_t              meshIdx{0};
+  std::set<std::string> vertexKeys;
+  std::set<int>         indexAccessors;
   for(const auto& mesh : tinyModel.meshes)
   {
     for(const auto& primitive : mesh.primitives)
     {
+      const auto& posAccessor = tinyModel.accessors[primitive.attributes.find("POSITION")->second];
+      uint32_t    vertexCount = static_cast<uint32_t>(posAccessor.count);
+      uint32_t    indexCount  = vertexCount;
       if(primitive.indices > -1)
       {
         const tinygltf::Accessor& indexAccessor = tinyModel.accessors[primitive.indices];
-        meshTriangle[meshIdx] += static_cast<uint32_t>(indexAccessor.count) / 3;
-      }
-      else
-      {
-        const auto& posAccessor = tinyModel.accessors[primitive.attributes.find("POSITION")->second];
-        meshTriangle[meshIdx] += static_cast<uint32_t>(posAccessor.count) / 3;
+        indexCount = static_cast<uint32_t>(indexAccessor.count);
       }
+      meshTriangle[meshIdx] += indexCount / 3;
+
+      if(primitive.mode != 4)  // Triangle
+        continue;
+      stats.nbVertices += vertexCount;
+      stats.nbIndices += indexCount;
+      if(vertexKeys.insert(vertexAccessorKey(primitive)).second)
+        stats.nbUniqueVertices += vertexCount;
+      if(primitive.indices < 0 || indexAccessors.insert(primitive.indices).second)
+        stats.nbUniqueIndices += indexCount;
     }
     meshIdx++;
   }
@@ -793,4 +886,580 @@ void GltfScene::checkRequiredExtensions(const tinygltf::Model& tmodel)
   }
 }
 
+//--------------------------------------------------------------------------------------------------
+// cgltf import path
+//--------------------------------------------------------------------------------------------------
+
+// Return the accessor of the attribute `type` (e.g. TEXCOORD_<index>), or nullptr
+static const cgltf_accessor* findAttribute(const cgltf_primitive& prim, cgltf_attribute_type type, cgltf_int index = 0)
+{
+  for(cgltf_size i = 0; i < prim.attributes_count; i++)
+  {
+    if(prim.attributes[i].type == type && prim.attributes[i].index == index)
+      return prim.attributes[i].data;
+  }
+  return nullptr;
+}
+
+// Converting `count` elements of `components` floats each, directly in the destination.
+// Normalized integers (KHR_mesh_quantization) and sparse accessors are handled by cgltf.
+// Return false if the attribute is missing
+static bool readAttribute(const cgltf_primitive& prim, cgltf_attribute_type type, float* out, size_t components, size_t count)
+{
+  const cgltf_accessor* accessor = findAttribute(prim, type);
+  if(accessor == nullptr || accessor->count < count)
+    return false;
+
+  size_t accessorComponents = cgltf_num_components(accessor->type);
+
+  // Plain float data is copied straight from the mapped buffer
+  if(accessorComponents == components && accessor->component_type == cgltf_component_type_r_32f && !accessor->is_sparse
+     && accessor->buffer_view != nullptr && accessor->buffer_view->buffer->data != nullptr)
+  {
+    const uint8_t* src = static_cast<const uint8_t*>(accessor->buffer_view->buffer->data) + accessor->buffer_view->offset + accessor->offset;
+    size_t         elemSize = components * sizeof(float);
+    if(accessor->stride == elemSize)
+    {
+      memcpy(out, src, count * elemSize);
+    }
+    else
+    {
+      for(size_t i = 0; i < count; i++)
+        memcpy(out + i * components, src + i * accessor->stride, elemSize);
+    }
+    return true;
+  }
+
+  if(accessorComponents == components)
+    return cgltf_accessor_unpack_floats(accessor, out, count * components) != 0;
+
+  // COLOR_0 can be a vec3, the missing components are set to one
+  for(size_t i = 0; i < count; i++)
+  {
+    float* elem = out + i * components;
+    std::fill(elem, elem + components, 1.f);
+    cgltf_accessor_read_float(accessor, i, elem, std::min(components, accessorComponents));
+  }
+  return true;
+}
+
+// Indices are read without going through cgltf_accessor_read_index for each element
+static void readIndices(const cgltf_accessor& accessor, uint32_t* out)
+{
+  if(accessor.is_sparse || accessor.buffer_view == nullptr || accessor.buffer_view->buffer->data == nullptr)
+  {
+    for(cgltf_size i = 0; i < accessor.count; i++)
+      out[i] = static_cast<uint32_t>(cgltf_accessor_read_index(&accessor, i));
+    return;
+  }
+
+  const uint8_t* src = static_cast<const uint8_t*>(accessor.buffer_view->buffer->data) + accessor.buffer_view->offset + accessor.offset;
+  switch(accessor.component_type)
+  {
+    case cgltf_component_type_r_32u:
+      if(accessor.stride == sizeof(uint32_t))
+      {
+        memcpy(out, src, accessor.count * sizeof(uint32_t));
+        break;
+      }
+      for(cgltf_size i = 0; i < accessor.count; i++)
+        memcpy(&out[i], src + i * accessor.stride, sizeof(uint32_t));
+      break;
+    case cgltf_component_type_r_16u:
+      for(cgltf_size i = 0; i < accessor.count; i++)
+      {
+        uint16_t index;
+        memcpy(&index, src + i * accessor.stride, sizeof(uint16_t));
+        out[i] = index;
+      }
+      break;
+    case cgltf_component_type_r_8u:
+      for(cgltf_size i = 0; i < accessor.count; i++)
+        out[i] = src[i * accessor.stride];
+      break;
+    default:
+      LOGE("Index component type %d not supported!\n", accessor.component_type);
+      std::fill(out, out + accessor.count, 0u);
+      break;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Loading the scene with cgltf.
+// The file and its external buffers are memory mapped and the accessors are converted straight
+// from the mapping. A first pass gives every primitive its range in the flat attribute arrays,
+// which are allocated once; the second pass converts the primitives in parallel, each one only
+// writing to its own range.
+//
+bool GltfScene::importCgltf(const std::string& filename, GltfAttributes attributes, uint32_t numThreads)
+{
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  // primMesh indices are used to address the converted primitives, they can't be appended to a scene
+  if(!m_primMeshes.empty() || !m_positions.empty())
+  {
+    LOGE("Could not import %s with cgltf: the scene is not empty\n", filename.c_str());
+    return false;
+  }
+
+  nvh::FileReadMapping fileMapping;
+  if(!fileMapping.open(filename.c_str()))
+  {
+    LOGE("Could not open %s\n", filename.c_str());
+    return false;
+  }
+
+  cgltf_options options{};
+  cgltf_data*   data{nullptr};
+  if(cgltf_parse(&options, fileMapping.data(), fileMapping.size(), &data) != cgltf_result_success)
+  {
+    LOGE("Could not parse %s\n", filename.c_str());
+    return false;
+  }
+
+  // Mapping the external .bin files, cgltf_load_buffers only loads what is left: the GLB
+  // chunk (already pointing in the mapping) and the data URIs.
+  std::string basePath;
+  size_t      slash = filename.find_last_of("/\\");
+  if(slash != std::string::npos)
+    basePath = filename.substr(0, slash + 1);
+
+  std::vector<std::unique_ptr<nvh::FileReadMapping>> bufferMappings(data->buffers_count);
+  for(cgltf_size i = 0; i < data->buffers_count; i++)
+  {
+    cgltf_buffer& buffer = data->buffers[i];
+    if(buffer.data != nullptr || buffer.uri == nullptr || strncmp(buffer.uri, "data:", 5) == 0 || strstr(buffer.uri, "://") != nullptr)
+      continue;
+
+    std::string uri(buffer.uri);
+    cgltf_decode_uri(&uri[0]);
+    uri.resize(strlen(uri.c_str()));
+
+    auto mapping = std::make_unique<nvh::FileReadMapping>();
+    if(mapping->open((basePath + uri).c_str()) && mapping->size() >= buffer.size)
+    {
+      buffer.data       = const_cast<void*>(mapping->data());
+      bufferMappings[i] = std::move(mapping);
+    }
+  }
+
+  // cgltf must not release the mapped buffers
+  auto freeData = [&]() {
+    for(cgltf_size i = 0; i < data->buffers_count; i++)
+    {
+      if(bufferMappings[i])
+        data->buffers[i].data = nullptr;
+    }
+    cgltf_free(data);
+  };
+
+  if(cgltf_load_buffers(&options, data, filename.c_str()) != cgltf_result_success || cgltf_validate(data) != cgltf_result_success)
+  {
+    LOGE("Could not load the buffers of %s\n", filename.c_str());
+    freeData();
+    return false;
+  }
+
+  importMaterials(data);
+
+  // First pass: the range of each primitive in the flat arrays.
+  // Primitives made of the same accessors share their range, only the first one converts it.
+  std::vector<const cgltf_primitive*>       primitives;
+  std::vector<uint32_t>                     vertexOwners;  // primMeshes converting the vertices
+  std::vector<uint32_t>                     indexOwners;   // primMeshes converting the indices
+  std::unordered_map<std::string, uint32_t> vertexCache;
+  std::unordered_map<const void*, uint32_t> indexCache;
+  uint32_t                                  nbVert{0};
+  uint32_t                                  nbIndex{0};
+  GltfStats                                 stats;  // Vertices and indices saved by sharing accessors
+  for(cgltf_size meshIdx = 0; meshIdx < data->meshes_count; meshIdx++)
+  {
+    const cgltf_mesh&     mesh = data->meshes[meshIdx];
+    std::vector<uint32_t> vprim;
+    for(cgltf_size primIdx = 0; primIdx < mesh.primitives_count; primIdx++)
+    {
+      const cgltf_primitive& prim        = mesh.primitives[primIdx];
+      const cgltf_accessor*  posAccessor = findAttribute(prim, cgltf_attribute_type_position);
+      if(prim.type != cgltf_primitive_type_triangles || posAccessor == nullptr)
+        continue;
+      if(prim.has_draco_mesh_compression)
+      {
+        LOGW("Draco compressed primitive of %s is skipped\n", mesh.name ? mesh.name : "");
+        continue;
+      }
+
+      GltfPrimMesh resultMesh;
+      resultMesh.name          = mesh.name ? mesh.name : "";
+      resultMesh.materialIndex = prim.material ? static_cast<int>(prim.material - data->materials) : 0;
+      resultMesh.vertexCount   = static_cast<uint32_t>(posAccessor->count);
+      resultMesh.indexCount    = static_cast<uint32_t>(prim.indices ? prim.indices->count : posAccessor->count);
+      if(posAccessor->has_min)
+        resultMesh.posMin = nvmath::vec3f(posAccessor->min[0], posAccessor->min[1], posAccessor->min[2]);
+      if(posAccessor->has_max)
+        resultMesh.posMax = nvmath::vec3f(posAccessor->max[0], posAccessor->max[1], posAccessor->max[2]);
+
+      uint32_t primMeshIdx = static_cast<uint32_t>(m_primMeshes.size());
+      stats.nbVertices += resultMesh.vertexCount;
+      stats.nbIndices += resultMesh.indexCount;
+
+      std::vector<std::pair<std::string, int>> attribs;
+      for(cgltf_size a = 0; a < prim.attributes_count; a++)
+        attribs.emplace_back(prim.attributes[a].name, static_cast<int>(prim.attributes[a].data - data->accessors));
+      std::string vertexKey = vertexAccessorKey(attribs, prim.indices ? static_cast<int>(prim.indices - data->accessors) : -1);
+
+      auto itVertex = vertexCache.find(vertexKey);
+      if(itVertex != vertexCache.end())
+      {
+        resultMesh.vertexOffset = m_primMeshes[itVertex->second].vertexOffset;
+      }
+      else
+      {
+        resultMesh.vertexOffset = nbVert;
+        nbVert += resultMesh.vertexCount;
+        vertexCache[vertexKey] = primMeshIdx;
+        vertexOwners.emplace_back(primMeshIdx);
+      }
+
+      // Indices are local to the primitive, they can be shared even if the vertices are not
+      auto itIndex = prim.indices ? indexCache.find(prim.indices) : indexCache.end();
+      if(itIndex != indexCache.end())
+      {
+        resultMesh.firstIndex = m_primMeshes[itIndex->second].firstIndex;
+      }
+      else
+      {
+        resultMesh.firstIndex = nbIndex;
+        nbIndex += resultMesh.indexCount;
+        if(prim.indices)
+          indexCache[prim.indices] = primMeshIdx;
+        indexOwners.emplace_back(primMeshIdx);
+      }
+
+      vprim.emplace_back(primMeshIdx);
+      m_primMeshes.emplace_back(resultMesh);
+      primitives.emplace_back(&prim);
+    }
+    m_meshToPrimMeshes[static_cast<int>(meshIdx)] = std::move(vprim);
+  }
+
+  m_positions.resize(nbVert);
+  m_indices.resize(nbIndex);
+  if((attributes & GltfAttributes::Normal) == GltfAttributes::Normal)
+    m_normals.resize(nbVert);
+  if((attributes & GltfAttributes::Texcoord_0) == GltfAttributes::Texcoord_0)
+    m_texcoords0.resize(nbVert);
+  if((attributes & GltfAttributes::Tangent) == GltfAttributes::Tangent)
+    m_tangents.resize(nbVert);
+  if((attributes & GltfAttributes::Color_0) == GltfAttributes::Color_0)
+    m_colors0.resize(nbVert);
+
+  // Second pass: converting the primitives, largest first to balance the threads.
+  // All indices are written before the vertices, which may be generated from indices
+  // converted by another primitive.
+  auto largestFirst = [&](uint32_t a, uint32_t b) {
+    return m_primMeshes[a].vertexCount + m_primMeshes[a].indexCount > m_primMeshes[b].vertexCount + m_primMeshes[b].indexCount;
+  };
+  std::sort(indexOwners.begin(), indexOwners.end(), largestFirst);
+  std::sort(vertexOwners.begin(), vertexOwners.end(), largestFirst);
+
+  if(numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::max(1u, std::min(numThreads, static_cast<uint32_t>(primitives.size())));
+
+  auto parallelFor = [numThreads](const std::vector<uint32_t>& items, const std::function<void(uint32_t)>& fct) {
+    std::atomic<size_t> next{0};
+    auto                worker = [&]() {
+      for(size_t i = next++; i < items.size(); i = next++)
+        fct(items[i]);
+    };
+    std::vector<std::thread> threads;
+    for(uint32_t t = 1; t < numThreads; t++)
+      threads.emplace_back(worker);
+    worker();
+    for(auto& thread : threads)
+      thread.join();
+  };
+
+  parallelFor(indexOwners, [&](uint32_t primMeshIdx) {
+    const GltfPrimMesh& primMesh = m_primMeshes[primMeshIdx];
+    uint32_t*           indices  = &m_indices[primMesh.firstIndex];
+    if(primitives[primMeshIdx]->indices)
+      readIndices(*primitives[primMeshIdx]->indices, indices);
+    else
+      std::iota(indices, indices + primMesh.indexCount, 0u);
+  });
+  parallelFor(vertexOwners, [&](uint32_t primMeshIdx) {
+    processMesh(*primitives[primMeshIdx], m_primMeshes[primMeshIdx], attributes);
+  });
+
+  // Transforming the scene hierarchy to a flat list
+  const cgltf_scene* scene = data->scene ? data->scene : (data->scenes_count > 0 ? &data->scenes[0] : nullptr);
+  if(scene)
+  {
+    for(cgltf_size i = 0; i < scene->nodes_count; i++)
+      processNode(data, scene->nodes[i], nvmath::mat4f(1));
+  }
+  else
+  {
+    for(cgltf_size i = 0; i < data->nodes_count; i++)
+    {
+      if(data->nodes[i].parent == nullptr)
+        processNode(data, &data->nodes[i], nvmath::mat4f(1));
+    }
+  }
+
+  computeSceneDimensions();
+  computeCamera();
+
+  m_meshToPrimMeshes.clear();
+  freeData();
+
+  auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+  stats.nbUniqueVertices = nbVert;
+  stats.nbUniqueIndices  = nbIndex;
+  LOGI("Loaded %s with cgltf: %u primitives, %u vertices (%u unique), %u indices (%u unique) in %.1f ms (%u threads)\n",
+       filename.c_str(), static_cast<uint32_t>(m_primMeshes.size()), stats.nbVertices, stats.nbUniqueVertices,
+       stats.nbIndices, stats.nbUniqueIndices, elapsed, numThreads);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Collect the value of all materials (cgltf)
+//
+void GltfScene::importMaterials(const cgltf_data* data)
+{
+  auto texIndex = [&](const cgltf_texture_view& view) {
+    return view.texture ? static_cast<int>(view.texture - data->textures) : -1;
+  };
+
+  m_materials.reserve(data->materials_count);
+
+  for(cgltf_size i = 0; i < data->materials_count; i++)
+  {
+    const cgltf_material& cmat = data->materials[i];
+    GltfMaterial          gmat;
+
+    gmat.alphaCutoff              = cmat.alpha_cutoff;
+    gmat.alphaMode                = cmat.alpha_mode == cgltf_alpha_mode_mask ? 1 : (cmat.alpha_mode == cgltf_alpha_mode_blend ? 2 : 0);
+    gmat.doubleSided              = cmat.double_sided ? 1 : 0;
+    gmat.emissiveFactor           = nvmath::vec3f(cmat.emissive_factor[0], cmat.emissive_factor[1], cmat.emissive_factor[2]);
+    gmat.emissiveTexture          = texIndex(cmat.emissive_texture);
+    gmat.normalTexture            = texIndex(cmat.normal_texture);
+    gmat.normalTextureScale       = cmat.normal_texture.scale;
+    gmat.occlusionTexture         = texIndex(cmat.occlusion_texture);
+    gmat.occlusionTextureStrength = cmat.occlusion_texture.scale;
+
+    // PbrMetallicRoughness
+    if(cmat.has_pbr_metallic_roughness)
+    {
+      const auto& cpbr = cmat.pbr_metallic_roughness;
+      gmat.baseColorFactor =
+          nvmath::vec4f(cpbr.base_color_factor[0], cpbr.base_color_factor[1], cpbr.base_color_factor[2], cpbr.base_color_factor[3]);
+      gmat.baseColorTexture         = texIndex(cpbr.base_color_texture);
+      gmat.metallicFactor           = cpbr.metallic_factor;
+      gmat.metallicRoughnessTexture = texIndex(cpbr.metallic_roughness_texture);
+      gmat.roughnessFactor          = cpbr.roughness_factor;
+
+      // KHR_texture_transform
+      if(cpbr.base_color_texture.has_transform)
+      {
+        const auto& ctt = cpbr.base_color_texture.transform;
+        auto&       tt  = gmat.textureTransform;
+        tt.offset       = nvmath::vec2f(ctt.offset[0], ctt.offset[1]);
+        tt.scale        = nvmath::vec2f(ctt.scale[0], ctt.scale[1]);
+        tt.rotation     = ctt.rotation;
+        tt.texCoord     = ctt.texcoord;
+
+        // Computing the transformation
+        mat3 translation = mat3(1, 0, tt.offset.x, 0, 1, tt.offset.y, 0, 0, 1);
+        mat3 rotation    = mat3(cos(tt.rotation), sin(tt.rotation), 0, -sin(tt.rotation), cos(tt.rotation), 0, 0, 0, 1);
+        mat3 scale       = mat3(tt.scale.x, 0, 0, 0, tt.scale.y, 0, 0, 0, 1);
+        tt.uvTransform   = scale * rotation * translation;
+      }
+    }
+
+    // KHR_materials_pbrSpecularGlossiness
+    if(cmat.has_pbr_specular_glossiness)
+    {
+      gmat.shadingModel = 1;
+
+      const auto& csg = cmat.pbr_specular_glossiness;
+      gmat.specularGlossiness.diffuseFactor =
+          nvmath::vec4f(csg.diffuse_factor[0], csg.diffuse_factor[1], csg.diffuse_factor[2], csg.diffuse_factor[3]);
+      gmat.specularGlossiness.glossinessFactor = csg.glossiness_factor;
+      gmat.specularGlossiness.specularFactor = nvmath::vec3f(csg.specular_factor[0], csg.specular_factor[1], csg.specular_factor[2]);
+      gmat.specularGlossiness.diffuseTexture = texIndex(csg.diffuse_texture);
+      gmat.specularGlossiness.specularGlossinessTexture = texIndex(csg.specular_glossiness_texture);
+    }
+
+    // KHR_materials_unlit
+    if(cmat.unlit)
+    {
+      gmat.unlit.active = 1;
+    }
+
+    // KHR_materials_clearcoat
+    if(cmat.has_clearcoat)
+    {
+      gmat.clearcoat.factor           = cmat.clearcoat.clearcoat_factor;
+      gmat.clearcoat.texture          = texIndex(cmat.clearcoat.clearcoat_texture);
+      gmat.clearcoat.roughnessFactor  = cmat.clearcoat.clearcoat_roughness_factor;
+      gmat.clearcoat.roughnessTexture = texIndex(cmat.clearcoat.clearcoat_roughness_texture);
+      gmat.clearcoat.normalTexture    = texIndex(cmat.clearcoat.clearcoat_normal_texture);
+    }
+
+    // The other material extensions are not parsed by this version of cgltf
+
+    m_materials.emplace_back(gmat);
+  }
+
+  // Make default
+  if(m_materials.empty())
+  {
+    GltfMaterial gmat;
+    gmat.metallicFactor = 0;
+    m_materials.emplace_back(gmat);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Linearize the scene graph (cgltf)
+//
+void GltfScene::processNode(const cgltf_data* data, const cgltf_node* node, const nvmath::mat4f& parentMatrix)
+{
+  nvmath::mat4f matrix{1};
+  cgltf_node_transform_local(node, matrix.mat_array);
+  nvmath::mat4f worldMatrix = parentMatrix * matrix;
+
+  if(node->mesh)
+  {
+    const auto& meshes = m_meshToPrimMeshes[static_cast<int>(node->mesh - data->meshes)];
+    for(const auto& mesh : meshes)
+    {
+      GltfNode gnode;
+      gnode.primMesh    = mesh;
+      gnode.worldMatrix = worldMatrix;
+      m_nodes.emplace_back(gnode);
+    }
+  }
+  else if(node->camera)
+  {
+    const cgltf_camera& ccam = *node->camera;
+    GltfCamera          camera;
+    camera.worldMatrix = worldMatrix;
+    camera.cam.name    = ccam.name ? ccam.name : "";
+    if(ccam.type == cgltf_camera_type_orthographic)
+    {
+      camera.cam.type               = "orthographic";
+      camera.cam.orthographic.xmag  = ccam.data.orthographic.xmag;
+      camera.cam.orthographic.ymag  = ccam.data.orthographic.ymag;
+      camera.cam.orthographic.zfar  = ccam.data.orthographic.zfar;
+      camera.cam.orthographic.znear = ccam.data.orthographic.znear;
+    }
+    else
+    {
+      camera.cam.type                    = "perspective";
+      camera.cam.perspective.aspectRatio = ccam.data.perspective.aspect_ratio;
+      camera.cam.perspective.yfov        = ccam.data.perspective.yfov;
+      camera.cam.perspective.zfar        = ccam.data.perspective.zfar;
+      camera.cam.perspective.znear       = ccam.data.perspective.znear;
+    }
+    m_cameras.emplace_back(camera);
+  }
+  else if(node->light)
+  {
+    const cgltf_light& clight = *node->light;
+    GltfLight          light;
+    light.worldMatrix = worldMatrix;
+    light.light.name  = clight.name ? clight.name : "";
+    light.light.color = {clight.color[0], clight.color[1], clight.color[2]};
+    light.light.intensity = clight.intensity;
+    light.light.range     = clight.range;
+    light.light.type = clight.type == cgltf_light_type_directional ? "directional" : (clight.type == cgltf_light_type_spot ? "spot" : "point");
+    light.light.spot.innerConeAngle = clight.spot_inner_cone_angle;
+    light.light.spot.outerConeAngle = clight.spot_outer_cone_angle;
+    m_lights.emplace_back(light);
+  }
+
+  // Recursion for all children
+  for(cgltf_size i = 0; i < node->children_count; i++)
+  {
+    processNode(data, node->children[i], worldMatrix);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Converting the vertices of one primitive in its preallocated range (cgltf).
+// Called concurrently, must only write inside [vertexOffset, +vertexCount)
+//
+void GltfScene::processMesh(const cgltf_primitive& prim, const GltfPrimMesh& resultMesh, GltfAttributes attributes)
+{
+  const uint32_t vertexCount = resultMesh.vertexCount;
+
+  // INDICES, already converted
+  const uint32_t* indices = &m_indices[resultMesh.firstIndex];
+
+  // POSITION
+  nvmath::vec3f* positions = &m_positions[resultMesh.vertexOffset];
+  readAttribute(prim, cgltf_attribute_type_position, &positions->x, 3, vertexCount);
+
+  bool needTangents = (attributes & GltfAttributes::Tangent) == GltfAttributes::Tangent;
+
+  // NORMAL (also needed to generate the tangents)
+  std::vector<nvmath::vec3f> tmpNormals;
+  nvmath::vec3f*             normals = nullptr;
+  if((attributes & GltfAttributes::Normal) == GltfAttributes::Normal)
+  {
+    normals = &m_normals[resultMesh.vertexOffset];
+  }
+  else if(needTangents && findAttribute(prim, cgltf_attribute_type_tangent) == nullptr)
+  {
+    tmpNormals.resize(vertexCount);
+    normals = tmpNormals.data();
+  }
+  if(normals && !readAttribute(prim, cgltf_attribute_type_normal, &normals->x, 3, vertexCount))
+  {
+    computeNormals(indices, resultMesh.indexCount, positions, vertexCount, normals);
+  }
+
+  // TEXCOORD_0 (also needed to generate the tangents)
+  std::vector<nvmath::vec2f> tmpTexcoords;
+  nvmath::vec2f*             texcoords = nullptr;
+  if((attributes & GltfAttributes::Texcoord_0) == GltfAttributes::Texcoord_0)
+  {
+    texcoords = &m_texcoords0[resultMesh.vertexOffset];
+  }
+  else if(needTangents && findAttribute(prim, cgltf_attribute_type_tangent) == nullptr)
+  {
+    tmpTexcoords.resize(vertexCount);
+    texcoords = tmpTexcoords.data();
+  }
+  if(texcoords && !readAttribute(prim, cgltf_attribute_type_texcoord, &texcoords->x, 2, vertexCount))
+  {
+    computeCubeTexcoords(positions, vertexCount, texcoords);
+  }
+
+  // TANGENT
+  if(needTangents)
+  {
+    nvmath::vec4f* tangents = &m_tangents[resultMesh.vertexOffset];
+    if(!readAttribute(prim, cgltf_attribute_type_tangent, &tangents->x, 4, vertexCount))
+    {
+      computeTangents(indices, resultMesh.indexCount, positions, normals, texcoords, vertexCount, tangents);
+    }
+  }
+
+  // COLOR_0
+  if((attributes & GltfAttributes::Color_0) == GltfAttributes::Color_0)
+  {
+    nvmath::vec4f* colors = &m_colors0[resultMesh.vertexOffset];
+    if(!readAttribute(prim, cgltf_attribute_type_color, &colors->x, 4, vertexCount))
+    {
+      // Set them all to one
+      std::fill(colors, colors + vertexCount, nvmath::vec4f(1, 1, 1, 1));
+    }
+  }
+}
+
+
 }  // namespace nvh
@@ -51,6 +51,14 @@
   //   create descriptorSet for material using directly gltfScene.m_materials
   ~~~
 
+  The geometry can also be loaded without tinygltf, the buffers being memory
+  mapped and the primitives converted in parallel. Images still have to be
+  loaded separately.
+
+  ~~~ C++
+  gltfScene.importCgltf(m_filename, GltfAttributes::Normal | GltfAttributes::Texcoord_0);
+  ~~~
+
 */
 
 #pragma once
@@ -64,6 +72,10 @@
 #include <unordered_map>
 #include <vector>
 
+struct cgltf_data;
+struct cgltf_node;
+struct cgltf_primitive;
+
 using namespace nvmath;
 #define KHR_LIGHTS_PUNCTUAL_EXTENSION_NAME "KHR_lights_punctual"
 
@@ -223,6 +235,10 @@ struct GltfStats
   uint32_t imageMem{0};
   uint32_t nbUniqueTriangles{0};
   uint32_t nbTriangles{0};
+  uint32_t nbVertices{0};        // Sum over all primitives
+  uint32_t nbUniqueVertices{0};  // Primitives sharing accessors share vertices
+  uint32_t nbIndices{0};
+  uint32_t nbUniqueIndices{0};
 };
 
 struct GltfCamera
@@ -276,6 +292,12 @@ struct GltfScene
   void computeSceneDimensions();
   void destroy();
 
+  // Alternative to importMaterials + importDrawableNodes, loading the file with cgltf.
+  // The .glb/.bin buffers are memory mapped instead of copied, and the primitives are
+  // converted on `numThreads` threads (0: hardware concurrency). Returns false if the scene
+  // is not empty.
+  bool importCgltf(const std::string& filename, GltfAttributes attributes, uint32_t numThreads = 0);
+
   static GltfStats getStatistics(const tinygltf::Model& tinyModel);
 
   // Scene data
@@ -313,9 +335,16 @@ struct GltfScene
 private:
   void          processNode(const tinygltf::Model& tmodel, int& nodeIdx, const nvmath::mat4f& parentMatrix);
   void          processMesh(const tinygltf::Model& tmodel, const tinygltf::Primitive& tmesh, GltfAttributes attributes, const std::string& name);
+
+  // cgltf import path
+  void importMaterials(const cgltf_data* data);
+  void processNode(const cgltf_data* data, const cgltf_node* node, const nvmath::mat4f& parentMatrix);
+  void processMesh(const cgltf_primitive& prim, const GltfPrimMesh& resultMesh, GltfAttributes attributes);
   
   // Temporary data
   std::unordered_map<int, std::vector<uint32_t>> m_meshToPrimMeshes;
+  std::unordered_map<std::string, uint32_t>      m_cacheVertices;  // vertex accessors -> first primMesh using them
+  std::unordered_map<int, uint32_t>              m_cacheIndices;   // index accessor -> first primMesh using it
   std::vector<uint32_t>                          primitiveIndices32u;
   std::vector<uint16_t>                          primitiveIndices16u;
   std::vector<uint8_t>                           primitiveIndices8u;
@@ -35,6 +35,7 @@ extern std::vector<std::string> defaultSearchPaths;
 #include "obj_loader.h"
 
 #include "hello_vulkan.h"
+#include "triangle_opacity.h"
 #include "nvh//cameramanipulator.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
 #include "nvvk/pipeline_vk.hpp"
@@ -254,15 +255,23 @@ void HelloVulkan::loadModel(const std::string& filename, nvmath::mat4f transform
     m.specular = nvmath::pow(m.specular, 2.2f);
   }
 
+  // Opaque triangles first, then the ones the any hit shader has to test. The
+  // transparent ones come last and are left out of the BLAS.
+  TriangleOpacityRanges ranges =
+      sortTrianglesByOpacity(loader.m_indices, loader.m_matIndx, loader.m_materials);
+
   ObjInstance instance;
-  instance.objIndex    = static_cast<uint32_t>(m_objModel.size());
-  instance.transform   = transform;
-  instance.transformIT = nvmath::transpose(nvmath::invert(transform));
-  instance.txtOffset   = static_cast<uint32_t>(m_textures.size());
+  instance.objIndex          = static_cast<uint32_t>(m_objModel.size());
+  instance.transform         = transform;
+  instance.transformIT       = nvmath::transpose(nvmath::invert(transform));
+  instance.txtOffset         = static_cast<uint32_t>(m_textures.size());
+  instance.nbOpaqueTriangles = ranges.opaqueCount;
 
   ObjModel model;
-  model.nbIndices  = static_cast<uint32_t>(loader.m_indices.size());
-  model.nbVertices = static_cast<uint32_t>(loader.m_vertices.size());
+  model.nbIndices         = static_cast<uint32_t>(loader.m_indices.size());
+  model.nbVertices        = static_cast<uint32_t>(loader.m_vertices.size());
+  model.nbOpaqueTriangles = ranges.opaqueCount;
+  model.nbAnyHitTriangles = ranges.needsTestCount;
 
   // Create the buffers on Device and copy vertices, indices and materials
   nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
@@ -677,20 +686,35 @@ nvvk::RaytracingBuilderKHR::BlasInput HelloVulkan::objectToVkGeometryKHR(const O
   triangles.setTransformData({});
   triangles.setMaxVertex(model.nbVertices);
 
-  vk::AccelerationStructureGeometryKHR asGeom;
-  asGeom.setGeometryType(vk::GeometryTypeKHR::eTriangles);
-  asGeom.setFlags(vk::GeometryFlagBitsKHR::eNoDuplicateAnyHitInvocation);  // Avoid double hits
-  asGeom.geometry.setTriangles(triangles);
-
-  vk::AccelerationStructureBuildRangeInfoKHR offset;
-  offset.setFirstVertex(0);
-  offset.setPrimitiveCount(model.nbIndices / 3);
-  offset.setPrimitiveOffset(0);
-  offset.setTransformOffset(0);
-
+  // Geometry 0: opaque triangles, the any hit shader is never called on them.
+  // Geometry 1: triangles with a partial dissolve, gl_PrimitiveID starts back at 0 and is
+  // offset by sceneDesc.nbOpaqueTriangles in the shaders.
+  // Fully transparent triangles would never be hit and are not added.
   nvvk::RaytracingBuilderKHR::BlasInput input;
-  input.asGeometry.emplace_back(asGeom);
-  input.asBuildOffsetInfo.emplace_back(offset);
+  auto addGeometry = [&](vk::GeometryFlagsKHR flags, uint32_t firstTriangle, uint32_t nbTriangles) {
+    if(nbTriangles == 0)
+      return;
+    vk::AccelerationStructureGeometryKHR asGeom;
+    asGeom.setGeometryType(vk::GeometryTypeKHR::eTriangles);
+    asGeom.setFlags(flags);
+    asGeom.geometry.setTriangles(triangles);
+
+    vk::AccelerationStructureBuildRangeInfoKHR offset;
+    offset.setFirstVertex(0);
+    offset.setPrimitiveCount(nbTriangles);
+    offset.setPrimitiveOffset(firstTriangle * 3 * sizeof(uint32_t));
+    offset.setTransformOffset(0);
+
+    input.asGeometry.emplace_back(asGeom);
+    input.asBuildOffsetInfo.emplace_back(offset);
+  };
+  addGeometry(vk::GeometryFlagBitsKHR::eOpaque, 0, model.nbOpaqueTriangles);
+  addGeometry(vk::GeometryFlagBitsKHR::eNoDuplicateAnyHitInvocation,  // Avoid double hits
+              model.nbOpaqueTriangles, model.nbAnyHitTriangles);
+  // A BLAS needs a geometry: keep the transparent triangles, the any hit shader ignores them
+  if(input.asGeometry.empty())
+    addGeometry(vk::GeometryFlagBitsKHR::eNoDuplicateAnyHitInvocation, model.nbOpaqueTriangles,
+                model.nbIndices / 3 - model.nbOpaqueTriangles);
   return input;
 }
 
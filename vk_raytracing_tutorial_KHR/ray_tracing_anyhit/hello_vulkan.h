@@ -67,6 +67,8 @@ public:
   {
     uint32_t     nbIndices{0};
     uint32_t     nbVertices{0};
+    uint32_t     nbOpaqueTriangles{0};   // First triangles of the index buffer, any hit skipped
+    uint32_t     nbAnyHitTriangles{0};   // Following triangles, tested in the any hit shader
     nvvk::Buffer vertexBuffer;    // Device buffer of all 'Vertex'
     nvvk::Buffer indexBuffer;     // Device buffer of the indices forming triangles
     nvvk::Buffer matColorBuffer;  // Device buffer of array of 'Wavefront material'
@@ -80,6 +82,7 @@ public:
     uint32_t      txtOffset{0};    // Offset in `m_textures`
     nvmath::mat4f transform{1};    // Position of the instance
     nvmath::mat4f transformIT{1};  // Inverse transpose
+    uint32_t      nbOpaqueTriangles{0};  // Of the model, to offset gl_PrimitiveID of geometry 1
   };
 
   // Information pushed at each draw call
@@ -30,12 +30,14 @@
 // at the top of imgui.cpp.
 
 #include <array>
+#include <cstring>
 #include <vulkan/vulkan.hpp>
 
 #include "imgui.h"
 #include "imgui/backends/imgui_impl_glfw.h"
 
 #include "hello_vulkan.h"
+#include "triangle_opacity.h"
 #include "imgui/extras/imgui_camera_widget.h"
 #include "nvh/cameramanipulator.hpp"
 #include "nvh/fileoperations.hpp"
@@ -85,7 +87,23 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
+  // -opacity [file.obj]: check the triangle opacity sort on the scenes and exit.
+  for(int i = 1; i < argc; ++i)
+  {
+    if(strcmp(argv[i], "-opacity") == 0)
+    {
+      std::vector<std::string> searchPaths = {NVPSystem::exePath() + PROJECT_RELDIRECTORY,
+                                              NVPSystem::exePath() + PROJECT_RELDIRECTORY ".."};
+      std::vector<std::string> files = {"media/scenes/wuson.obj", "media/scenes/sphere.obj",
+                                        "media/scenes/plane.obj"};
+      if(i + 1 < argc)
+        files = {argv[i + 1]};
+      bool ok = true;
+      for(const auto& file : files)
+        ok = checkTriangleOpacity(nvh::findFile(file, searchPaths, true)) && ok;
+      return ok ? 0 : 1;
+    }
+  }
 
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
@@ -26,13 +26,15 @@ void main()
 {
   // Object of this instance
   uint objId = scnDesc.i[gl_InstanceCustomIndexEXT].objId;
+  // Only the triangles after the opaque ones have an any hit
+  int primId = gl_PrimitiveID + scnDesc.i[gl_InstanceCustomIndexEXT].nbOpaqueTriangles;
   // Indices of the triangle
-  uint ind = indices[nonuniformEXT(objId)].i[3 * gl_PrimitiveID + 0];
+  uint ind = indices[nonuniformEXT(objId)].i[3 * primId + 0];
   // Vertex of the triangle
   Vertex v0 = vertices[nonuniformEXT(objId)].v[ind.x];
 
   // Material of the object
-  int               matIdx = matIndex[nonuniformEXT(objId)].i[gl_PrimitiveID];
+  int               matIdx = matIndex[nonuniformEXT(objId)].i[primId];
   WaveFrontMaterial mat    = materials[nonuniformEXT(objId)].m[matIdx];
 
   if(mat.illum != 4)
@@ -26,6 +26,7 @@ struct sceneDesc
   int  txtOffset;
   mat4 transfo;
   mat4 transfoIT;
+  int  nbOpaqueTriangles;  // Triangles of the BLAS geometry 0, see objectToVkGeometryKHR
 };
 
 
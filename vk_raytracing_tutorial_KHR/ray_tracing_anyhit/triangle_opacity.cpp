@@ -0,0 +1,211 @@
+/* Copyright (c) 2014-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <tuple>
+
+#include "triangle_opacity.h"
+
+// Triangles per work item
+static const uint32_t CHUNK_SIZE = 1 << 14;
+
+static uint32_t getChunkCount(size_t count)
+{
+  return static_cast<uint32_t>((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+// Calls `fct(chunk)` for each chunk, spread over the threads.
+static void forEachChunk(uint32_t nbChunks, uint32_t numThreads, const std::function<void(uint32_t)>& fct)
+{
+  if(numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, nbChunks);
+  if(numThreads <= 1)
+  {
+    for(uint32_t chunk = 0; chunk < nbChunks; ++chunk)
+      fct(chunk);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  for(uint32_t t = 0; t < numThreads; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      for(uint32_t chunk = t; chunk < nbChunks; chunk += numThreads)
+        fct(chunk);
+    });
+  }
+  for(auto& thread : threads)
+    thread.join();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Mirrors raytrace_rahit.glsl: hits are ignored if rnd() > dissolve, rnd() being in [0,1).
+//
+TriangleOpacity classifyMaterial(const MaterialObj& mat)
+{
+  if(mat.illum != 4 || mat.dissolve >= 1.f)
+    return TriangleOpacity::eOpaque;
+  if(mat.dissolve <= 0.f)
+    return TriangleOpacity::eTransparent;
+  return TriangleOpacity::eNeedsTest;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Counting sort: each chunk counts its triangles per class, the prefix sums over the
+// chunks give where each chunk writes its triangles of each class.
+//
+TriangleOpacityRanges sortTrianglesByOpacity(std::vector<uint32_t>&          indices,
+                                             std::vector<int32_t>&           matIndx,
+                                             const std::vector<MaterialObj>& materials,
+                                             uint32_t                        numThreads)
+{
+  const uint32_t nbTriangles = static_cast<uint32_t>(indices.size() / 3);
+  const uint32_t nbChunks    = getChunkCount(nbTriangles);
+
+  // Classes of the materials. A triangle with an unknown material keeps the test.
+  std::vector<TriangleOpacity> materialClass(materials.size());
+  for(size_t m = 0; m < materials.size(); ++m)
+    materialClass[m] = classifyMaterial(materials[m]);
+  auto getClass = [&](uint32_t triangle) {
+    int32_t m = matIndx[triangle];
+    return (m >= 0 && m < int32_t(materialClass.size())) ? materialClass[m] : TriangleOpacity::eNeedsTest;
+  };
+
+  std::vector<TriangleOpacity>         classes(nbTriangles);
+  std::vector<std::array<uint32_t, 3>> chunkCounts(nbChunks);
+  forEachChunk(nbChunks, numThreads, [&](uint32_t chunk) {
+    std::array<uint32_t, 3> counts{};
+    uint32_t                end = std::min(nbTriangles, (chunk + 1) * CHUNK_SIZE);
+    for(uint32_t t = chunk * CHUNK_SIZE; t < end; ++t)
+    {
+      classes[t] = getClass(t);
+      counts[static_cast<size_t>(classes[t])]++;
+    }
+    chunkCounts[chunk] = counts;
+  });
+
+  TriangleOpacityRanges   ranges;
+  std::array<uint32_t, 3> classStart{};
+  for(const auto& counts : chunkCounts)
+  {
+    ranges.opaqueCount += counts[0];
+    ranges.needsTestCount += counts[1];
+    ranges.transparentCount += counts[2];
+  }
+  classStart[1] = ranges.opaqueCount;
+  classStart[2] = ranges.opaqueCount + ranges.needsTestCount;
+
+  std::vector<std::array<uint32_t, 3>> chunkStart(nbChunks);
+  for(uint32_t chunk = 0; chunk < nbChunks; ++chunk)
+  {
+    chunkStart[chunk] = classStart;
+    for(size_t c = 0; c < 3; ++c)
+      classStart[c] += chunkCounts[chunk][c];
+  }
+
+  std::vector<uint32_t> sortedIndices(indices.size());
+  std::vector<int32_t>  sortedMatIndx(matIndx.size());
+  forEachChunk(nbChunks, numThreads, [&](uint32_t chunk) {
+    std::array<uint32_t, 3> next = chunkStart[chunk];
+    uint32_t                end  = std::min(nbTriangles, (chunk + 1) * CHUNK_SIZE);
+    for(uint32_t t = chunk * CHUNK_SIZE; t < end; ++t)
+    {
+      uint32_t dst = next[static_cast<size_t>(classes[t])]++;
+      std::copy_n(indices.begin() + 3 * size_t(t), 3, sortedIndices.begin() + 3 * size_t(dst));
+      sortedMatIndx[dst] = matIndx[t];
+    }
+  });
+
+  indices.swap(sortedIndices);
+  matIndx.swap(sortedMatIndx);
+  return ranges;
+}
+
+//--------------------------------------------------------------------------------------------------
+// CPU check of sortTrianglesByOpacity on a scene, see triangle_opacity.h
+//
+bool checkTriangleOpacity(const std::string& filename)
+{
+  using Clock = std::chrono::high_resolution_clock;
+
+  ObjLoader loader;
+  loader.loadModel(filename);
+  const uint32_t nbTriangles = static_cast<uint32_t>(loader.m_indices.size() / 3);
+
+  // Sorted triangles, to compare the sets before and after
+  using Triangle     = std::tuple<uint32_t, uint32_t, uint32_t, int32_t>;
+  auto getTriangles  = [&](const std::vector<uint32_t>& indices, const std::vector<int32_t>& matIndx) {
+    std::vector<Triangle> triangles(nbTriangles);
+    for(uint32_t t = 0; t < nbTriangles; ++t)
+      triangles[t] = {indices[3 * t], indices[3 * t + 1], indices[3 * t + 2], matIndx[t]};
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+  };
+  std::vector<Triangle> before = getTriangles(loader.m_indices, loader.m_matIndx);
+
+  std::vector<uint32_t> indices1 = loader.m_indices;
+  std::vector<int32_t>  matIndx1 = loader.m_matIndx;
+  auto                  start    = Clock::now();
+  TriangleOpacityRanges ranges1  = sortTrianglesByOpacity(indices1, matIndx1, loader.m_materials, 1);
+  double                ms1 = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  std::vector<uint32_t> indices = loader.m_indices;
+  std::vector<int32_t>  matIndx = loader.m_matIndx;
+  start                         = Clock::now();
+  TriangleOpacityRanges ranges  = sortTrianglesByOpacity(indices, matIndx, loader.m_materials, 0);
+  double                ms      = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  bool sameResult = indices == indices1 && matIndx == matIndx1 && ranges.opaqueCount == ranges1.opaqueCount
+                    && ranges.needsTestCount == ranges1.needsTestCount
+                    && ranges.transparentCount == ranges1.transparentCount;
+  bool sameTriangles = getTriangles(indices, matIndx) == before;
+
+  uint32_t misplaced = 0;
+  for(uint32_t t = 0; t < nbTriangles; ++t)
+  {
+    TriangleOpacity expected = t < ranges.opaqueCount ? TriangleOpacity::eOpaque :
+                               t < ranges.opaqueCount + ranges.needsTestCount ? TriangleOpacity::eNeedsTest :
+                                                                                TriangleOpacity::eTransparent;
+    int32_t m = matIndx[t];
+    TriangleOpacity actual = (m >= 0 && m < int32_t(loader.m_materials.size())) ?
+                                 classifyMaterial(loader.m_materials[m]) :
+                                 TriangleOpacity::eNeedsTest;
+    misplaced += actual != expected;
+  }
+
+  bool ok = sameResult && sameTriangles && misplaced == 0
+            && ranges.opaqueCount + ranges.needsTestCount + ranges.transparentCount == nbTriangles;
+  printf("%s: %u triangles, %u opaque, %u need the any hit test, %u transparent, "
+         "sorted in %.2f ms (1 thread) / %.2f ms%s\n",
+         filename.c_str(), nbTriangles, ranges.opaqueCount, ranges.needsTestCount,
+         ranges.transparentCount, ms1, ms, ok ? "" : "  FAILED");
+  return ok;
+}
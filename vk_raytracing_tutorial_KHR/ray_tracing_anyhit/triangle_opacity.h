@@ -0,0 +1,71 @@
+/* Copyright (c) 2014-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "obj_loader.h"
+
+// What the any hit shader (raytrace_rahit.glsl) does with the hits on a triangle.
+// The values are the order of the triangles once sorted.
+enum class TriangleOpacity : uint8_t
+{
+  eOpaque,       // Every hit is accepted: illum != 4, or dissolve >= 1.
+  eNeedsTest,    // Hits are accepted with probability dissolve.
+  eTransparent,  // Every hit is ignored: dissolve <= 0.
+};
+
+TriangleOpacity classifyMaterial(const MaterialObj& mat);
+
+// Number of triangles of each class, in the order they are stored after sorting.
+struct TriangleOpacityRanges
+{
+  uint32_t opaqueCount{0};
+  uint32_t needsTestCount{0};
+  uint32_t transparentCount{0};
+};
+
+//--------------------------------------------------------------------------------------------------
+// Reorders the triangles of `indices` and their entry in `matIndx` (one per triangle, as
+// filled by ObjLoader) so that opaque triangles come first, then the ones needing the any
+// hit test, then the transparent ones. The order within each class is kept, and the result
+// does not depend on the number of threads (0 uses all the cores).
+//
+// The opaque range can then be built as a geometry flagged eOpaque, skipping the any hit
+// shader, and the transparent range left out of the acceleration structure: none of its
+// hits would be accepted.
+//
+TriangleOpacityRanges sortTrianglesByOpacity(std::vector<uint32_t>&          indices,
+                                             std::vector<int32_t>&           matIndx,
+                                             const std::vector<MaterialObj>& materials,
+                                             uint32_t                        numThreads = 0);
+
+// Loads `filename`, sorts its triangles with one thread and with all cores and checks that
+// both results are the same, that every triangle is in the range of its class and that no
+// triangle was lost. Prints the counts and timings, returns false if a check fails.
+bool checkTriangleOpacity(const std::string& filename);
@@ -0,0 +1,384 @@
+/* Copyright (c) 2014-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <thread>
+
+#include "ao_upsample.h"
+
+// Same constants as aocommon.glsl
+static const float AO_PLANE_SIGMA  = 0.05f;
+static const float AO_NORMAL_POWER = 32.0f;
+static const float AO_MIN_WEIGHT   = 1e-3f;
+
+// Calls `fct(chunk)` for each chunk, spread over the threads.
+static void forEachChunk(uint32_t nbChunks, uint32_t numThreads, const std::function<void(uint32_t)>& fct)
+{
+  if(numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, nbChunks);
+  if(numThreads <= 1)
+  {
+    for(uint32_t chunk = 0; chunk < nbChunks; ++chunk)
+      fct(chunk);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  for(uint32_t t = 0; t < numThreads; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      for(uint32_t chunk = t; chunk < nbChunks; chunk += numThreads)
+        fct(chunk);
+    });
+  }
+  for(auto& thread : threads)
+    thread.join();
+}
+
+static bool isRendered(const AoGBuffer& gBuffer, size_t pixel)
+{
+  const nvmath::vec3f& n = gBuffer.normals[pixel];
+  return n.x != 0.f || n.y != 0.f || n.z != 0.f;
+}
+
+uint32_t getAoLowResSize(uint32_t size, uint32_t downscale)
+{
+  return (size + downscale - 1) / downscale;
+}
+
+void getAoRepresentative(uint32_t bx, uint32_t by, uint32_t downscale, uint32_t width, uint32_t height, uint32_t& x, uint32_t& y)
+{
+  uint32_t offset = ((bx + by) & 1) == 1 ? downscale / 2 : 0;
+  x               = std::min(bx * downscale + offset, width - 1);
+  y               = std::min(by * downscale + offset, height - 1);
+}
+
+float getAoBilateralWeight(int32_t              x,
+                           int32_t              y,
+                           const nvmath::vec3f& position,
+                           const nvmath::vec3f& normal,
+                           int32_t              sx,
+                           int32_t              sy,
+                           const nvmath::vec3f& samplePosition,
+                           const nvmath::vec3f& sampleNormal,
+                           uint32_t             downscale,
+                           float                radius)
+{
+  float dx      = float(x - sx) / float(downscale);
+  float dy      = float(y - sy) / float(downscale);
+  float plane   = nvmath::dot(sampleNormal, position - samplePosition) / (AO_PLANE_SIGMA * radius);
+  float spatial = std::exp(-0.5f * (dx * dx + dy * dy));
+  float depth   = std::exp(-0.5f * plane * plane);
+  float facing  = std::pow(std::max(nvmath::dot(normal, sampleNormal), 0.f), AO_NORMAL_POWER);
+  return spatial * depth * facing;
+}
+
+//--------------------------------------------------------------------------------------------------
+// One row per work item, in the same order as ao_upsample.comp
+//
+void upsampleAo(const AoGBuffer&          gBuffer,
+                const std::vector<float>& lowRes,
+                uint32_t                  downscale,
+                float                     radius,
+                std::vector<float>&       out,
+                uint32_t                  numThreads)
+{
+  const uint32_t width     = gBuffer.width;
+  const uint32_t height    = gBuffer.height;
+  const int32_t  lowWidth  = int32_t(getAoLowResSize(width, downscale));
+  const int32_t  lowHeight = int32_t(getAoLowResSize(height, downscale));
+
+  out.assign(size_t(width) * height, 0.f);
+  forEachChunk(height, numThreads, [&](uint32_t y) {
+    for(uint32_t x = 0; x < width; ++x)
+    {
+      size_t pixel = size_t(y) * width + x;
+      if(!isRendered(gBuffer, pixel))
+        continue;
+
+      const nvmath::vec3f& position = gBuffer.positions[pixel];
+      const nvmath::vec3f& normal   = gBuffer.normals[pixel];
+      int32_t              bx       = int32_t(x / downscale);
+      int32_t              by       = int32_t(y / downscale);
+
+      float   sum         = 0.f;
+      float   weightSum   = 0.f;
+      float   nearest     = 1.f;
+      int32_t nearestDist = -1;
+      for(int32_t j = -1; j <= 1; ++j)
+      {
+        for(int32_t i = -1; i <= 1; ++i)
+        {
+          int32_t b = bx + i;
+          int32_t c = by + j;
+          if(b < 0 || c < 0 || b >= lowWidth || c >= lowHeight)
+            continue;
+
+          uint32_t sx, sy;
+          getAoRepresentative(b, c, downscale, width, height, sx, sy);
+          size_t sample = size_t(sy) * width + sx;
+          if(!isRendered(gBuffer, sample))
+            continue;
+
+          float ao = lowRes[size_t(c) * lowWidth + b];
+          float w  = getAoBilateralWeight(x, y, position, normal, sx, sy, gBuffer.positions[sample],
+                                         gBuffer.normals[sample], downscale, radius);
+          sum += w * ao;
+          weightSum += w;
+
+          int32_t dx   = int32_t(x) - int32_t(sx);
+          int32_t dy   = int32_t(y) - int32_t(sy);
+          int32_t dist = dx * dx + dy * dy;
+          if(nearestDist < 0 || dist < nearestDist)
+          {
+            nearest     = ao;
+            nearestDist = dist;
+          }
+        }
+      }
+      out[pixel] = weightSum > AO_MIN_WEIGHT ? sum / weightSum : nearest;
+    }
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+// Check of the upsampling, see ao_upsample.h
+//
+
+namespace {
+
+// Synthetic scene seen from above, 1 pixel = PIXEL_SIZE. `surface` tells which surface
+// each pixel belongs to, 0 for the sky.
+const float PIXEL_SIZE = 0.02f;
+const float AO_RADIUS  = 2.f;
+
+struct AoScene
+{
+  AoGBuffer             gBuffer;
+  std::vector<float>    ao;  // Known AO of each pixel
+  std::vector<uint32_t> surface;
+};
+
+AoScene createAoScene(uint32_t width, uint32_t height)
+{
+  AoScene scene;
+  scene.gBuffer.width  = width;
+  scene.gBuffer.height = height;
+  scene.gBuffer.positions.resize(size_t(width) * height);
+  scene.gBuffer.normals.resize(size_t(width) * height);
+  scene.ao.resize(size_t(width) * height, 0.f);
+  scene.surface.resize(size_t(width) * height, 0);
+
+  // Box of height 1: top, then its side facing +X, and a pole of 3 pixels
+  const uint32_t boxX0 = width * 5 / 16, boxX1 = width * 9 / 16, sideX1 = boxX1 + 12;
+  const uint32_t boxY0 = height / 3, boxY1 = height * 2 / 3;
+  const uint32_t poleX0 = width * 13 / 16, poleX1 = poleX0 + 3;
+  const uint32_t skyY   = height / 10;
+
+  for(uint32_t y = 0; y < height; ++y)
+  {
+    for(uint32_t x = 0; x < width; ++x)
+    {
+      size_t        pixel = size_t(y) * width + x;
+      float         px    = x * PIXEL_SIZE;
+      float         pz    = y * PIXEL_SIZE;
+      nvmath::vec3f position, normal;
+      float         ao;
+      uint32_t      surface;
+      if(y < skyY)
+        continue;
+      if(x >= boxX0 && x < boxX1 && y >= boxY0 && y < boxY1)
+      {
+        position = {px, 1.f, pz};
+        normal   = {0.f, 1.f, 0.f};
+        ao       = 0.85f + 0.1f * std::sin(px * 2.5f);
+        surface  = 1;
+      }
+      else if(x >= boxX1 && x < sideX1 && y >= boxY0 && y < boxY1)
+      {
+        float h  = 1.f - float(x - boxX1) / float(sideX1 - boxX1);
+        position = {boxX1 * PIXEL_SIZE, h, pz};
+        normal   = {1.f, 0.f, 0.f};
+        ao       = 0.4f + 0.5f * h;
+        surface  = 2;
+      }
+      else if(x >= poleX0 && x < poleX1)
+      {
+        position = {poleX0 * PIXEL_SIZE, 3.f - pz * 0.5f, pz};
+        normal   = {0.f, 0.f, 1.f};
+        ao       = 0.7f;
+        surface  = 3;
+      }
+      else
+      {
+        // Darker close to the box
+        float dx = std::max({boxX0 * PIXEL_SIZE - px, px - sideX1 * PIXEL_SIZE, 0.f});
+        float dz = std::max({boxY0 * PIXEL_SIZE - pz, pz - boxY1 * PIXEL_SIZE, 0.f});
+        position = {px, 0.f, pz};
+        normal   = {0.f, 1.f, 0.f};
+        ao       = 1.f - 0.6f * std::exp(-std::sqrt(dx * dx + dz * dz) / 0.5f);
+        surface  = 4;
+      }
+      scene.gBuffer.positions[pixel] = position;
+      scene.gBuffer.normals[pixel]   = normal;
+      scene.ao[pixel]                = ao;
+      scene.surface[pixel]           = surface;
+    }
+  }
+  return scene;
+}
+
+// Pixels next to another surface
+std::vector<bool> getEdges(const AoScene& scene)
+{
+  const uint32_t    width  = scene.gBuffer.width;
+  const uint32_t    height = scene.gBuffer.height;
+  std::vector<bool> edges(size_t(width) * height, false);
+  for(uint32_t y = 0; y < height; ++y)
+  {
+    for(uint32_t x = 0; x < width; ++x)
+    {
+      uint32_t s = scene.surface[size_t(y) * width + x];
+      for(uint32_t j = y > 0 ? y - 1 : 0; j <= std::min(y + 1, height - 1); ++j)
+        for(uint32_t i = x > 0 ? x - 1 : 0; i <= std::min(x + 1, width - 1); ++i)
+          if(scene.surface[size_t(j) * width + i] != s)
+            edges[size_t(y) * width + x] = true;
+    }
+  }
+  return edges;
+}
+
+// RMSE over the rendered pixels, only the edges if `edges` is set
+float getRmse(const AoScene& scene, const std::vector<float>& image, const std::vector<bool>* edges = nullptr)
+{
+  double sum   = 0.0;
+  size_t count = 0;
+  for(size_t pixel = 0; pixel < image.size(); ++pixel)
+  {
+    if(scene.surface[pixel] == 0 || (edges && !(*edges)[pixel]))
+      continue;
+    double d = double(image[pixel]) - scene.ao[pixel];
+    sum += d * d;
+    count++;
+  }
+  return count > 0 ? float(std::sqrt(sum / count)) : 0.f;
+}
+
+// AO of each block, traced at its representative: exact, or the mean of `nbRays`
+// visibility tests when not 0
+std::vector<float> traceLowRes(const AoScene& scene, uint32_t downscale, uint32_t nbRays, std::mt19937& rng)
+{
+  const uint32_t     width     = scene.gBuffer.width;
+  const uint32_t     height    = scene.gBuffer.height;
+  const uint32_t     lowWidth  = getAoLowResSize(width, downscale);
+  const uint32_t     lowHeight = getAoLowResSize(height, downscale);
+  std::vector<float> lowRes(size_t(lowWidth) * lowHeight);
+  for(uint32_t by = 0; by < lowHeight; ++by)
+  {
+    for(uint32_t bx = 0; bx < lowWidth; ++bx)
+    {
+      uint32_t x, y;
+      getAoRepresentative(bx, by, downscale, width, height, x, y);
+      float ao = scene.ao[size_t(y) * width + x];
+      if(nbRays > 0)
+        ao = float(std::binomial_distribution<uint32_t>(nbRays, ao)(rng)) / float(nbRays);
+      lowRes[size_t(by) * lowWidth + bx] = ao;
+    }
+  }
+  return lowRes;
+}
+
+// Each pixel takes the AO of its block, what sampling the low resolution image would give
+std::vector<float> upsampleBlocks(const AoScene& scene, const std::vector<float>& lowRes, uint32_t downscale)
+{
+  const uint32_t     width    = scene.gBuffer.width;
+  const uint32_t     lowWidth = getAoLowResSize(width, downscale);
+  std::vector<float> out(scene.ao.size(), 0.f);
+  for(size_t pixel = 0; pixel < out.size(); ++pixel)
+  {
+    uint32_t x = uint32_t(pixel % width), y = uint32_t(pixel / width);
+    if(scene.surface[pixel] != 0)
+      out[pixel] = lowRes[size_t(y / downscale) * lowWidth + x / downscale];
+  }
+  return out;
+}
+
+}  // namespace
+
+bool checkAoUpsample()
+{
+  using Clock = std::chrono::high_resolution_clock;
+
+  // Rays per pixel accumulated over the frames (4 rays per pixel, 16 frames)
+  const uint32_t NB_RAYS = 64;
+
+  AoScene           scene = createAoScene(640, 360);
+  std::vector<bool> edges = getEdges(scene);
+  std::mt19937      rng(1234);
+  bool              ok    = true;
+
+  // Noise of the AO traced at full resolution
+  std::vector<float> noisyFull = traceLowRes(scene, 1, NB_RAYS, rng);
+  float              fullRmse  = getRmse(scene, noisyFull);
+  printf("AO upsampling: %ux%u, full resolution, %u rays per pixel: RMSE %.4f\n", scene.gBuffer.width,
+         scene.gBuffer.height, NB_RAYS, fullRmse);
+
+  for(uint32_t downscale : {2u, 4u})
+  {
+    // Converged AO: the error only comes from the upsampling
+    std::vector<float> lowRes = traceLowRes(scene, downscale, 0, rng);
+    std::vector<float> image1, image;
+    upsampleAo(scene.gBuffer, lowRes, downscale, AO_RADIUS, image1, 1);
+    auto start = Clock::now();
+    upsampleAo(scene.gBuffer, lowRes, downscale, AO_RADIUS, image, 0);
+    double             ms     = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::vector<float> blocks = upsampleBlocks(scene, lowRes, downscale);
+
+    float rmse           = getRmse(scene, image);
+    float edgeRmse       = getRmse(scene, image, &edges);
+    float blocksEdgeRmse = getRmse(scene, blocks, &edges);
+
+    // Same number of frames, 1 / downscale^2 of the rays
+    std::vector<float> noisy;
+    upsampleAo(scene.gBuffer, traceLowRes(scene, downscale, NB_RAYS, rng), downscale, AO_RADIUS, noisy, 0);
+    float noisyRmse = getRmse(scene, noisy);
+
+    bool pass = image == image1 && rmse < 0.01f && edgeRmse < 0.05f && edgeRmse < 0.5f * blocksEdgeRmse
+                && noisyRmse < 1.5f * fullRmse;
+    printf("  1/%u resolution, %ux fewer rays: RMSE %.4f, edges %.4f (blocks %.4f), %u rays per block %.4f, "
+           "%.2f ms%s\n",
+           downscale, downscale * downscale, rmse, edgeRmse, blocksEdgeRmse, NB_RAYS, noisyRmse, ms,
+           pass ? "" : "  FAILED");
+    ok = pass && ok;
+  }
+  return ok;
+}
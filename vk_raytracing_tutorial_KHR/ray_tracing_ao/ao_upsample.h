@@ -0,0 +1,85 @@
+/* Copyright (c) 2014-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "nvmath/nvmath.h"
+
+//--------------------------------------------------------------------------------------------------
+// CPU reference of the reduced resolution AO: the pixel traced for each block by ao.comp
+// and the joint bilateral upsampling of ao_upsample.comp (shaders/aocommon.glsl). Used to
+// compare the upsampled images against the AO traced at full resolution without device.
+//
+
+// Decoded G-Buffer: world position and normal of each pixel, row-major. A null normal
+// marks a pixel where nothing was rendered.
+struct AoGBuffer
+{
+  uint32_t                   width{0};
+  uint32_t                   height{0};
+  std::vector<nvmath::vec3f> positions;
+  std::vector<nvmath::vec3f> normals;
+};
+
+// Number of blocks along a side of `size` pixels, the size of the image traced by ao.comp
+uint32_t getAoLowResSize(uint32_t size, uint32_t downscale);
+
+// Full resolution pixel traced for the block (bx, by), as aoRepresentative()
+void getAoRepresentative(uint32_t bx, uint32_t by, uint32_t downscale, uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+
+// Weight of the AO traced at the pixel (sx, sy) for the pixel (x, y), as aoBilateralWeight()
+float getAoBilateralWeight(int32_t              x,
+                           int32_t              y,
+                           const nvmath::vec3f& position,
+                           const nvmath::vec3f& normal,
+                           int32_t              sx,
+                           int32_t              sy,
+                           const nvmath::vec3f& samplePosition,
+                           const nvmath::vec3f& sampleNormal,
+                           uint32_t             downscale,
+                           float                radius);
+
+//--------------------------------------------------------------------------------------------------
+// Same as ao_upsample.comp: fills `out` (width x height) from `lowRes`, the AO of each block
+// (getAoLowResSize() of the width x height), for a `downscale` of 2 or 4 and the AO
+// `radius`. The rows are spread over `numThreads` (0 uses all the cores), the result does
+// not depend on it.
+//
+void upsampleAo(const AoGBuffer&          gBuffer,
+                const std::vector<float>& lowRes,
+                uint32_t                  downscale,
+                float                     radius,
+                std::vector<float>&       out,
+                uint32_t                  numThreads = 0);
+
+// Image diff of the upsampling on a synthetic G-Buffer (floor, box, thin pole and sky) with
+// a known AO, at half and quarter resolution: the error over the image and along the
+// edges of the surfaces, against a plain block upsampling, and the noise of the AO
+// accumulated from the same number of frames at full and reduced resolution. Prints the
+// results, returns false if a check fails.
+bool checkAoUpsample();
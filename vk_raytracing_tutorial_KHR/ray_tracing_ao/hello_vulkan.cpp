@@ -421,6 +421,7 @@ void HelloVulkan::destroyResources()
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_gBuffer);
   m_alloc.destroy(m_aoBuffer);
+  m_alloc.destroy(m_aoLowBuffer);
   m_alloc.destroy(m_offscreenDepth);
   m_device.destroy(m_offscreenRenderPass);
   m_device.destroy(m_offscreenFramebuffer);
@@ -429,6 +430,7 @@ void HelloVulkan::destroyResources()
   m_device.destroy(m_compDescPool);
   m_device.destroy(m_compDescSetLayout);
   m_device.destroy(m_compPipeline);
+  m_device.destroy(m_compUpsamplePipeline);
   m_device.destroy(m_compPipelineLayout);
 
   // #VKRay
@@ -491,6 +493,7 @@ void HelloVulkan::createOffscreenRender()
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_gBuffer);
   m_alloc.destroy(m_aoBuffer);
+  m_alloc.destroy(m_aoLowBuffer);
   m_alloc.destroy(m_offscreenDepth);
 
   // Creating the color image
@@ -538,6 +541,20 @@ void HelloVulkan::createOffscreenRender()
     m_debug.setObjectName(m_aoBuffer.image, "aoBuffer");
   }
 
+  // The ambient occlusion traced at half or quarter resolution (r32), sized for half
+  {
+    vk::Extent2D lowSize{(m_size.width + 1) / 2, (m_size.height + 1) / 2};
+    auto         colorCreateInfo = nvvk::makeImage2DCreateInfo(lowSize, vk::Format::eR32Sfloat,
+                                                       vk::ImageUsageFlagBits::eStorage);
+
+
+    nvvk::Image             image  = m_alloc.createImage(colorCreateInfo);
+    vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
+    m_aoLowBuffer                  = m_alloc.createTexture(image, ivInfo, vk::SamplerCreateInfo());
+    m_aoLowBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    m_debug.setObjectName(m_aoLowBuffer.image, "aoLowBuffer");
+  }
+
 
   // Creating the depth buffer
   auto depthCreateInfo =
@@ -565,6 +582,8 @@ void HelloVulkan::createOffscreenRender()
                                 vk::ImageLayout::eGeneral);
     nvvk::cmdBarrierImageLayout(cmdBuf, m_aoBuffer.image, vk::ImageLayout::eUndefined,
                                 vk::ImageLayout::eGeneral);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_aoLowBuffer.image, vk::ImageLayout::eUndefined,
+                                vk::ImageLayout::eGeneral);
     nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenDepth.image, vk::ImageLayout::eUndefined,
                                 vk::ImageLayout::eDepthStencilAttachmentOptimal,
                                 vk::ImageAspectFlagBits::eDepth);
@@ -784,6 +803,8 @@ void HelloVulkan::createCompDescriptors()
       1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute));
   m_compDescSetLayoutBind.addBinding(vk::DescriptorSetLayoutBinding(  // [in] TLAS
       2, vk::DescriptorType::eAccelerationStructureKHR, 1, vk::ShaderStageFlagBits::eCompute));
+  m_compDescSetLayoutBind.addBinding(vk::DescriptorSetLayoutBinding(  // [in/out] Reduced resolution AO
+      3, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute));
 
   m_compDescSetLayout = m_compDescSetLayoutBind.createLayout(m_device);
   m_compDescPool      = m_compDescSetLayoutBind.createPool(m_device, 1);
@@ -802,6 +823,7 @@ void HelloVulkan::updateCompDescriptors()
   vk::AccelerationStructureKHR                   tlas = m_rtBuilder.getAccelerationStructure();
   vk::WriteDescriptorSetAccelerationStructureKHR descASInfo{1, &tlas};
   writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 2, &descASInfo));
+  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 3, &m_aoLowBuffer.descriptor));
 
   m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
@@ -824,6 +846,14 @@ void HelloVulkan::createCompPipelines()
   m_compPipeline = static_cast<const vk::Pipeline&>(
       m_device.createComputePipeline({}, computePipelineCreateInfo));
   m_device.destroy(computePipelineCreateInfo.stage.module);
+
+  // Upsampling of the AO traced at reduced resolution, same descriptors and push constants
+  computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+      m_device, nvh::loadFile("spv/ao_upsample.comp.spv", true, defaultSearchPaths, true),
+      VK_SHADER_STAGE_COMPUTE_BIT);
+  m_compUpsamplePipeline = static_cast<const vk::Pipeline&>(
+      m_device.createComputePipeline({}, computePipelineCreateInfo));
+  m_device.destroy(computePipelineCreateInfo.stage.module);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -865,9 +895,27 @@ void HelloVulkan::runCompute(vk::CommandBuffer cmdBuf, AoControl& aoControl)
   cmdBuf.pushConstants(m_compPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
                        sizeof(AoControl), &aoControl);
 
-  // Dispatching the shader
-  cmdBuf.dispatch((m_size.width + (GROUP_SIZE - 1)) / GROUP_SIZE,
-                  (m_size.height + (GROUP_SIZE - 1)) / GROUP_SIZE, 1);
+  // Dispatching the shader, one invocation per block of rtao_downscale x rtao_downscale pixels
+  uint32_t downscale = static_cast<uint32_t>(aoControl.rtao_downscale);
+  uint32_t lowWidth  = (m_size.width + downscale - 1) / downscale;
+  uint32_t lowHeight = (m_size.height + downscale - 1) / downscale;
+  cmdBuf.dispatch((lowWidth + (GROUP_SIZE - 1)) / GROUP_SIZE,
+                  (lowHeight + (GROUP_SIZE - 1)) / GROUP_SIZE, 1);
+
+  // At reduced resolution, filling the full resolution AO buffer
+  if(downscale > 1)
+  {
+    imgMemBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+    imgMemBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    imgMemBarrier.setImage(m_aoLowBuffer.image);
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                           vk::PipelineStageFlagBits::eComputeShader,
+                           vk::DependencyFlagBits::eDeviceGroup, {}, {}, {imgMemBarrier});
+
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_compUpsamplePipeline);
+    cmdBuf.dispatch((m_size.width + (GROUP_SIZE - 1)) / GROUP_SIZE,
+                    (m_size.height + (GROUP_SIZE - 1)) / GROUP_SIZE, 1);
+  }
 
 
   // Adding a barrier to be sure the compute shader has finished
@@ -43,6 +43,7 @@ struct AoControl
   int   rtao_distance_based{1};  // Attenuate based on distance
   int   frame{0};                // Current frame
   int   max_samples{100'000};    // Max samples before it stops
+  int   rtao_downscale{1};       // 1: full, 2: half, 4: quarter resolution, see ao_upsample.h
 };
 
 
@@ -140,6 +141,7 @@ public:
   nvvk::Texture               m_offscreenColor;
   nvvk::Texture               m_gBuffer;
   nvvk::Texture               m_aoBuffer;
+  nvvk::Texture               m_aoLowBuffer;  // AO traced at reduced resolution
   vk::Format                  m_offscreenColorFormat{vk::Format::eR32G32B32A32Sfloat};
   nvvk::Texture               m_offscreenDepth;
   vk::Format                  m_offscreenDepthFormat;
@@ -165,6 +167,7 @@ public:
   vk::DescriptorSetLayout     m_compDescSetLayout;
   vk::DescriptorSet           m_compDescSet;
   vk::Pipeline                m_compPipeline;
+  vk::Pipeline                m_compUpsamplePipeline;
   vk::PipelineLayout          m_compPipelineLayout;
 
   // #Tuto_jitter_cam
@@ -30,6 +30,7 @@
 // at the top of imgui.cpp.
 
 #include <array>
+#include <cstring>
 #include <iostream>
 
 #include <vulkan/vulkan.hpp>
@@ -39,6 +40,7 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 #include "imgui/backends/imgui_impl_glfw.h"
 
 #include "hello_vulkan.h"
+#include "ao_upsample.h"
 #include "imgui/extras/imgui_camera_widget.h"
 #include "nvh/cameramanipulator.hpp"
 #include "nvh/fileoperations.hpp"
@@ -87,7 +89,12 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
+  // -aoupsample: check the reduced resolution AO upsampling against its CPU reference and exit.
+  for(int i = 1; i < argc; ++i)
+  {
+    if(strcmp(argv[i], "-aoupsample") == 0)
+      return checkAoUpsample() ? 0 : 1;
+  }
 
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
@@ -244,6 +251,13 @@ int main(int argc, char** argv)
           changed |= ImGui::SliderFloat("Power", &aoControl.rtao_power, 1, 5);
           changed |= ImGui::InputInt("Max Samples", &aoControl.max_samples);
           changed |= ImGui::Checkbox("Distanced Based", (bool*)&aoControl.rtao_distance_based);
+          ImGui::Text("Resolution");
+          ImGui::SameLine();
+          changed |= ImGui::RadioButton("Full", &aoControl.rtao_downscale, 1);
+          ImGui::SameLine();
+          changed |= ImGui::RadioButton("Half", &aoControl.rtao_downscale, 2);
+          ImGui::SameLine();
+          changed |= ImGui::RadioButton("Quarter", &aoControl.rtao_downscale, 4);
           if(changed)
             helloVk.resetFrame();
         }
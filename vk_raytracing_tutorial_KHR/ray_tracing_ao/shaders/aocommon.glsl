@@ -0,0 +1,51 @@
+//-------------------------------------------------------------------------------------------------
+// Shared by ao.comp and ao_upsample.comp. The pixel traced for each low resolution
+// texel and the weights of the upsampling are mirrored on the CPU in ao_upsample.cpp,
+// keep both in sync.
+//-------------------------------------------------------------------------------------------------
+
+// See AoControl
+layout(push_constant) uniform params_
+{
+  float rtao_radius;
+  int   rtao_samples;
+  float rtao_power;
+  int   rtao_distance_based;
+  int   frame_number;
+  int   max_samples;
+  int   rtao_downscale;
+};
+
+// Standard deviation of the distance to the plane of a sample, relative to the AO radius
+const float AO_PLANE_SIGMA = 0.05;
+// Exponent of the cosine between the normals
+const float AO_NORMAL_POWER = 32.0;
+// Below this total weight, no sample lies on the surface: the nearest one is used
+const float AO_MIN_WEIGHT = 1e-3;
+
+//-------------------------------------------------------------------------------------------------
+// Full resolution pixel traced for the low resolution texel `block`. The pixel alternates
+// between the corner and the center of the blocks in a checkerboard, so that neighboring
+// blocks don't sample the same row and column. It stays the same from frame to frame: the
+// accumulated AO and the G-Buffer used to upsample it always describe the same point.
+//
+ivec2 aoRepresentative(ivec2 block, ivec2 size)
+{
+  ivec2 offset = ((block.x + block.y) & 1) == 1 ? ivec2(rtao_downscale / 2) : ivec2(0);
+  return min(block * rtao_downscale + offset, size - 1);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Joint bilateral weight of the AO traced at `samplePixel` for the pixel `pixel`: a Gaussian of
+// the distance in blocks, of the distance of the pixel to the plane of the sample and the
+// agreement of the normals. Samples of other surfaces get a negligible weight.
+//
+float aoBilateralWeight(ivec2 pixel, vec3 position, vec3 normal, ivec2 samplePixel, vec3 samplePosition, vec3 sampleNormal)
+{
+  vec2  d       = vec2(pixel - samplePixel) / float(rtao_downscale);
+  float plane   = dot(sampleNormal, position - samplePosition) / (AO_PLANE_SIGMA * rtao_radius);
+  float spatial = exp(-0.5 * dot(d, d));
+  float depth   = exp(-0.5 * plane * plane);
+  float facing  = pow(max(dot(normal, sampleNormal), 0.0), AO_NORMAL_POWER);
+  return spatial * depth * facing;
+}
@@ -809,16 +809,27 @@ void HelloVulkan::createRtPipeline()
   stages.push_back({{}, vk::ShaderStageFlagBits::eMissKHR, shadowmissSM, "main"});
   m_rtShaderGroups.push_back(mg);
 
-  // Hit Group - Closest Hit + AnyHit
+  // Hit Groups - Closest Hit
+  // The same shader, specialized with LIGHT_TYPE: -1 calls the callable shader
+  // of the light, then one group per light type evaluating it in place. The
+  // group is selected in raytrace() by the start of the hit region of the SBT.
   vk::ShaderModule chitSM = nvvk::createShaderModule(
       m_device, nvh::loadFile("spv/raytrace.rchit.spv", true, defaultSearchPaths, true));
 
-  vk::RayTracingShaderGroupCreateInfoKHR hg{vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
-                                            VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
-                                            VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
-  hg.setClosestHitShader(static_cast<uint32_t>(stages.size()));
-  stages.push_back({{}, vk::ShaderStageFlagBits::eClosestHitKHR, chitSM, "main"});
-  m_rtShaderGroups.push_back(hg);
+  std::array<int, 4>                    lightTypes{-1, 0, 1, 2};
+  vk::SpecializationMapEntry            lightTypeEntry{0, 0, sizeof(int)};
+  std::array<vk::SpecializationInfo, 4> lightTypeInfos;
+  for(size_t i = 0; i < lightTypes.size(); i++)
+  {
+    lightTypeInfos[i] = vk::SpecializationInfo{1, &lightTypeEntry, sizeof(int), &lightTypes[i]};
+
+    vk::RayTracingShaderGroupCreateInfoKHR hg{vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
+                                              VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
+                                              VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR};
+    hg.setClosestHitShader(static_cast<uint32_t>(stages.size()));
+    stages.push_back({{}, vk::ShaderStageFlagBits::eClosestHitKHR, chitSM, "main", &lightTypeInfos[i]});
+    m_rtShaderGroups.push_back(hg);
+  }
 
   // Callable shaders
   vk::RayTracingShaderGroupCreateInfoKHR callGroup{vk::RayTracingShaderGroupTypeKHR::eGeneral,
@@ -893,7 +904,7 @@ void HelloVulkan::createRtPipeline()
 void HelloVulkan::createRtShaderBindingTable()
 {
   auto groupCount =
-      static_cast<uint32_t>(m_rtShaderGroups.size());  // shaders: raygen, 2 miss, chit, 3 call
+      static_cast<uint32_t>(m_rtShaderGroups.size());  // shaders: raygen, 2 miss, 4 chit, 3 call
   uint32_t groupHandleSize = m_rtProperties.shaderGroupHandleSize;  // Size of a program identifier
   uint32_t groupSizeAligned =
       nvh::align_up(groupHandleSize, m_rtProperties.shaderGroupBaseAlignment);
@@ -960,11 +971,14 @@ void HelloVulkan::raytrace(const vk::CommandBuffer& cmdBuf, const nvmath::vec4f&
   vk::DeviceAddress sbtAddress  = m_device.getBufferAddress({m_rtSBTBuffer.buffer});
 
   using Stride = vk::StridedDeviceAddressRegionKHR;
+  // Hit group of the light: the callable one, or the one specialized for its type
+  uint32_t hitGroup = m_useCallable ? 0u : 1u + static_cast<uint32_t>(m_pushConstant.lightType);
+
   std::array<Stride, 4> strideAddresses{
-      Stride{sbtAddress + 0u * groupSize, groupStride, groupSize * 1},   // raygen
-      Stride{sbtAddress + 1u * groupSize, groupStride, groupSize * 2},   // miss
-      Stride{sbtAddress + 3u * groupSize, groupStride, groupSize * 1},   // hit
-      Stride{sbtAddress + 4u * groupSize, groupStride, groupSize * 1}};  // callable
+      Stride{sbtAddress + 0u * groupSize, groupStride, groupSize * 1},               // raygen
+      Stride{sbtAddress + 1u * groupSize, groupStride, groupSize * 2},               // miss
+      Stride{sbtAddress + (3u + hitGroup) * groupSize, groupStride, groupSize * 1},  // hit
+      Stride{sbtAddress + 7u * groupSize, groupStride, groupSize * 3}};              // 3 callable
 
   cmdBuf.traceRaysKHR(&strideAddresses[0], &strideAddresses[1], &strideAddresses[2],
                       &strideAddresses[3],              //
@@ -92,9 +92,12 @@ public:
     float         lightSpotCutoff{cos(deg2rad(12.5f))};
     float         lightSpotOuterCutoff{cos(deg2rad(17.5f))};
     int           instanceId{0};  // To retrieve the transformation matrix
-    int           lightType{0};   // 0: point, 1: infinite
+    int           lightType{0};   // 0: point, 1: spot, 2: infinite
   };
   ObjPushConstant m_pushConstant;
+  // Ray tracing: light evaluated by its callable shader, else by the hit group
+  // specialized for its type
+  bool m_useCallable{false};
 
   // Array of objects and instances in the scene
   std::vector<ObjModel>    m_objModel;
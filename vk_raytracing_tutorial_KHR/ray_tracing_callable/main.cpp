@@ -70,6 +70,7 @@ void renderUI(HelloVulkan& helloVk)
     ImGui::RadioButton("Spot", &helloVk.m_pushConstant.lightType, 1);
     ImGui::SameLine();
     ImGui::RadioButton("Infinite", &helloVk.m_pushConstant.lightType, 2);
+    ImGui::Checkbox("Callable shaders", &helloVk.m_useCallable);
 
     if(helloVk.m_pushConstant.lightType < 2)
       ImGui::SliderFloat3("Light Position", &helloVk.m_pushConstant.lightPosition.x, -20.f, 20.f);
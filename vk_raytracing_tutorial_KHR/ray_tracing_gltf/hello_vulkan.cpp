@@ -50,6 +50,15 @@ extern std::vector<std::string> defaultSearchPaths;
 #include "shaders/binding.glsl"
 #include "shaders/gltf.glsl"
 
+#include <algorithm>
+#include <chrono>
+#ifdef WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
 
 // Holding the camera matrices
 struct CameraMatrices
@@ -225,9 +234,27 @@ void HelloVulkan::createGraphicsPipeline()
 }
 
 //--------------------------------------------------------------------------------------------------
-// Loading the OBJ file and setting up all buffers
+// Peak resident memory of the process, in MB
+//
+static double getPeakMemoryMB()
+{
+#ifdef WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<double>(usage.ru_maxrss) / 1024.0;  // In KB
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+// Loading the glTF file and setting up all buffers
+// - useCgltf: the geometry is imported with cgltf from the mapped buffers instead of tinygltf,
+//   the import time and peak memory of the loader are reported
 //
-void HelloVulkan::loadScene(const std::string& filename)
+void HelloVulkan::loadScene(const std::string& filename, bool useCgltf)
 {
   using vkBU = vk::BufferUsageFlagBits;
   tinygltf::Model    tmodel;
@@ -235,17 +262,47 @@ void HelloVulkan::loadScene(const std::string& filename)
   std::string        warn, error;
 
   LOGI("Loading file: %s", filename.c_str());
-  if(!tcontext.LoadASCIIFromFile(&tmodel, &error, &warn, filename))
+  auto   startTime = std::chrono::high_resolution_clock::now();
+  double startPeak = getPeakMemoryMB();
+
+  auto loadTinyModel = [&]() {
+    if(!tcontext.LoadASCIIFromFile(&tmodel, &error, &warn, filename))
+    {
+      assert(!"Error while loading scene");
+    }
+    LOGW(warn.c_str());
+    LOGE(error.c_str());
+  };
+
+  // cgltf is stricter than tinygltf: the files it rejects, leaving the scene empty, go through tinygltf
+  if(useCgltf
+     && !m_gltfScene.importCgltf(filename, nvh::GltfAttributes::Normal | nvh::GltfAttributes::Texcoord_0))
   {
-    assert(!"Error while loading scene");
+    LOGW("cgltf could not import %s, falling back to tinygltf\n", filename.c_str());
+    useCgltf = false;
+  }
+  if(!useCgltf)
+  {
+    loadTinyModel();
+    m_gltfScene.importMaterials(tmodel);
+    m_gltfScene.importDrawableNodes(tmodel,
+                                    nvh::GltfAttributes::Normal | nvh::GltfAttributes::Texcoord_0);
   }
-  LOGW(warn.c_str());
-  LOGE(error.c_str());
-
 
-  m_gltfScene.importMaterials(tmodel);
-  m_gltfScene.importDrawableNodes(tmodel,
-                                  nvh::GltfAttributes::Normal | nvh::GltfAttributes::Texcoord_0);
+  // Peak of the process: what the import added on top of what was already used
+  double elapsed =
+      std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+  double peak = getPeakMemoryMB();
+  LOGI("Imported with %s in %.1f ms, peak memory %.1f MB (+%.1f MB)\n", useCgltf ? "cgltf" : "tinygltf",
+       elapsed, peak, peak - startPeak);
+
+  // cgltf only imports the geometry and the materials, the images come from tinygltf
+  bool hasTextures = std::any_of(m_gltfScene.m_materials.begin(), m_gltfScene.m_materials.end(),
+                                 [](const nvh::GltfMaterial& m) { return m.baseColorTexture >= 0; });
+  if(useCgltf && hasTextures)
+  {
+    loadTinyModel();
+  }
 
   // Create the buffers on Device and copy vertices, indices and materials
   nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
@@ -53,7 +53,7 @@ public:
              uint32_t                  queueFamily) override;
   void createDescriptorSetLayout();
   void createGraphicsPipeline();
-  void loadScene(const std::string& filename);
+  void loadScene(const std::string& filename, bool useCgltf = false);
   void updateDescriptorSet();
   void createUniformBuffer();
   void createTextureImages(const vk::CommandBuffer& cmdBuf, tinygltf::Model& gltfModel);
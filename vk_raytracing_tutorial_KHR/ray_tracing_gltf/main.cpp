@@ -40,6 +40,7 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 #include "imgui/extras/imgui_camera_widget.h"
 #include "nvh/cameramanipulator.hpp"
 #include "nvh/fileoperations.hpp"
+#include "nvh/inputparser.h"
 #include "nvpsystem.hpp"
 #include "nvvk/appbase_vkpp.hpp"
 #include "nvvk/commands_vk.hpp"
@@ -85,7 +86,8 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
+  // -cgltf: imports the scene with cgltf instead of tinygltf
+  InputParser parser(argc, argv);
 
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
@@ -176,7 +178,8 @@ int main(int argc, char** argv)
   helloVk.initGUI(0);  // Using sub-pass 0
 
   // Creation of the example
-  helloVk.loadScene(nvh::findFile("media/scenes/cornellBox.gltf", defaultSearchPaths, true));
+  helloVk.loadScene(nvh::findFile("media/scenes/cornellBox.gltf", defaultSearchPaths, true),
+                    parser.exist("-cgltf"));
 
 
   helloVk.createOffscreenRender();
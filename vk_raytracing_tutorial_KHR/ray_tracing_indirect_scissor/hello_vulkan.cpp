@@ -456,6 +456,8 @@ void HelloVulkan::destroyResources()
   m_device.destroy(m_lanternIndirectCompPipeline);
   m_device.destroy(m_lanternIndirectCompPipelineLayout);
   m_alloc.destroy(m_lanternIndirectBuffer);
+  m_alloc.destroy(m_lightBvhNodeBuffer);
+  m_alloc.destroy(m_lightBvhOrderBuffer);
   m_alloc.destroy(m_lanternVertexBuffer);
   m_alloc.destroy(m_lanternIndexBuffer);
 }
@@ -928,7 +930,8 @@ void HelloVulkan::createTopLevelAS()
 }
 
 //--------------------------------------------------------------------------------------------------
-// This descriptor set holds the Acceleration structure, output image, and lanterns array buffer.
+// This descriptor set holds the Acceleration structure, output image, lanterns array buffer,
+// and the light BVH over the lanterns.
 //
 void HelloVulkan::createRtDescriptorSet()
 {
@@ -947,6 +950,9 @@ void HelloVulkan::createRtDescriptorSet()
   m_rtDescSetLayoutBind.addBinding(  //
       vkDSLB(2, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR | vkSS::eClosestHitKHR));
   assert(m_lanternCount > 0);
+  // Light BVH nodes (binding = 3) and lantern indices of its leaves (binding = 4)
+  m_rtDescSetLayoutBind.addBinding(vkDSLB(3, vkDT::eStorageBuffer, 1, vkSS::eClosestHitKHR));
+  m_rtDescSetLayoutBind.addBinding(vkDSLB(4, vkDT::eStorageBuffer, 1, vkSS::eClosestHitKHR));
 
   m_rtDescPool      = m_rtDescSetLayoutBind.createPool(m_device);
   m_rtDescSetLayout = m_rtDescSetLayoutBind.createLayout(m_device);
@@ -960,11 +966,15 @@ void HelloVulkan::createRtDescriptorSet()
       {}, m_offscreenColor.descriptor.imageView, vk::ImageLayout::eGeneral};
   vk::DescriptorBufferInfo lanternBufferInfo{m_lanternIndirectBuffer.buffer, 0,
                                              m_lanternCount * sizeof(LanternIndirectEntry)};
+  vk::DescriptorBufferInfo lightBvhNodeInfo{m_lightBvhNodeBuffer.buffer, 0, VK_WHOLE_SIZE};
+  vk::DescriptorBufferInfo lightBvhOrderInfo{m_lightBvhOrderBuffer.buffer, 0, VK_WHOLE_SIZE};
 
   std::vector<vk::WriteDescriptorSet> writes;
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 0, &descASInfo));
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 1, &imageInfo));
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 2, &lanternBufferInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 3, &lightBvhNodeInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, 4, &lightBvhOrderInfo));
   m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -1307,23 +1317,45 @@ void HelloVulkan::createLanternIndirectBuffer()
 }
 
 //--------------------------------------------------------------------------------------------------
-// Ray Tracing the scene
-//
-// The raytracing is split into multiple passes:
-//
-// First pass fills in the initial values for every pixel in the output image.
-// Illumination and shadow rays come from the main light.
+// Build the light BVH over m_lanterns and upload its nodes and the lantern indices of its
+// leaves. Must be called only after TLAS build, the BVH refers to lanterns by their index
+// which is also their instance custom index.
 //
-// Subsequently, one lantern pass is run for each lantern in the scene. We run
-// a compute shader to calculate a bounding scissor rectangle for each lantern's light
-// effect. This is stored in m_lanternIndirectBuffer. Then an indirect trace rays command
-// is run for every lantern within its scissor rectangle. The lanterns' light
-// contribution is additively blended into the output image.
-void HelloVulkan::raytrace(const vk::CommandBuffer& cmdBuf, const nvmath::vec4f& clearColor)
+void HelloVulkan::createLightBvhBuffers()
 {
-  // Before tracing rays, we need to dispatch the compute shaders that
-  // fill in the ray trace indirect parameters for each lantern pass.
+  assert(m_lanternCount > 0);
+  assert(m_lanternCount == m_lanterns.size());
+
+  // Same power as lanternWeight in raytrace.rchit.
+  std::vector<LightBvh::Light> lights(m_lanternCount);
+  for(size_t i = 0; i < m_lanternCount; ++i)
+  {
+    const Lantern& lantern = m_lanterns[i];
+    float luminance = nvmath::dot(lantern.color, nvmath::vec3f(0.2126f, 0.7152f, 0.0722f));
+    lights[i]       = {lantern.position, luminance * lantern.brightness, lantern.radius};
+  }
+
+  LightBvh lightBvh;
+  lightBvh.build(lights);
+
+  using vkBU = vk::BufferUsageFlagBits;
+  nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+
+  auto cmdBuf           = cmdGen.createCommandBuffer();
+  m_lightBvhNodeBuffer  = m_alloc.createBuffer(cmdBuf, lightBvh.getNodes(), vkBU::eStorageBuffer);
+  m_lightBvhOrderBuffer = m_alloc.createBuffer(cmdBuf, lightBvh.getOrder(), vkBU::eStorageBuffer);
+  cmdGen.submitAndWait(cmdBuf);
+  m_alloc.finalizeAndReleaseStaging();
+  m_debug.setObjectName(m_lightBvhNodeBuffer.buffer, "lightBvhNodes");
+  m_debug.setObjectName(m_lightBvhOrderBuffer.buffer, "lightBvhOrder");
+}
 
+//--------------------------------------------------------------------------------------------------
+// Before tracing the lantern passes, we need to dispatch the compute shaders that
+// fill in the ray trace indirect parameters for each lantern pass.
+//
+void HelloVulkan::dispatchLanternIndirect(const vk::CommandBuffer& cmdBuf)
+{
   // First, barrier before, ensure writes aren't visible to previous frame.
   vk::BufferMemoryBarrier bufferBarrier;
   bufferBarrier.setSrcAccessMask(vk::AccessFlagBits::eIndirectCommandRead);
@@ -1365,7 +1397,30 @@ void HelloVulkan::raytrace(const vk::CommandBuffer& cmdBuf, const nvmath::vec4f&
       vk::PipelineStageFlagBits::eDrawIndirect,   //
       vk::DependencyFlags(0),                     //
       {}, {bufferBarrier}, {});
+}
 
+//--------------------------------------------------------------------------------------------------
+// Ray Tracing the scene
+//
+// The raytracing is split into multiple passes:
+//
+// First pass fills in the initial values for every pixel in the output image.
+// Illumination and shadow rays come from the main light.
+//
+// Subsequently, one lantern pass is run for each lantern in the scene. We run
+// a compute shader to calculate a bounding scissor rectangle for each lantern's light
+// effect. This is stored in m_lanternIndirectBuffer. Then an indirect trace rays command
+// is run for every lantern within its scissor rectangle. The lanterns' light
+// contribution is additively blended into the output image.
+//
+// With m_lanternSampling, the first pass also adds the light of lanterns sampled from the
+// light BVH, and is the only pass: its cost no longer grows with the lantern count.
+void HelloVulkan::raytrace(const vk::CommandBuffer& cmdBuf, const nvmath::vec4f& clearColor)
+{
+  if(!m_lanternSampling)
+  {
+    dispatchLanternIndirect(cmdBuf);
+  }
 
   // Now move on to the actual ray tracing.
   m_debug.beginLabel(cmdBuf, "Ray trace");
@@ -1378,7 +1433,9 @@ void HelloVulkan::raytrace(const vk::CommandBuffer& cmdBuf, const nvmath::vec4f&
   m_rtPushConstants.lanternPassNumber = -1;  // Global non-lantern pass
   m_rtPushConstants.screenX           = m_size.width;
   m_rtPushConstants.screenY           = m_size.height;
-  m_rtPushConstants.lanternDebug      = m_lanternDebug;
+  m_rtPushConstants.lanternDebug      = m_lanternDebug && !m_lanternSampling;
+  m_rtPushConstants.lanternSamples    = m_lanternSampling ? m_lanternSamples : 0;
+  m_rtPushConstants.frame             = m_frame++;
 
   cmdBuf.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, m_rtPipeline);
   cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, m_rtPipelineLayout, 0,
@@ -1402,13 +1459,14 @@ void HelloVulkan::raytrace(const vk::CommandBuffer& cmdBuf, const nvmath::vec4f&
       Stride{sbtAddress + 4u * groupSize, groupStride, groupSize * 4},  // hit
       Stride{0u, 0u, 0u}};                                              // callable
 
-  // First pass, illuminate scene with global light.
+  // First pass, illuminate scene with global light, and sampled lanterns if m_lanternSampling.
   cmdBuf.traceRaysKHR(&strideAddresses[0], &strideAddresses[1],  //
                       &strideAddresses[2], &strideAddresses[3],  //
                       m_size.width, m_size.height, 1);
 
   // Lantern passes, ensure previous pass completed, then add light contribution from each lantern.
-  for(int i = 0; i < static_cast<int>(m_lanternCount); ++i)
+  int lanternPassCount = m_lanternSampling ? 0 : static_cast<int>(m_lanternCount);
+  for(int i = 0; i < lanternPassCount; ++i)
   {
     // Barrier to ensure previous pass finished.
     vk::Image                 offscreenImage{m_offscreenColor.image};
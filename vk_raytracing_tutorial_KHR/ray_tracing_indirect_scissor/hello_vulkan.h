@@ -36,6 +36,8 @@
 // #VKRay
 #include "nvvk/raytraceKHR_vk.hpp"
 
+#include "light_bvh.h"
+
 //--------------------------------------------------------------------------------------------------
 // Simple rasterizer of OBJ objects
 // - Each OBJ loaded are stored in an `ObjModel` and referenced by a `ObjInstance`
@@ -189,7 +191,9 @@ public:
   void createLanternIndirectCompPipeline();
   void createRtShaderBindingTable();
   void createLanternIndirectBuffer();
+  void createLightBvhBuffers();
 
+  void dispatchLanternIndirect(const vk::CommandBuffer& cmdBuf);
   void raytrace(const vk::CommandBuffer& cmdBuf, const nvmath::vec4f& clearColor);
 
   // Used to store lantern model, generated at runtime.
@@ -224,6 +228,11 @@ public:
   VkDeviceSize m_lanternCount = 0;  // Set to actual lantern count after TLAS build, as
                                     // that is the point no more lanterns may be added.
 
+  // Light BVH over the lanterns (LightBvhNode array) and the lantern indices of its
+  // leaves, used to sample lanterns in the full-screen pass.
+  nvvk::Buffer m_lightBvhNodeBuffer;
+  nvvk::Buffer m_lightBvhOrderBuffer;
+
   // Push constant for ray trace pipeline.
   struct RtPushConstant
   {
@@ -246,6 +255,13 @@ public:
 
     // See m_lanternDebug.
     int32_t lanternDebug;
+
+    // Lanterns sampled per pixel from the light BVH in the full-screen pass, 0 when
+    // the lantern passes add their light instead. See m_lanternSampling.
+    int32_t lanternSamples;
+
+    // Seed of the lantern sampling, changes every frame.
+    uint32_t frame;
   } m_rtPushConstants;
 
   // Copied to RtPushConstant::lanternDebug. If true,
@@ -253,6 +269,13 @@ public:
   // so that I can see the screen rectangle coverage.
   bool m_lanternDebug = false;
 
+  // If true, the full-screen pass samples m_lanternSamples lanterns per pixel from the
+  // light BVH, weighted by their inverse probability, instead of running one indirect
+  // pass per lantern. The lantern passes stay as the reference the sampling converges to.
+  bool     m_lanternSampling = true;
+  int      m_lanternSamples  = 4;
+  uint32_t m_frame           = 0;
+
 
   // Push constant for compute shader filling lantern indirect buffer.
   // Barely fits in 128-byte push constant limit guaranteed by spec.
@@ -0,0 +1,301 @@
+/* Copyright (c) 2014-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+#include "light_bvh.h"
+
+//--------------------------------------------------------------------------------------------------
+// Build the nodes depth first, the root is node 0. The lanterns of each leaf are
+// contiguous in getOrder().
+//
+void LightBvh::build(const std::vector<Light>& lights)
+{
+  m_lights = lights;
+  m_nodes.clear();
+  m_parents.clear();
+  m_leafOfLight.assign(lights.size(), -1);
+  m_order.resize(lights.size());
+  if(lights.empty())
+    return;
+
+  std::iota(m_order.begin(), m_order.end(), 0);
+  m_parents.push_back(-1);
+  buildRecursive(0, static_cast<uint32_t>(m_order.size()));
+}
+
+int LightBvh::buildRecursive(uint32_t first, uint32_t last)
+{
+  int index = static_cast<int>(m_nodes.size());
+  m_nodes.emplace_back();
+
+  LightBvhNode node{nvmath::vec3f(FLT_MAX), 0.f, nvmath::vec3f(-FLT_MAX), 0.f, -1, -1};
+  for(uint32_t i = first; i < last; ++i)
+  {
+    const Light& light = m_lights[m_order[i]];
+    node.boundsMin     = nvmath::nv_min(node.boundsMin, light.position);
+    node.boundsMax     = nvmath::nv_max(node.boundsMax, light.position);
+    node.power += light.power;
+    node.maxRadius = std::max(node.maxRadius, light.radius);
+  }
+
+  if(last - first <= LIGHT_BVH_LEAF_SIZE)
+  {
+    node.left  = -static_cast<int32_t>(last - first);
+    node.right = static_cast<int32_t>(first);
+    for(uint32_t i = first; i < last; ++i)
+      m_leafOfLight[m_order[i]] = index;
+    m_nodes[index] = node;
+    return index;
+  }
+
+  // Median split along the largest extent of the positions.
+  nvmath::vec3f extent = node.boundsMax - node.boundsMin;
+  int           axis   = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+  uint32_t      middle = first + (last - first) / 2;
+  std::nth_element(m_order.begin() + first, m_order.begin() + middle, m_order.begin() + last,
+                   [&](uint32_t a, uint32_t b) { return m_lights[a].position[axis] < m_lights[b].position[axis]; });
+
+  m_parents.push_back(index);
+  node.left = buildRecursive(first, middle);
+  m_parents.push_back(index);
+  node.right     = buildRecursive(middle, last);
+  m_nodes[index] = node;
+  return index;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same as lightBvhImportance in raytrace.rchit.
+//
+float LightBvh::importance(const LightBvhNode& node, const nvmath::vec3f& p) const
+{
+  nvmath::vec3f closest  = nvmath::nv_min(nvmath::nv_max(p, node.boundsMin), node.boundsMax);
+  float         distance = nvmath::length(p - closest);
+  float         fade     = std::max(0.f, 1.f - distance / node.maxRadius);
+
+  // Part of the bounds within maxRadius of p on each axis, as if the power was
+  // spread uniformly in the bounds. Positive whenever the fade is.
+  float fraction = 1.f;
+  for(int axis = 0; axis < 3; ++axis)
+  {
+    float extent = node.boundsMax[axis] - node.boundsMin[axis];
+    if(extent > 0.f)
+    {
+      float overlap = std::min(p[axis] + node.maxRadius, node.boundsMax[axis])
+                      - std::max(p[axis] - node.maxRadius, node.boundsMin[axis]);
+      fraction *= std::max(0.f, overlap) / extent;
+    }
+  }
+  return node.power * fraction * fade;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Exact contribution estimate of one lantern, the importance of a single lantern node.
+float LightBvh::weight(uint32_t light, const nvmath::vec3f& p) const
+{
+  const Light& l = m_lights[light];
+  return l.power * std::max(0.f, 1.f - nvmath::length(p - l.position) / l.radius);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same as sampleLantern in raytrace.rchit: `u` is rescaled at each level to pick the
+// next child, then a lantern of the leaf proportionally to its weight.
+//
+int LightBvh::sample(const nvmath::vec3f& p, float u, float& pdf) const
+{
+  pdf = 0.f;
+  if(m_nodes.empty() || importance(m_nodes[0], p) <= 0.f)
+    return -1;
+
+  int   index = 0;
+  float prob  = 1.f;
+  while(m_nodes[index].left >= 0)
+  {
+    const LightBvhNode& node   = m_nodes[index];
+    float               wLeft  = importance(m_nodes[node.left], p);
+    float               wRight = importance(m_nodes[node.right], p);
+    if(wLeft + wRight <= 0.f)
+      return -1;
+    float pLeft = wLeft / (wLeft + wRight);
+    if(u < pLeft)
+    {
+      index = node.left;
+      u     = u / pLeft;
+      prob *= pLeft;
+    }
+    else
+    {
+      index = node.right;
+      u     = (u - pLeft) / (1.f - pLeft);
+      prob *= 1.f - pLeft;
+    }
+    u = std::min(u, 0.99999994f);
+  }
+
+  const LightBvhNode& leaf  = m_nodes[index];
+  uint32_t            first = static_cast<uint32_t>(leaf.right);
+  uint32_t            last  = first + static_cast<uint32_t>(-leaf.left);
+  float               total = 0.f;
+  for(uint32_t i = first; i < last; ++i)
+    total += weight(m_order[i], p);
+  if(total <= 0.f)
+    return -1;
+
+  // Last lantern with a non-zero weight if rounding leaves u above the sum.
+  float target = u * total;
+  int   light  = -1;
+  float w      = 0.f;
+  for(uint32_t i = first; i < last; ++i)
+  {
+    float wi = weight(m_order[i], p);
+    if(wi <= 0.f)
+      continue;
+    light = static_cast<int>(m_order[i]);
+    w     = wi;
+    if(target < wi)
+      break;
+    target -= wi;
+  }
+
+  pdf = prob * w / total;
+  return light;
+}
+
+float LightBvh::pdf(const nvmath::vec3f& p, int light) const
+{
+  if(m_nodes.empty() || importance(m_nodes[0], p) <= 0.f)
+    return 0.f;
+
+  int                 index = m_leafOfLight[light];
+  const LightBvhNode& leaf  = m_nodes[index];
+  float               total = 0.f;
+  for(uint32_t i = leaf.right; i < uint32_t(leaf.right - leaf.left); ++i)
+    total += weight(m_order[i], p);
+  float prob = total > 0.f ? weight(light, p) / total : 0.f;
+
+  for(; m_parents[index] >= 0 && prob > 0.f; index = m_parents[index])
+  {
+    const LightBvhNode& parent = m_nodes[m_parents[index]];
+    float               wLeft  = importance(m_nodes[parent.left], p);
+    float               wRight = importance(m_nodes[parent.right], p);
+    float               w      = index == parent.left ? wLeft : wRight;
+    prob *= w > 0.f ? w / (wLeft + wRight) : 0.f;
+  }
+  return prob;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Check of the sampling at random points. The contribution of a lantern is
+// approximated by power * fade, which is what the sampling has to be unbiased for:
+// the shading and shadow terms only scale each lantern's contribution.
+//
+bool checkLightBvh(uint32_t lightCount)
+{
+  using Clock = std::chrono::high_resolution_clock;
+
+  // Lanterns spread with a density of 1 per 8 cubic units, radii from 1 to 4.
+  std::mt19937                          rng(1234);
+  std::uniform_real_distribution<float> uniform(0.f, 1.f);
+  float                                 side = 2.f * std::cbrt(float(lightCount));
+
+  std::vector<LightBvh::Light> lights(lightCount);
+  for(auto& light : lights)
+  {
+    light.position = nvmath::vec3f(uniform(rng), uniform(rng), uniform(rng)) * side;
+    light.power    = 0.1f + uniform(rng);
+    light.radius   = 1.f + 3.f * uniform(rng);
+  }
+
+  LightBvh bvh;
+  auto     start = Clock::now();
+  bvh.build(lights);
+  double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  printf("Light BVH: %u lanterns, %zu nodes, built in %.2f ms\n", lightCount, bvh.getNodes().size(),
+         buildMs);
+
+  const int nbPoints  = 16;
+  const int nbSamples = 1 << 16;
+  bool      success   = true;
+  for(int i = 0; i < nbPoints; ++i)
+  {
+    nvmath::vec3f p = nvmath::vec3f(uniform(rng), uniform(rng), uniform(rng)) * side;
+
+    // Exact sum, and every lantern reaching p must have a non-zero probability.
+    double exact   = 0.0;
+    double sumPdf  = 0.0;
+    int    reached = 0;
+    int    missed  = 0;
+    for(uint32_t l = 0; l < lightCount; ++l)
+    {
+      float fade = std::max(0.f, 1.f - nvmath::length(p - lights[l].position) / lights[l].radius);
+      float pdf  = bvh.pdf(p, int(l));
+      exact += lights[l].power * fade;
+      sumPdf += pdf;
+      reached += fade > 0.f;
+      missed += fade > 0.f && pdf <= 0.f;
+    }
+
+    // Monte Carlo estimate with one lantern per sample.
+    double sum    = 0.0;
+    double sumSq  = 0.0;
+    int    badPdf = 0;
+    int    noLight = 0;
+    for(int s = 0; s < nbSamples; ++s)
+    {
+      float pdf   = 0.f;
+      int   light = bvh.sample(p, uniform(rng), pdf);
+      if(light < 0)
+      {
+        noLight++;
+        continue;
+      }
+      float  fade  = std::max(0.f, 1.f - nvmath::length(p - lights[light].position) / lights[light].radius);
+      double value = lights[light].power * fade / pdf;
+      sum += value;
+      sumSq += value * value;
+      badPdf += std::abs(pdf - bvh.pdf(p, light)) > 1e-3f * pdf;
+    }
+    double mean   = sum / nbSamples;
+    double stdErr = std::sqrt(std::max(0.0, sumSq / nbSamples - mean * mean) / nbSamples);
+
+    // Traversals ending in nodes whose lanterns do not reach p return no lantern:
+    // this happens with the probability missing from the sum of the pdfs.
+    double noLightRate = double(noLight) / nbSamples;
+    double noLightErr  = std::sqrt(std::max(0.0, 1.0 - sumPdf) * sumPdf / nbSamples);
+
+    bool ok = missed == 0 && badPdf == 0 && std::abs(mean - exact) <= 5.0 * stdErr + 1e-6 * exact
+              && sumPdf <= 1.0 + 1e-4 && std::abs(noLightRate - (1.0 - sumPdf)) <= 5.0 * noLightErr + 1e-4;
+    printf("  point %2d: %5d lanterns reach, sum %.4f, estimate %.4f +- %.4f, sum of pdf %.3f%s\n", i,
+           reached, exact, mean, stdErr, sumPdf, ok ? "" : "  FAILED");
+    success = success && ok;
+  }
+  return success;
+}
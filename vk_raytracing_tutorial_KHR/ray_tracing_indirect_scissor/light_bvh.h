@@ -0,0 +1,109 @@
+/* Copyright (c) 2014-2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "nvmath/nvmath.h"
+
+// Node of the light BVH, mirrored as LightBvhNode in shaders/LightBvhNode.glsl
+// (scalar layout).
+struct LightBvhNode
+{
+  nvmath::vec3f boundsMin;  // Bounds of the lantern positions below this node.
+  float         power;      // Sum of the lantern powers below this node.
+  nvmath::vec3f boundsMax;
+  float         maxRadius;  // Largest lantern radius below this node.
+  int32_t       left;       // Index of the left child, or -(lantern count) of a leaf.
+  int32_t       right;      // Index of the right child, or first lantern of a leaf in getOrder().
+};
+
+// Max lanterns per leaf, picked among with their exact weight.
+static const uint32_t LIGHT_BVH_LEAF_SIZE = 8;
+
+//--------------------------------------------------------------------------------------------------
+// Binary BVH over the lanterns, used to pick one lantern per shading point with a
+// probability proportional to an estimate of its contribution, instead of running
+// one ray trace pass per lantern.
+//
+// A lantern only lights points closer than its radius, fading linearly to 0 at the
+// radius. The importance of a node at point p is
+//     power * max(0, 1 - distance(p, bounds) / maxRadius) * overlap
+// where overlap is the part of the bounds within maxRadius of p, and is larger than
+// zero for every node containing a lantern that reaches p. Traversal picks a child
+// proportionally to its importance, then a lantern of the leaf proportionally to
+// its exact power * fade. Every lantern lighting p has a non-zero probability, and
+// dividing its contribution by that probability gives an unbiased estimate of the
+// sum over all lanterns.
+//
+// The importance is only an estimate: a traversal may end in a leaf whose lanterns
+// all are too far from p, the sample then adds no light. The probabilities of a
+// point sum to less than 1 by that amount.
+//
+// The traversal is duplicated in raytrace.rchit, sample() and pdf() here are the
+// reference used to check it.
+class LightBvh
+{
+public:
+  struct Light
+  {
+    nvmath::vec3f position;
+    float         power;   // Luminance of the color times brightness.
+    float         radius;  // Max world-space distance that light illuminates.
+  };
+
+  // Top-down build splitting the lanterns at the median of the largest axis.
+  void build(const std::vector<Light>& lights);
+
+  const std::vector<LightBvhNode>& getNodes() const { return m_nodes; }
+  const std::vector<uint32_t>&     getOrder() const { return m_order; }
+
+  float importance(const LightBvhNode& node, const nvmath::vec3f& p) const;
+  float weight(uint32_t light, const nvmath::vec3f& p) const;
+
+  // Pick a lantern for point p with u in [0,1). Returns -1 if no lantern reaches p,
+  // otherwise the lantern index and its probability in `pdf`.
+  int sample(const nvmath::vec3f& p, float u, float& pdf) const;
+
+  // Probability that sample() at point p returns lantern `light`.
+  float pdf(const nvmath::vec3f& p, int light) const;
+
+private:
+  int buildRecursive(uint32_t first, uint32_t last);
+
+  std::vector<Light>        m_lights;
+  std::vector<uint32_t>     m_order;        // Lantern indices, grouped by leaf.
+  std::vector<LightBvhNode> m_nodes;
+  std::vector<int32_t>      m_parents;      // Parent of each node, -1 for the root.
+  std::vector<int32_t>      m_leafOfLight;  // Leaf node of each lantern.
+};
+
+// Builds a BVH over `lightCount` random lanterns, prints the build time and checks
+// at random points that every lantern reaching the point can be sampled, that
+// sample() and pdf() agree, and that the estimator converges to the sum over all
+// lanterns. Returns false if a check fails.
+bool checkLightBvh(uint32_t lightCount);
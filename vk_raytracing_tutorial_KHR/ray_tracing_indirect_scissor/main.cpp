@@ -29,7 +29,10 @@
 // pipeline If you are new to ImGui, see examples/README.txt and documentation
 // at the top of imgui.cpp.
 
+#include <algorithm>
 #include <array>
+#include <cstdlib>
+#include <cstring>
 #include <vulkan/vulkan.hpp>
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
@@ -37,6 +40,7 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 #include "imgui/backends/imgui_impl_glfw.h"
 
 #include "hello_vulkan.h"
+#include "light_bvh.h"
 #include "imgui/extras/imgui_camera_widget.h"
 #include "nvh/cameramanipulator.hpp"
 #include "nvh/fileoperations.hpp"
@@ -73,6 +77,11 @@ void renderUI(HelloVulkan& helloVk)
     ImGui::SliderFloat("Intensity", &helloVk.m_pushConstant.lightIntensity, 0.f, 150.f);
     ImGui::Checkbox("Lantern Debug", &helloVk.m_lanternDebug);
   }
+  if(ImGui::CollapsingHeader("Lanterns"))
+  {
+    ImGui::Checkbox("Light BVH sampling", &helloVk.m_lanternSampling);
+    ImGui::SliderInt("Samples", &helloVk.m_lanternSamples, 1, 16);
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -86,7 +95,15 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
+  // -lightbvh [count]: check the light BVH sampling over random lanterns and exit.
+  for(int i = 1; i < argc; ++i)
+  {
+    if(strcmp(argv[i], "-lightbvh") == 0)
+    {
+      uint32_t count = (i + 1 < argc) ? uint32_t(atoi(argv[i + 1])) : 100000;
+      return checkLightBvh(std::max(count, 1u)) ? 0 : 1;
+    }
+  }
 
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
@@ -201,6 +218,7 @@ int main(int argc, char** argv)
   helloVk.createBottomLevelAS();
   helloVk.createTopLevelAS();
   helloVk.createLanternIndirectBuffer();
+  helloVk.createLightBvhBuffers();
   helloVk.createRtDescriptorSet();
   helloVk.createRtPipeline();
   helloVk.createLanternIndirectDescriptorSet();
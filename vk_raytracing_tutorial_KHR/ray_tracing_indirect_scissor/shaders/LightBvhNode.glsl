@@ -0,0 +1,10 @@
+// Node of the light BVH, see LightBvh in light_bvh.h.
+struct LightBvhNode
+{
+  vec3  boundsMin;  // Bounds of the lantern positions below this node.
+  float power;      // Sum of the lantern powers below this node.
+  vec3  boundsMax;
+  float maxRadius;  // Largest lantern radius below this node.
+  int   left;       // Index of the left child, or -(lantern count) of a leaf.
+  int   right;      // Index of the right child, or first lantern of a leaf in the lantern order.
+};
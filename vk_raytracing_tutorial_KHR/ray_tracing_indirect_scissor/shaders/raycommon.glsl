@@ -16,5 +16,7 @@ layout(push_constant) uniform Constants
   int   screenX;
   int   screenY;
   int   lanternDebug;
+  int   lanternSamples;    // Lanterns sampled from the light BVH in the full-screen pass, 0 for lantern passes.
+  uint  frame;             // Seed of the lantern sampling.
 }
 pushC;
\ No newline at end of file